@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+
+#include "config.h"
+#include "util/morton.h"
+#include "asteroid.h"
+
+/* uniform random float in [0, 1); numerical recipes LCG, deterministic across
+   platforms unlike rand() */
+static inline float
+randf(unsigned *state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return (float)(*state >> 8) * (1.f / 16777216.f);
+}
+
+/* cell_index - index of the clustering cell containing the point. */
+static inline int
+cell_index(float x, float y, float z, float half_extent_m, int cells_per_axis)
+{
+  int cx = (int)((x + half_extent_m) / CULL_CLUSTER_SIZE_M);
+  int cy = (int)((y + half_extent_m) / CULL_CLUSTER_SIZE_M);
+  int cz = (int)((z + half_extent_m) / CULL_CLUSTER_SIZE_M);
+
+  /* points exactly on the max face belong to the last cell */
+  cx = (cx < cells_per_axis) ? cx : cells_per_axis - 1;
+  cy = (cy < cells_per_axis) ? cy : cells_per_axis - 1;
+  cz = (cz < cells_per_axis) ? cz : cells_per_axis - 1;
+
+  return (cz * cells_per_axis + cy) * cells_per_axis + cx;
+}
+
+void
+asteroid_field_cluster(const struct asteroid_field *af, int first, int count, struct cull_cluster *cl)
+{
+  float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+  for(int i = first; i < first + count; ++i)
+  {
+    min[0] = fminf(min[0], af->x[i] - af->r[i]);
+    min[1] = fminf(min[1], af->y[i] - af->r[i]);
+    min[2] = fminf(min[2], af->z[i] - af->r[i]);
+    max[0] = fmaxf(max[0], af->x[i] + af->r[i]);
+    max[1] = fmaxf(max[1], af->y[i] + af->r[i]);
+    max[2] = fmaxf(max[2], af->z[i] + af->r[i]);
+  }
+
+  cl->x = (min[0] + max[0]) * 0.5f;
+  cl->y = (min[1] + max[1]) * 0.5f;
+  cl->z = (min[2] + max[2]) * 0.5f;
+  cl->r = 0.f;
+  for(int i = first; i < first + count; ++i)
+  {
+    float dx = af->x[i] - cl->x, dy = af->y[i] - cl->y, dz = af->z[i] - cl->z;
+    cl->r = fmaxf(cl->r, sqrtf(dx * dx + dy * dy + dz * dz) + af->r[i]);
+  }
+  cl->first = first;
+  cl->count = count;
+}
+
+void
+asteroid_field_init(struct asteroid_field *af,
+                    struct arena *arena,
+                    int count,
+                    float half_extent_m,
+                    unsigned seed)
+{
+  assert(af != NULL && count >= 0 && half_extent_m > 0.f);
+
+  int cells_per_axis = (int)ceilf((2.f * half_extent_m) / CULL_CLUSTER_SIZE_M);
+  int cell_count = cells_per_axis * cells_per_axis * cells_per_axis;
+
+  af->count = count;
+  af->x = ARENA_NEW(arena, float, count * 4);
+  af->y = af->x + count;
+  af->z = af->y + count;
+  af->r = af->z + count;
+
+  /* the cells are laid out in the Morton order of their coordinates, so the
+     asteroids of neighbouring cells, e.g. those a query around a point
+     visits, are mostly near each other in memory */
+  arena_mark scratch = arena_get_mark(&memory_frame);
+  struct morton_sort order;
+  morton_sort_init(&order, cell_count, &memory_frame);
+  morton_sort_begin(&order, cell_count);
+  uint32_t *codes = morton_sort_keys(&order), *cells = morton_sort_values(&order);
+  for(int c = 0; c < cell_count; ++c)
+  {
+    codes[c] = morton_code(c % cells_per_axis,
+                           (c / cells_per_axis) % cells_per_axis,
+                           c / (cells_per_axis * cells_per_axis));
+    cells[c] = c;
+  }
+  morton_sort_run(&order);
+  cells = morton_sort_values(&order);
+  int *cell_rank = frame_alloc(sizeof(int) * cell_count);
+  for(int r = 0; r < cell_count; ++r)
+    cell_rank[cells[r]] = r;
+
+  /* generate unsorted into 'tmp' as (x, y, z, r) records */
+  float *tmp = frame_alloc(sizeof(float) * count * 4);
+  int *cell = frame_alloc(sizeof(int) * count);
+  int *cell_start = frame_alloc(sizeof(int) * (cell_count + 1));
+  memset(cell_start, 0, sizeof(int) * (cell_count + 1));
+
+  unsigned state = seed;
+  for(int i = 0; i < count; ++i)
+  {
+    float *a = tmp + i * 4;
+    a[0] = (randf(&state) * 2.f - 1.f) * half_extent_m;
+    a[1] = (randf(&state) * 2.f - 1.f) * half_extent_m;
+    a[2] = (randf(&state) * 2.f - 1.f) * half_extent_m;
+    a[3] = ASTEROID_MIN_RADIUS_M + randf(&state) * (ASTEROID_MAX_RADIUS_M - ASTEROID_MIN_RADIUS_M);
+    cell[i] = cell_rank[cell_index(a[0], a[1], a[2], half_extent_m, cells_per_axis)];
+    ++cell_start[cell[i] + 1];
+  }
+
+  /* counting sort by cell so each cell's asteroids are contiguous; cell_start
+     and cell are by rank in the Morton order from here */
+  for(int r = 0; r < cell_count; ++r)
+    cell_start[r + 1] += cell_start[r];
+
+  int *cursor = frame_alloc(sizeof(int) * cell_count);
+  memcpy(cursor, cell_start, sizeof(int) * cell_count);
+  for(int i = 0; i < count; ++i)
+  {
+    int j = cursor[cell[i]]++;
+    af->x[j] = tmp[i * 4 + 0];
+    af->y[j] = tmp[i * 4 + 1];
+    af->z[j] = tmp[i * 4 + 2];
+    af->r[j] = tmp[i * 4 + 3];
+  }
+
+  af->mw = ARENA_NEW(arena, struct matrix44f, count ? count : 1);
+  for(int i = 0; i < count; ++i)
+  {
+    scale44fm(af->r[i] * ASTEROID_CUBE_SCALE, &af->mw[i]);
+    af->mw[i].m[3][0] = af->x[i];
+    af->mw[i].m[3][1] = af->y[i];
+    af->mw[i].m[3][2] = af->z[i];
+  }
+
+  af->cluster_count = 0;
+  for(int r = 0; r < cell_count; ++r)
+    if(cell_start[r + 1] > cell_start[r])
+      ++af->cluster_count;
+
+  af->clusters = ARENA_NEW(arena, struct cull_cluster, af->cluster_count ? af->cluster_count : 1);
+  af->half_extent_m = half_extent_m;
+  af->cells_per_axis = cells_per_axis;
+  af->cell_clusters = ARENA_NEW(arena, int, cell_count);
+  for(int r = 0, k = 0; r < cell_count; ++r)
+  {
+    int c = cells[r];
+    af->cell_clusters[c] = -1;
+    if(cell_start[r + 1] > cell_start[r])
+    {
+      af->cell_clusters[c] = k;
+      asteroid_field_cluster(af, cell_start[r], cell_start[r + 1] - cell_start[r], &af->clusters[k++]);
+    }
+  }
+
+  arena_release(&memory_frame, scratch);
+}
+
+/* segment_distance2 - squared distance from the point c to the segment p0-p1. */
+static inline float
+segment_distance2(const float p0[3], const float d[3], float d2, float cx, float cy, float cz)
+{
+  float wx = cx - p0[0], wy = cy - p0[1], wz = cz - p0[2];
+  float t = d2 > 0.f ? (wx * d[0] + wy * d[1] + wz * d[2]) / d2 : 0.f;
+  t = t < 0.f ? 0.f : t > 1.f ? 1.f : t;
+  float ex = wx - d[0] * t, ey = wy - d[1] * t, ez = wz - d[2] * t;
+  return ex * ex + ey * ey + ez * ez;
+}
+
+int
+asteroid_field_hit(const struct asteroid_field *af,
+                   float x0, float y0, float z0,
+                   float x1, float y1, float z1)
+{
+  int n = af->cells_per_axis;
+  float h = af->half_extent_m;
+  if(fabsf(x1) > h + CULL_CLUSTER_SIZE_M || fabsf(y1) > h + CULL_CLUSTER_SIZE_M || fabsf(z1) > h + CULL_CLUSTER_SIZE_M)
+    return -1;
+
+  float p0[3] = {x0, y0, z0};
+  float d[3] = {x1 - x0, y1 - y0, z1 - z0};
+  float d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+  /* the segment and any asteroid it touches lie within the cells around p1,
+     as both are smaller than a cell */
+  int cx = (int)floorf((x1 + h) / CULL_CLUSTER_SIZE_M);
+  int cy = (int)floorf((y1 + h) / CULL_CLUSTER_SIZE_M);
+  int cz = (int)floorf((z1 + h) / CULL_CLUSTER_SIZE_M);
+  for(int z = cz - 1; z <= cz + 1; ++z)
+  {
+    if(z < 0 || z >= n)
+      continue;
+    for(int y = cy - 1; y <= cy + 1; ++y)
+    {
+      if(y < 0 || y >= n)
+        continue;
+      for(int x = cx - 1; x <= cx + 1; ++x)
+      {
+        if(x < 0 || x >= n)
+          continue;
+        int k = af->cell_clusters[(z * n + y) * n + x];
+        if(k < 0)
+          continue;
+
+        const struct cull_cluster *cl = &af->clusters[k];
+        if(segment_distance2(p0, d, d2, cl->x, cl->y, cl->z) > cl->r * cl->r)
+          continue;
+        for(int a = cl->first; a < cl->first + cl->count; ++a)
+          if(segment_distance2(p0, d, d2, af->x[a], af->y[a], af->z[a]) <= af->r[a] * af->r[a])
+            return a;
+      }
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,85 @@
+#ifndef _ASTEROID_H_
+#define _ASTEROID_H_
+
+#include "cull.h"
+#include "math/matrix44f.h"
+#include "util/memory.h"
+
+/* asteroids are drawn as cubes inscribed in their bounding sphere; this is the
+   half side length of the cube as a fraction of the sphere radius, 1/sqrt(3) */
+#define ASTEROID_CUBE_SCALE 0.57735f
+
+/* a static field of asteroids stored SoA, i.e. one array per component, so
+ * the positions and radii can be streamed straight into the culling SIMD.
+ *
+ * asteroids are sorted into cubic cells of side CULL_CLUSTER_SIZE_M; the
+ * asteroids of each cell are contiguous in the arrays and the cell is
+ * described by a cull_cluster with a sphere bounding all its asteroids. The
+ * cells, and so the clusters, are in the Morton order of their coordinates,
+ * see util/morton.h.
+ */
+struct asteroid_field
+{
+  int count;
+
+  /* position w.r.t world space and bounding radius (unit: meters) */
+  float *x;
+  float *y;
+  float *z;
+  float *r;
+
+  /* model-world matrices of the asteroid cubes; computed once as the field is
+     static, shared by every view and backend that draws the field */
+  struct matrix44f *mw;
+
+  int cluster_count;
+  struct cull_cluster *clusters;
+
+  /* the clustering cells; the index of each cell's cluster, or -1 if the
+     cell is empty, by cell index (z * cells + y) * cells + x */
+  float half_extent_m;
+  int cells_per_axis;
+  int *cell_clusters;
+};
+
+/* asteroid_field_init - scatters 'count' asteroids uniformly through the cube
+ *   of half side length 'half_extent_m' centered on the world origin. The
+ *   field's arrays are allocated together from the arena, and freed with it;
+ *   the frame scratch arena is used whilst building them.
+ *
+ * @seed - the same seed always generates the same field.
+ */
+void
+asteroid_field_init(struct asteroid_field *af,
+                    struct arena *arena,
+                    int count,
+                    float half_extent_m,
+                    unsigned seed);
+
+/* asteroid_field_cluster - the cluster of the asteroids [first, first + count)
+ *   with a sphere bounding all of them. */
+void
+asteroid_field_cluster(const struct asteroid_field *af, int first, int count, struct cull_cluster *cl);
+
+/* asteroid_field_hit - the asteroid hit by a point moving from p0 to p1, e.g.
+ *   a projectile over a tick; only the cells around p1 are searched, so the
+ *   segment must be shorter than CULL_CLUSTER_SIZE_M.
+ *
+ * returns - index of the first asteroid found whose sphere the segment
+ *   touches, or -1 if none.
+ */
+int
+asteroid_field_hit(const struct asteroid_field *af,
+                   float x0, float y0, float z0,
+                   float x1, float y1, float z1);
+
+/* asteroid_field_spheres - access the field as a set of spheres for culling. */
+static inline struct cull_spheres
+asteroid_field_spheres(struct asteroid_field *af)
+{
+  return (struct cull_spheres){
+    af->count, af->x, af->y, af->z, af->r, af->cluster_count, af->clusters
+  };
+}
+
+#endif
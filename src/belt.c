@@ -0,0 +1,618 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "config.h"
+#include "util/clock.h"
+#include "util/log.h"
+#include "util/trace.h"
+#include "util/rng.h"
+#include "belt.h"
+
+#define BELT_SECTOR_CLUSTERS (BELT_SECTOR_CELLS * BELT_SECTOR_CELLS * BELT_SECTOR_CELLS)
+
+static inline int
+sector_state(const struct belt_sector *sec)
+{
+  return __atomic_load_n(&sec->state, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+set_sector_state(struct belt_sector *sec, int state)
+{
+  __atomic_store_n(&sec->state, state, __ATOMIC_RELEASE);
+}
+
+static inline unsigned
+coord_hash(struct sector_coord c)
+{
+  return ((unsigned)c.x * 73856093u) ^ ((unsigned)c.y * 19349663u) ^ ((unsigned)c.z * 83492791u);
+}
+
+/* sector_id - the entity id of the sector's random stream; 21 bits of each
+ * coordinate, so the belt repeats every 2^21 sectors along an axis. */
+static inline uint64_t
+sector_id(struct sector_coord c)
+{
+  return ((uint64_t)(c.x & 0x1fffff) << 42) | ((uint64_t)(c.y & 0x1fffff) << 21) | (uint64_t)(c.z & 0x1fffff);
+}
+
+/* sector_gap2 - squared distance between the nearest points of two sectors;
+ * any point of 'b' is at least this far from any point of 'a'. */
+static inline float
+sector_gap2(struct sector_coord a, struct sector_coord b)
+{
+  int64_t d[3] = {(int64_t)a.x - b.x, (int64_t)a.y - b.y, (int64_t)a.z - b.z};
+  float gap2 = 0.f;
+  for(int i = 0; i < 3; ++i)
+  {
+    int64_t g = (d[i] < 0 ? -d[i] : d[i]) - 1;
+    if(g > 0)
+      gap2 += (float)g * (float)g;
+  }
+  return gap2 * WORLD_SECTOR_SIZE_M * WORLD_SECTOR_SIZE_M;
+}
+
+/**** SECTOR TABLE ***********************************************************/
+
+static int
+table_find(const struct belt *b, struct sector_coord c)
+{
+  for(unsigned i = coord_hash(c) & b->table_mask;; i = (i + 1) & b->table_mask)
+  {
+    int slot = b->table[i];
+    if(slot < 0 || sector_equal(b->sectors[slot].coord, c))
+      return slot;
+  }
+}
+
+static void
+table_insert(struct belt *b, int slot)
+{
+  unsigned i = coord_hash(b->sectors[slot].coord) & b->table_mask;
+  while(b->table[i] >= 0)
+    i = (i + 1) & b->table_mask;
+  b->table[i] = slot;
+}
+
+/* table_remove - removes the slot, shifting back the entries after it which
+ * probed past it so no lookup ends early at the hole. */
+static void
+table_remove(struct belt *b, int slot)
+{
+  unsigned i = coord_hash(b->sectors[slot].coord) & b->table_mask;
+  while(b->table[i] != slot)
+    i = (i + 1) & b->table_mask;
+
+  for(unsigned j = (i + 1) & b->table_mask; b->table[j] >= 0; j = (j + 1) & b->table_mask)
+  {
+    unsigned home = coord_hash(b->sectors[b->table[j]].coord) & b->table_mask;
+
+    /* the entry may fill the hole if its home is not cyclically in (i, j] */
+    bool reachable = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+    if(!reachable)
+    {
+      b->table[i] = b->table[j];
+      i = j;
+    }
+  }
+  b->table[i] = -1;
+}
+
+/**** GENERATION *************************************************************/
+
+/* generate_sector - generates the slot's sector into its slot; the asteroids
+ * are counting sorted into the sector's cells, each cell a cluster, as
+ * asteroid_field_init sorts the world box. Runs on any thread; touches only
+ * the slot's memory. */
+static void
+generate_sector(struct belt *b, int slot)
+{
+  TRACE_ZONE("generate_sector");
+  uint64_t start_ns = clock_now_ns();
+
+  struct belt_sector *sec = &b->sectors[slot];
+  struct asteroid_field *af = &b->field;
+  struct rng_stream rng = rng_stream(b->seed, sector_id(sec->coord), RNG_SPAWN, 0);
+
+  /* each asteroid takes 4 uniforms: position within the sector and radius */
+  float u[4 * BELT_SECTOR_MAX_ASTEROIDS];
+  rng_uniform(&rng, u, 1);
+  int count = BELT_SECTOR_MIN_ASTEROIDS + (int)(u[0] * (BELT_SECTOR_MAX_ASTEROIDS - BELT_SECTOR_MIN_ASTEROIDS + 1));
+  count = count < BELT_SECTOR_MAX_ASTEROIDS ? count : BELT_SECTOR_MAX_ASTEROIDS;
+  rng_uniform(&rng, u, 4 * count);
+
+  int cell[BELT_SECTOR_MAX_ASTEROIDS];
+  int cell_start[BELT_SECTOR_CLUSTERS + 1] = {0};
+  for(int i = 0; i < count; ++i)
+  {
+    int cx = (int)(u[4 * i + 0] * BELT_SECTOR_CELLS);
+    int cy = (int)(u[4 * i + 1] * BELT_SECTOR_CELLS);
+    int cz = (int)(u[4 * i + 2] * BELT_SECTOR_CELLS);
+    cell[i] = (cz * BELT_SECTOR_CELLS + cy) * BELT_SECTOR_CELLS + cx;
+    ++cell_start[cell[i] + 1];
+  }
+  for(int c = 0; c < BELT_SECTOR_CLUSTERS; ++c)
+    cell_start[c + 1] += cell_start[c];
+
+  /* relative to the origin the slot was given when requested */
+  int first = slot * BELT_SECTOR_MAX_ASTEROIDS;
+  struct vector4f o = origin_shift(sec->coord, sec->origin);
+  int cursor[BELT_SECTOR_CLUSTERS];
+  memcpy(cursor, cell_start, sizeof(cursor));
+  for(int i = 0; i < count; ++i)
+  {
+    int j = first + cursor[cell[i]]++;
+    af->x[j] = o.x + u[4 * i + 0] * WORLD_SECTOR_SIZE_M;
+    af->y[j] = o.y + u[4 * i + 1] * WORLD_SECTOR_SIZE_M;
+    af->z[j] = o.z + u[4 * i + 2] * WORLD_SECTOR_SIZE_M;
+    af->r[j] = ASTEROID_MIN_RADIUS_M + u[4 * i + 3] * (ASTEROID_MAX_RADIUS_M - ASTEROID_MIN_RADIUS_M);
+  }
+
+  sec->cluster_count = 0;
+  for(int c = 0; c < BELT_SECTOR_CLUSTERS; ++c)
+  {
+    if(cell_start[c + 1] > cell_start[c])
+    {
+      asteroid_field_cluster(af,
+                             first + cell_start[c],
+                             cell_start[c + 1] - cell_start[c],
+                             &sec->clusters[sec->cluster_count++]);
+    }
+  }
+  sec->count = count;
+  sec->generate_ns = clock_now_ns() - start_ns;
+  set_sector_state(sec, SECTOR_READY);
+}
+
+static void
+generate_job(void *arg, int begin, int end)
+{
+  for(int slot = begin; slot < end; ++slot)
+    generate_sector(arg, slot);
+}
+
+/**** RESIDENCY **************************************************************/
+
+void
+belt_init(struct belt *b, struct arena *arena, size_t budget_bytes, unsigned seed)
+{
+  assert(b != NULL && arena != NULL);
+
+  memset(b, 0, sizeof(struct belt));
+  b->seed = seed;
+  b->background = jobs_thread_count() > 1;
+  b->origin = b->stale_origin = (struct sector_coord){0, 0, 0};
+
+  /* a slot's asteroids, its sector and clusters, its share of the field's
+     cluster list and of the table */
+  size_t slot_bytes = BELT_SECTOR_MAX_ASTEROIDS * 4 * sizeof(float) +
+                      sizeof(struct belt_sector) +
+                      2 * BELT_SECTOR_CLUSTERS * sizeof(struct cull_cluster) +
+                      2 * sizeof(int);
+  b->slot_count = (int)(budget_bytes / slot_bytes);
+  assert(b->slot_count > 0);
+  b->rebase_cursor = b->slot_count;
+
+  unsigned table_size = 1;
+  while(table_size < 2u * (unsigned)b->slot_count)
+    table_size <<= 1;
+  b->table_mask = table_size - 1;
+  b->table = ARENA_NEW(arena, int, table_size);
+  for(unsigned i = 0; i < table_size; ++i)
+    b->table[i] = -1;
+
+  b->sectors = ARENA_NEW(arena, struct belt_sector, b->slot_count);
+  struct cull_cluster *clusters = ARENA_NEW(arena, struct cull_cluster, b->slot_count * BELT_SECTOR_CLUSTERS);
+  for(int s = 0; s < b->slot_count; ++s)
+  {
+    memset(&b->sectors[s], 0, sizeof(struct belt_sector));
+    b->sectors[s].clusters = clusters + s * BELT_SECTOR_CLUSTERS;
+  }
+
+  struct asteroid_field *af = &b->field;
+  af->count = b->slot_count * BELT_SECTOR_MAX_ASTEROIDS;
+  af->x = ARENA_NEW(arena, float, af->count * 4);
+  af->y = af->x + af->count;
+  af->z = af->y + af->count;
+  af->r = af->z + af->count;
+  af->mw = NULL;
+  af->cluster_count = 0;
+  af->clusters = ARENA_NEW(arena, struct cull_cluster, b->slot_count * BELT_SECTOR_CLUSTERS);
+  af->half_extent_m = 0.f;
+  af->cells_per_axis = 0;
+  af->cell_clusters = NULL;
+
+  log_write(LOG_INFO,
+            "belt: %d sector slots of %zu bytes, %d asteroids at most; generated %s",
+            b->slot_count,
+            slot_bytes,
+            af->count,
+            b->background ? "by the job system's workers" : "in the update, the pool has no workers");
+}
+
+/* evict - frees a live sector's slot. */
+static void
+evict(struct belt *b, int slot)
+{
+  struct belt_sector *sec = &b->sectors[slot];
+  assert(sector_state(sec) == SECTOR_LIVE);
+
+  table_remove(b, slot);
+  b->live_asteroids -= sec->count;
+  set_sector_state(sec, SECTOR_FREE);
+  ++b->evicted;
+}
+
+/* take_slot - a free slot, else the slot of the live sector farthest ahead of
+ * the ship which is beyond the eviction distance.
+ *
+ * returns - the slot, or -1 if every sector is wanted or generating.
+ */
+static int
+take_slot(struct belt *b, bool *evicted)
+{
+  const float keep_m = BELT_LOAD_RADIUS_M + WORLD_SECTOR_SIZE_M;
+  float victim_gap2 = keep_m * keep_m;
+  int victim = -1;
+  for(int s = 0; s < b->slot_count; ++s)
+  {
+    int state = sector_state(&b->sectors[s]);
+    if(state == SECTOR_FREE)
+      return s;
+    if(state != SECTOR_LIVE)
+      continue;
+
+    float ship2 = sector_gap2(b->ship_sector, b->sectors[s].coord);
+    float ahead2 = sector_gap2(b->ahead_sector, b->sectors[s].coord);
+    if(ship2 > keep_m * keep_m && ahead2 > victim_gap2)
+    {
+      victim = s;
+      victim_gap2 = ahead2;
+    }
+  }
+  if(victim >= 0)
+  {
+    evict(b, victim);
+    *evicted = true;
+  }
+  return victim;
+}
+
+struct wanted_sector
+{
+  struct sector_coord coord;
+  float gap2;
+};
+
+/* compare_wanted - nearest first; ties in coordinate order so the order is
+ * the same every run. */
+static int
+compare_wanted(const void *a, const void *b)
+{
+  const struct wanted_sector *x = a, *y = b;
+  if(x->gap2 != y->gap2)
+    return x->gap2 < y->gap2 ? -1 : 1;
+  if(x->coord.z != y->coord.z)
+    return x->coord.z < y->coord.z ? -1 : 1;
+  if(x->coord.y != y->coord.y)
+    return x->coord.y < y->coord.y ? -1 : 1;
+  return (x->coord.x > y->coord.x) - (x->coord.x < y->coord.x);
+}
+
+/* request_sectors - starts generating the missing sectors within the load
+ * radius of the ship's and lookahead sectors, nearest first, whilst fewer
+ * than 'most' are generating. Uses frame scratch.
+ *
+ * returns - true if none were missing.
+ */
+static bool
+request_sectors(struct belt *b, int most, bool *evicted)
+{
+  struct sector_coord ship = b->ship_sector, ahead = b->ahead_sector;
+  int reach = (int)ceilf(BELT_LOAD_RADIUS_M / WORLD_SECTOR_SIZE_M) + 1;
+  struct sector_coord lo = {
+    (ship.x < ahead.x ? ship.x : ahead.x) - reach,
+    (ship.y < ahead.y ? ship.y : ahead.y) - reach,
+    (ship.z < ahead.z ? ship.z : ahead.z) - reach
+  };
+  struct sector_coord hi = {
+    (ship.x > ahead.x ? ship.x : ahead.x) + reach,
+    (ship.y > ahead.y ? ship.y : ahead.y) + reach,
+    (ship.z > ahead.z ? ship.z : ahead.z) + reach
+  };
+
+  int capacity = (hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+  struct wanted_sector *missing = frame_alloc(sizeof(struct wanted_sector) * capacity);
+  int missing_count = 0;
+
+  const float load2 = BELT_LOAD_RADIUS_M * BELT_LOAD_RADIUS_M;
+  for(int32_t z = lo.z; z <= hi.z; ++z)
+  {
+    for(int32_t y = lo.y; y <= hi.y; ++y)
+    {
+      for(int32_t x = lo.x; x <= hi.x; ++x)
+      {
+        struct sector_coord c = {x, y, z};
+        float ship2 = sector_gap2(ship, c), ahead2 = sector_gap2(ahead, c);
+        float gap2 = ship2 < ahead2 ? ship2 : ahead2;
+        if(gap2 > load2 || table_find(b, c) >= 0)
+          continue;
+        missing[missing_count++] = (struct wanted_sector){c, gap2};
+      }
+    }
+  }
+  if(missing_count == 0)
+    return true;
+
+  qsort(missing, missing_count, sizeof(struct wanted_sector), compare_wanted);
+  for(int i = 0; i < missing_count && b->generating < most; ++i)
+  {
+    int slot = take_slot(b, evicted);
+    if(slot < 0)
+    {
+      ++b->deferred;
+      LOGF_WARNING_RATE(1, "belt: no sector slot to free for %d wanted sectors; the budget is too small",
+                        missing_count - i);
+      break;
+    }
+
+    struct belt_sector *sec = &b->sectors[slot];
+    sec->coord = missing[i].coord;
+    sec->origin = b->origin;
+    set_sector_state(sec, SECTOR_GENERATING);
+    table_insert(b, slot);
+    ++b->generating;
+    if(b->background)
+      jobs_submit_background(generate_job, b, slot, slot + 1, 1, &b->jobs);
+    else
+      generate_sector(b, slot);
+  }
+  return false;
+}
+
+/* move_sector - moves the slot's asteroids and clusters to the belt's origin,
+ * if not relative to it already; the slot must not be generating. */
+static void
+move_sector(struct belt *b, int slot)
+{
+  struct belt_sector *sec = &b->sectors[slot];
+  if(sector_equal(sec->origin, b->origin))
+    return;
+
+  struct vector4f shift = origin_shift(sec->origin, b->origin);
+  struct asteroid_field *af = &b->field;
+  int first = slot * BELT_SECTOR_MAX_ASTEROIDS;
+  for(int j = first; j < first + sec->count; ++j)
+  {
+    af->x[j] += shift.x;
+    af->y[j] += shift.y;
+    af->z[j] += shift.z;
+  }
+  for(int c = 0; c < sec->cluster_count; ++c)
+  {
+    sec->clusters[c].x += shift.x;
+    sec->clusters[c].y += shift.y;
+    sec->clusters[c].z += shift.z;
+  }
+  sec->origin = b->origin;
+}
+
+/* collect_sectors - makes the sectors generated since the last collection
+ * live.
+ *
+ * returns - true if any were.
+ */
+static bool
+collect_sectors(struct belt *b)
+{
+  if(b->generating == 0)
+    return false;
+
+  bool collected = false;
+  for(int s = 0; s < b->slot_count; ++s)
+  {
+    struct belt_sector *sec = &b->sectors[s];
+    if(sector_state(sec) != SECTOR_READY)
+      continue;
+
+    move_sector(b, s);
+    set_sector_state(sec, SECTOR_LIVE);
+    --b->generating;
+    b->live_asteroids += sec->count;
+    b->generate_ns += sec->generate_ns;
+    ++b->generated;
+    collected = true;
+  }
+  return collected;
+}
+
+/* list_clusters - the field's clusters are those of the live sectors within
+ * the load radius of the ship's sector; sectors beyond it stay resident until
+ * their slots are needed, but are not culled every frame meanwhile. Those of
+ * sectors relative to the origin are listed first, then the stale. */
+static void
+list_clusters(struct belt *b)
+{
+  const float load2 = BELT_LOAD_RADIUS_M * BELT_LOAD_RADIUS_M;
+  int n = 0;
+  b->listed_asteroids = b->stale_asteroids = 0;
+  for(int group = 0; group < 2; ++group)
+  {
+    bool stale = group == 1;
+    int listed = 0, first = n;
+    for(int s = 0; s < b->slot_count; ++s)
+    {
+      const struct belt_sector *sec = &b->sectors[s];
+      if(sector_state(sec) != SECTOR_LIVE ||
+         sector_equal(sec->origin, b->origin) == stale ||
+         sector_gap2(b->ship_sector, sec->coord) > load2)
+        continue;
+      memcpy(b->field.clusters + n, sec->clusters, sizeof(struct cull_cluster) * sec->cluster_count);
+      n += sec->cluster_count;
+      listed += sec->count;
+    }
+    if(stale)
+    {
+      b->stale_cluster_count = n - first;
+      b->stale_asteroids = listed;
+    }
+    else
+    {
+      b->field.cluster_count = n;
+      b->listed_asteroids = listed;
+    }
+  }
+}
+
+/**** REBASING ***************************************************************/
+
+/* rebase_slots - moves the next 'most' slots of the rebase in progress;
+ * generating sectors are skipped, they are moved once collected.
+ *
+ * returns - true if any slot was moved.
+ */
+static bool
+rebase_slots(struct belt *b, int most)
+{
+  bool moved = false;
+  int end = b->rebase_cursor + most < b->slot_count ? b->rebase_cursor + most : b->slot_count;
+  for(; b->rebase_cursor < end; ++b->rebase_cursor)
+  {
+    int state = sector_state(&b->sectors[b->rebase_cursor]);
+    if(state == SECTOR_READY || state == SECTOR_LIVE)
+    {
+      move_sector(b, b->rebase_cursor);
+      moved = true;
+    }
+  }
+  return moved;
+}
+
+void
+belt_rebase(struct belt *b, struct sector_coord origin)
+{
+  TRACE_ZONE("belt_rebase");
+
+  rebase_slots(b, b->slot_count);
+  b->stale_origin = b->origin;
+  b->origin = origin;
+  b->rebase_cursor = 0;
+  ++b->rebases;
+
+  /* every sector is stale until moved */
+  list_clusters(b);
+}
+
+void
+belt_transforms(const struct belt *b, const int *asteroids, int count, struct matrix44f *out)
+{
+  TRACE_ZONE("belt_transforms");
+
+  const struct asteroid_field *af = &b->field;
+  for(int i = 0; i < count; ++i)
+  {
+    int a = asteroids[i];
+    const struct belt_sector *sec = &b->sectors[a / BELT_SECTOR_MAX_ASTEROIDS];
+    struct vector4f shift = origin_shift(sec->origin, b->origin);
+
+    scale44fm(af->r[a] * ASTEROID_CUBE_SCALE, &out[i]);
+    out[i].m[3][0] = af->x[a] + shift.x;
+    out[i].m[3][1] = af->y[a] + shift.y;
+    out[i].m[3][2] = af->z[a] + shift.z;
+  }
+}
+
+/* look_ahead - the sectors of the ship and of where it will be. */
+static void
+look_ahead(struct belt *b, struct vector4f pos_w_m, struct vector4f vel_w_m_p_s)
+{
+  b->ship_sector = sector_add(b->origin, sector_of(pos_w_m));
+  b->ahead_sector = sector_add(b->origin, sector_of(add4fv(pos_w_m, scale4fv(vel_w_m_p_s, BELT_LOOKAHEAD_S))));
+}
+
+void
+belt_load(struct belt *b, struct vector4f pos_w_m, struct vector4f vel_w_m_p_s)
+{
+  TRACE_ZONE("belt_load");
+
+  look_ahead(b, pos_w_m, vel_w_m_p_s);
+  bool evicted = false;
+  b->complete = request_sectors(b, b->slot_count, &evicted);
+  if(b->background)
+    jobs_wait(&b->jobs);
+  collect_sectors(b);
+  list_clusters(b);
+}
+
+void
+belt_update(struct belt *b, struct vector4f pos_w_m, struct vector4f vel_w_m_p_s)
+{
+  TRACE_ZONE("belt_update");
+  uint64_t start_ns = clock_now_ns();
+
+  bool changed = collect_sectors(b);
+  if(b->rebase_cursor < b->slot_count)
+    changed |= rebase_slots(b, (b->slot_count + ORIGIN_REBASE_FRAMES - 1) / ORIGIN_REBASE_FRAMES);
+
+  /* the sectors wanted depend only on the ship's and lookahead sectors, so
+     there is nothing to look for until one changes, unless some are missing */
+  struct sector_coord ship = b->ship_sector, ahead = b->ahead_sector;
+  look_ahead(b, pos_w_m, vel_w_m_p_s);
+  changed |= !sector_equal(ship, b->ship_sector);
+  if(!b->complete || !sector_equal(ship, b->ship_sector) || !sector_equal(ahead, b->ahead_sector))
+  {
+    b->complete = request_sectors(b, BELT_MAX_GENERATING, &changed);
+    if(!b->background)
+      changed |= collect_sectors(b);
+  }
+  if(changed)
+    list_clusters(b);
+
+  uint64_t ns = clock_now_ns() - start_ns;
+  ++b->updates;
+  b->update_ns += ns;
+  b->update_max_ns = ns > b->update_max_ns ? ns : b->update_max_ns;
+}
+
+void
+belt_quit(struct belt *b)
+{
+  if(b->background)
+    jobs_wait(&b->jobs);
+}
+
+void
+belt_log_report(const struct belt *b)
+{
+  int live = 0;
+  for(int s = 0; s < b->slot_count; ++s)
+    live += sector_state(&b->sectors[s]) == SECTOR_LIVE;
+
+  log_write(LOG_INFO,
+            "belt: %d of %d sectors live, %d asteroids; %d in range in %d clusters; %d generating",
+            live,
+            b->slot_count,
+            b->live_asteroids,
+            b->listed_asteroids,
+            b->field.cluster_count,
+            b->generating);
+  log_write(b->deferred ? LOG_WARNING : LOG_INFO,
+            "belt: generated %llu sectors, %.1f us each; evicted %llu; %llu updates short of slots",
+            (unsigned long long)b->generated,
+            b->generated ? (b->generate_ns * 1e-3) / b->generated : 0.0,
+            (unsigned long long)b->evicted,
+            (unsigned long long)b->deferred);
+  if(b->updates)
+  {
+    log_write(LOG_INFO,
+              "belt: update %.1f us mean, %.1f us max; origin sector (%d, %d, %d), rebased %llu times",
+              (b->update_ns * 1e-3) / b->updates,
+              b->update_max_ns * 1e-3,
+              b->origin.x,
+              b->origin.y,
+              b->origin.z,
+              (unsigned long long)b->rebases);
+  }
+}
@@ -0,0 +1,185 @@
+#ifndef _BELT_H_
+#define _BELT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "asteroid.h"
+#include "origin.h"
+#include "util/jobs.h"
+
+/*
+ * The open asteroid belt; space is divided into the world's sectors, see
+ * origin.h, whose asteroids are generated from the seed and the sector's
+ * coordinate alone, so a sector left behind and returned to is generated the
+ * same, and the belt goes on as far as the ship flies.
+ *
+ * Only the sectors around the ship are resident. Each frame the sectors
+ * within BELT_LOAD_RADIUS_M of the ship, or of where it will be in
+ * BELT_LOOKAHEAD_S, are found and the missing ones generated as background
+ * jobs of the job system, nearest first, which only idle workers take; the
+ * frame never waits for them nor runs them in its own waits. A
+ * sector's memory is one of a fixed number of slots reserved at init from
+ * the memory budget; when none is free the resident sector farthest from
+ * where the ship is going is evicted, if it is no longer wanted. Memory is
+ * flat however far the ship flies.
+ *
+ * The resident asteroids are presented as an asteroid_field, so are culled
+ * as the world box's field is: slot s holds its asteroids from index
+ * s * BELT_SECTOR_MAX_ASTEROIDS of the field's arrays, and the field's
+ * clusters are those of the live sectors in range, so the asteroids of empty
+ * slots, of sectors still generating and of those left behind are never
+ * visited. The field has no cells; asteroid_field_hit finds nothing in it.
+ *
+ * Positions are relative to the belt's floating origin. When the origin is
+ * rebased the resident sectors are moved to it over ORIGIN_REBASE_FRAMES
+ * updates; each sector records the origin its positions are relative to, and
+ * those not yet moved are listed after the rest as the stale clusters, to be
+ * culled in the old origin's space. The field has no model-world matrices;
+ * belt_transforms builds those of the asteroids drawn, relative to the
+ * current origin, in one pass.
+ *
+ * With a pool of one thread there are no workers to generate in the
+ * background; up to BELT_MAX_GENERATING sectors are generated in each update
+ * instead.
+ */
+
+enum sector_state
+{
+  SECTOR_FREE = 0,   /* slot unused */
+  SECTOR_GENERATING, /* a job is generating the sector into the slot */
+  SECTOR_READY,      /* generated; not yet collected by an update */
+  SECTOR_LIVE        /* resident; in the field's clusters, i.e. culled and
+                        drawn, whilst within the load radius of the ship */
+};
+
+struct belt_sector
+{
+  struct sector_coord coord;
+  struct sector_coord origin; /* the asteroids' positions are relative to */
+  int state;          /* enum sector_state; atomic */
+  int count;          /* asteroids of the sector */
+  int cluster_count;
+  struct cull_cluster *clusters; /* indices are of the field's arrays */
+  uint64_t generate_ns;
+};
+
+struct belt
+{
+  unsigned seed;
+  bool background;       /* generated by workers, else in the update */
+
+  int slot_count;
+  struct belt_sector *sectors; /* by slot */
+
+  /* the resident sectors' slots by coordinate; open addressing with linear
+     probing, -1 if empty */
+  int *table;
+  unsigned table_mask;
+
+  struct asteroid_field field;
+  int live_asteroids;    /* of the live sectors */
+  int listed_asteroids;  /* of the sectors in the field's clusters */
+
+  /* the origin positions are relative to; whilst a rebase is in progress the
+     sectors of slots from 'rebase_cursor' on may still be relative to
+     'stale_origin', their clusters listed after the field's clusters */
+  struct sector_coord origin;
+  struct sector_coord stale_origin;
+  int rebase_cursor;     /* slot_count if no rebase is in progress */
+  int stale_cluster_count;
+  int stale_asteroids;
+
+  struct job_counter jobs;
+  int generating;
+
+  /* the sectors of ship and lookahead of the last update, and whether all
+     the sectors wanted around them were resident; if so, and they are the
+     same, the update has nothing to look for */
+  struct sector_coord ship_sector;
+  struct sector_coord ahead_sector;
+  bool complete;
+
+  /* totals since init */
+  uint64_t rebases;
+  uint64_t generated;
+  uint64_t evicted;
+  uint64_t deferred;     /* sectors wanted but no slot could be freed */
+  uint64_t generate_ns;
+  uint64_t updates;
+  uint64_t update_ns;
+  uint64_t update_max_ns;
+};
+
+/* belt_init - reserves as many sector slots as fit in 'budget_bytes' from
+ *   the arena; call after jobs_init. Nothing is allocated after.
+ *
+ * @seed - the same seed always generates the same belt.
+ */
+void
+belt_init(struct belt *b, struct arena *arena, size_t budget_bytes, unsigned seed);
+
+/* belt_load - generates every sector wanted around the ship, waiting for
+ *   them; e.g. at the start of the level, so the first frame is complete.
+ *   Positions are relative to the origin, sector (0, 0, 0) until rebased. */
+void
+belt_load(struct belt *b, struct vector4f pos_w_m, struct vector4f vel_w_m_p_s);
+
+/* belt_update - makes the sectors generated since the last update live and
+ *   starts generating the missing sectors wanted around the ship, evicting
+ *   unwanted sectors to free their slots. Call once per frame, between the
+ *   frame's ticks and its culling; never waits for generation. */
+void
+belt_update(struct belt *b, struct vector4f pos_w_m, struct vector4f vel_w_m_p_s);
+
+/* belt_rebase - moves the belt to 'origin', a part each update; positions
+ *   passed to the belt from now on must be relative to it. A rebase still in
+ *   progress is finished first. */
+void
+belt_rebase(struct belt *b, struct sector_coord origin);
+
+/* belt_transforms - builds the model-world matrices, relative to the origin,
+ *   of the asteroids at the field's indices 'asteroids' into 'out'. */
+void
+belt_transforms(const struct belt *b, const int *asteroids, int count, struct matrix44f *out);
+
+/* belt_quit - waits for the sectors still generating; call before the
+ *   belt's arena is freed. */
+void
+belt_quit(struct belt *b);
+
+/* belt_log_report - logs the sectors resident, generated and evicted and the
+ *   cost of generating and updating. */
+void
+belt_log_report(const struct belt *b);
+
+/* belt_spheres - the live asteroids relative to the origin as a set of
+ *   spheres for culling; changes with each update. */
+static inline struct cull_spheres
+belt_spheres(struct belt *b)
+{
+  return (struct cull_spheres){
+    b->listed_asteroids, b->field.x, b->field.y, b->field.z, b->field.r, b->field.cluster_count, b->field.clusters
+  };
+}
+
+/* belt_stale_spheres - the live asteroids not yet moved to the origin by a
+ *   rebase in progress; empty if none. Adding 'shift' to their positions
+ *   would move them to the origin. */
+static inline struct cull_spheres
+belt_stale_spheres(struct belt *b, struct vector4f *shift)
+{
+  *shift = origin_shift(b->stale_origin, b->origin);
+  return (struct cull_spheres){
+    b->stale_asteroids,
+    b->field.x,
+    b->field.y,
+    b->field.z,
+    b->field.r,
+    b->stale_cluster_count,
+    b->field.clusters + b->field.cluster_count
+  };
+}
+
+#endif
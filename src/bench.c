@@ -0,0 +1,651 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "config.h"
+#include "util/clock.h"
+#include "util/log.h"
+#include "util/memory.h"
+#include "util/jobs.h"
+#include "util/rng.h"
+#include "util/perf.h"
+#include "math/matrix44f.h"
+#include "spaceship.h"
+#include "spaceship_camera.h"
+#include "asteroid.h"
+#include "projectile.h"
+#include "event_bus.h"
+#include "input.h"
+#include "cull.h"
+#include "render/render.h"
+
+/*
+ * Scenario stress benchmark; builds scenes of N ships, M asteroids and P
+ * projectiles in world boxes scaled from the game's, runs K ticks of the
+ * pipeline headlessly and writes a json report of the time of each stage,
+ * the throughput and the peak memory.
+ *
+ * usage: bench [--scene=NAME] [--ships=N] [--asteroids=M] [--projectiles=P]
+ *              [--box=S] [--ticks=K] [--threads=N] [--no-draw] [--no-reorder]
+ *              [--out=PATH]
+ *
+ * Without scene options the suite of standard scenes is run; any of them runs
+ * a single custom scene, or changes the named scene. Each tick runs the
+ * stages:
+ *
+ *   tick       - the ships fly and fire, their chase camera follows ship 0,
+ *                the projectiles move; and are re-sorted into Morton order
+ *                every PROJECTILE_REORDER_TICKS ticks, unless --no-reorder.
+ *   broadphase - the projectiles are tested against the asteroid field's cells
+ *                and hits are resolved.
+ *   events     - the hits and expiries published during the broadphase are
+ *                drained from the event bus to a score keeper.
+ *   cull       - asteroids, ships and projectiles are culled against the chase
+ *                camera's frustum.
+ *   render     - the software renderer draws the chase view; --no-draw skips
+ *                it to time the simulation alone.
+ *
+ * Scenes are generated from fixed seeds and fly fixed patterns, every run of a
+ * build does the same work, so reports of two commits compare directly. The
+ * report records the commit built (see the makefile), the threads and the
+ * ticks. The first BENCH_WARMUP_TICKS ticks of each scene aren't timed.
+ *
+ * Where the kernel gives access to the hardware counters (see util/perf.h)
+ * the last level cache misses of the broadphase and cull stages are reported
+ * too; the reports of a run with and without --no-reorder give the misses
+ * the Morton order saves. The counters count the main thread, so run on one
+ * thread to count all the work.
+ */
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+#define BENCH_ARENA_BYTES (1024ull << 20)
+#define BENCH_WIDTH_PX 640
+#define BENCH_HEIGHT_PX 360
+#define BENCH_TICKS 600
+#define BENCH_WARMUP_TICKS 30
+#define BENCH_SHIP_RADIUS_M 1.f
+#define BENCH_PROJECTILE_RADIUS_M 0.1f
+
+enum bench_stage
+{
+  STAGE_TICK = 0,
+  STAGE_BROADPHASE,
+  STAGE_EVENTS,
+  STAGE_CULL,
+  STAGE_RENDER,
+  STAGE_COUNT
+};
+
+static const char *stage_names[STAGE_COUNT] = {"tick", "broadphase", "events", "cull", "render"};
+
+struct scene_params
+{
+  const char *name;
+  int ships;
+  int asteroids;
+  int projectiles;
+  float box;  /* half extent of the world box as a multiple of the game's */
+};
+
+/* the standard suite; scale each of the counts and the density in turn */
+static const struct scene_params suite[] = {
+  {"game",        1,    ASTEROID_COUNT, 0,     1.f},
+  {"ships",       1024, ASTEROID_COUNT, 1024,  1.f},
+  {"dense",       16,   50000,          4096,  1.f},
+  {"sparse",      16,   50000,          4096,  4.f},
+  {"projectiles", 64,   ASTEROID_COUNT, 65536, 1.f},
+  {"large",       1024, 200000,         65536, 4.f},
+};
+
+#define SUITE_SCENES ((int)(sizeof(suite) / sizeof(suite[0])))
+
+struct options
+{
+  const char *scene;  /* run only this scene; NULL for all or custom */
+  struct scene_params custom; /* the scene options given; -1 if not */
+  bool is_custom;
+  int ticks;
+  int threads;
+  bool draw;
+  bool reorder;
+  const char *out_path;
+};
+
+struct scene
+{
+  struct scene_params params;
+  float half_extent_m;
+
+  struct spaceship *ships;
+  struct asteroid_field field;
+  struct cull_spheres field_spheres;
+  struct projectiles projectiles;
+  bool reorder;
+  int next_shooter;
+  struct event_bus events;
+  uint64_t score;
+
+  struct spaceship_camera camera;
+  struct matrix44f projection;
+
+  /* the spheres of the ships and projectiles, refilled for each cull */
+  float *sx, *sy, *sz, *sr;
+  int *visible;           /* the visible asteroids, then ships or projectiles */
+  int visible_asteroids;
+
+  /* this scene's results */
+  uint64_t *stage_ns[STAGE_COUNT]; /* by timed tick */
+  uint64_t visible_sum[3];         /* asteroids, ships, projectiles */
+  struct perf_sample broadphase_cache;
+  struct perf_sample cull_cache;
+  double disorder_sum;             /* of the projectiles' order, by sample */
+  int disorder_samples;
+};
+
+/* the main thread's cache counters; read around the stages they report */
+static struct perf_counters counters;
+
+static void
+usage()
+{
+  fprintf(stderr,
+          "usage: bench [--scene=NAME] [--ships=N] [--asteroids=M] [--projectiles=P]\n"
+          "             [--box=S] [--ticks=K] [--threads=N] [--no-draw] [--no-reorder]\n"
+          "             [--out=PATH]\n"
+          "  --scene=NAME    run only the named scene of the suite:");
+  for(int s = 0; s < SUITE_SCENES; ++s)
+    fprintf(stderr, " %s", suite[s].name);
+  fprintf(stderr,
+          "\n"
+          "  --ships, --asteroids, --projectiles, --box=S\n"
+          "                  run a custom scene, or change the named scene; the box\n"
+          "                  is S times the game's world box\n"
+          "  --ticks=K       ticks per scene (default %d)\n"
+          "  --threads=N     threads of the job system, 0 for one per cpu (default %d)\n"
+          "  --no-draw       skip the render stage\n"
+          "  --no-reorder    never re-sort the projectiles into Morton order\n"
+          "  --out=PATH      write the report to PATH rather than stdout\n",
+          BENCH_TICKS,
+          JOBS_THREADS);
+  exit(EXIT_FAILURE);
+}
+
+static void
+parse_options(int argc, char *argv[], struct options *opts)
+{
+  memset(opts, 0, sizeof(struct options));
+  opts->custom = (struct scene_params){"custom", -1, -1, -1, -1.f};
+  opts->ticks = BENCH_TICKS;
+  opts->threads = JOBS_THREADS;
+  opts->draw = true;
+  opts->reorder = true;
+
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strncmp(argv[i], "--scene=", 8) == 0)
+      opts->scene = argv[i] + 8;
+    else if(strncmp(argv[i], "--ships=", 8) == 0)
+      opts->custom.ships = atoi(argv[i] + 8), opts->is_custom = true;
+    else if(strncmp(argv[i], "--asteroids=", 12) == 0)
+      opts->custom.asteroids = atoi(argv[i] + 12), opts->is_custom = true;
+    else if(strncmp(argv[i], "--projectiles=", 14) == 0)
+      opts->custom.projectiles = atoi(argv[i] + 14), opts->is_custom = true;
+    else if(strncmp(argv[i], "--box=", 6) == 0)
+      opts->custom.box = (float)atof(argv[i] + 6), opts->is_custom = true;
+    else if(strncmp(argv[i], "--ticks=", 8) == 0)
+      opts->ticks = atoi(argv[i] + 8);
+    else if(strncmp(argv[i], "--threads=", 10) == 0)
+      opts->threads = atoi(argv[i] + 10);
+    else if(strcmp(argv[i], "--no-draw") == 0)
+      opts->draw = false;
+    else if(strcmp(argv[i], "--no-reorder") == 0)
+      opts->reorder = false;
+    else if(strncmp(argv[i], "--out=", 6) == 0)
+      opts->out_path = argv[i] + 6;
+    else
+      usage();
+  }
+
+  /* the scene options change the named scene, else a custom scene */
+  struct scene_params base = {"custom", 16, ASTEROID_COUNT, 1024, 1.f};
+  if(opts->scene)
+  {
+    int s = 0;
+    while(s < SUITE_SCENES && strcmp(suite[s].name, opts->scene) != 0)
+      ++s;
+    if(s == SUITE_SCENES)
+      usage();
+    base = suite[s];
+    opts->is_custom = true;
+  }
+  if(opts->custom.ships != -1)
+    base.ships = opts->custom.ships;
+  if(opts->custom.asteroids != -1)
+    base.asteroids = opts->custom.asteroids;
+  if(opts->custom.projectiles != -1)
+    base.projectiles = opts->custom.projectiles;
+  if(opts->custom.box != -1.f)
+    base.box = opts->custom.box;
+  opts->custom = base;
+
+  if(opts->ticks <= BENCH_WARMUP_TICKS || opts->threads < 0 || opts->custom.ships < 1 ||
+     opts->custom.asteroids < 0 || opts->custom.projectiles < 0 || !(opts->custom.box > 0.f))
+    usage();
+}
+
+/* spawn_job - places ships; each draws from its own stream, so the placement
+ * is the same however the ships are split between threads. */
+static void
+spawn_job(void *arg, int begin, int end)
+{
+  struct scene *sc = arg;
+  for(int s = begin; s < end; ++s)
+  {
+    struct vector4f pos = {0.f, 0.f, 0.f, 1.f};
+    struct vector4f at = {0.f, 0.f, -1.f, 1.f};
+    if(s > 0)
+    {
+      struct rng_stream rng = rng_stream(ASTEROID_SEED, (uint64_t)s, RNG_SPAWN, 0);
+      float u[5];
+      rng_uniform(&rng, u, 5);
+      pos.x = (u[0] - 0.5f) * sc->half_extent_m;
+      pos.y = (u[1] - 0.5f) * sc->half_extent_m;
+      pos.z = (u[2] - 0.5f) * sc->half_extent_m;
+      at.x = pos.x + u[3] - 0.5f;
+      at.y = pos.y;
+      at.z = pos.z + u[4] - 0.5f;
+    }
+    spaceship_init(&sc->ships[s], pos, at, (struct vector4f){0.f, 1.f, 0.f, 0.f});
+  }
+}
+
+/* keep_score - the event bus handler of the projectiles' hits; a hit scores
+ * the radius of the asteroid. */
+static void
+keep_score(void *ctx, const struct event *events, int count)
+{
+  struct scene *sc = ctx;
+  for(int i = 0; i < count; ++i)
+    sc->score += (uint64_t)sc->field.r[events[i].projectile_hit.asteroid];
+}
+
+static void
+build_scene(struct scene *sc, const struct scene_params *params, const struct options *opts, struct arena *arena)
+{
+  int ticks = opts->ticks;
+  sc->params = *params;
+  sc->half_extent_m = WORLD_HALF_EXTENT_M * params->box;
+
+  asteroid_field_init(&sc->field, arena, params->asteroids, sc->half_extent_m, ASTEROID_SEED);
+  sc->field_spheres = asteroid_field_spheres(&sc->field);
+
+  /* ships are scattered through the middle half of the box facing random
+     directions; ship 0 starts where the game's ship does */
+  sc->ships = ARENA_NEW(arena, struct spaceship, params->ships);
+  parallel_for(0, params->ships, 256, spawn_job, sc);
+
+  projectiles_init(&sc->projectiles, params->projectiles ? params->projectiles : 1, arena);
+  sc->next_shooter = 0;
+  /* every projectile may hit or expire in one tick */
+  event_bus_init(&sc->events, params->projectiles ? params->projectiles : 1, arena);
+  event_bus_subscribe(&sc->events, EVENT_PROJECTILE_HIT, keep_score, sc);
+  sc->projectiles.events = &sc->events;
+  sc->reorder = opts->reorder;
+  sc->score = 0;
+
+  shipcam_init(&sc->camera, &sc->ships[0], arena);
+  perspective44fm(VIEW_FOV_Y_DG,
+                  (float)BENCH_WIDTH_PX / (float)BENCH_HEIGHT_PX,
+                  VIEW_NEAR_M,
+                  VIEW_FAR_M,
+                  &sc->projection);
+
+  /* the projectiles are culled straight from their arrays; only the radii
+     are filled in */
+  int spheres = params->ships > params->projectiles ? params->ships : params->projectiles;
+  sc->sx = ARENA_NEW(arena, float, spheres * 4);
+  sc->sy = sc->sx + spheres;
+  sc->sz = sc->sy + spheres;
+  sc->sr = sc->sz + spheres;
+  int most = params->asteroids + spheres;
+  sc->visible = ARENA_NEW(arena, int, most ? most : 1);
+
+  for(int s = 0; s < STAGE_COUNT; ++s)
+    sc->stage_ns[s] = ARENA_NEW(arena, uint64_t, ticks);
+  memset(sc->visible_sum, 0, sizeof(sc->visible_sum));
+  memset(&sc->broadphase_cache, 0, sizeof(struct perf_sample));
+  memset(&sc->cull_cache, 0, sizeof(struct perf_sample));
+  sc->disorder_sum = 0.0;
+  sc->disorder_samples = 0;
+}
+
+/* fly - the command of ship 's' at 'tick'; every ship boosts, and pitches and
+ * rolls through a pattern offset by its index. */
+static struct tick_command
+fly(int s, int tick)
+{
+  int phase = (tick / 90 + s) % 4;
+  struct tick_command cmd = {BOOST_FORWARD, ROTATE_NONE, ROTATE_NONE};
+  cmd.pitch = phase == 1 ? ROTATE_CCW : phase == 3 ? ROTATE_CW : ROTATE_NONE;
+  cmd.roll = phase == 2 ? ROTATE_CW : ROTATE_NONE;
+  return cmd;
+}
+
+static void
+ships_job(void *arg, int begin, int end)
+{
+  struct scene *sc = arg;
+  for(int s = begin; s < end; ++s)
+    spaceship_tick(&sc->ships[s]);
+}
+
+static void
+tick_scene(struct scene *sc, int tick)
+{
+  if(sc->reorder)
+    projectiles_reorder(&sc->projectiles);
+
+  for(int s = 0; s < sc->params.ships; ++s)
+  {
+    struct tick_command cmd = fly(s, tick);
+    tick_command_apply(&cmd, &sc->ships[s]);
+  }
+  parallel_for(0, sc->params.ships, 64, ships_job, sc);
+  shipcam_tick(&sc->camera);
+
+  /* the ships take turns to fire, keeping the projectiles in flight topped up */
+  while(sc->projectiles.live_count < sc->params.projectiles)
+  {
+    struct spaceship *ship = &sc->ships[sc->next_shooter];
+    sc->next_shooter = (sc->next_shooter + 1) % sc->params.ships;
+    projectiles_fire(&sc->projectiles, ship->vpos_w_m, ship->front);
+  }
+  projectiles_move(&sc->projectiles);
+}
+
+static void
+cull_scene(struct scene *sc, struct frustum *frustum)
+{
+  struct matrix44f wc;
+  concatenate44fm(&sc->projection, &sc->camera.wv, &wc);
+  frustum_extract(frustum, &wc);
+
+  int visible = frustum_cull(frustum, &sc->field_spheres, sc->visible, NULL);
+  sc->visible_asteroids = visible;
+  sc->visible_sum[0] += visible;
+
+  int ships = sc->params.ships;
+  for(int s = 0; s < ships; ++s)
+  {
+    sc->sx[s] = sc->ships[s].vpos_w_m.x;
+    sc->sy[s] = sc->ships[s].vpos_w_m.y;
+    sc->sz[s] = sc->ships[s].vpos_w_m.z;
+    sc->sr[s] = BENCH_SHIP_RADIUS_M;
+  }
+  struct cull_spheres spheres = {ships, sc->sx, sc->sy, sc->sz, sc->sr, 0, NULL};
+  sc->visible_sum[1] += frustum_cull(frustum, &spheres, sc->visible + visible, NULL);
+
+  const struct projectiles *ps = &sc->projectiles;
+  for(int p = 0; p < ps->live_count; ++p)
+    sc->sr[p] = BENCH_PROJECTILE_RADIUS_M;
+  spheres = (struct cull_spheres){ps->live_count, ps->x, ps->y, ps->z, sc->sr, 0, NULL};
+  sc->visible_sum[2] += frustum_cull(frustum, &spheres, sc->visible + visible, NULL);
+}
+
+static void
+draw_scene(struct scene *sc, struct render_backend *renderer, const struct frustum *frustum)
+{
+  struct render_view view;
+  view.x_px = view.y_px = 0;
+  view.width_px = BENCH_WIDTH_PX;
+  view.height_px = BENCH_HEIGHT_PX;
+  view.wv = &sc->camera.wv;
+  view.vc = &sc->projection;
+  for(int g = 0; g < GRID_COUNT; ++g)
+  {
+    view.grid_visible[g] = frustum_test_sphere(frustum,
+                                               grid_centers[g][0],
+                                               grid_centers[g][1],
+                                               grid_centers[g][2],
+                                               GRID_RADIUS_M);
+  }
+  view.axes_visible = frustum_test_sphere(frustum, 0.f, 0.f, 0.f, AXIS_RADIUS_M);
+  view.asteroids = sc->visible;
+  view.asteroid_count = sc->visible_asteroids;
+  view.asteroid_mw = NULL;
+
+  struct render_scene scene = {&sc->ships[0].mw, &sc->field, &view, 1};
+  renderer->draw(renderer, &scene);
+}
+
+static int
+compare_ns(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* write_stage - writes the stage's timings as a json object; sorts the times. */
+static void
+write_stage(FILE *f, const char *name, uint64_t *ns, int count, bool last)
+{
+  uint64_t total_ns = 0;
+  for(int i = 0; i < count; ++i)
+    total_ns += ns[i];
+  qsort(ns, count, sizeof(uint64_t), compare_ns);
+
+  fprintf(f,
+          "        \"%s\": {\"total_ms\": %.3f, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+          "\"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+          name,
+          total_ns * 1e-6,
+          total_ns * 1e-6 / count,
+          ns[count / 2] * 1e-6,
+          ns[(int)(count * 0.95)] * 1e-6,
+          ns[(int)(count * 0.99)] * 1e-6,
+          ns[count - 1] * 1e-6,
+          last ? "" : ",");
+}
+
+/* miss_ratio - the fraction of the cache references which missed. */
+static double
+miss_ratio(const struct perf_sample *cache)
+{
+  uint64_t references = cache->count[PERF_CACHE_REFERENCES];
+  return references ? (double)cache->count[PERF_CACHE_MISSES] / references : 0.0;
+}
+
+/* run_scene - builds the scene, ticks it and writes its report to 'f'. */
+static void
+run_scene(FILE *f, const struct scene_params *params, const struct options *opts, bool last)
+{
+  struct arena arena;
+  arena_init(&arena, "bench", BENCH_ARENA_BYTES, MEMORY_FLAGS);
+
+  log_write(LOG_INFO,
+            "bench: scene %s, %d ships, %d asteroids, %d projectiles, box x%.2f",
+            params->name, params->ships, params->asteroids, params->projectiles, params->box);
+
+  uint64_t build_start_ns = clock_now_ns();
+  struct scene sc;
+  build_scene(&sc, params, opts, &arena);
+  double build_ms = (clock_now_ns() - build_start_ns) * 1e-6;
+
+  struct render_backend renderer;
+  if(opts->draw)
+    render_soft_init(&renderer, BENCH_WIDTH_PX, BENCH_HEIGHT_PX);
+
+  int timed = 0;
+  uint64_t start_ns = 0;
+  for(int tick = 0; tick < opts->ticks; ++tick)
+  {
+    if(tick == BENCH_WARMUP_TICKS)
+      start_ns = clock_now_ns();
+
+    struct perf_sample c0, c1, c2, c3;
+    uint64_t t0 = clock_now_ns();
+    tick_scene(&sc, tick);
+    perf_counters_read(&counters, &c0);
+    uint64_t t1 = clock_now_ns();
+    projectiles_collide(&sc.projectiles, &sc.field);
+    uint64_t t2 = clock_now_ns();
+    perf_counters_read(&counters, &c1);
+    event_bus_drain(&sc.events);
+    event_bus_frame_end(&sc.events, NULL);
+    perf_counters_read(&counters, &c2);
+    uint64_t t3 = clock_now_ns();
+    struct frustum frustum;
+    cull_scene(&sc, &frustum);
+    uint64_t t4 = clock_now_ns();
+    perf_counters_read(&counters, &c3);
+    if(opts->draw)
+      draw_scene(&sc, &renderer, &frustum);
+    uint64_t t5 = clock_now_ns();
+    frame_reset();
+
+    if(tick < BENCH_WARMUP_TICKS)
+      continue;
+    perf_sample_add(&sc.broadphase_cache, &c0, &c1);
+    perf_sample_add(&sc.cull_cache, &c2, &c3);
+    if(timed % 16 == 0)
+    {
+      sc.disorder_sum += projectiles_disorder(&sc.projectiles);
+      ++sc.disorder_samples;
+    }
+    sc.stage_ns[STAGE_TICK][timed] = t1 - t0;
+    sc.stage_ns[STAGE_BROADPHASE][timed] = t2 - t1;
+    sc.stage_ns[STAGE_EVENTS][timed] = t3 - t2;
+    sc.stage_ns[STAGE_CULL][timed] = t4 - t3;
+    sc.stage_ns[STAGE_RENDER][timed] = t5 - t4;
+    ++timed;
+  }
+  double wall_s = (clock_now_ns() - start_ns) * 1e-9;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  uint64_t entities = (uint64_t)params->ships + params->asteroids + params->projectiles;
+  double volume_km3 = pow(2.0 * sc.half_extent_m * 1e-3, 3.0);
+
+  fprintf(f, "    {\n");
+  fprintf(f, "      \"scene\": \"%s\",\n", params->name);
+  fprintf(f,
+          "      \"ships\": %d, \"asteroids\": %d, \"projectiles\": %d, "
+          "\"box_half_extent_m\": %.1f, \"asteroids_per_km3\": %.1f,\n",
+          params->ships, params->asteroids, params->projectiles,
+          sc.half_extent_m, params->asteroids / volume_km3);
+  fprintf(f, "      \"build_ms\": %.3f, \"ticks\": %d, \"wall_ms\": %.3f,\n", build_ms, timed, wall_s * 1e3);
+  fprintf(f,
+          "      \"throughput\": {\"ticks_per_s\": %.2f, \"entity_ticks_per_s\": %.0f, "
+          "\"projectile_ticks_per_s\": %.0f},\n",
+          timed / wall_s,
+          entities * timed / wall_s,
+          (double)params->projectiles * timed / wall_s);
+  fprintf(f, "      \"stages\": {\n");
+  for(int s = 0; s < STAGE_COUNT; ++s)
+    write_stage(f, stage_names[s], sc.stage_ns[s], timed, s + 1 == STAGE_COUNT);
+  fprintf(f, "      },\n");
+  fprintf(f,
+          "      \"visible_mean\": {\"asteroids\": %.1f, \"ships\": %.1f, \"projectiles\": %.1f},\n",
+          (double)sc.visible_sum[0] / opts->ticks,
+          (double)sc.visible_sum[1] / opts->ticks,
+          (double)sc.visible_sum[2] / opts->ticks);
+  fprintf(f,
+          "      \"projectiles_fired\": %llu, \"projectiles_hit\": %llu, \"projectiles_expired\": %llu,\n",
+          (unsigned long long)sc.projectiles.fired,
+          (unsigned long long)sc.projectiles.hit,
+          (unsigned long long)sc.projectiles.expired);
+  fprintf(f,
+          "      \"events\": {\"hit\": %llu, \"expired\": %llu, \"per_tick\": %.1f, \"dropped\": %llu, \"score\": %llu},\n",
+          (unsigned long long)sc.events.totals[EVENT_PROJECTILE_HIT],
+          (unsigned long long)sc.events.totals[EVENT_PROJECTILE_EXPIRED],
+          (double)(sc.events.totals[EVENT_PROJECTILE_HIT] + sc.events.totals[EVENT_PROJECTILE_EXPIRED]) / opts->ticks,
+          (unsigned long long)sc.events.dropped,
+          (unsigned long long)sc.score);
+  const struct perf_sample *bc = &sc.broadphase_cache, *cc = &sc.cull_cache;
+  if(!counters.available)
+  {
+    fprintf(f, "      \"cache\": null,\n");
+  }
+  else
+  {
+    fprintf(f,
+            "      \"cache\": {\"broadphase_misses_per_tick\": %.1f, \"broadphase_miss_ratio\": %.4f, "
+            "\"cull_misses_per_tick\": %.1f, \"cull_miss_ratio\": %.4f},\n",
+            (double)bc->count[PERF_CACHE_MISSES] / timed,
+            miss_ratio(bc),
+            (double)cc->count[PERF_CACHE_MISSES] / timed,
+            miss_ratio(cc));
+  }
+  fprintf(f,
+          "      \"projectile_order\": {\"reorders\": %llu, \"disorder_mean\": %.4f},\n",
+          (unsigned long long)sc.projectiles.reorders,
+          sc.disorder_samples ? sc.disorder_sum / sc.disorder_samples : 0.0);
+  fprintf(f,
+          "      \"memory\": {\"arena_peak_bytes\": %zu, \"frame_peak_bytes\": %zu, "
+          "\"process_peak_rss_bytes\": %llu}\n",
+          arena.high_water,
+          memory_frame.high_water,
+          (unsigned long long)usage.ru_maxrss * 1024ull);
+  fprintf(f, "    }%s\n", last ? "" : ",");
+  fflush(f);
+
+  if(opts->draw)
+    renderer.quit(&renderer);
+  arena_free(&arena);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct options opts;
+  parse_options(argc, argv, &opts);
+
+  FILE *f = opts.out_path ? fopen(opts.out_path, "w") : stdout;
+  if(!f)
+  {
+    fprintf(stderr, "failed to open '%s'\n", opts.out_path);
+    return EXIT_FAILURE;
+  }
+
+  log_init();
+  clock_timestamp_init();
+  memory_init(FRAME_SCRATCH_BYTES, MEMORY_FLAGS);
+  jobs_init(opts.threads);
+  models_init();
+  perf_counters_open(&counters);
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"commit\": \"%s\",\n", BENCH_COMMIT);
+  fprintf(f, "  \"threads\": %d, \"cpus\": %ld,\n", jobs_thread_count(), sysconf(_SC_NPROCESSORS_ONLN));
+  fprintf(f, "  \"ticks\": %d, \"warmup_ticks\": %d, \"draw\": %s, \"reorder\": %s,\n",
+          opts.ticks, BENCH_WARMUP_TICKS, opts.draw ? "true" : "false", opts.reorder ? "true" : "false");
+  fprintf(f, "  \"cache_counters\": %s,\n", counters.available ? "true" : "false");
+  fprintf(f, "  \"timestamps\": \"%s\",\n", clock_tsc.use_tsc ? "tsc" : clock_timestamp_source());
+  fprintf(f, "  \"scenes\": [\n");
+  if(opts.is_custom)
+    run_scene(f, &opts.custom, &opts, true);
+  else
+    for(int s = 0; s < SUITE_SCENES; ++s)
+      run_scene(f, &suite[s], &opts, s + 1 == SUITE_SCENES);
+  fprintf(f, "  ]\n}\n");
+
+  int status = EXIT_SUCCESS;
+  if(opts.out_path && fclose(f))
+  {
+    fprintf(stderr, "failed to write '%s'\n", opts.out_path);
+    status = EXIT_FAILURE;
+  }
+
+  memory_log_stats();
+  perf_counters_close(&counters);
+  jobs_quit();
+  memory_quit();
+  log_quit();
+  return status;
+}
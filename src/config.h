@@ -8,6 +8,31 @@
    iteration */
 #define MAX_TICKS_PER_FRAME 5
 
+/*** OVERLOAD CONFIG ********************************************************/
+
+/* the game loop is judged by the overload governor over windows of this
+   length; see overload.h */
+#define OVERLOAD_WINDOW_S 0.5
+
+/* a window is overloaded if more than this fraction of its ticks were run to
+   catch up, i.e. beyond the first tick of a loop iteration */
+#define OVERLOAD_CATCHUP_FRACTION 0.2f
+
+/* a degraded level is restored once the loop has been idle for at least this
+   fraction of every window for the hold time; the hold doubles each time a
+   restored level doesn't hold */
+#define OVERLOAD_RECOVER_IDLE_FRACTION 0.3f
+#define OVERLOAD_RECOVER_HOLD_S 2.0
+
+/* unsimulated time carried into the next iteration, rather than dropped, while
+   the governor can still shed load */
+#define OVERLOAD_MAX_BACKLOG_S 0.25
+
+/* levels of render detail the governor may shed, and the fraction of the far
+   plane distance each takes off the asteroids' draw distance */
+#define OVERLOAD_RENDER_LOD_LEVELS 2
+#define OVERLOAD_DRAW_DISTANCE_STEP 0.3f
+
 /*** SHIP CONFIG *************************************************************/
 
 /* anglular velocity limits of ship: limits symmetrical for CW, CCW rotations */
@@ -25,6 +50,20 @@
 /* ship scalar linear acceleration (constant) */
 #define SHIP_POS_M_P_S2 1.f
 
+/*** PROJECTILE CONFIG *******************************************************/
+
+/* speed and lifetime of a projectile once fired */
+#define PROJECTILE_SPEED_M_P_S 60.f
+#define PROJECTILE_LIFETIME_S 3.f
+
+/* projectiles per job when moving and colliding them across the job system */
+#define PROJECTILE_JOB_GRAIN 1024
+
+/* the projectiles' arrays are re-sorted into the Morton order of the cells of
+   this side their positions are in every PROJECTILE_REORDER_TICKS ticks */
+#define PROJECTILE_ORDER_CELL_M 4.f
+#define PROJECTILE_REORDER_TICKS 30
+
 /*** FOLLOW CAMERA CONFIG *****************************************************/
 
 /* the delay between the follow camera and the ship; the camera is actually
@@ -33,10 +72,9 @@
    delay the 'stronger' the lagging effect. */
 #define FOLLOW_DELAY_S 0.2
 
-/* the number of the ship's past model-world matrices the camera stores. This
-   value must be precomputed and is given by:
-        = (int)(FOLLOW_DELAY_S / TICK_DELTA_S) */
-#define SHIP_MW_HISTORY_SIZE 12 
+/* the longest delay the follow camera can be set to; sizes the history of
+   the ship's poses the camera keeps. */
+#define SHIPCAM_MAX_DELAY_S 1.0
 
 /* controls how close the camera can get to the ship; distance when ship at rest */
 #define SHIPCAM_MIN_VIEW_DISTANCE_M 5.f
@@ -44,4 +82,180 @@
 /* height above the ship of the camera */
 #define SHIPCAM_VIEW_HEIGHT_M 5.f
 
+/* height above the ship of the rear-view mirror camera, which looks back from
+   the ship's centre */
+#define SHIPCAM_MIRROR_HEIGHT_M 1.f
+
+/* world space position of the spectator camera, which watches the ship from a
+   fixed point */
+#define SHIPCAM_SPECTATOR_X_M 400.f
+#define SHIPCAM_SPECTATOR_Y_M 150.f
+#define SHIPCAM_SPECTATOR_Z_M 400.f
+
+/*** RENDER CONFIG ***********************************************************/
+
+/* perspective projection parameters; shared by the gl projection matrix and
+   the view frustum used for culling */
+#define VIEW_FOV_Y_DG 60.f
+#define VIEW_NEAR_M 1.f
+#define VIEW_FAR_M 1024.f
+
+/* half the side length of the cubic world box bounded by the grid walls */
+#define WORLD_HALF_EXTENT_M 505.f
+
+/*** ASTEROID FIELD CONFIG ****************************************************/
+
+/* number of asteroids scattered through the world box */
+#define ASTEROID_COUNT 2000
+
+/* asteroid radius limits */
+#define ASTEROID_MIN_RADIUS_M 0.5f
+#define ASTEROID_MAX_RADIUS_M 8.f
+
+/* seed for the asteroid placement; same seed always gives the same field */
+#define ASTEROID_SEED 0x5eed
+
+/*** FLOATING ORIGIN CONFIG **************************************************/
+
+/* side length of the cubic sectors of the world's grid; positions are floats
+   relative to the corner of a sector, see origin.h */
+#define WORLD_SECTOR_SIZE_M 400.f
+
+/* the origin is moved to the ship's sector once the ship is this far from it
+   along an axis; floats this far out are still good to ~0.1mm */
+#define ORIGIN_REBASE_DISTANCE_M 1000.f
+
+/* frames over which the belt's resident sectors are moved to a new origin */
+#define ORIGIN_REBASE_FRAMES 8
+
+/*** ASTEROID BELT CONFIG ****************************************************/
+
+/* the open belt (--belt) generates a sector of the world's grid at a time;
+   the number of clustering cells along each side of a sector */
+#define BELT_SECTOR_CELLS 2
+
+/* asteroids generated in a sector; uniformly between the limits, the mean
+   matching the density of the world box */
+#define BELT_SECTOR_MIN_ASTEROIDS 64
+#define BELT_SECTOR_MAX_ASTEROIDS 184
+
+/* sectors within this distance of the ship's sector, or of the sector it will
+   be in after BELT_LOOKAHEAD_S at its velocity, are generated; sectors a
+   sector farther than this are evicted when their memory is needed */
+#define BELT_LOAD_RADIUS_M VIEW_FAR_M
+#define BELT_LOOKAHEAD_S 4.f
+
+/* memory reserved for the resident sectors; fixed however far the ship flies */
+#define BELT_MEMORY_BYTES (2u << 20)
+
+/* most sectors generating at once */
+#define BELT_MAX_GENERATING 8
+
+/*** CULLING CONFIG ***********************************************************/
+
+/* side length of the cubic cells used to cluster objects for hierarchical
+   culling; whole cells are culled at once before testing their members */
+#define CULL_CLUSTER_SIZE_M 100.f
+
+/* interval between culling statistics reports in the log */
+#define CULL_REPORT_INTERVAL_S 5.0
+
+/*** OCCLUSION CULLING CONFIG *************************************************/
+
+/* resolution of the software depth buffer occluders are rasterized into;
+   width must be a multiple of 4 and both a multiple of OCCLUSION_TILE_PX */
+#define OCCLUSION_WIDTH_PX 256
+#define OCCLUSION_HEIGHT_PX 128
+
+/* side length of the square tiles of the coarse level of the depth buffer */
+#define OCCLUSION_TILE_PX 8
+
+/* number of bands of tile rows the occluders are rasterized in; each band is
+   a job, rasterized in parallel with the others */
+#define OCCLUSION_BANDS 8
+
+/* max number of asteroids chosen as occluders each frame; the nearest and
+   largest are chosen, i.e. those with the greatest radius / distance */
+#define OCCLUSION_MAX_OCCLUDERS 16
+
+/* asteroids with radius / distance less than this are never occluders */
+#define OCCLUSION_MIN_OCCLUDER_SIZE 0.05f
+
+/*** EVENT BUS CONFIG *******************************************************/
+
+/* events each thread may publish between drains of the game's event bus; see
+   event_bus.h */
+#define EVENT_BUFFER_EVENTS 4096
+
+/* handlers one type of event may have */
+#define EVENT_MAX_HANDLERS 4
+
+/*** PACING CONFIG **********************************************************/
+
+/* how the window's frames are paced by default; see util/pacer.h. Overridden
+   by --pacing */
+#define PACER_MODE PACER_VSYNC
+
+/* frame rate of capped pacing, e.g. for spectator instances sharing a
+   server; overridden by --fps-cap */
+#define PACER_CAP_HZ 30.0
+
+/*** JOBS CONFIG ************************************************************/
+
+/* threads of the job system, including the main thread; 0 for one per online
+   cpu. Overridden by --threads */
+#define JOBS_THREADS 0
+
+/*** MEMORY CONFIG **********************************************************/
+
+/* address space reserved for the level's data and for each frame's scratch
+   memory; pages are committed as used, the high-water marks are logged at
+   exit. Running out is fatal. */
+#define LEVEL_ARENA_BYTES (64u << 20)
+#define FRAME_SCRATCH_BYTES (16u << 20)
+
+/* arena_init flags of the level and frame arenas, e.g. MEMORY_HUGE_PAGES */
+#define MEMORY_FLAGS 0
+
+/*** TELEMETRY CONFIG *******************************************************/
+
+/* number of most recent frames kept by the frame telemetry; the percentiles
+   reported are over this window */
+#define TELEMETRY_FRAMES 1024
+
+/* interval between frame telemetry reports in the log */
+#define TELEMETRY_REPORT_INTERVAL_S 10.0
+
+/* file the telemetry hotkey (F12) writes to when no --telemetry path is given */
+#define TELEMETRY_DUMP_PATH "telemetry.csv"
+
+/*** INPUT CONFIG ***********************************************************/
+
+/* changes of command an input recording buffers before writing them out; a
+   record is 8 bytes */
+#define INPUT_RECORD_BUFFER 4096
+
+/*** GOLDEN STATE CONFIG ****************************************************/
+
+/* simcheck snapshots the simulation state every this many ticks; see golden.h */
+#define GOLDEN_INTERVAL_TICKS 30
+
+/* relative tolerance of simcheck's tolerance mode when none is given */
+#define GOLDEN_TOLERANCE 1e-4f
+
+/*** TRACE CONFIG ***********************************************************/
+
+/* file the trace zones are written to in builds with tracing enabled; see
+   util/trace.h */
+#define TRACE_PATH "trace.json"
+
+/*** HEADLESS CONFIG **********************************************************/
+
+/* defaults of the headless (software rendered, no window) run options */
+#define HEADLESS_FRAMES 600
+
+/* frames before the game loop is in its steady state, after which the
+   allocation check (--alloc-check) allows no allocations */
+#define ALLOC_WARMUP_FRAMES 60
+
 #endif
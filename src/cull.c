@@ -0,0 +1,207 @@
+#include <math.h>
+#include <assert.h>
+
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+#include "cull.h"
+
+/* classification of a sphere w.r.t the frustum */
+enum containment {OUTSIDE = 0, INTERSECTS = 1, INSIDE = 2};
+
+void
+frustum_extract(struct frustum *f, struct matrix44f *wc)
+{
+  assert(f != NULL && wc != NULL);
+
+  /* row i of the matrix; elements are stored [col][row] */
+#define ROW(i) wc->m[0][i], wc->m[1][i], wc->m[2][i], wc->m[3][i]
+
+  const float r0[4] = {ROW(0)};
+  const float r1[4] = {ROW(1)};
+  const float r2[4] = {ROW(2)};
+  const float r3[4] = {ROW(3)};
+
+#undef ROW
+
+  for(int i = 0; i < 4; ++i)
+  {
+    float *coef = (i == 0) ? f->a : (i == 1) ? f->b : (i == 2) ? f->c : f->d;
+    coef[PLANE_LEFT]   = r3[i] + r0[i];
+    coef[PLANE_RIGHT]  = r3[i] - r0[i];
+    coef[PLANE_BOTTOM] = r3[i] + r1[i];
+    coef[PLANE_TOP]    = r3[i] - r1[i];
+    coef[PLANE_NEAR]   = r3[i] + r2[i];
+    coef[PLANE_FAR]    = r3[i] - r2[i];
+  }
+
+  /* normalise so plane equations give true signed distances */
+  for(int p = 0; p < PLANE_COUNT; ++p)
+  {
+    float invlen = 1.f / sqrtf(f->a[p] * f->a[p] + f->b[p] * f->b[p] + f->c[p] * f->c[p]);
+    f->a[p] *= invlen;
+    f->b[p] *= invlen;
+    f->c[p] *= invlen;
+    f->d[p] *= invlen;
+  }
+}
+
+static inline enum containment
+classify_sphere(const struct frustum *f, float x, float y, float z, float r)
+{
+  enum containment result = INSIDE;
+  for(int p = 0; p < PLANE_COUNT; ++p)
+  {
+    float dist = f->a[p] * x + f->b[p] * y + f->c[p] * z + f->d[p];
+    if(dist < -r)
+      return OUTSIDE;
+    if(dist < r)
+      result = INTERSECTS;
+  }
+  return result;
+}
+
+bool
+frustum_test_sphere(const struct frustum *f, float x, float y, float z, float r)
+{
+  return classify_sphere(f, x, y, z, r) != OUTSIDE;
+}
+
+/* cull_range - tests spheres [first, first + count) individually, appending the
+ * indices of visible spheres to 'visible' from position 'n'.
+ *
+ * returns - the new number of indices in 'visible'.
+ */
+static int
+cull_range(const struct frustum *f,
+           const struct cull_spheres *s,
+           int first,
+           int count,
+           int *visible,
+           int n)
+{
+  int i = first, end = first + count;
+
+#if defined(__AVX__)
+
+  __m256 pa[PLANE_COUNT], pb[PLANE_COUNT], pc[PLANE_COUNT], pd[PLANE_COUNT];
+  for(int p = 0; p < PLANE_COUNT; ++p)
+  {
+    pa[p] = _mm256_set1_ps(f->a[p]);
+    pb[p] = _mm256_set1_ps(f->b[p]);
+    pc[p] = _mm256_set1_ps(f->c[p]);
+    pd[p] = _mm256_set1_ps(f->d[p]);
+  }
+
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  for(; i + 8 <= end; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(s->x + i);
+    __m256 y = _mm256_loadu_ps(s->y + i);
+    __m256 z = _mm256_loadu_ps(s->z + i);
+    __m256 negr = _mm256_xor_ps(_mm256_loadu_ps(s->r + i), sign);
+    __m256 outside = _mm256_setzero_ps();
+    for(int p = 0; p < PLANE_COUNT; ++p)
+    {
+      __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pa[p], x), _mm256_mul_ps(pb[p], y)),
+                                  _mm256_add_ps(_mm256_mul_ps(pc[p], z), pd[p]));
+      outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, negr, _CMP_LT_OQ));
+    }
+    unsigned mask = ~(unsigned)_mm256_movemask_ps(outside) & 0xffu;
+    while(mask)
+    {
+      visible[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+
+#elif defined(__SSE__)
+
+  __m128 pa[PLANE_COUNT], pb[PLANE_COUNT], pc[PLANE_COUNT], pd[PLANE_COUNT];
+  for(int p = 0; p < PLANE_COUNT; ++p)
+  {
+    pa[p] = _mm_set1_ps(f->a[p]);
+    pb[p] = _mm_set1_ps(f->b[p]);
+    pc[p] = _mm_set1_ps(f->c[p]);
+    pd[p] = _mm_set1_ps(f->d[p]);
+  }
+
+  const __m128 sign = _mm_set1_ps(-0.f);
+  for(; i + 4 <= end; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(s->x + i);
+    __m128 y = _mm_loadu_ps(s->y + i);
+    __m128 z = _mm_loadu_ps(s->z + i);
+    __m128 negr = _mm_xor_ps(_mm_loadu_ps(s->r + i), sign);
+    __m128 outside = _mm_setzero_ps();
+    for(int p = 0; p < PLANE_COUNT; ++p)
+    {
+      __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa[p], x), _mm_mul_ps(pb[p], y)),
+                               _mm_add_ps(_mm_mul_ps(pc[p], z), pd[p]));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, negr));
+    }
+    unsigned mask = ~(unsigned)_mm_movemask_ps(outside) & 0xfu;
+    while(mask)
+    {
+      visible[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+
+#endif
+
+  /* scalar tail, or everything if no SIMD */
+  for(; i < end; ++i)
+    if(classify_sphere(f, s->x[i], s->y[i], s->z[i], s->r[i]) != OUTSIDE)
+      visible[n++] = i;
+
+  return n;
+}
+
+int
+frustum_cull(const struct frustum *f,
+             const struct cull_spheres *spheres,
+             int *visible,
+             struct cull_stats *stats)
+{
+  assert(f != NULL && spheres != NULL && visible != NULL);
+
+  int n = 0, tested = 0;
+
+  if(spheres->cluster_count == 0)
+  {
+    n = cull_range(f, spheres, 0, spheres->count, visible, 0);
+    tested = spheres->count;
+  }
+  else
+  {
+    for(int c = 0; c < spheres->cluster_count; ++c)
+    {
+      const struct cull_cluster *cl = &spheres->clusters[c];
+      ++tested;
+      switch(classify_sphere(f, cl->x, cl->y, cl->z, cl->r))
+      {
+      case OUTSIDE:
+        break;
+      case INSIDE:
+        for(int i = cl->first; i < cl->first + cl->count; ++i)
+          visible[n++] = i;
+        break;
+      case INTERSECTS:
+        n = cull_range(f, spheres, cl->first, cl->count, visible, n);
+        tested += cl->count;
+        break;
+      }
+    }
+  }
+
+  if(stats)
+  {
+    stats->visible += n;
+    stats->culled += spheres->count - n;
+    stats->tested += tested;
+  }
+
+  return n;
+}
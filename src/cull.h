@@ -0,0 +1,127 @@
+#ifndef _CULL_H_
+#define _CULL_H_
+
+#include <stdbool.h>
+
+#include "math/matrix44f.h"
+
+enum frustum_plane
+{
+  PLANE_LEFT = 0,
+  PLANE_RIGHT,
+  PLANE_BOTTOM,
+  PLANE_TOP,
+  PLANE_NEAR,
+  PLANE_FAR,
+  PLANE_COUNT
+};
+
+/* the 6 planes of a view frustum in world space. Each plane is stored as the
+ * coefficients (a, b, c, d) of the plane equation ax + by + cz + d = 0 with
+ * the normal (a, b, c) of unit length and pointing into the frustum, thus the
+ * signed distance of a point p to a plane is simply:
+ *
+ *    a*p.x + b*p.y + c*p.z + d
+ *
+ * note - planes are stored SoA, i.e. a[PLANE_LEFT] is the 'a' coefficient of
+ * the left plane, so the planes can be splatted into SIMD registers.
+ */
+struct frustum
+{
+  float a[PLANE_COUNT];
+  float b[PLANE_COUNT];
+  float c[PLANE_COUNT];
+  float d[PLANE_COUNT];
+};
+
+/* a bounding sphere enclosing a contiguous range of objects; the unit of
+ * hierarchical culling. If the cluster's sphere is outside the frustum all
+ * its objects are culled without being tested, if it is wholly inside all
+ * its objects are visible without being tested. */
+struct cull_cluster
+{
+  float x, y, z, r;
+  int first; /* index of the first object in the cluster */
+  int count; /* number of objects in the cluster */
+};
+
+/* a set of bounding spheres stored SoA for SIMD testing, optionally grouped
+ * into clusters. If cluster_count == 0 the spheres are tested flat. */
+struct cull_spheres
+{
+  int count;
+  const float *x;
+  const float *y;
+  const float *z;
+  const float *r;
+
+  int cluster_count;
+  const struct cull_cluster *clusters;
+};
+
+struct cull_stats
+{
+  int visible; /* objects which passed culling */
+  int culled;  /* objects rejected by culling */
+  int tested;  /* sphere-frustum tests performed, clusters included */
+  int occluded; /* objects inside the frustum rejected by occlusion culling */
+};
+
+/* frustum_extract - extracts the world space frustum planes from a combined
+ *   world-clip matrix, i.e. the matrix product (projection)(world-view).
+ *
+ * note - uses the Gribb/Hartmann method; each plane is a sum or difference of
+ *   the 4th row of the matrix with one of the other rows.
+ */
+void
+frustum_extract(struct frustum *f, struct matrix44f *wc);
+
+/* frustum_pull_far - moves the far plane 'distance_m' nearer the eye, e.g. to
+ *   cull at a shorter draw distance than the projection's far plane. */
+static inline void
+frustum_pull_far(struct frustum *f, float distance_m)
+{
+  f->d[PLANE_FAR] -= distance_m;
+}
+
+/* frustum_shift - re-expresses the frustum for positions which need
+ *   (dx, dy, dz) added to be in its space; e.g. to cull objects still relative
+ *   to the old origin during a rebase, without moving them. */
+static inline void
+frustum_shift(struct frustum *f, float dx, float dy, float dz)
+{
+  for(int p = 0; p < PLANE_COUNT; ++p)
+    f->d[p] += f->a[p] * dx + f->b[p] * dy + f->c[p] * dz;
+}
+
+/* frustum_test_sphere - tests a single sphere against the frustum.
+ *
+ * returns - true if the sphere is at least partially inside the frustum.
+ */
+bool
+frustum_test_sphere(const struct frustum *f, float x, float y, float z, float r);
+
+/* frustum_cull - culls a set of spheres against the frustum, writing the
+ *   indices of the visible spheres to 'visible' in ascending order.
+ *
+ * @visible - output buffer; must be large enough for 'spheres->count' indices.
+ * @stats - if not NULL, counts of this cull are added to the stats.
+ *
+ * returns - number of indices written to 'visible'.
+ *
+ * note - spheres are tested 8 at a time with AVX, 4 at a time with SSE, else
+ *   one at a time; selected at compile time.
+ */
+int
+frustum_cull(const struct frustum *f,
+             const struct cull_spheres *spheres,
+             int *visible,
+             struct cull_stats *stats);
+
+static inline void
+cull_stats_reset(struct cull_stats *stats)
+{
+  stats->visible = stats->culled = stats->tested = stats->occluded = 0;
+}
+
+#endif
@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+#include "util/trace.h"
+#include "util/jobs.h"
+#include "event_bus.h"
+
+/* a thread's events; on its own cache line as threads publish concurrently */
+struct event_thread_buffer
+{
+  struct event *events;
+  int count;
+  int dropped;
+} __attribute__((aligned(CACHE_LINE_BYTES)));
+
+static const char *type_names[EVENT_TYPE_COUNT] = {"ship control", "projectile hit", "projectile expired"};
+
+void
+event_bus_init(struct event_bus *bus, int capacity, struct arena *arena)
+{
+  assert(bus != NULL && capacity > 0 && arena != NULL);
+
+  memset(bus, 0, sizeof(struct event_bus));
+  bus->thread_count = jobs_thread_count();
+  bus->capacity = capacity;
+  bus->buffers = ARENA_NEW(arena, struct event_thread_buffer, bus->thread_count);
+  for(int t = 0; t < bus->thread_count; ++t)
+  {
+    bus->buffers[t].events = ARENA_NEW(arena, struct event, capacity);
+    bus->buffers[t].count = 0;
+    bus->buffers[t].dropped = 0;
+  }
+}
+
+void
+event_bus_subscribe(struct event_bus *bus, enum event_type type, event_handler fn, void *ctx)
+{
+  assert(type >= 0 && type < EVENT_TYPE_COUNT && fn != NULL);
+  assert(bus->handler_counts[type] < EVENT_MAX_HANDLERS);
+
+  int h = bus->handler_counts[type]++;
+  bus->handlers[type][h].fn = fn;
+  bus->handlers[type][h].ctx = ctx;
+}
+
+void
+event_bus_publish(struct event_bus *bus, const struct event *event)
+{
+  assert(event->type < EVENT_TYPE_COUNT);
+
+  int t = jobs_thread_index();
+  assert(t >= 0 && t < bus->thread_count);
+
+  struct event_thread_buffer *b = &bus->buffers[t];
+  if(b->count == bus->capacity)
+  {
+    ++b->dropped;
+    return;
+  }
+  b->events[b->count++] = *event;
+}
+
+static int
+compare_keys(const void *a, const void *b)
+{
+  uint32_t x = ((const struct event *)a)->key, y = ((const struct event *)b)->key;
+  return (x > y) - (x < y);
+}
+
+/* sort_keys - sorts a type's events by key; insertion sort as batches are
+ * mostly small and often already in order, e.g. a job's events by index. */
+static void
+sort_keys(struct event *events, int count)
+{
+  if(count > 64)
+  {
+    qsort(events, count, sizeof(struct event), compare_keys);
+    return;
+  }
+  for(int i = 1; i < count; ++i)
+  {
+    struct event e = events[i];
+    int j = i;
+    for(; j > 0 && events[j - 1].key > e.key; --j)
+      events[j] = events[j - 1];
+    events[j] = e;
+  }
+}
+
+int
+event_bus_drain(struct event_bus *bus)
+{
+  TRACE_ZONE("event_bus_drain");
+  uint64_t start_ns = clock_now_ns();
+
+  int total = 0;
+  for(int t = 0; t < bus->thread_count; ++t)
+  {
+    total += bus->buffers[t].count;
+    if(bus->buffers[t].dropped)
+    {
+      bus->frame.dropped += bus->buffers[t].dropped;
+      bus->dropped += bus->buffers[t].dropped;
+      LOGF_WARNING_RATE(1, "event bus: thread %d dropped %d events, its buffer is full", t, bus->buffers[t].dropped);
+      bus->buffers[t].dropped = 0;
+    }
+  }
+  ++bus->drains;
+  if(total == 0)
+  {
+    uint64_t ns = clock_now_ns() - start_ns;
+    bus->frame.drain_ns += ns;
+    bus->drain_ns += ns;
+    return 0;
+  }
+
+  /* counting sort by type into scratch; the buffers are emptied first so
+     handlers may publish the next drain's events */
+  struct event *sorted = frame_alloc(sizeof(struct event) * total);
+  int start[EVENT_TYPE_COUNT + 1] = {0};
+  for(int t = 0; t < bus->thread_count; ++t)
+    for(int i = 0; i < bus->buffers[t].count; ++i)
+      ++start[bus->buffers[t].events[i].type + 1];
+  for(int type = 0; type < EVENT_TYPE_COUNT; ++type)
+    start[type + 1] += start[type];
+
+  int cursor[EVENT_TYPE_COUNT];
+  memcpy(cursor, start, sizeof(cursor));
+  for(int t = 0; t < bus->thread_count; ++t)
+  {
+    struct event_thread_buffer *b = &bus->buffers[t];
+    for(int i = 0; i < b->count; ++i)
+      sorted[cursor[b->events[i].type]++] = b->events[i];
+    b->count = 0;
+  }
+
+  for(int type = 0; type < EVENT_TYPE_COUNT; ++type)
+  {
+    int count = start[type + 1] - start[type];
+    if(count == 0)
+      continue;
+
+    sort_keys(sorted + start[type], count);
+    for(int h = 0; h < bus->handler_counts[type]; ++h)
+      bus->handlers[type][h].fn(bus->handlers[type][h].ctx, sorted + start[type], count);
+    bus->frame.counts[type] += count;
+    bus->totals[type] += count;
+  }
+  bus->frame.total += total;
+
+  uint64_t ns = clock_now_ns() - start_ns;
+  bus->frame.drain_ns += ns;
+  bus->drain_ns += ns;
+  return total;
+}
+
+void
+event_bus_frame_end(struct event_bus *bus, struct event_frame_stats *stats)
+{
+  if(stats)
+    *stats = bus->frame;
+  memset(&bus->frame, 0, sizeof(struct event_frame_stats));
+  ++bus->frames;
+}
+
+void
+event_bus_log_report(const struct event_bus *bus)
+{
+  if(bus->frames == 0)
+    return;
+
+  for(int type = 0; type < EVENT_TYPE_COUNT; ++type)
+  {
+    log_write(LOG_INFO,
+              "events: %-18s %llu, %.2f per frame",
+              type_names[type],
+              (unsigned long long)bus->totals[type],
+              (double)bus->totals[type] / bus->frames);
+  }
+  log_write(bus->dropped ? LOG_WARNING : LOG_INFO,
+            "events: drained %llu times, %.3f us per frame, %llu dropped",
+            (unsigned long long)bus->drains,
+            (bus->drain_ns * 1e-3) / bus->frames,
+            (unsigned long long)bus->dropped);
+}
@@ -0,0 +1,120 @@
+#ifndef _EVENT_BUS_H_
+#define _EVENT_BUS_H_
+
+#include <stdint.h>
+
+#include "config.h"
+#include "util/memory.h"
+#include "input.h"
+
+/*
+ * The event bus; gameplay events published during a phase of the game loop
+ * are delivered in batches at the end of the phase, rather than by direct
+ * calls from where they happen.
+ *
+ * Each thread of the job system appends the events it publishes to its own
+ * buffer, so publishing takes no lock or atomic and jobs of a parallel tick
+ * publish freely. The job system's join makes the buffers' contents visible
+ * to the main thread, which drains them at a phase boundary: the events of
+ * all threads are sorted by type, and by key within a type, and each type's
+ * handlers are called once with the whole batch. Handlers see the events of a
+ * type contiguously, and in the same order whichever threads published them,
+ * as long as the keys of a type's events are unique within a phase.
+ *
+ * Only the main thread subscribes and drains, and not while jobs that publish
+ * are running. Each thread's buffer holds a fixed number of events; events
+ * published to a full buffer are dropped and counted.
+ */
+
+enum event_type
+{
+  EVENT_SHIP_CONTROL = 0,   /* a ship's command changed */
+  EVENT_PROJECTILE_HIT,     /* a projectile hit an asteroid */
+  EVENT_PROJECTILE_EXPIRED, /* a projectile's time to live ran out */
+  EVENT_TYPE_COUNT
+};
+
+struct event
+{
+  uint16_t type;  /* enum event_type */
+  uint32_t key;   /* orders the events of a type, e.g. an entity index */
+  union
+  {
+    struct {int tick; struct tick_command command;} ship_control;
+    struct {int asteroid; float x, y, z;} projectile_hit;
+    struct {float x, y, z;} projectile_expired;
+  };
+};
+
+/* a handler of a batch of events of one type */
+typedef void (*event_handler)(void *ctx, const struct event *events, int count);
+
+struct event_thread_buffer;
+
+/* the events published and the cost of draining them in a frame */
+struct event_frame_stats
+{
+  int counts[EVENT_TYPE_COUNT];
+  int total;
+  int dropped;
+  uint64_t drain_ns;
+};
+
+struct event_bus
+{
+  int thread_count;
+  int capacity;                        /* events of each thread's buffer */
+  struct event_thread_buffer *buffers; /* by job system thread index */
+
+  struct
+  {
+    event_handler fn;
+    void *ctx;
+  } handlers[EVENT_TYPE_COUNT][EVENT_MAX_HANDLERS];
+  int handler_counts[EVENT_TYPE_COUNT];
+
+  struct event_frame_stats frame;
+
+  /* totals since init */
+  uint64_t totals[EVENT_TYPE_COUNT];
+  uint64_t dropped;
+  uint64_t drains;
+  uint64_t drain_ns;
+  uint64_t frames;
+};
+
+/* event_bus_init - a buffer of 'capacity' events for each thread of the job
+ *   system, allocated from the arena; call after jobs_init. */
+void
+event_bus_init(struct event_bus *bus, int capacity, struct arena *arena);
+
+/* event_bus_subscribe - 'fn' is called with every batch of events of 'type';
+ *   a type's handlers are called in the order subscribed. */
+void
+event_bus_subscribe(struct event_bus *bus, enum event_type type, event_handler fn, void *ctx);
+
+/* event_bus_publish - appends the event to the calling thread's buffer; the
+ *   calling thread must be of the job system's pool. */
+void
+event_bus_publish(struct event_bus *bus, const struct event *event);
+
+/* event_bus_drain - delivers the events published since the last drain to
+ *   their handlers, by type, and empties the buffers. Handlers may publish;
+ *   those events are delivered by the next drain. Sorts in frame scratch.
+ *
+ * returns - the number of events delivered.
+ */
+int
+event_bus_drain(struct event_bus *bus);
+
+/* event_bus_frame_end - copies the frame's counts and drain cost to 'stats',
+ *   if not NULL, then resets them for the next frame. */
+void
+event_bus_frame_end(struct event_bus *bus, struct event_frame_stats *stats);
+
+/* event_bus_log_report - logs the events published and the mean drain cost
+ *   per frame since init. */
+void
+event_bus_log_report(const struct event_bus *bus);
+
+#endif
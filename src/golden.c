@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "util/log.h"
+#include "golden.h"
+
+#define LINE_BYTES 1024
+
+/* 64-bit FNV-1a */
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static const struct
+{
+  const char *name;
+  int first;  /* index of the field's first value in a sample */
+  int count;
+} fields[GOLDEN_FIELD_COUNT] = {
+  {"vpos_w_m", 0, 4},
+  {"front", 4, 4},
+  {"right", 8, 4},
+  {"mw", 12, 16},
+  {"wv", 28, 16},
+};
+
+const char *
+golden_field_name(enum golden_field field)
+{
+  return field < GOLDEN_FIELD_COUNT ? fields[field].name : "length";
+}
+
+void
+golden_run_init(struct golden_run *run, int interval, int ticks, struct arena *arena)
+{
+  assert(interval > 0 && ticks >= 0);
+
+  run->interval = interval;
+  run->count = 0;
+  run->capacity = ticks / interval;
+  run->samples = ARENA_NEW(arena, struct golden_sample, run->capacity ? run->capacity : 1);
+}
+
+static inline uint32_t
+float_bits(float f)
+{
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+/* canonical - tested on the bits, as a build with -ffast-math may assume no
+ * NaN or signed zero exists. */
+static inline float
+canonical(float f)
+{
+  uint32_t bits = float_bits(f);
+  if((bits & 0x7fffffffu) == 0)
+    bits = 0;
+  else if((bits & 0x7f800000u) == 0x7f800000u && (bits & 0x007fffffu) != 0)
+    bits = 0x7fc00000u;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+static uint64_t
+hash_sample(const struct golden_sample *s)
+{
+  uint64_t h = FNV_OFFSET;
+  uint32_t words[GOLDEN_VALUE_COUNT + 1];
+  words[0] = (uint32_t)s->tick;
+  for(int v = 0; v < GOLDEN_VALUE_COUNT; ++v)
+    words[v + 1] = float_bits(s->values[v]);
+
+  /* bytes in little-endian order, so hashes match across hosts */
+  for(int w = 0; w < GOLDEN_VALUE_COUNT + 1; ++w)
+  {
+    for(int b = 0; b < 4; ++b)
+    {
+      h ^= (words[w] >> (8 * b)) & 0xff;
+      h *= FNV_PRIME;
+    }
+  }
+  return h;
+}
+
+static void
+store_vector(float *out, const struct vector4f *v)
+{
+  out[0] = canonical(v->x);
+  out[1] = canonical(v->y);
+  out[2] = canonical(v->z);
+  out[3] = canonical(v->w);
+}
+
+static void
+store_matrix(float *out, const struct matrix44f *m)
+{
+  for(int c = 0; c < 4; ++c)
+    for(int r = 0; r < 4; ++r)
+      out[c * 4 + r] = canonical(m->m[c][r]);
+}
+
+void
+golden_capture(struct golden_run *run,
+               int tick,
+               const struct spaceship *ship,
+               const struct spaceship_camera *camera)
+{
+  if(tick % run->interval != 0 || tick == 0 || run->count == run->capacity)
+    return;
+
+  struct golden_sample *s = &run->samples[run->count++];
+  s->tick = tick;
+  store_vector(s->values + fields[GOLDEN_SHIP_POSITION].first, &ship->vpos_w_m);
+  store_vector(s->values + fields[GOLDEN_SHIP_FRONT].first, &ship->front);
+  store_vector(s->values + fields[GOLDEN_SHIP_RIGHT].first, &ship->right);
+  store_matrix(s->values + fields[GOLDEN_SHIP_MW].first, &ship->mw);
+  store_matrix(s->values + fields[GOLDEN_CAMERA_WV].first, &camera->wv);
+  s->hash = hash_sample(s);
+}
+
+bool
+golden_write(const struct golden_run *run, const char *path, const char *scenario)
+{
+  FILE *f = fopen(path, "w");
+  if(!f)
+  {
+    log_write(LOG_ERROR, "failed to open golden file '%s'", path);
+    return false;
+  }
+
+  fprintf(f, "# golden simulation state of scenario '%s'; written by simcheck --update\n", scenario);
+  fprintf(f, "interval %d\nsamples %d\n", run->interval, run->count);
+  for(int i = 0; i < run->count; ++i)
+  {
+    const struct golden_sample *s = &run->samples[i];
+    fprintf(f, "tick %d hash %016llx\n", s->tick, (unsigned long long)s->hash);
+    for(int d = 0; d < GOLDEN_FIELD_COUNT; ++d)
+    {
+      fprintf(f, "  %s", fields[d].name);
+      for(int v = 0; v < fields[d].count; ++v)
+        fprintf(f, " %a", s->values[fields[d].first + v]);
+      fputc('\n', f);
+    }
+  }
+
+  if(fclose(f))
+  {
+    log_write(LOG_ERROR, "failed to write golden file '%s'", path);
+    return false;
+  }
+  return true;
+}
+
+/* next_line - the next line of the file which isn't a comment. */
+static bool
+next_line(FILE *f, char *line)
+{
+  while(fgets(line, LINE_BYTES, f))
+    if(line[0] != '#')
+      return true;
+  return false;
+}
+
+static bool
+read_field(FILE *f, char *line, enum golden_field field, float *values)
+{
+  if(!next_line(f, line))
+    return false;
+
+  char *p = line;
+  while(*p == ' ')
+    ++p;
+  size_t name_len = strlen(fields[field].name);
+  if(strncmp(p, fields[field].name, name_len) != 0 || p[name_len] != ' ')
+    return false;
+
+  p += name_len;
+  for(int v = 0; v < fields[field].count; ++v)
+  {
+    char *end;
+    values[fields[field].first + v] = strtof(p, &end);
+    if(end == p)
+      return false;
+    p = end;
+  }
+  return true;
+}
+
+bool
+golden_read(struct golden_run *run, const char *path, struct arena *arena)
+{
+  FILE *f = fopen(path, "r");
+  if(!f)
+  {
+    log_write(LOG_ERROR, "failed to open golden file '%s'", path);
+    return false;
+  }
+
+  char line[LINE_BYTES];
+  int interval, count;
+  bool ok = next_line(f, line) && sscanf(line, "interval %d", &interval) == 1 && interval > 0 &&
+            next_line(f, line) && sscanf(line, "samples %d", &count) == 1 && count >= 0;
+  if(ok)
+  {
+    golden_run_init(run, interval, count * interval, arena);
+    for(int i = 0; ok && i < count; ++i)
+    {
+      struct golden_sample *s = &run->samples[i];
+      unsigned long long hash = 0;
+      ok = next_line(f, line) && sscanf(line, "tick %d hash %llx", &s->tick, &hash) == 2;
+      for(int d = 0; ok && d < GOLDEN_FIELD_COUNT; ++d)
+        ok = read_field(f, line, d, s->values);
+      /* a hash which doesn't match its values was edited by hand */
+      s->hash = hash;
+      ok = ok && hash_sample(s) == s->hash;
+      run->count += ok;
+    }
+  }
+  fclose(f);
+
+  if(!ok)
+    log_write(LOG_ERROR, "golden file '%s' is malformed", path);
+  return ok;
+}
+
+/* value_differs - compares a value in exact mode if 'tolerance' is 0, else in
+ * tolerance mode; NaNs are only equal to NaNs. */
+static bool
+value_differs(float expected, float actual, float tolerance)
+{
+  if(tolerance == 0.f || isnan(expected) || isnan(actual))
+    return float_bits(expected) != float_bits(actual);
+  return fabsf(actual - expected) > tolerance * (1.f + fabsf(expected));
+}
+
+bool
+golden_compare(const struct golden_run *golden,
+               const struct golden_run *run,
+               float tolerance,
+               struct golden_diff *diff)
+{
+  memset(diff, 0, sizeof(struct golden_diff));
+  diff->field = GOLDEN_FIELD_COUNT;
+  if(golden->interval != run->interval)
+    return false;
+
+  int count = golden->count < run->count ? golden->count : run->count;
+  for(int i = 0; i < count; ++i)
+  {
+    const struct golden_sample *e = &golden->samples[i];
+    const struct golden_sample *a = &run->samples[i];
+    diff->tick = e->tick;
+    if(e->tick != a->tick)
+      return false;
+    if(tolerance == 0.f && e->hash == a->hash)
+      continue;
+
+    for(int d = 0; d < GOLDEN_FIELD_COUNT; ++d)
+    {
+      for(int v = 0; v < fields[d].count; ++v)
+      {
+        float ev = e->values[fields[d].first + v];
+        float av = a->values[fields[d].first + v];
+        if(value_differs(ev, av, tolerance))
+        {
+          diff->field = d;
+          diff->component = v;
+          diff->expected = ev;
+          diff->actual = av;
+          return false;
+        }
+      }
+    }
+  }
+
+  if(golden->count != run->count)
+  {
+    diff->tick = (count < golden->count ? golden->samples : run->samples)[count].tick;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,118 @@
+#ifndef _GOLDEN_H_
+#define _GOLDEN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "util/memory.h"
+#include "spaceship.h"
+#include "spaceship_camera.h"
+
+/*
+ * Golden simulation state; snapshots of the canonical state of a simulation
+ * taken every few ticks of a replayed scenario, hashed and compared against
+ * snapshots committed as golden files. A change to the simulation or the math
+ * it relies on (SIMD, fast-math, reordered sums) which changes behaviour shows
+ * as the first tick and field which differ from the golden state.
+ *
+ * Snapshots compare in one of two modes:
+ *
+ *   exact     - every value bit for bit; compared by hash, then field by field
+ *               to find the difference.
+ *   tolerance - every value within a tolerance of the golden value, relative
+ *               to its magnitude: |a - e| <= tolerance * (1 + |e|).
+ *
+ * Golden files are text; values are written as hex floats so they read back
+ * exactly, and a changed golden file diffs readably.
+ */
+
+/* the fields of a snapshot, in the order they are hashed */
+enum golden_field
+{
+  GOLDEN_SHIP_POSITION = 0, /* ship vpos_w_m */
+  GOLDEN_SHIP_FRONT,        /* ship front */
+  GOLDEN_SHIP_RIGHT,        /* ship right */
+  GOLDEN_SHIP_MW,           /* ship model-world matrix, column-major */
+  GOLDEN_CAMERA_WV,         /* camera world-view matrix, column-major */
+  GOLDEN_FIELD_COUNT
+};
+
+/* floats of all the fields of a snapshot */
+#define GOLDEN_VALUE_COUNT (4 + 4 + 4 + 16 + 16)
+
+struct golden_sample
+{
+  int tick;       /* ticks simulated when the snapshot was taken */
+  uint64_t hash;
+  float values[GOLDEN_VALUE_COUNT];
+};
+
+/* the snapshots of a run of a scenario */
+struct golden_run
+{
+  int interval;   /* ticks between snapshots */
+  int count;
+  int capacity;
+  struct golden_sample *samples;
+};
+
+/* where two runs first differ */
+struct golden_diff
+{
+  int tick;
+  enum golden_field field;
+  int component;  /* index of the differing value within the field */
+  float expected;
+  float actual;
+};
+
+/* golden_field_name - the field as named in golden files. */
+const char *
+golden_field_name(enum golden_field field);
+
+/* golden_run_init - starts a run snapshotting every 'interval' ticks of a
+ *   scenario of 'ticks' ticks; the snapshots are allocated from the arena. */
+void
+golden_run_init(struct golden_run *run, int interval, int ticks, struct arena *arena);
+
+/* golden_capture - snapshots the ship and camera after 'tick' ticks if a
+ *   snapshot is due. Values are canonicalized before hashing; -0 is stored as
+ *   0 and any NaN as the one quiet NaN. */
+void
+golden_capture(struct golden_run *run,
+               int tick,
+               const struct spaceship *ship,
+               const struct spaceship_camera *camera);
+
+/* golden_write - writes the run's snapshots to the golden file at 'path'.
+ *
+ * @scenario - the name of the scenario, recorded in the file.
+ *
+ * returns - false on failure; logged.
+ */
+bool
+golden_write(const struct golden_run *run, const char *path, const char *scenario);
+
+/* golden_read - reads the snapshots of the golden file at 'path' into 'run',
+ *   allocated from the arena.
+ *
+ * returns - false if the file can't be read or is malformed; logged.
+ */
+bool
+golden_read(struct golden_run *run, const char *path, struct arena *arena);
+
+/* golden_compare - compares a run with the golden run in exact mode if
+ *   'tolerance' is 0, else in tolerance mode.
+ *
+ * @diff - on a mismatch, set to the first tick and field which differ; if the
+ *   runs differ in length or interval the field is GOLDEN_FIELD_COUNT.
+ *
+ * returns - true if the runs match.
+ */
+bool
+golden_compare(const struct golden_run *golden,
+               const struct golden_run *run,
+               float tolerance,
+               struct golden_diff *diff);
+
+#endif
@@ -0,0 +1,228 @@
+#include <string.h>
+#include <assert.h>
+
+#include "config.h"
+#include "util/log.h"
+#include "input.h"
+
+#define INPUT_MAGIC "PSIN"
+#define INPUT_VERSION 1
+#define HEADER_BYTES 20
+#define TICK_COUNT_OFFSET 16
+#define RECORD_BYTES 8
+
+void
+input_press(struct tick_command *held, enum input_action action)
+{
+  switch(action)
+  {
+  case INPUT_BOOST_FORWARD: held->boost = BOOST_FORWARD; break;
+  case INPUT_BOOST_REVERSE: held->boost = BOOST_REVERSE; break;
+  case INPUT_PITCH_CCW:     held->pitch = ROTATE_CCW; break;
+  case INPUT_PITCH_CW:      held->pitch = ROTATE_CW; break;
+  case INPUT_ROLL_CCW:      held->roll = ROTATE_CCW; break;
+  case INPUT_ROLL_CW:       held->roll = ROTATE_CW; break;
+  default: assert(false);
+  }
+}
+
+void
+input_release(struct tick_command *held, enum input_action action)
+{
+  switch(action)
+  {
+  case INPUT_BOOST_FORWARD:
+  case INPUT_BOOST_REVERSE: held->boost = BOOST_NONE; break;
+  case INPUT_PITCH_CCW:
+  case INPUT_PITCH_CW:      held->pitch = ROTATE_NONE; break;
+  case INPUT_ROLL_CCW:
+  case INPUT_ROLL_CW:       held->roll = ROTATE_NONE; break;
+  default: assert(false);
+  }
+}
+
+/**** RECORDING **************************************************************/
+
+static void
+put_u32(unsigned char *p, uint32_t v)
+{
+  for(int b = 0; b < 4; ++b)
+    p[b] = (v >> (8 * b)) & 0xff;
+}
+
+static uint32_t
+get_u32(const unsigned char *p)
+{
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void
+put_f64(unsigned char *p, double d)
+{
+  uint64_t v;
+  memcpy(&v, &d, sizeof(v));
+  put_u32(p, (uint32_t)v);
+  put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static double
+get_f64(const unsigned char *p)
+{
+  uint64_t v = get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+  double d;
+  memcpy(&d, &v, sizeof(d));
+  return d;
+}
+
+/* flush - writes the buffered records out; a failure is remembered until the
+ * recording is closed. */
+static bool
+flush(struct input_recorder *r)
+{
+  size_t n = (size_t)r->buffered;
+  r->buffered = 0;
+  if(fwrite(r->buffer, RECORD_BYTES, n, r->file) != n)
+    r->failed = true;
+  return !r->failed;
+}
+
+bool
+input_recorder_open(struct input_recorder *r, const char *path, struct arena *arena)
+{
+  assert(r != NULL && path != NULL && arena != NULL);
+
+  r->file = fopen(path, "wb");
+  if(!r->file)
+  {
+    log_write(LOG_ERROR, "failed to open input recording '%s'", path);
+    return false;
+  }
+
+  /* unbuffered, as the records are buffered here; the tick count is patched
+     in when the recording is closed */
+  setvbuf(r->file, NULL, _IONBF, 0);
+  unsigned char header[HEADER_BYTES];
+  memcpy(header, INPUT_MAGIC, 4);
+  put_u32(header + 4, INPUT_VERSION);
+  put_f64(header + 8, TICK_DELTA_S);
+  put_u32(header + TICK_COUNT_OFFSET, 0);
+  r->failed = fwrite(header, 1, HEADER_BYTES, r->file) != HEADER_BYTES;
+
+  r->path = path;
+  r->ticks = 0;
+  r->buffer = ARENA_NEW(arena, unsigned char, INPUT_RECORD_BUFFER * RECORD_BYTES);
+  r->buffered = 0;
+  r->capacity = INPUT_RECORD_BUFFER;
+  return true;
+}
+
+void
+input_recorder_tick(struct input_recorder *r, const struct tick_command *cmd)
+{
+  if(r->ticks == 0 || !tick_command_equal(cmd, &r->last))
+  {
+    if(r->buffered == r->capacity && !flush(r))
+      LOGF_WARNING_RATE(1, "failed to write input recording '%s'", r->path);
+
+    unsigned char *record = r->buffer + r->buffered++ * RECORD_BYTES;
+    put_u32(record, r->ticks);
+    record[4] = (unsigned char)cmd->boost;
+    record[5] = cmd->pitch;
+    record[6] = cmd->roll;
+    record[7] = 0;
+    r->last = *cmd;
+  }
+  ++r->ticks;
+}
+
+bool
+input_recorder_close(struct input_recorder *r)
+{
+  unsigned char count[4];
+  put_u32(count, r->ticks);
+
+  bool ok = flush(r);
+  ok = fseek(r->file, TICK_COUNT_OFFSET, SEEK_SET) == 0 && ok;
+  ok = fwrite(count, 1, 4, r->file) == 4 && ok;
+  ok = fclose(r->file) == 0 && ok;
+  r->file = NULL;
+  if(!ok)
+    log_write(LOG_ERROR, "failed to write input recording '%s'", r->path);
+  else
+    log_write(LOG_INFO, "recorded %u ticks of input to '%s'", r->ticks, r->path);
+  return ok;
+}
+
+bool
+input_player_open(struct input_player *p, const char *path, struct arena *arena)
+{
+  assert(p != NULL && path != NULL && arena != NULL);
+
+  FILE *f = fopen(path, "rb");
+  if(!f)
+  {
+    log_write(LOG_ERROR, "failed to open input recording '%s'", path);
+    return false;
+  }
+
+  long bytes = -1;
+  if(fseek(f, 0, SEEK_END) == 0)
+    bytes = ftell(f);
+  rewind(f);
+  if(bytes < HEADER_BYTES || (bytes - HEADER_BYTES) % RECORD_BYTES != 0)
+  {
+    log_write(LOG_ERROR, "'%s' is not an input recording", path);
+    fclose(f);
+    return false;
+  }
+
+  unsigned char *data = ARENA_NEW(arena, unsigned char, bytes);
+  bool ok = fread(data, 1, bytes, f) == (size_t)bytes;
+  fclose(f);
+  if(!ok || memcmp(data, INPUT_MAGIC, 4) != 0 || get_u32(data + 4) != INPUT_VERSION)
+  {
+    log_write(LOG_ERROR, "'%s' is not an input recording of this version", path);
+    return false;
+  }
+
+  /* commands are per tick, so a recording of another tick rate flies another
+     path */
+  double tick_delta_s = get_f64(data + 8);
+  if(tick_delta_s != TICK_DELTA_S)
+  {
+    log_write(LOG_WARNING,
+              "input recording '%s' has %.6f s ticks, not %.6f s; it won't replay the same",
+              path,
+              tick_delta_s,
+              TICK_DELTA_S);
+  }
+
+  p->records = data + HEADER_BYTES;
+  p->record_count = (int)((bytes - HEADER_BYTES) / RECORD_BYTES);
+  p->next = 0;
+  p->ticks = get_u32(data + TICK_COUNT_OFFSET);
+  memset(&p->current, 0, sizeof(p->current));
+  log_write(LOG_INFO,
+            "replaying %u ticks of input (%d commands) from '%s'",
+            p->ticks,
+            p->record_count,
+            path);
+  return true;
+}
+
+bool
+input_player_command(struct input_player *p, uint32_t tick, struct tick_command *cmd)
+{
+  if(tick >= p->ticks)
+    return false;
+
+  while(p->next < p->record_count && get_u32(p->records + p->next * RECORD_BYTES) <= tick)
+  {
+    const unsigned char *record = p->records + p->next++ * RECORD_BYTES;
+    p->current.boost = (int8_t)record[4];
+    p->current.pitch = record[5];
+    p->current.roll = record[6];
+  }
+  *cmd = p->current;
+  return true;
+}
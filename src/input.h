@@ -0,0 +1,133 @@
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "util/memory.h"
+#include "spaceship.h"
+
+/* the controls of the ship held through a tick; the only input the
+ * simulation sees. Input is quantized to ticks, so a tick's command is
+ * whatever was held when the tick ran; the commands of a session replayed
+ * into the fixed-step loop fly the same path every time. */
+struct tick_command
+{
+  int8_t boost;  /* enum boost */
+  uint8_t pitch; /* enum rotation */
+  uint8_t roll;  /* enum rotation */
+};
+
+/* the game's actions; keys are mapped to actions by the window code, so
+ * input needs no SDL */
+enum input_action
+{
+  INPUT_BOOST_FORWARD = 0,
+  INPUT_BOOST_REVERSE,
+  INPUT_PITCH_CCW,
+  INPUT_PITCH_CW,
+  INPUT_ROLL_CCW,
+  INPUT_ROLL_CW,
+  INPUT_ACTION_COUNT
+};
+
+/* input_press - an action's key went down; the newest press of a control wins. */
+void
+input_press(struct tick_command *held, enum input_action action);
+
+/* input_release - an action's key went up; the control it drives is released,
+ *   whichever of its actions is held. */
+void
+input_release(struct tick_command *held, enum input_action action);
+
+static inline bool
+tick_command_equal(const struct tick_command *a, const struct tick_command *b)
+{
+  return a->boost == b->boost && a->pitch == b->pitch && a->roll == b->roll;
+}
+
+/* tick_command_apply - sets the ship's controls for the tick. */
+static inline void
+tick_command_apply(const struct tick_command *cmd, struct spaceship *ship)
+{
+  spaceship_boost(ship, (enum boost)cmd->boost);
+  spaceship_pitch(ship, (enum rotation)cmd->pitch);
+  spaceship_roll(ship, (enum rotation)cmd->roll);
+}
+
+/**** RECORDING **************************************************************/
+
+/*
+ * Input files are little-endian binary; a 20 byte header followed by the
+ * commands as 8 byte records, one per change of command:
+ *
+ *   header: "PSIN", u32 version, f64 tick delta (s), u32 tick count
+ *   record: u32 tick, i8 boost, u8 pitch, u8 roll, u8 0
+ *
+ * a record's command holds from its tick until the next record's. The tick
+ * count is the number of ticks recorded, i.e. the length of the session.
+ */
+
+/* a recording in progress; changes are buffered in memory and written out
+ * when the buffer fills and at the end, so recording costs the loop nothing
+ * but a compare per tick and never allocates */
+struct input_recorder
+{
+  FILE *file;
+  const char *path;
+  struct tick_command last;
+  uint32_t ticks;
+  unsigned char *buffer;
+  int buffered;     /* records in the buffer */
+  int capacity;     /* records the buffer holds */
+  bool failed;      /* a write failed; the recording is incomplete */
+};
+
+/* input_recorder_open - starts recording to 'path'; the buffer is allocated
+ *   from the arena.
+ *
+ * returns - false if the file can't be opened; logged.
+ */
+bool
+input_recorder_open(struct input_recorder *r, const char *path, struct arena *arena);
+
+/* input_recorder_tick - records the command of the next tick. */
+void
+input_recorder_tick(struct input_recorder *r, const struct tick_command *cmd);
+
+/* input_recorder_close - writes out the recording and closes the file.
+ *
+ * returns - false if any write of the recording failed, including those of
+ *   earlier flushes; logged.
+ */
+bool
+input_recorder_close(struct input_recorder *r);
+
+/* a recording being replayed; the whole file is read into memory when
+ * opened, so playback does no io */
+struct input_player
+{
+  const unsigned char *records;
+  int record_count;
+  int next;         /* index of the next record to take effect */
+  uint32_t ticks;   /* length of the recording */
+  struct tick_command current;
+};
+
+/* input_player_open - reads the recording at 'path' into memory from the arena.
+ *
+ * returns - false if the file can't be read or isn't a recording; logged.
+ */
+bool
+input_player_open(struct input_player *p, const char *path, struct arena *arena);
+
+/* input_player_command - the command of tick 'tick'; ticks must be asked for
+ *   in order from 0.
+ *
+ * returns - false once past the end of the recording.
+ */
+bool
+input_player_command(struct input_player *p, uint32_t tick, struct tick_command *cmd);
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+#include "util/system.h"
+#include "util/jobs.h"
+
+/*
+ * Scaling benchmark of the job system; times workloads run with parallel_for
+ * on pools of 1 to N threads and prints the speedup over 1 thread.
+ *
+ * usage: jobsbench [--threads=N] [--runs=N]
+ *
+ * workloads:
+ *   uniform - integrate a million particles; every index costs the same.
+ *   skewed  - the cost of an index grows with the index; the last jobs of a
+ *             static split would take far longer, so balance needs stealing.
+ *   fine    - a cheap loop in jobs of 16 indices; the scheduling overhead.
+ */
+
+#define PARTICLE_COUNT (1 << 20)
+#define SKEWED_COUNT (1 << 14)
+#define FINE_COUNT (1 << 18)
+
+struct particles
+{
+  float *x, *y, *z;
+  float *vx, *vy, *vz;
+};
+
+static struct particles particles;
+static float *results;
+
+static void
+uniform_job(void *arg, int begin, int end)
+{
+  struct particles *p = arg;
+  const float dt = 1.f / 60.f;
+  for(int i = begin; i < end; ++i)
+  {
+    /* a spring pulling each particle to the origin, with some trig so the
+       loop is bound by compute rather than memory */
+    float r = sqrtf(p->x[i] * p->x[i] + p->y[i] * p->y[i] + p->z[i] * p->z[i]) + 1.f;
+    float s = sinf(r) * cosf(r * 0.5f) / r;
+    p->vx[i] -= p->x[i] * s * dt;
+    p->vy[i] -= p->y[i] * s * dt;
+    p->vz[i] -= p->z[i] * s * dt;
+    p->x[i] += p->vx[i] * dt;
+    p->y[i] += p->vy[i] * dt;
+    p->z[i] += p->vz[i] * dt;
+  }
+}
+
+static void
+skewed_job(void *arg, int begin, int end)
+{
+  float *out = arg;
+  for(int i = begin; i < end; ++i)
+  {
+    float sum = 0.f;
+    for(int k = 0; k < i / 32; ++k)
+      sum += sinf((float)(i + k));
+    out[i] = sum;
+  }
+}
+
+static void
+fine_job(void *arg, int begin, int end)
+{
+  float *out = arg;
+  for(int i = begin; i < end; ++i)
+    out[i] = out[i] * 0.5f + 1.f;
+}
+
+struct workload
+{
+  const char *name;
+  int count;
+  int grain;
+  job_fn fn;
+  void *arg;
+};
+
+static void
+init_particles()
+{
+  particles.x = xmalloc(sizeof(float) * PARTICLE_COUNT * 6);
+  particles.y = particles.x + PARTICLE_COUNT;
+  particles.z = particles.y + PARTICLE_COUNT;
+  particles.vx = particles.z + PARTICLE_COUNT;
+  particles.vy = particles.vx + PARTICLE_COUNT;
+  particles.vz = particles.vy + PARTICLE_COUNT;
+  for(int i = 0; i < PARTICLE_COUNT; ++i)
+  {
+    particles.x[i] = (float)(i % 1000) - 500.f;
+    particles.y[i] = (float)(i % 777) - 388.f;
+    particles.z[i] = (float)(i % 555) - 277.f;
+    particles.vx[i] = particles.vy[i] = particles.vz[i] = 0.f;
+  }
+  results = xmalloc(sizeof(float) * FINE_COUNT);
+  memset(results, 0, sizeof(float) * FINE_COUNT);
+}
+
+/* time_workload - the fastest of 'runs' runs in milliseconds. */
+static double
+time_workload(const struct workload *w, int runs)
+{
+  /* warm up the caches and wake the workers */
+  parallel_for(0, w->count, w->grain, w->fn, w->arg);
+
+  uint64_t best_ns = UINT64_MAX;
+  for(int r = 0; r < runs; ++r)
+  {
+    uint64_t start_ns = clock_now_ns();
+    parallel_for(0, w->count, w->grain, w->fn, w->arg);
+    uint64_t ns = clock_now_ns() - start_ns;
+    if(ns < best_ns)
+      best_ns = ns;
+  }
+  return best_ns / 1e6;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int runs = 10;
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strncmp(argv[i], "--threads=", 10) == 0)
+      max_threads = atoi(argv[i] + 10);
+    else if(strncmp(argv[i], "--runs=", 7) == 0)
+      runs = atoi(argv[i] + 7);
+    else
+    {
+      fprintf(stderr, "usage: jobsbench [--threads=N] [--runs=N]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if(max_threads < 1 || runs < 1)
+  {
+    fprintf(stderr, "usage: jobsbench [--threads=N] [--runs=N]\n");
+    return EXIT_FAILURE;
+  }
+
+  log_init();
+  clock_timestamp_init();
+  init_particles();
+
+  const struct workload workloads[] = {
+    {"uniform", PARTICLE_COUNT, 4096, uniform_job, &particles},
+    {"skewed", SKEWED_COUNT, 64, skewed_job, results},
+    {"fine", FINE_COUNT, 16, fine_job, results},
+  };
+  const int workload_count = (int)(sizeof(workloads) / sizeof(workloads[0]));
+
+  double base_ms[workload_count];
+  printf("%-8s %7s %10s %8s %10s %8s %8s\n",
+         "workload", "threads", "ms", "speedup", "efficiency", "jobs", "stolen");
+  for(int w = 0; w < workload_count; ++w)
+  {
+    for(int t = 1; t <= max_threads; ++t)
+    {
+      jobs_init(t);
+      double ms = time_workload(&workloads[w], runs);
+      if(t == 1)
+        base_ms[w] = ms;
+
+      uint64_t executed = 0, stolen = 0;
+      for(int i = 0; i < t; ++i)
+      {
+        struct jobs_thread_stats stats;
+        jobs_get_stats(i, &stats);
+        executed += stats.executed;
+        stolen += stats.stolen;
+      }
+      jobs_quit();
+
+      double speedup = base_ms[w] / ms;
+      printf("%-8s %7d %10.3f %7.2fx %9.0f%% %8llu %8llu\n",
+             workloads[w].name, t, ms, speedup, 100.0 * speedup / t,
+             (unsigned long long)(executed / (runs + 1)),
+             (unsigned long long)(stolen / (runs + 1)));
+    }
+  }
+
+  free(results);
+  free(particles.x);
+  log_quit();
+  return EXIT_SUCCESS;
+}
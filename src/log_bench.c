@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+
+/*
+ * Benchmark of the logger's hot path; times log_write on the calling thread,
+ * i.e. claiming a record of the queue and copying the format pointer and
+ * arguments into it, for messages of a few shapes. The writer thread formats
+ * and writes them to the log file meanwhile.
+ *
+ * usage: logbench [--batches=N]
+ *
+ * Calls are timed in batches of half the queue, and the queue is flushed
+ * between batches, so no call finds the queue full; the time of a call is
+ * that of the caller, not of the write to disk. The target is under 100ns a
+ * call.
+ *
+ * messages:
+ *   plain    - a format without arguments.
+ *   numbers  - three ints and a double, as the game's reports.
+ *   string   - a %s argument, which is copied.
+ *   filtered - LOGF_DEBUG at the info level; the level check only.
+ */
+
+#define BATCH_CALLS 512
+#define TARGET_NS 100.0
+
+enum message {MESSAGE_PLAIN = 0, MESSAGE_NUMBERS, MESSAGE_STRING, MESSAGE_FILTERED, MESSAGE_COUNT};
+
+static const char *message_names[MESSAGE_COUNT] = {"plain", "numbers", "string", "filtered"};
+
+static void
+log_batch(enum message m, int batch)
+{
+  for(int i = 0; i < BATCH_CALLS; ++i)
+  {
+    switch(m)
+    {
+    case MESSAGE_PLAIN:
+      log_write(LOG_INFO, "logbench: a message without arguments");
+      break;
+    case MESSAGE_NUMBERS:
+      log_write(LOG_INFO, "logbench: batch %d call %d of %d took %.3f ms", batch, i, BATCH_CALLS, i * 0.001);
+      break;
+    case MESSAGE_STRING:
+      log_write(LOG_INFO, "logbench: message '%s' call %d", message_names[m], i);
+      break;
+    case MESSAGE_FILTERED:
+      LOGF_DEBUG("logbench: batch %d call %d", batch, i);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int batches = 200;
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strncmp(argv[i], "--batches=", 10) == 0)
+      batches = atoi(argv[i] + 10);
+    else
+      batches = 0;
+  }
+  if(batches < 1)
+  {
+    fprintf(stderr, "usage: logbench [--batches=N]\n");
+    return EXIT_FAILURE;
+  }
+
+  log_init();
+  clock_timestamp_init();
+
+  printf("%-8s %10s %10s %10s %7s\n", "message", "calls", "mean ns", "best ns", "target");
+  for(int m = 0; m < MESSAGE_COUNT; ++m)
+  {
+    /* warm up the queue's records and the writer */
+    log_batch(m, -1);
+    log_flush();
+
+    uint64_t total_ns = 0, best_ns = UINT64_MAX;
+    for(int b = 0; b < batches; ++b)
+    {
+      uint64_t start_ns = clock_now_ns();
+      log_batch(m, b);
+      uint64_t ns = clock_now_ns() - start_ns;
+      total_ns += ns;
+      best_ns = ns < best_ns ? ns : best_ns;
+      log_flush();
+    }
+
+    double mean_ns = (double)total_ns / ((double)batches * BATCH_CALLS);
+    printf("%-8s %10d %10.1f %10.1f %7s\n",
+           message_names[m],
+           batches * BATCH_CALLS,
+           mean_ns,
+           (double)best_ns / BATCH_CALLS,
+           mean_ns < TARGET_NS ? "met" : "missed");
+  }
+
+  log_quit();
+  return EXIT_SUCCESS;
+}
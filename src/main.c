@@ -1,313 +1,592 @@
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_opengl.h>
-#include <GL/glu.h>
 #include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
 #include <assert.h>
 #include "util/log.h"
 #include "util/clock.h"
+#include "util/system.h"
+#include "util/memory.h"
+#include "util/alloc_track.h"
+#include "util/trace.h"
+#include "util/jobs.h"
+#include "util/pacer.h"
 #include "spaceship.h"
 #include "spaceship_camera.h"
+#include "asteroid.h"
+#include "origin.h"
+#include "belt.h"
+#include "cull.h"
+#include "occlusion.h"
+#include "telemetry.h"
+#include "overload.h"
+#include "input.h"
+#include "event_bus.h"
+#include "render/render.h"
 #include "config.h"
 
 #define SCREEN_WIDTH_PX 1500
 #define SCREEN_HEIGHT_PX 800
 
-static SDL_GLContext glcontext;
-static SDL_Window *window;
-
-/**** CUBE MODEL *************************************************************/
-
-static GLfloat cube_vertices[] = {
-  -1.0f, -1.0f,  1.0f,  
-   1.0f, -1.0f,  1.0f,
-   1.0f,  1.0f,  1.0f,
-  -1.0f,  1.0f,  1.0f,
-  -1.0f, -1.0f, -1.0f,  
-   1.0f, -1.0f, -1.0f,
-   1.0f,  1.0f, -1.0f,
-  -1.0f,  1.0f, -1.0f
-}; /* size = 12 */
-
-static GLfloat cube_colors[] = {
-  1.0f, 0.f, 0.f,
-  1.0f, 0.f, 0.f,
-  1.0f, 0.f, 0.f,
-  1.0f, 0.f, 0.f,
-  0.0f, 1.f, 0.f,
-  0.0f, 1.f, 0.f,
-  0.0f, 1.f, 0.f,
-  0.0f, 1.f, 0.f
-}; /* size = 12 */
-
-static GLubyte cube_indices[] = {
-  0, 1, 2,
-  0, 2, 3,
-  1, 5, 6,
-  1, 6, 2,
-  5, 4, 7,
-  5, 7, 6, 
-  4, 0, 3,
-  4, 3, 7,
-  3, 2, 6,
-  3, 6, 7,
-  1, 0, 4, 
-  1, 4, 5
-}; /* size == 36 */
-
-/**** spaceship MODEL *************************************************************/
-
-static GLfloat spaceship_vertices[] = {
-  -0.5f,  0.0f, -1.0f,
-  -1.0f,  0.0f,  1.0f,
-   1.0f,  0.0f,  1.0f,
-   0.5f,  0.0f, -1.0f,
-  -0.75f, 0.3f,  0.5f,
-   0.75f, 0.3f,  0.5f,
-   0.75f,-0.3f,  0.5f,
-  -0.75f,-0.3f,  0.5f
-}; /* size = 8 */
-
-static GLfloat spaceship_colors[] = {
-  0.0f, 1.0f, 0.0f,
-  1.0f, 1.0f, 0.0f,
-  1.0f, 1.0f, 0.0f,
-  0.0f, 1.0f, 0.0f,
-  1.0f, 0.0f, 0.0f,
-  1.0f, 0.0f, 0.0f,
-  0.0f, 0.0f, 1.0f,
-  0.0f, 0.0f, 1.0f
-}; /* size = 8 */
-
-static GLubyte spaceship_indices[] = {
-  0, 4, 1,
-  4, 5, 1,
-  1, 5, 2,
-  2, 5, 3,
-  0, 3, 4,
-  4, 3, 5,
-  0, 1, 7,
-  1, 6, 7,
-  1, 2, 6,
-  0, 7, 3,
-  3, 7, 6,
-  2, 3, 6
-}; /* size = 36 */
-
-static GLubyte spaceship_bottom_indices[] = {
-  0, 7, 1,
-  1, 7, 6,
-  1, 6, 2,
-  0, 3, 7,
-  3, 6, 7,
-  2, 6, 3,
+/* how frames are rendered; all but the window are benchmark runs of a fixed
+   number of frames of the scripted flight */
+enum render_mode
+{
+  RENDER_WINDOW,    /* opengl to an SDL window, interactive */
+  RENDER_OFFSCREEN, /* opengl to an EGL pbuffer; no window or swap pacing */
+  RENDER_SOFTWARE   /* software rasterizer; no window or gpu */
 };
 
-static GLubyte spaceship_top_indices[] = {
-  0, 1, 4,
-  4, 1, 5,
-  1, 2, 5,
-  2, 3, 5,
-  0, 4, 3,
-  4, 5, 3
+/* command line options */
+struct options
+{
+  enum render_mode mode;
+  int frames;           /* benchmark: number of frames to render, one tick each;
+                           0 for the length of the replay, or the default */
+  int threads;          /* threads of the job system; 0 for one per cpu */
+  const char *ppm_path; /* benchmark: write the last frame to this ppm file */
+  bool mirror;          /* add a rear-view mirror inset */
+  bool spectator;       /* split the screen with a spectator view */
+  const char *telemetry_path; /* write the frame telemetry here on exit */
+  bool verbose;         /* log debug messages */
+  bool alloc_check;     /* fail if the game loop allocates once warmed up */
+  enum pacer_mode pacing; /* window: how frames are paced */
+  double fps_cap;       /* window: frame rate of capped pacing */
+  const char *record_path; /* record the ticks' input to this file */
+  const char *replay_path; /* fly the input recorded in this file */
+  bool belt;            /* fly the open asteroid belt rather than the world box */
 };
 
-static GLubyte spaceship_wireframe_indices[] = {
-  0, 1,
-  1, 2,
-  2, 3,
-  0, 3,
-  0, 4,
-  1, 4,
-  2, 5,
-  4, 5,
-  3, 5,
-  0, 7,
-  1, 7,
-  2, 6,
-  6, 7,
-  6, 3
+/* a view of the scene through one camera into a rectangle of the screen; the
+   views share the scene and the occlusion buffer, each culls the scene
+   itself */
+struct view
+{
+  enum shipcam_mode mode;
+  struct spaceship_camera camera;
+
+  /* the viewport as fractions of the screen, from the top left */
+  float x, y, width, height;
+
+  /* view-clip matrix; kept so the view frustum can be extracted for culling */
+  struct matrix44f projection;
+
+  int *visible_asteroids;
+  struct render_view rv;
 };
 
-/*** WORLD AXES **************************************************************/
-
-static GLfloat axis_vertices[] = {
-   0.f  , 0.f  , 0.f  ,
-   200.f, 0.f  , 0.f  ,   /* (+)x-axis */
-   0.f  , 0.f  , 0.f  ,
-  -200.f, 0.f  , 0.f  ,   /* (-)x-axis */
-   0.f  , 0.f  , 0.f  ,
-   0.f  , 200.f, 0.f  ,   /* (+)y-axis */
-   0.f  , 0.f  , 0.f  ,
-   0.f  ,-200.f, 0.f  ,   /* (-)y-axis */
-   0.f  , 0.f  , 0.f  ,
-   0.f  , 0.f  , 200.f,   /* (+)z-axis */
-   0.f  , 0.f  , 0.f  ,
-   0.f  , 0.f  ,-200.f    /* (-)z-axis */
-}; /* size = 36 */
-
-static GLfloat axis_colors[] = {
-  1.0f, 0.0f, 0.0f,
-  1.0f, 0.0f, 0.0f,       /* (+)x-axis */
-  1.0f, 0.5f, 0.0f,
-  1.0f, 0.5f, 0.0f,       /* (-)x-axis */
-  0.0f, 1.0f, 0.0f,
-  0.0f, 1.0f, 0.0f,       /* (+)y-axis */
-  1.0f, 1.0f, 0.0f,
-  1.0f, 1.0f, 0.0f,       /* (-)y-axis */
-  0.0f, 0.0f, 1.0f,
-  0.0f, 0.0f, 1.0f,       /* (+)z-axis */
-  0.0f, 1.0f, 1.0f,
-  0.0f, 1.0f, 1.0f,       /* (-)z-axis */
-}; /* size = 12 */
-
-/*****************************************************************************/
-
-static const int xz_grid_lines = 101; /* num lines per dimension; square grid */
-static const int xz_grid_vertex_count = (xz_grid_lines * 2 * 2);
-static const int xz_grid_vertex_component_count = xz_grid_vertex_count * 3;
-static GLfloat xzgrid[1212]; 
-
-/* generate_xz_grid - generates a vertex array which can be used to render
- * a grid in the world space x-z plane. The grid is centered about it's origin.
- *
- * @vertex_array - buffer to store generated vertices.
- * @ox,oy,oz - position vector to origin of the grid.
- * @d - distance between grid lines (unit: meters).
- * @nx - num lines perpendicular to x-axis in grid.
- * @nz - num lines perpendicular to z-axis in grid.
- *
- * note - the @vertex_array MUST be large enough to store all the generated
- * vertices or a seg fault will occur. The number of generated vertices can
- * be calculated as:
- *    
- *    num_vertices = (nx + ny) * 2 * 3
- *
- * why? nx + ny = num lines in grid, then have 2 points per line and 3 vertices
- * per point.
- *
- * note - nx and nz should be odd values to allow the grid to be evenly spaced
- * about the origin; the odd, extra line in each dimension is the center line
- * in that dimension. This approach is taken to allow the center line to be
- * rendered as the axes of the grid and have the grid evenly spaced about the
- * axes. If nx or nz is even, they are made odd by subtracting 1.
- */
-void
-generate_xz_grid(GLfloat *vertex_array, float d_m, int nx, int nz)
+/* a step of the scripted flight flown by benchmark runs; the command is
+   held from 'tick' until the next step */
+struct script_step
 {
-  assert(vertex_array != NULL);
+  int tick;
+  struct tick_command command;
+};
 
-  int nhx, nhz, v = 0;
+static const struct script_step flight_script[] = {
+  {0,   {BOOST_FORWARD, ROTATE_NONE, ROTATE_NONE}},
+  {60,  {BOOST_FORWARD, ROTATE_CCW,  ROTATE_NONE}},
+  {120, {BOOST_NONE,    ROTATE_NONE, ROTATE_CW}},
+  {180, {BOOST_FORWARD, ROTATE_CW,   ROTATE_NONE}},
+  {240, {BOOST_REVERSE, ROTATE_NONE, ROTATE_CCW}},
+  {300, {BOOST_NONE,    ROTATE_NONE, ROTATE_NONE}},
+  {360, {BOOST_FORWARD, ROTATE_CCW,  ROTATE_CW}},
+  {480, {BOOST_NONE,    ROTATE_NONE, ROTATE_NONE}},
+};
+
+#define FLIGHT_SCRIPT_STEPS ((int)(sizeof(flight_script) / sizeof(flight_script[0])))
 
-  if(nx % 2 == 0)
-    nx--;
-  if(nz % 2 == 0)
-    nz--;
+/* the keys of the game's actions in window runs */
+static const struct key_binding
+{
+  SDL_Keycode key;
+  enum input_action action;
+} key_bindings[] = {
+  {SDLK_w, INPUT_BOOST_FORWARD},
+  {SDLK_s, INPUT_BOOST_REVERSE},
+  {SDLK_i, INPUT_PITCH_CCW},
+  {SDLK_k, INPUT_PITCH_CW},
+  {SDLK_j, INPUT_ROLL_CW},
+  {SDLK_l, INPUT_ROLL_CCW},
+};
 
-  nhx = (nx - 1) / 2;
-  nhz = (nz - 1) / 2;
+#define KEY_BINDING_COUNT ((int)(sizeof(key_bindings) / sizeof(key_bindings[0])))
 
-  /* generate the lines perpendicular to the x-axis */
-  for(int i = -nhx; i <= nhx; ++i)
-  {
-    vertex_array[v++] = (d_m * i);
-    vertex_array[v++] = 0.f;
-    vertex_array[v++] = (-nhz) * d_m;
+static struct render_backend renderer;
 
-    vertex_array[v++] = (d_m * i);
-    vertex_array[v++] = 0.f;
-    vertex_array[v++] = nhz * d_m;
-  }
+static struct view views[RENDER_MAX_VIEWS];
+static int view_count;
+
+/* asteroids farther than this are culled; shortened by the overload governor
+   shedding render detail */
+static float asteroid_draw_distance_m = VIEW_FAR_M;
+
+/* the grid walls and axes are drawn only around the world box, not in the
+   open belt, where the origin follows the ship */
+static bool world_box = true;
+
+static void
+usage()
+{
+  fprintf(stderr, 
+          "usage: test [--headless | --offscreen] [--frames=N] [--threads=N] [--ppm=PATH]\n"
+          "            [--mirror] [--spectator] [--telemetry=PATH] [--verbose]\n"
+          "            [--alloc-check] [--pacing=MODE] [--fps-cap=HZ]\n"
+          "            [--record=PATH] [--replay=PATH] [--belt]\n"
+          "  --headless   render with the software rasterizer, no window\n"
+          "  --offscreen  render with opengl to an offscreen EGL pbuffer, no window\n"
+          "  --frames=N   headless/offscreen: render N frames then quit (default %d,\n"
+          "               or the length of the replay)\n"
+          "  --threads=N  threads of the job system, 0 for one per cpu (default %d)\n"
+          "  --ppm=PATH   headless/offscreen: write the last frame to a ppm image\n"
+          "  --mirror     add a rear-view mirror\n"
+          "  --spectator  split the screen with a spectator's view of the ship\n"
+          "  --telemetry=PATH  write the frame telemetry to PATH on exit; json if\n"
+          "                    PATH ends in .json, else csv\n"
+          "  --verbose    log debug messages\n"
+          "  --alloc-check  headless/offscreen: exit with failure if any frame after\n"
+          "                 the first %d allocates; needs 'make alloccheck'\n"
+          "  --pacing=MODE  window: vsync, capped or uncapped (default %s)\n"
+          "  --fps-cap=HZ   window: frame rate of capped pacing (default %.0f)\n"
+          "  --record=PATH  record the input of every tick to PATH\n"
+          "  --replay=PATH  fly the input recorded in PATH instead of the keyboard\n"
+          "                 or the flight script\n"
+          "  --belt       fly the open asteroid belt, generated around the ship as it\n"
+          "               flies, instead of the world box\n",
+          HEADLESS_FRAMES,
+          JOBS_THREADS,
+          ALLOC_WARMUP_FRAMES,
+          pacer_mode_name(PACER_MODE),
+          PACER_CAP_HZ);
+  exit(EXIT_FAILURE);
+}
 
-  /* generate the lines perpendicular to the z-axis */
-  for(int i = -nhz; i <= nhz; ++i)
+static void
+parse_options(int argc, char *argv[], struct options *opts)
+{
+  opts->mode = RENDER_WINDOW;
+  opts->frames = 0;
+  opts->threads = JOBS_THREADS;
+  opts->ppm_path = NULL;
+  opts->mirror = false;
+  opts->spectator = false;
+  opts->telemetry_path = NULL;
+  opts->verbose = false;
+  opts->alloc_check = false;
+  opts->pacing = PACER_MODE;
+  opts->fps_cap = PACER_CAP_HZ;
+  opts->record_path = NULL;
+  opts->replay_path = NULL;
+  opts->belt = false;
+
+  for(int i = 1; i < argc; ++i)
   {
-    vertex_array[v++] = (-nhx) * d_m;
-    vertex_array[v++] = 0.f;
-    vertex_array[v++] = d_m * i;
+    if(strcmp(argv[i], "--headless") == 0)
+      opts->mode = RENDER_SOFTWARE;
+    else if(strcmp(argv[i], "--offscreen") == 0)
+      opts->mode = RENDER_OFFSCREEN;
+    else if(strncmp(argv[i], "--frames=", 9) == 0)
+      opts->frames = atoi(argv[i] + 9);
+    else if(strncmp(argv[i], "--threads=", 10) == 0)
+      opts->threads = atoi(argv[i] + 10);
+    else if(strncmp(argv[i], "--ppm=", 6) == 0)
+      opts->ppm_path = argv[i] + 6;
+    else if(strcmp(argv[i], "--mirror") == 0)
+      opts->mirror = true;
+    else if(strcmp(argv[i], "--spectator") == 0)
+      opts->spectator = true;
+    else if(strncmp(argv[i], "--telemetry=", 12) == 0)
+      opts->telemetry_path = argv[i] + 12;
+    else if(strcmp(argv[i], "--verbose") == 0)
+      opts->verbose = true;
+    else if(strcmp(argv[i], "--alloc-check") == 0)
+      opts->alloc_check = true;
+    else if(strncmp(argv[i], "--pacing=", 9) == 0)
+    {
+      int m = 0;
+      while(m < PACER_MODE_COUNT && strcmp(argv[i] + 9, pacer_mode_name(m)) != 0)
+        ++m;
+      if(m == PACER_MODE_COUNT)
+        usage();
+      opts->pacing = m;
+    }
+    else if(strncmp(argv[i], "--fps-cap=", 10) == 0)
+      opts->fps_cap = atof(argv[i] + 10);
+    else if(strncmp(argv[i], "--record=", 9) == 0)
+      opts->record_path = argv[i] + 9;
+    else if(strncmp(argv[i], "--replay=", 9) == 0)
+      opts->replay_path = argv[i] + 9;
+    else if(strcmp(argv[i], "--belt") == 0)
+      opts->belt = true;
+    else
+      usage();
+  }
+
+  if(opts->frames < 0 || opts->threads < 0 || !(opts->fps_cap > 0.0))
+    usage();
 
-    vertex_array[v++] = nhx * d_m;
-    vertex_array[v++] = 0.f;
-    vertex_array[v++] = (d_m * i);
+#ifndef ALLOC_TRACKING
+  if(opts->alloc_check)
+  {
+    fprintf(stderr, "--alloc-check needs allocation tracking built in; see 'make alloccheck'\n");
+    exit(EXIT_FAILURE);
   }
+#endif
+  if(opts->alloc_check && opts->mode == RENDER_WINDOW)
+    usage();
 }
 
+/* set_projection - lays out the views' viewports on the screen, rebuilds
+ * their projection matrices for the viewport sizes and resizes the renderer's
+ * output. */
 static void
-init()
+set_projection(int width_px, int height_px)
 {
-  log_init();
+  for(int v = 0; v < view_count; ++v)
+  {
+    struct view *view = &views[v];
+    view->rv.x_px = (int)(view->x * width_px);
+    view->rv.y_px = (int)(view->y * height_px);
+    view->rv.width_px = (int)((view->x + view->width) * width_px) - view->rv.x_px;
+    view->rv.height_px = (int)((view->y + view->height) * height_px) - view->rv.y_px;
+
+    perspective44fm(VIEW_FOV_Y_DG,
+                    (float)view->rv.width_px / (float)view->rv.height_px,
+                    VIEW_NEAR_M,
+                    VIEW_FAR_M,
+                    &view->projection);
+  }
+
+  renderer.resize(&renderer, width_px, height_px);
+}
 
-  GLenum glerror;
+/* add_view - adds a view of 'mode' through the viewport (as fractions of the
+ * screen); views are drawn in the order added. */
+static struct view *
+add_view(enum shipcam_mode mode, float x, float y, float width, float height)
+{
+  assert(view_count < RENDER_MAX_VIEWS);
+
+  struct view *view = &views[view_count++];
+  view->mode = mode;
+  view->x = x;
+  view->y = y;
+  view->width = width;
+  view->height = height;
+  return view;
+}
+
+/* layout_views - the chase view fills the screen, or its left half when split
+ * with the spectator; the mirror is a letterbox inset at the top of it. */
+static void
+layout_views(struct options *opts)
+{
+  view_count = 0;
+  float chase_width = opts->spectator ? 0.5f : 1.f;
+  add_view(SHIPCAM_CHASE, 0.f, 0.f, chase_width, 1.f);
+  if(opts->spectator)
+    add_view(SHIPCAM_SPECTATOR, 0.5f, 0.f, 0.5f, 1.f);
+  if(opts->mirror)
+    add_view(SHIPCAM_MIRROR, chase_width * 0.3f, 0.02f, chase_width * 0.4f, 0.2f);
+}
 
-  if(SDL_Init(SDL_INIT_VIDEO) < 0)
+/* fly_script - holds the command of the flight script step starting at
+ * 'tick', if any. */
+static void
+fly_script(struct tick_command *held, int tick)
+{
+  for(int i = 0; i < FLIGHT_SCRIPT_STEPS; ++i)
   {
-    fprintf(stderr, "fatal: failed to init SDL2: SDL error: %s\n", SDL_GetError());
-    exit(EXIT_SUCCESS);
+    if(flight_script[i].tick != tick)
+      continue;
+    *held = flight_script[i].command;
+    return;
   }
+}
 
-  window = SDL_CreateWindow("sdl2-opengl", 
-                         SDL_WINDOWPOS_UNDEFINED,
-                         SDL_WINDOWPOS_UNDEFINED,
-                         SCREEN_WIDTH_PX,
-                         SCREEN_HEIGHT_PX,
-                         SDL_WINDOW_OPENGL);
-  if(!window)
+/* key_action - the action bound to 'key'.
+ *
+ * returns - false if the key has none.
+ */
+static bool
+key_action(SDL_Keycode key, enum input_action *action)
+{
+  for(int i = 0; i < KEY_BINDING_COUNT; ++i)
   {
-    fprintf(stderr, "fatal: failed to create window: SDL error: %s\n", SDL_GetError());
-    exit(EXIT_SUCCESS);
+    if(key_bindings[i].key != key)
+      continue;
+    *action = key_bindings[i].action;
+    return true;
   }
+  return false;
+}
+
+/* select_occluders - chooses up to OCCLUSION_MAX_OCCLUDERS of the visible
+ * asteroids to rasterize as occluders; the nearest and largest, i.e. those
+ * with greatest radius / distance, are chosen.
+ *
+ * returns - number of occluders written to 'occluders'.
+ */
+static int
+select_occluders(struct asteroid_field *field,
+                 struct matrix44f *wv,
+                 const int *visible,
+                 int visible_count,
+                 int *occluders)
+{
+  float size[OCCLUSION_MAX_OCCLUDERS];
+  int n = 0;
 
-  glcontext = SDL_GL_CreateContext(window);
-  if(!glcontext)
+  for(int v = 0; v < visible_count; ++v)
   {
-    fprintf(stderr, "fatal: failed to create opengl context: SDL error: %s\n", SDL_GetError());
-    exit(EXIT_SUCCESS);
+    int a = visible[v];
+
+    /* distance along the view direction; view space looks down (-)z */
+    float d = -(wv->m[0][2] * field->x[a] + 
+                wv->m[1][2] * field->y[a] + 
+                wv->m[2][2] * field->z[a] + 
+                wv->m[3][2]);
+    if(d <= field->r[a])
+      continue;
+
+    float s = field->r[a] / d;
+    if(s < OCCLUSION_MIN_OCCLUDER_SIZE)
+      continue;
+    if(n == OCCLUSION_MAX_OCCLUDERS && s <= size[n - 1])
+      continue;
+
+    /* insertion into the list sorted by descending size */
+    int i = (n < OCCLUSION_MAX_OCCLUDERS) ? n++ : n - 1;
+    for(; i > 0 && size[i - 1] < s; --i)
+    {
+      size[i] = size[i - 1];
+      occluders[i] = occluders[i - 1];
+    }
+    size[i] = s;
+    occluders[i] = a;
   }
+  return n;
+}
+
+/* cull_view - culls the scene against the view's frustum then the occluders
+ * chosen for the view; fills the view's visibility for rendering. In the
+ * belt the asteroids not yet moved to a new origin are culled in the old
+ * origin's space, but not occluded, and the model-world matrices of the
+ * asteroids drawn are built into frame scratch.
+ *
+ * @belt - the belt the field is of, else NULL.
+ *
+ * returns - the number of occluders used.
+ */
+static int
+cull_view(struct view *view,
+          struct asteroid_field *field,
+          struct cull_spheres *field_spheres,
+          struct belt *belt,
+          struct occlusion_buffer *occlusion,
+          struct cull_stats *stats)
+{
+  TRACE_ZONE("cull_view");
+
+  struct frustum frustum;
+  struct matrix44f wc;
+  int occluders[OCCLUSION_MAX_OCCLUDERS];
+  struct matrix44f occluder_mw[OCCLUSION_MAX_OCCLUDERS];
+
+  /* extract the view frustum and cull the scene against it */
+  concatenate44fm(&view->projection, &view->camera.wv, &wc);
+  frustum_extract(&frustum, &wc);
 
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
-  
-  assert((!SDL_GL_SetSwapInterval(1) || !SDL_GL_SetSwapInterval(0)));
+  for(int g = 0; g < GRID_COUNT; ++g)
+  {
+    view->rv.grid_visible[g] = world_box &&
+                               frustum_test_sphere(&frustum,
+                                                   grid_centers[g][0],
+                                                   grid_centers[g][1],
+                                                   grid_centers[g][2],
+                                                   GRID_RADIUS_M);
+  }
+  view->rv.axes_visible = world_box && frustum_test_sphere(&frustum, 0.f, 0.f, 0.f, AXIS_RADIUS_M);
+  frustum_pull_far(&frustum, VIEW_FAR_M - asteroid_draw_distance_m);
+  int visible_asteroid_count = frustum_cull(&frustum, 
+                                            field_spheres, 
+                                            view->visible_asteroids, 
+                                            stats);
+
+  /* rasterize the chosen occluders and cull the asteroids hidden behind them */
+  occlusion_begin(occlusion, &view->camera.wv, &view->projection);
+  int occluder_count = select_occluders(field, 
+                                        &view->camera.wv, 
+                                        view->visible_asteroids, 
+                                        visible_asteroid_count, 
+                                        occluders);
+  if(belt)
+    belt_transforms(belt, occluders, occluder_count, occluder_mw);
+  for(int o = 0; o < occluder_count; ++o)
+  {
+    occlusion_add_occluder(occlusion, 
+                           cube_vertices, 
+                           cube_indices, 
+                           CUBE_INDEX_COUNT, 
+                           belt ? &occluder_mw[o] : &field->mw[occluders[o]]);
+  }
+  if(occluder_count > 0)
+  {
+    occlusion_rasterize(occlusion);
+    visible_asteroid_count = occlusion_cull(occlusion, 
+                                            field_spheres, 
+                                            view->visible_asteroids, 
+                                            visible_asteroid_count, 
+                                            stats);
+  }
 
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  if((glerror = glGetError()) != GL_NO_ERROR)
+  view->rv.asteroid_mw = NULL;
+  if(belt)
   {
-    fprintf(stderr, "fatal: glMatrixMode: opengl error: %s\n", gluErrorString(glerror));
-    exit(EXIT_SUCCESS);
+    struct vector4f shift;
+    struct cull_spheres stale = belt_stale_spheres(belt, &shift);
+    if(stale.count > 0)
+    {
+      frustum_shift(&frustum, shift.x, shift.y, shift.z);
+      visible_asteroid_count += frustum_cull(&frustum, 
+                                             &stale, 
+                                             view->visible_asteroids + visible_asteroid_count, 
+                                             stats);
+    }
+    int drawn = visible_asteroid_count ? visible_asteroid_count : 1;
+    view->rv.asteroid_mw = frame_alloc(sizeof(struct matrix44f) * drawn);
+    belt_transforms(belt, view->visible_asteroids, visible_asteroid_count, view->rv.asteroid_mw);
   }
+  view->rv.asteroids = view->visible_asteroids;
+  view->rv.asteroid_count = visible_asteroid_count;
+  return occluder_count;
+}
 
-  gluPerspective(60.0f, 
-                 (double)SCREEN_WIDTH_PX / (double)SCREEN_HEIGHT_PX,
-                 1.0f,
-                 1024.0f);
+/* ship_velocity - the ship moves pos_w_m_p_s along its front each tick. */
+static struct vector4f
+ship_velocity(const struct spaceship *ship)
+{
+  return scale4fv(ship->front, ship->pos_w_m_p_s / TICK_DELTA_S);
+}
+
+/* apply_render_lod - the overload governor's render level of detail; each level
+ * shortens the asteroids' draw distance. */
+static void
+apply_render_lod(void *ctx, int level)
+{
+  (void)ctx;
+  asteroid_draw_distance_m = VIEW_FAR_M * (1.f - OVERLOAD_DRAW_DISTANCE_STEP * level);
+}
+
+/* log_ship_control - the event bus handler of the ship's changes of command. */
+static void
+log_ship_control(void *ctx, const struct event *events, int count)
+{
+  (void)ctx;
+  for(int i = 0; i < count; ++i)
+  {
+    LOGF_DEBUG("ship: tick %d boost=%d pitch=%d roll=%d",
+               events[i].ship_control.tick,
+               events[i].ship_control.command.boost,
+               events[i].ship_control.command.pitch,
+               events[i].ship_control.command.roll);
+  }
+}
 
-  glClearColor(0.f, 0.f, 0.f, 1.f);
-  if((glerror = glGetError()) != GL_NO_ERROR)
+/* init_pacing - sets the renderer's vsync and starts pacing frames as the
+ * options ask; vsync falls back to uncapped if the renderer can't sync.
+ *
+ * @between_ticks - vsynced and capped frames are also drawn between ticks, as
+ *   a camera interpolates; else frames are drawn after ticks, so none are
+ *   expected more often than ticks.
+ */
+static void
+init_pacing(struct frame_pacer *pacer, struct options *opts, bool between_ticks)
+{
+  enum pacer_mode mode = opts->pacing;
+  double refresh_s = renderer.set_vsync(&renderer, mode == PACER_VSYNC);
+  if(mode == PACER_VSYNC && refresh_s == 0.0)
   {
-    fprintf(stderr, "fatal: glClearColor: opengl error: %s\n", gluErrorString(glerror));
-    exit(EXIT_SUCCESS);
+    log_write(LOG_WARNING, "pacing: vsync unavailable, frames are uncapped");
+    mode = PACER_UNCAPPED;
   }
 
-  glViewport(0, 0, (GLsizei)SCREEN_WIDTH_PX, (GLsizei)SCREEN_HEIGHT_PX);
+  double cap_s = 1.0 / opts->fps_cap;
+  double interval_s = mode == PACER_VSYNC ? refresh_s : mode == PACER_CAPPED ? cap_s : 0.0;
+  if(!between_ticks || mode == PACER_UNCAPPED)
+    interval_s = interval_s > TICK_DELTA_S ? interval_s : TICK_DELTA_S;
+  pacer_init(pacer, mode, cap_s, interval_s);
+  log_write(LOG_INFO, "pacing: %s, %.3f ms frames", pacer_mode_name(mode), pacer->target_interval_ns * 1e-6);
 }
 
 static void
-run()
+init(struct options *opts)
 {
-  struct clock real_clock;
-  clock_init(&real_clock, CLOCK_MONOTONIC);
-  log_write(LOG_INFO, 
-            "real-time clock resolution = %ld nanoseconds\n", 
-            clock_resolution_ns(&real_clock));
+  log_init();
+  if(opts->verbose)
+    log_set_level(LOG_LEVEL_DEBUG);
+  clock_timestamp_init();
+  if(clock_tsc.use_tsc)
+    log_write(LOG_INFO, "timestamps: tsc at %.3f GHz", clock_tsc.ghz);
+  else
+    log_write(LOG_INFO, "timestamps: %s", clock_timestamp_source());
+  TRACE_INIT(TRACE_PATH);
+  TRACE_THREAD_NAME("main");
+  memory_init(FRAME_SCRATCH_BYTES, MEMORY_FLAGS);
+  ALLOC_TRACK_INIT();
+  jobs_init(opts->threads);
+  models_init();
+
+  switch(opts->mode)
+  {
+  case RENDER_WINDOW:
+    render_gl_init(&renderer, SCREEN_WIDTH_PX, SCREEN_HEIGHT_PX);
+    break;
+  case RENDER_OFFSCREEN:
+    if(!render_gl_offscreen_init(&renderer, SCREEN_WIDTH_PX, SCREEN_HEIGHT_PX))
+    {
+      fprintf(stderr, "fatal: failed to create offscreen opengl context; see log\n");
+      log_quit();
+      exit(EXIT_FAILURE);
+    }
+    break;
+  case RENDER_SOFTWARE:
+    render_soft_init(&renderer, SCREEN_WIDTH_PX, SCREEN_HEIGHT_PX);
+    break;
+  }
 
+  log_write(LOG_INFO, "render backend: %s", renderer.name);
 
-  generate_xz_grid(xzgrid, 10.f, xz_grid_lines, xz_grid_lines);
+  layout_views(opts);
+  set_projection(SCREEN_WIDTH_PX, SCREEN_HEIGHT_PX);
+}
 
-  glEnableClientState(GL_VERTEX_ARRAY);
-      
-  glCullFace(GL_BACK);
-  glFrontFace(GL_CCW);
-  glEnable(GL_CULL_FACE);
+/* run - plays the game, or the benchmark, until done.
+ *
+ * returns - the exit status of the program. */
+static int
+run(struct options *opts)
+{
+  TRACE_ZONE("run");
+  ALLOC_TAG("run");
+
+  /* everything of the level's lifetime; freed together at the end */
+  struct arena level;
+  arena_init(&level, "level", LEVEL_ARENA_BYTES, MEMORY_FLAGS);
+
+  /* the ship flies the replay if given, else the flight script in benchmark
+     runs or the keyboard in window runs; whichever it flies is recorded */
+  struct input_player replay;
+  struct input_recorder recorder;
+  bool replaying = opts->replay_path != NULL;
+  bool recording = opts->record_path != NULL;
+  if((replaying && !input_player_open(&replay, opts->replay_path, &level)) ||
+     (recording && !input_recorder_open(&recorder, opts->record_path, &level)))
+  {
+    fprintf(stderr, "fatal: failed to open the input recording; see log\n");
+    arena_free(&level);
+    return EXIT_FAILURE;
+  }
 
   struct spaceship nautilus;
   spaceship_init(&nautilus,
@@ -315,315 +594,452 @@ run()
             (struct vector4f){0.f, 0.f, -1.f, 1.f},
             (struct vector4f){0.f, 1.f, 0.f, 0.f});
 
-  struct spaceship_camera camera;
-  shipcam_init(&camera, &nautilus);
-
-  float angle_deg = 0.f;
-  float angle_vel_degPs = 10.f;
-
-  //int camera_yaw_dir = 0; /* -1 == -change, 0=no change, +1=positive change */
-  //float camera_yaw_deg = 0.f;
-  //float camera_yaw_vel_degPs = 20.f;
+  /* the asteroids are those of the world box, or of the belt's sectors
+     resident around the ship; the belt's change as the ship flies */
+  struct floating_origin origin;
+  struct asteroid_field box;
+  struct belt belt;
+  struct asteroid_field *field;
+  struct cull_spheres field_spheres;
+  world_box = !opts->belt;
+  origin_init(&origin);
+  if(opts->belt)
+  {
+    belt_init(&belt, &level, BELT_MEMORY_BYTES, ASTEROID_SEED);
+    belt_load(&belt, nautilus.vpos_w_m, ship_velocity(&nautilus));
+    field = &belt.field;
+    field_spheres = belt_spheres(&belt);
+    log_write(LOG_INFO,
+              "asteroid belt: %d asteroids in %d clusters loaded",
+              belt.listed_asteroids,
+              belt.field.cluster_count);
+  }
+  else
+  {
+    asteroid_field_init(&box, &level, ASTEROID_COUNT, WORLD_HALF_EXTENT_M, ASTEROID_SEED);
+    field = &box;
+    field_spheres = asteroid_field_spheres(&box);
+    log_write(LOG_INFO, 
+              "asteroid field: %d asteroids in %d clusters", 
+              box.count, 
+              box.cluster_count);
+  }
 
-  //int camera_pitch_dir = 0; /* -1 == -change, 0=no change, +1=positive change */
-  //float camera_pitch_deg = 0.f;
-  //float camera_pitch_vel_degPs = 20.f;
+  /* every view has its own camera and culling results; the mirror shows the
+     present, not the lagged past of the chase camera. A lagged camera
+     interpolates the ship's past poses, so has a view between ticks */
+  struct render_view render_views[RENDER_MAX_VIEWS];
+  bool interpolating = false;
+  for(int v = 0; v < view_count; ++v)
+  {
+    shipcam_init(&views[v].camera, &nautilus, &level);
+    shipcam_set_mode(&views[v].camera, views[v].mode);
+    if(views[v].mode == SHIPCAM_MIRROR)
+      shipcam_set_delay(&views[v].camera, 0.0);
+    interpolating |= views[v].camera.delay_s > 0.0;
+    views[v].visible_asteroids = ARENA_NEW(&level, int, field->count ? field->count : 1);
+    views[v].rv.wv = &views[v].camera.wv;
+    views[v].rv.vc = &views[v].projection;
+  }
 
-  //int camera_roll_dir = 0; /* -1 == -change, 0=no change, +1=positive change */
-  //float camera_roll_deg = 0.f;
-  //float camera_roll_vel_degPs = 20.f;
+  /* one occlusion buffer is reused by the views in turn */
+  struct occlusion_buffer occlusion;
+  occlusion_init(&occlusion, OCCLUSION_WIDTH_PX, OCCLUSION_HEIGHT_PX, OCCLUSION_BANDS);
+
+  struct cull_stats cull_stats;
+  double next_cull_report_s = CULL_REPORT_INTERVAL_S;
+
+  struct render_scene scene;
+  scene.ship_mw = &nautilus.mw;
+  scene.field = field;
+  scene.views = render_views;
+  scene.view_count = view_count;
+
+  /* benchmark runs fly for a fixed number of frames, one tick each */
+  bool is_benchmark = opts->mode != RENDER_WINDOW;
+  int frame_limit = opts->frames;
+  if(frame_limit == 0)
+    frame_limit = replaying ? (replay.ticks > 0 ? (int)replay.ticks : 1) : HEADLESS_FRAMES;
+  int sim_tick = 0;
+
+  /* the command held by the keys or the script; ticks take theirs from it
+     unless replaying */
+  struct tick_command held, applied;
+  memset(&held, 0, sizeof(held));
+  memset(&applied, 0, sizeof(applied));
+
+  /* gameplay events are published during the ticks and delivered once they
+     are done, before the frame is drawn */
+  struct event_bus events;
+  event_bus_init(&events, EVENT_BUFFER_EVENTS, &level);
+  event_bus_subscribe(&events, EVENT_SHIP_CONTROL, log_ship_control, NULL);
+
+  /* per frame cpu time submitting the draw and wall time of the whole frame,
+     i.e. submit + present; the render throughput */
+  uint64_t submit_ns = 0, submit_min_ns = UINT64_MAX, submit_max_ns = 0;
+  uint64_t frame_ns = 0, frame_min_ns = UINT64_MAX, frame_max_ns = 0;
+  int frame_count = 0;
+
+  /* time spent in each phase of the current frame, and of all frames */
+  struct phase_times frame_times, total_times;
+  phase_times_reset(&frame_times);
+  phase_times_reset(&total_times);
+
+  /* the recent frames; recorded every frame, reported at intervals */
+  struct telemetry telemetry;
+  telemetry_init(&telemetry, TELEMETRY_FRAMES);
+  double next_telemetry_report_s = TELEMETRY_REPORT_INTERVAL_S;
+  uint64_t last_present_ns = 0;
+  float dropped_ms = 0.f;
+
+  /* window runs are paced; benchmark runs draw a frame every loop */
+  struct frame_pacer pacer;
+  if(is_benchmark)
+    pacer_init(&pacer, PACER_UNCAPPED, 0.0, 0.0);
+  else
+    init_pacing(&pacer, opts, interpolating);
+
+  /* window runs shed detail rather than fall behind real time; the sim lod
+     and particle steps have nothing to shed yet, so are skipped */
+  struct overload_governor governor;
+  overload_init(&governor, clock_now_ns());
+  overload_set_handler(&governor, OVERLOAD_RENDER_LOD, OVERLOAD_RENDER_LOD_LEVELS, apply_render_lod, NULL);
+  uint64_t idle_ns = 0;
 
   double next_tick_s = TICK_DELTA_S;
   bool redraw = true;
+  bool draw_between_ticks = interpolating && pacer.mode != PACER_UNCAPPED;
   bool is_done = false;
   int tick_count;
-  clock_reset(&real_clock);
+  uint64_t start_ns = clock_now_ns();
   while(!is_done)
   {
     /* handle window events */
     SDL_Event event;
-    while(SDL_PollEvent(&event))
+    struct phase_timer events_timer = phase_begin(&frame_times, PHASE_EVENTS);
+    while(!is_benchmark && SDL_PollEvent(&event))
     {
+      TRACE_ZONE("handle_event");
+      ALLOC_TAG("events");
       switch(event.type)
       {
       case SDL_QUIT:
         is_done = true;
-      case SDL_KEYDOWN:
-        if(event.key.repeat != 0)
-        {
-          break;
-        }
-        if(event.key.keysym.sym == SDLK_w)
-        {
-          spaceship_boost(&nautilus, BOOST_FORWARD);
-        }
-        else if(event.key.keysym.sym == SDLK_s)
-        {
-          spaceship_boost(&nautilus, BOOST_REVERSE);
-        }
-        else if(event.key.keysym.sym == SDLK_i)
-        {
-          spaceship_pitch(&nautilus, ROTATE_CCW);
-        }
-        else if(event.key.keysym.sym == SDLK_k)
-        {
-          spaceship_pitch(&nautilus, ROTATE_CW);
-        }
-        else if(event.key.keysym.sym == SDLK_j)
-        {
-          spaceship_roll(&nautilus, ROTATE_CW);
-        }
-        else if(event.key.keysym.sym == SDLK_l)
-        {
-          spaceship_roll(&nautilus, ROTATE_CCW);
-        }
-
-        //else if(event.key.keysym.sym == SDLK_l)
-        //{
-        //  camera_yaw_dir = 1; 
-        //}
-        //else if(event.key.keysym.sym == SDLK_j)
-        //{
-        //  camera_yaw_dir = -1; 
-        //}
-
-        //else if(event.key.keysym.sym == SDLK_i)
-        //{
-        //  camera_pitch_dir = 1; 
-        //}
-        //else if(event.key.keysym.sym == SDLK_k)
-        //{
-        //  camera_pitch_dir = -1; 
-        //}
-
-        //else if(event.key.keysym.sym == SDLK_o)
-        //{
-        //  camera_roll_dir = 1; 
-        //}
-        //else if(event.key.keysym.sym == SDLK_u)
-        //{
-        //  camera_roll_dir = -1; 
-        //}
-
         break;
+      case SDL_KEYDOWN:
       case SDL_KEYUP:
         if(event.key.repeat != 0)
-        {
           break;
-        }
-        if(event.key.keysym.sym == SDLK_w)
-        {
-          spaceship_boost(&nautilus, BOOST_NONE);
-        }
-        else if(event.key.keysym.sym == SDLK_s)
-        {
-          spaceship_boost(&nautilus, BOOST_NONE);
-        }
-        else if(event.key.keysym.sym == SDLK_i)
+        /* keys only change the held command; the next tick takes it */
+        enum input_action action;
+        if(key_action(event.key.keysym.sym, &action))
         {
-          spaceship_pitch(&nautilus, ROTATE_NONE);
+          if(event.type == SDL_KEYDOWN)
+            input_press(&held, action);
+          else
+            input_release(&held, action);
         }
-        else if(event.key.keysym.sym == SDLK_k)
+        else if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12)
         {
-          spaceship_pitch(&nautilus, ROTATE_NONE);
+          telemetry_write(&telemetry, opts->telemetry_path ? opts->telemetry_path : TELEMETRY_DUMP_PATH);
         }
-        else if(event.key.keysym.sym == SDLK_j)
-        {
-          spaceship_roll(&nautilus, ROTATE_NONE);
-        }
-        else if(event.key.keysym.sym == SDLK_l)
-        {
-          spaceship_roll(&nautilus, ROTATE_NONE);
-        }
-
-        //else if(event.key.keysym.sym == SDLK_l)
-        //{
-        //  camera_yaw_dir = 0; 
-        //}
-        //else if(event.key.keysym.sym == SDLK_j)
-        //{
-        //  camera_yaw_dir = 0; 
-        //}
-
-        //else if(event.key.keysym.sym == SDLK_i)
-        //{
-        //  camera_pitch_dir = 0; 
-        //}
-        //else if(event.key.keysym.sym == SDLK_k)
-        //{
-        //  camera_pitch_dir = 0; 
-        //}
-
-        //else if(event.key.keysym.sym == SDLK_o)
-        //{
-        //  camera_roll_dir = 0; 
-        //}
-        //else if(event.key.keysym.sym == SDLK_u)
-        //{
-        //  camera_roll_dir = 0; 
-        //}
-
         break;
       case SDL_WINDOWEVENT:
         switch(event.window.event)
         {
         case SDL_WINDOWEVENT_RESIZED:
-          gluPerspective(60.0f, 
-                         (double)event.window.data1 / (double)event.window.data2,
-                         1.0f,
-                         1024.0f);
-          glViewport(0, 0, (double)event.window.data1, (double)event.window.data2);
+          set_projection(event.window.data1, event.window.data2);
           break;
         }
         break;
       }
     }
+    phase_end(&events_timer);
 
-    double time_s = clock_time_s(&real_clock);
+    /* benchmark runs advance simulated time by exactly one tick per frame,
+       independent of real time, so every run renders the same frames */
+    double time_s = is_benchmark ? next_tick_s : (clock_now_ns() - start_ns) * 1e-9;
     tick_count = 0;
-    while(time_s > next_tick_s && tick_count < MAX_TICKS_PER_FRAME)
+    while(time_s >= next_tick_s && tick_count < MAX_TICKS_PER_FRAME)
     {
-      angle_deg += angle_vel_degPs * TICK_DELTA_S;
+      PHASE_SCOPE(&frame_times, PHASE_SIM);
+      TRACE_ZONE("tick");
+      ALLOC_TAG("sim");
 
-      spaceship_tick(&nautilus);
-      shipcam_tick(&camera);
+      struct tick_command command;
+      if(replaying && !input_player_command(&replay, sim_tick, &command))
+      {
+        replaying = false;
+        log_write(LOG_INFO, "input: replay ended at tick %d", sim_tick);
+      }
+      if(!replaying)
+      {
+        if(is_benchmark)
+          fly_script(&held, sim_tick);
+        command = held;
+      }
+      if(recording)
+        input_recorder_tick(&recorder, &command);
+      if(!tick_command_equal(&command, &applied))
+      {
+        struct event e = {.type = EVENT_SHIP_CONTROL, .key = 0};
+        e.ship_control.tick = sim_tick;
+        e.ship_control.command = command;
+        event_bus_publish(&events, &e);
+        applied = command;
+      }
+      tick_command_apply(&command, &nautilus);
+      ++sim_tick;
+
+      /* the origin follows the ship through the belt; the ship and cameras
+         move at once, the belt's sectors over the next frames */
+      if(opts->belt && origin_due(nautilus.vpos_w_m))
+      {
+        struct vector4f shift = origin_rebase(&origin, nautilus.vpos_w_m);
+        spaceship_rebase(&nautilus, shift);
+        for(int v = 0; v < view_count; ++v)
+          shipcam_rebase(&views[v].camera, shift);
+        belt_rebase(&belt, origin.sector);
+      }
 
-      //camera_yaw_deg += cam_yaw_vel_degPs * cam_yaw_dir * TICK_DELTA_S;
-      //camera_pitch_deg += cam_pitch_vel_degPs * cam_pitch_dir * TICK_DELTA_S;
-      //camera_roll_deg += cam_roll_vel_degPs * cam_roll_dir * TICK_DELTA_S;
+      spaceship_tick(&nautilus);
+      for(int v = 0; v < view_count; ++v)
+        shipcam_tick(&views[v].camera);
 
       next_tick_s += TICK_DELTA_S;
       ++tick_count;
       redraw = true;
     }
 
-    if(redraw)
+    if(tick_count > 0)
+    {
+      PHASE_SCOPE(&frame_times, PHASE_SIM);
+      event_bus_drain(&events);
+      if(opts->belt)
+      {
+        belt_update(&belt, nautilus.vpos_w_m, ship_velocity(&nautilus));
+        field_spheres = belt_spheres(&belt);
+      }
+    }
+
+    /* still behind after the most ticks a frame may run; a short backlog is
+       carried into the next frame while the governor can still shed load to
+       catch up, else the unsimulated time is dropped rather than fall further
+       behind each frame the ticks cannot keep up */
+    if(time_s >= next_tick_s)
+    {
+      double behind_s = time_s - next_tick_s;
+      if(overload_exhausted(&governor) || behind_s > OVERLOAD_MAX_BACKLOG_S)
+      {
+        int skipped = (int)(behind_s / TICK_DELTA_S) + 1;
+        next_tick_s += skipped * TICK_DELTA_S;
+        dropped_ms += (float)(skipped * TICK_DELTA_S * 1e3);
+        overload_ticks_dropped(&governor, skipped);
+      }
+    }
+
+    /* paced frames between ticks show the lagged cameras' interpolated views */
+    redraw |= draw_between_ticks;
+    if(redraw && pacer_frame_due(&pacer, clock_now_ns()))
     {
-      glClear(GL_COLOR_BUFFER_BIT);
-
-      /* set cameraera position - i.e. view matrix */
-      //glMatrixMode(GL_MODELVIEW);
-      //glLoadIdentity();
-      //glTranslatef(0.0f, 5.0f, -20.0f);
-      //glRotatef(30.f, 1.0f, 0.0f, 0.0f);
-      //glRotatef(angle_deg, 1.0f, 0.0f, 0.0f);
-      
-      //
-      // the model appears to be inverted if I use my own view matrix, if
-      // using the opengl matrix math to build the view it is not inverted.
-      //
-      // it is both the winding order and the spaceship direction that is inverted,
-      // it is asthough the spaceship is scaled by -1.0 on the z-axis.
-      //
-      // With my view the spaceship points down -z but the winding order is inside
-      // out, with opengl view the spaceship points up +z and the winding order is
-      // correct.
-      //
-      // NOPE! i was wrong, in both cases the spaceship points up +z, but with my
-      // view the winding order is inside out.
-      //
-      // NOPE! wrong again, they are actually the same. IT IS VERY HARD TO TELL!
-      //
-      // need a better testing setup/arrangement.
-      //
-      
-      /* set the view matrix */
-      glMatrixMode(GL_MODELVIEW);
-      glLoadIdentity();
-      //glTranslatef(0.0f, 0.0f, -10.0f);
-      //glRotatef(camera_yaw_deg, 0.0f, 1.0f, 0.0f);
-      //glRotatef(camera_pitch_deg, 1.0f, 0.0f, 0.0f);
-      //glRotatef(camera_roll_deg, 0.0f, 0.0f, 1.0f);
-      //glRotatef(70.f, 0.0f, 1.0f, 0.0f);
-      glLoadMatrixf(flatten44fm(&camera.wv));
-
-      //glEnableClientState(GL_COLOR_ARRAY);
-      
-      glDisableClientState(GL_COLOR_ARRAY);
-
-      /* bottom grid */
-      glVertexPointer(3, GL_FLOAT, 0, xzgrid);
-      glColor3f(0.5f, 0.5f, 0.5f);
-      glPushMatrix();
-      glTranslatef(0.0f, -505.f, 0.f);
-      glDrawArrays(GL_LINES, 0, xz_grid_vertex_count);
-      glPopMatrix();
-
-      /* top grid */
-      glPushMatrix();
-      glTranslatef(0.0f, 505.f, 0.f);
-      glDrawArrays(GL_LINES, 0, xz_grid_vertex_count);
-      glPopMatrix();
-
-      /* back grid (+)z */
-      glPushMatrix();
-      glTranslatef(0.f, 0.f, 505.f);
-      glRotatef(90.f, 1.0f, 0.0f, 0.0f);
-      glDrawArrays(GL_LINES, 0, xz_grid_vertex_count);
-      glPopMatrix();
-
-      /* front grid (-)z */
-      glPushMatrix();
-      glTranslatef(0.f, 0.f, -505.f);
-      glRotatef(90.f, 1.0f, 0.0f, 0.0f);
-      glDrawArrays(GL_LINES, 0, xz_grid_vertex_count);
-      glPopMatrix();
-
-      glEnableClientState(GL_COLOR_ARRAY);
-
-      /* draw world space axes */
-      glVertexPointer(3, GL_FLOAT, 0, axis_vertices);
-      glColorPointer(3, GL_FLOAT, 0, axis_colors);
-      glDrawArrays(GL_LINES, 0, 12);
-
-      /* draw cube */
-      //glPushMatrix();
-      //glRotatef(angle_deg, 0.0f, 1.0f, 0.0f);
-      //glVertexPointer(3, GL_FLOAT, 0, cube_vertices);
-      //glColorPointer(3, GL_FLOAT, 0, cube_colors);
-      //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, cube_indices);
-      //glPopMatrix();
-
-      /* draw spaceship */
-      glPushMatrix();
-      glMultMatrixf(flatten44fm(&nautilus.mw)); 
-      //glTranslatef(0.f, 0.f, -50.f);
-      //glVertexPointer(3, GL_FLOAT, 0, spaceship_vertices);
-      //glColorPointer(3, GL_FLOAT, 0, spaceship_colors);
-      //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, spaceship_indices);
-      glVertexPointer(3, GL_FLOAT, 0, spaceship_vertices);
-      glDisableClientState(GL_COLOR_ARRAY);
-      glPolygonMode(GL_FRONT, GL_FILL);
-      glColor3f(1.f, 0.f, 0.5f);
-      glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_BYTE, spaceship_top_indices);
-      glColor3f(0.f, 1.f, 1.f);
-      glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_BYTE, spaceship_bottom_indices);
-      glPolygonMode(GL_FRONT, GL_LINE);
-      glColor3f(1.f, 1.f, 1.0f);
-      glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_BYTE, spaceship_top_indices);
-      glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_BYTE, spaceship_bottom_indices);
-      //glColor3f(1.f, 1.f, 1.f);
-      //glDrawElements(GL_LINES, 28, GL_UNSIGNED_BYTE, spaceship_wireframe_indices);
-      glPopMatrix();
-
-      SDL_GL_SwapWindow(window);
+      ALLOC_TAG("render");
+      pacer_frame_begin(&pacer, clock_now_ns());
+      struct phase_timer render_timer = phase_begin(&frame_times, PHASE_RENDER);
+
+      /* only culling is per view; the scene is shared */
+      cull_stats_reset(&cull_stats);
+      int occluder_count = 0;
+      double since_tick_s = time_s - (next_tick_s - TICK_DELTA_S);
+      for(int v = 0; v < view_count; ++v)
+      {
+        shipcam_frame(&views[v].camera, since_tick_s > 0.0 ? since_tick_s : 0.0);
+        occluder_count += cull_view(&views[v], 
+                                    field, 
+                                    &field_spheres, 
+                                    opts->belt ? &belt : NULL, 
+                                    &occlusion, 
+                                    &cull_stats);
+        render_views[v] = views[v].rv;
+      }
+
+      if(time_s > next_cull_report_s)
+      {
+        log_write(LOG_INFO, 
+                  "culling: visible=%d culled=%d (occluded=%d) tested=%d occluders=%d", 
+                  cull_stats.visible, 
+                  cull_stats.culled, 
+                  cull_stats.occluded,
+                  cull_stats.tested,
+                  occluder_count);
+        next_cull_report_s = time_s + CULL_REPORT_INTERVAL_S;
+      }
+
+      TRACE_BEGIN(draw_zone, "draw");
+      uint64_t draw_start_ns = clock_now_ns();
+      renderer.draw(&renderer, &scene);
+      uint64_t draw_end_ns = clock_now_ns();
+      phase_end(&render_timer);
+      TRACE_END(draw_zone);
+
+      struct phase_timer swap_timer = phase_begin(&frame_times, PHASE_SWAP);
+      TRACE_BEGIN(present_zone, "present");
+      renderer.present(&renderer);
+      TRACE_END(present_zone);
+      phase_end(&swap_timer);
+      uint64_t present_end_ns = clock_now_ns();
+
+      /* with vsync the present mostly waits for the display */
+      if(pacer.mode == PACER_VSYNC)
+        idle_ns += frame_times.ns[PHASE_SWAP];
       redraw = false;
+
+      uint64_t dt_ns = draw_end_ns - draw_start_ns;
+      submit_ns += dt_ns;
+      submit_min_ns = dt_ns < submit_min_ns ? dt_ns : submit_min_ns;
+      submit_max_ns = dt_ns > submit_max_ns ? dt_ns : submit_max_ns;
+      dt_ns = present_end_ns - draw_start_ns;
+      frame_ns += dt_ns;
+      frame_min_ns = dt_ns < frame_min_ns ? dt_ns : frame_min_ns;
+      frame_max_ns = dt_ns > frame_max_ns ? dt_ns : frame_max_ns;
+
+      /* the frame time is present to present; the first is from the start */
+      struct frame_record record;
+      record.frame_ms = (present_end_ns - (last_present_ns ? last_present_ns : start_ns)) * 1e-6f;
+      record.ticks = tick_count;
+      record.dropped_ms = dropped_ms;
+      record.events_ms = frame_times.ns[PHASE_EVENTS] * 1e-6f;
+      record.sim_ms = frame_times.ns[PHASE_SIM] * 1e-6f;
+      record.render_ms = frame_times.ns[PHASE_RENDER] * 1e-6f;
+      record.swap_ms = frame_times.ns[PHASE_SWAP] * 1e-6f;
+      record.overload_level = governor.level;
+      struct event_frame_stats event_stats;
+      event_bus_frame_end(&events, &event_stats);
+      record.game_events = event_stats.total;
+      record.drain_ms = event_stats.drain_ns * 1e-6f;
+      telemetry_record(&telemetry, &record);
+      pacer_frame_presented(&pacer, present_end_ns);
+      last_present_ns = present_end_ns;
+      dropped_ms = 0.f;
+
+      if(!is_benchmark && time_s > next_telemetry_report_s)
+      {
+        telemetry_log_report(&telemetry);
+        pacer_log_report(&pacer);
+        overload_log_report(&governor);
+        event_bus_log_report(&events);
+        if(opts->belt)
+          belt_log_report(&belt);
+        next_telemetry_report_s = time_s + TELEMETRY_REPORT_INTERVAL_S;
+      }
+
+      /* the frame's phases end with its presentation, as does its scratch */
+      for(int p = 0; p < PHASE_COUNT; ++p)
+        total_times.ns[p] += frame_times.ns[p];
+      phase_times_reset(&frame_times);
+      frame_reset();
+      ALLOC_TRACK_FRAME_END(ALLOC_WARMUP_FRAMES);
+
+      if(++frame_count == frame_limit && is_benchmark)
+        is_done = true;
+    }
+
+    /* sleep until the next tick is due, or until the cap allows a frame that
+       is waiting to be drawn; events arriving meanwhile wait for the tick
+       which consumes them */
+    if(!is_benchmark && !is_done)
+    {
+      uint64_t deadline_ns = start_ns + (uint64_t)(next_tick_s * 1e9);
+      if(redraw && pacer_next_frame_ns(&pacer) < deadline_ns)
+        deadline_ns = pacer_next_frame_ns(&pacer);
+      idle_ns += pacer_wait_until(&pacer, deadline_ns);
+      overload_observe(&governor, tick_count, idle_ns, clock_now_ns());
+      idle_ns = 0;
     }
   }
+
+  if(frame_count > 0)
+  {
+    log_write(LOG_INFO, 
+              "rendered %d frames with %s: %.1f frames per second",
+              frame_count,
+              renderer.name,
+              frame_count / (frame_ns * 1e-9));
+    log_write(LOG_INFO, 
+              "submit ms per frame: mean=%.3f min=%.3f max=%.3f",
+              (submit_ns * 1e-6) / frame_count,
+              submit_min_ns * 1e-6,
+              submit_max_ns * 1e-6);
+    log_write(LOG_INFO, 
+              "wall ms per frame: mean=%.3f min=%.3f max=%.3f",
+              (frame_ns * 1e-6) / frame_count,
+              frame_min_ns * 1e-6,
+              frame_max_ns * 1e-6);
+    for(int p = 0; p < PHASE_COUNT; ++p)
+    {
+      log_write(LOG_INFO, 
+                "%s ms per frame: mean=%.3f", 
+                phase_name(p), 
+                (total_times.ns[p] * 1e-6) / frame_count);
+    }
+  }
+
+  if(frame_count > 0)
+  {
+    telemetry_log_report(&telemetry);
+    event_bus_log_report(&events);
+    if(opts->belt)
+      belt_log_report(&belt);
+  }
+  if(frame_count > 0 && !is_benchmark)
+  {
+    pacer_log_report(&pacer);
+    overload_log_report(&governor);
+  }
+  if(opts->telemetry_path)
+    telemetry_write(&telemetry, opts->telemetry_path);
+  telemetry_free(&telemetry);
+
+  if(opts->ppm_path && is_benchmark)
+    renderer.write_ppm(&renderer, opts->ppm_path);
+
+  int status = EXIT_SUCCESS;
+  if(recording && !input_recorder_close(&recorder))
+    status = EXIT_FAILURE;
+
+  memory_log_stats();
+  jobs_log_stats();
+#ifdef ALLOC_TRACKING
+  if(alloc_track_report() > 0 && opts->alloc_check)
+  {
+    log_write(LOG_ERROR, "allocation check failed: the game loop allocated once warmed up");
+    status = EXIT_FAILURE;
+  }
+#endif
+
+  if(opts->belt)
+    belt_quit(&belt);
+  occlusion_free(&occlusion);
+  arena_free(&level);
+  return status;
 }
 
 static void
 shutdown()
 {
+  renderer.quit(&renderer);
+  jobs_quit();
+  memory_quit();
+  TRACE_QUIT();
+  log_quit();
 }
 
 int 
 main(int argc, char *argv[])
 {
-  init();
-  run();
+  struct options opts;
+  parse_options(argc, argv, &opts);
+  init(&opts);
+  int status = run(&opts);
   shutdown();
-  exit(EXIT_SUCCESS);
+  exit(status);
 }
-
-
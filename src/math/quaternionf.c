@@ -0,0 +1,122 @@
+#include <math.h>
+#include <assert.h>
+
+#include "quaternionf.h"
+
+/* below this angle between 'a' and 'b' slerp falls back to a normalised lerp;
+   sin(angle) is too near zero to divide by */
+#define SLERP_MIN_COS 0.9995f
+
+struct quaternionf
+normaliseqf(struct quaternionf a)
+{
+  float s = 1.f / sqrtf(dotqf(a, a));
+  return (struct quaternionf){a.w * s, a.x * s, a.y * s, a.z * s};
+}
+
+struct quaternionf
+fromrotationqf(struct matrix44f *m)
+{
+  assert(m != NULL);
+
+  /* Shoemake's method; pivots on the largest of the diagonal and trace to
+     avoid dividing by a small number. Elements are m[col][row]. */
+  float m00 = m->m[0][0], m11 = m->m[1][1], m22 = m->m[2][2];
+  float trace = m00 + m11 + m22;
+  struct quaternionf q;
+  if(trace > 0.f)
+  {
+    float s = 0.5f / sqrtf(trace + 1.f);
+    q.w = 0.25f / s;
+    q.x = (m->m[1][2] - m->m[2][1]) * s;
+    q.y = (m->m[2][0] - m->m[0][2]) * s;
+    q.z = (m->m[0][1] - m->m[1][0]) * s;
+  }
+  else if(m00 > m11 && m00 > m22)
+  {
+    float s = 2.f * sqrtf(1.f + m00 - m11 - m22);
+    q.w = (m->m[1][2] - m->m[2][1]) / s;
+    q.x = 0.25f * s;
+    q.y = (m->m[1][0] + m->m[0][1]) / s;
+    q.z = (m->m[2][0] + m->m[0][2]) / s;
+  }
+  else if(m11 > m22)
+  {
+    float s = 2.f * sqrtf(1.f + m11 - m00 - m22);
+    q.w = (m->m[2][0] - m->m[0][2]) / s;
+    q.x = (m->m[1][0] + m->m[0][1]) / s;
+    q.y = 0.25f * s;
+    q.z = (m->m[2][1] + m->m[1][2]) / s;
+  }
+  else
+  {
+    float s = 2.f * sqrtf(1.f + m22 - m00 - m11);
+    q.w = (m->m[0][1] - m->m[1][0]) / s;
+    q.x = (m->m[2][0] + m->m[0][2]) / s;
+    q.y = (m->m[2][1] + m->m[1][2]) / s;
+    q.z = 0.25f * s;
+  }
+  return normaliseqf(q);
+}
+
+struct matrix44f *
+torotationqf(struct quaternionf q, struct matrix44f *out)
+{
+  assert(out != NULL);
+
+  float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+  out->m[0][0] = 1.f - 2.f * (yy + zz);
+  out->m[0][1] = 2.f * (xy + wz);
+  out->m[0][2] = 2.f * (xz - wy);
+  out->m[0][3] = 0.f;
+
+  out->m[1][0] = 2.f * (xy - wz);
+  out->m[1][1] = 1.f - 2.f * (xx + zz);
+  out->m[1][2] = 2.f * (yz + wx);
+  out->m[1][3] = 0.f;
+
+  out->m[2][0] = 2.f * (xz + wy);
+  out->m[2][1] = 2.f * (yz - wx);
+  out->m[2][2] = 1.f - 2.f * (xx + yy);
+  out->m[2][3] = 0.f;
+
+  out->m[3][0] = 0.f;
+  out->m[3][1] = 0.f;
+  out->m[3][2] = 0.f;
+  out->m[3][3] = 1.f;
+  return out;
+}
+
+struct quaternionf
+slerpqf(struct quaternionf a, struct quaternionf b, float t)
+{
+  /* take the shortest arc; q and -q are the same rotation */
+  float cos_angle = dotqf(a, b);
+  if(cos_angle < 0.f)
+  {
+    b = (struct quaternionf){-b.w, -b.x, -b.y, -b.z};
+    cos_angle = -cos_angle;
+  }
+
+  float sa, sb;
+  if(cos_angle > SLERP_MIN_COS)
+  {
+    sa = 1.f - t;
+    sb = t;
+  }
+  else
+  {
+    float angle = acosf(cos_angle);
+    float r = 1.f / sinf(angle);
+    sa = sinf((1.f - t) * angle) * r;
+    sb = sinf(t * angle) * r;
+  }
+
+  return normaliseqf((struct quaternionf){sa * a.w + sb * b.w, 
+                                          sa * a.x + sb * b.x, 
+                                          sa * a.y + sb * b.y, 
+                                          sa * a.z + sb * b.z});
+}
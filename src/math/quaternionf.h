@@ -0,0 +1,56 @@
+#ifndef _QUATERNIONF_H_
+#define _QUATERNIONF_H_
+
+#include "vector4f.h"
+#include "matrix44f.h"
+
+/* A rotation quaternion q = w + xi + yj + zk. Only unit quaternions represent
+ * rotations; all functions expect and return unit quaternions unless stated
+ * otherwise.
+ *
+ * note - q and -q represent the same rotation.
+ */
+struct quaternionf
+{
+  float w;
+  float x;
+  float y;
+  float z;
+};
+
+/* identityqf - returns the quaternion of no rotation. */
+static inline struct quaternionf
+identityqf(){return (struct quaternionf){1.f, 0.f, 0.f, 0.f};}
+
+/* dotqf - returns the 4D dot product of 'a' and 'b'. */
+static inline float
+dotqf(struct quaternionf a, struct quaternionf b)
+{
+  return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/* normaliseqf - returns 'a' scaled to unit length. */
+struct quaternionf
+normaliseqf(struct quaternionf a);
+
+/* fromrotationqf - returns the quaternion of the rotation part (the upper
+ *   3x3) of matrix 'm'; must be orthonormal, i.e. a pure rotation.
+ */
+struct quaternionf
+fromrotationqf(struct matrix44f *m);
+
+/* torotationqf - builds matrix 'out' into the rotation matrix of 'q'; the
+ *   translation part of 'out' is zero.
+ *
+ * returns - matrix 'out'.
+ */
+struct matrix44f *
+torotationqf(struct quaternionf q, struct matrix44f *out);
+
+/* slerpqf - spherical linear interpolation from 'a' (t = 0) to 'b' (t = 1)
+ *   along the shortest arc, at constant angular speed.
+ */
+struct quaternionf
+slerpqf(struct quaternionf a, struct quaternionf b, float t);
+
+#endif
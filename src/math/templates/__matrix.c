@@ -76,6 +76,7 @@ FUNCTION_NAME(concatenate)(struct MATRIX_NAME *a,
     for(int j = 0; j <= 3; ++j)
       for(int n = 0; n <= 3; ++n)
         out->m[i][j] += a->m[n][j] * b->m[i][n];
+  return out;
 }
 
 struct vector4f
@@ -338,6 +339,28 @@ FUNCTION_NAME(worldview)(struct vector4f unit_x_W,
 #undef t 
 }
 
+struct MATRIX_NAME *
+FUNCTION_NAME(perspective)(MATRIX_TYPE fovy_deg,
+                           MATRIX_TYPE aspect,
+                           MATRIX_TYPE near,
+                           MATRIX_TYPE far,
+                           struct MATRIX_NAME *out)
+{
+  assert(out != NULL);
+  assert(near > M0 && far > near && aspect > M0);
+
+  MATRIX_TYPE f = M1 / tan(DEG_TO_RAD(fovy_deg) * 0.5);
+  MATRIX_TYPE a = (far + near) / (near - far);
+  MATRIX_TYPE b = ((MATRIX_TYPE)2 * far * near) / (near - far);
+  *out = (struct MATRIX_NAME){
+    {{f / aspect, M0, M0, M0 },
+     {M0        , f , M0, M0 },
+     {M0        , M0, a , -M1},
+     {M0        , M0, b , M0 }}
+  };
+  return out;
+}
+
 struct MATRIX_NAME *
 FUNCTION_NAME(view_look_at)(struct vector4f eye_W,
                             struct vector4f at_W,
@@ -362,6 +362,26 @@ FUNCTION_NAME(worldview)(struct vector4f unit_x_W,
                          struct vector4f position_W,
                          struct MATRIX_NAME *out);
 
+/* perspective - builds matrix 'out' into a perspective projection matrix
+ *   from view space to clip space; equivilent to the matrix built by the
+ *   glu function 'gluPerspective'.
+ *
+ * @fovy_deg - field of view angle in the view space y direction.
+ * @aspect - aspect ratio of the viewport, i.e. width / height.
+ * @near - distance from the eye to the near clipping plane (always +ve).
+ * @far - distance from the eye to the far clipping plane (always +ve).
+ *
+ * returns - matrix 'out'.
+ *
+ * errors - asserts(0) if out == NULL.
+ */
+struct MATRIX_NAME *
+FUNCTION_NAME(perspective)(MATRIX_TYPE fovy_deg,
+                           MATRIX_TYPE aspect,
+                           MATRIX_TYPE near,
+                           MATRIX_TYPE far,
+                           struct MATRIX_NAME *out);
+
 /* view_look_at - build matrix 'out' into a change of basis matrix from the
  *   root 'world' space to the 'view' space of a camera based on a target
  *   point in world space the camera is looking at.
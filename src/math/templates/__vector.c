@@ -173,7 +173,7 @@ FUNCTION_NAME(normalise)(struct VECTOR_NAME a)
 
 /**** SPHERICAL VECTOR *******************************************************/
 
-#if(VECTOR_SIZE == 3)
+#if(VECTOR_SIZE > 2)
 
 struct VECTOR_NAME
 FUNCTION_NAME(spherical_to_cartesian)(struct SPHERICAL_NAME a)
@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+#include "config.h"
+#include "util/system.h"
+#include "util/trace.h"
+#include "util/alloc_track.h"
+#include "util/jobs.h"
+#include "occlusion.h"
+
+/* depth the buffer is cleared to; the far plane */
+#define FAR_DEPTH 1.f
+
+/* triangles with a screen space area (in pixels) smaller than this are dropped */
+#define MIN_TRIANGLE_AREA_PX 0.01f
+
+static inline int
+mini(int a, int b){return a < b ? a : b;}
+
+static inline int
+maxi(int a, int b){return a > b ? a : b;}
+
+/* band_rows - the range of tile rows [first, last) of band 'b'. */
+static inline void
+band_rows(const struct occlusion_buffer *ob, int b, int *first, int *last)
+{
+  *first = (ob->tiles_y * b) / ob->band_count;
+  *last = (ob->tiles_y * (b + 1)) / ob->band_count;
+}
+
+/* rasterize_triangle - rasterizes a triangle into the rows [y0, y1) of the
+ * buffer, keeping the nearest depth of each pixel. Pixels are sampled at their
+ * centres. */
+static void
+rasterize_triangle(struct occlusion_buffer *ob,
+                   const struct occluder_triangle *t,
+                   int y0,
+                   int y1)
+{
+  /* edge functions E(p) = A*p.x + B*p.y + C, one per edge, named by the vertex
+     opposite the edge so they double as unnormalised barycentric weights */
+  float A[3], B[3], C[3];
+  for(int e = 0; e < 3; ++e)
+  {
+    int a = (e + 1) % 3, b = (e + 2) % 3;
+    A[e] = t->y[a] - t->y[b];
+    B[e] = t->x[b] - t->x[a];
+    C[e] = (t->y[b] - t->y[a]) * t->x[a] - (t->x[b] - t->x[a]) * t->y[a];
+  }
+
+  float area = A[0] * t->x[0] + B[0] * t->y[0] + C[0];
+  if(fabsf(area) < MIN_TRIANGLE_AREA_PX)
+    return;
+
+  /* orient edges so the inside of the triangle is where all E(p) >= 0 */
+  if(area < 0.f)
+  {
+    for(int e = 0; e < 3; ++e)
+    {
+      A[e] = -A[e];
+      B[e] = -B[e];
+      C[e] = -C[e];
+    }
+    area = -area;
+  }
+
+  /* depth plane z(p) = zA*p.x + zB*p.y + zC from the barycentric weights */
+  float inv_area = 1.f / area;
+  float zA = (A[0] * t->z[0] + A[1] * t->z[1] + A[2] * t->z[2]) * inv_area;
+  float zB = (B[0] * t->z[0] + B[1] * t->z[1] + B[2] * t->z[2]) * inv_area;
+  float zC = (C[0] * t->z[0] + C[1] * t->z[1] + C[2] * t->z[2]) * inv_area;
+
+  /* bounding box clipped to the band and the buffer */
+  int minx = maxi(0, (int)floorf(fminf(t->x[0], fminf(t->x[1], t->x[2]))));
+  int maxx = mini(ob->width_px - 1, (int)ceilf(fmaxf(t->x[0], fmaxf(t->x[1], t->x[2]))));
+  int miny = maxi(y0, (int)floorf(fminf(t->y[0], fminf(t->y[1], t->y[2]))));
+  int maxy = mini(y1 - 1, (int)ceilf(fmaxf(t->y[0], fmaxf(t->y[1], t->y[2]))));
+  if(minx > maxx || miny > maxy)
+    return;
+
+#if defined(__SSE__)
+
+  /* process 4 pixels per step; align the start so stores stay in the row */
+  minx &= ~3;
+  const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  for(int py = miny; py <= maxy; ++py)
+  {
+    float *row = ob->depth + py * ob->width_px;
+    float cy = (float)py + 0.5f;
+    __m128 e0row = _mm_set1_ps(B[0] * cy + C[0]);
+    __m128 e1row = _mm_set1_ps(B[1] * cy + C[1]);
+    __m128 e2row = _mm_set1_ps(B[2] * cy + C[2]);
+    __m128 zrow = _mm_set1_ps(zB * cy + zC);
+    for(int px = minx; px <= maxx; px += 4)
+    {
+      __m128 cx = _mm_add_ps(_mm_set1_ps((float)px), offsets);
+      __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), cx), e0row);
+      __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), cx), e1row);
+      __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), cx), e2row);
+      __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                 _mm_cmpge_ps(e2, zero));
+      if(_mm_movemask_ps(inside) == 0)
+        continue;
+      __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), cx), zrow);
+      __m128 old = _mm_loadu_ps(row + px);
+      __m128 nearest = _mm_min_ps(old, z);
+      _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+    }
+  }
+
+#else
+
+  for(int py = miny; py <= maxy; ++py)
+  {
+    float *row = ob->depth + py * ob->width_px;
+    float cy = (float)py + 0.5f;
+    for(int px = minx; px <= maxx; ++px)
+    {
+      float cx = (float)px + 0.5f;
+      if(A[0] * cx + B[0] * cy + C[0] < 0.f ||
+         A[1] * cx + B[1] * cy + C[1] < 0.f ||
+         A[2] * cx + B[2] * cy + C[2] < 0.f)
+        continue;
+      float z = zA * cx + zB * cy + zC;
+      if(z < row[px])
+        row[px] = z;
+    }
+  }
+
+#endif
+}
+
+/* rasterize_band - clears, rasterizes all occluders into and builds the tile
+ * depths of the band 'b'. */
+static void
+rasterize_band(struct occlusion_buffer *ob, int b)
+{
+  TRACE_ZONE("occlusion_rasterize_band");
+
+  int first, last;
+  band_rows(ob, b, &first, &last);
+
+  int y0 = first * OCCLUSION_TILE_PX, y1 = last * OCCLUSION_TILE_PX;
+
+  float *depth = ob->depth + y0 * ob->width_px;
+  for(int i = 0; i < (y1 - y0) * ob->width_px; ++i)
+    depth[i] = FAR_DEPTH;
+
+  for(int t = 0; t < ob->triangle_count; ++t)
+    rasterize_triangle(ob, &ob->triangles[t], y0, y1);
+
+  for(int ty = first; ty < last; ++ty)
+  {
+    for(int tx = 0; tx < ob->tiles_x; ++tx)
+    {
+      float farthest = 0.f;
+      for(int py = ty * OCCLUSION_TILE_PX; py < (ty + 1) * OCCLUSION_TILE_PX; ++py)
+      {
+        const float *row = ob->depth + py * ob->width_px + tx * OCCLUSION_TILE_PX;
+        for(int px = 0; px < OCCLUSION_TILE_PX; ++px)
+          farthest = fmaxf(farthest, row[px]);
+      }
+      ob->tiles[ty * ob->tiles_x + tx] = farthest;
+    }
+  }
+}
+
+/* rasterize_bands - job rasterizing the bands [begin, end). */
+static void
+rasterize_bands(void *arg, int begin, int end)
+{
+  ALLOC_TAG("occlusion");
+  for(int b = begin; b < end; ++b)
+    rasterize_band(arg, b);
+}
+
+void
+occlusion_init(struct occlusion_buffer *ob, int width_px, int height_px, int band_count)
+{
+  assert(ob != NULL);
+  assert(width_px % 4 == 0);
+  assert(width_px % OCCLUSION_TILE_PX == 0 && height_px % OCCLUSION_TILE_PX == 0);
+  assert(band_count >= 1);
+
+  ob->width_px = width_px;
+  ob->height_px = height_px;
+  ob->tiles_x = width_px / OCCLUSION_TILE_PX;
+  ob->tiles_y = height_px / OCCLUSION_TILE_PX;
+  ob->depth = xmalloc(sizeof(float) * width_px * height_px);
+  ob->tiles = xmalloc(sizeof(float) * ob->tiles_x * ob->tiles_y);
+
+  ob->triangle_count = 0;
+  ob->triangle_capacity = 256;
+  ob->triangles = xmalloc(sizeof(struct occluder_triangle) * ob->triangle_capacity);
+
+  /* can't have more bands than tile rows */
+  ob->band_count = mini(band_count, ob->tiles_y);
+}
+
+void
+occlusion_free(struct occlusion_buffer *ob)
+{
+  free(ob->triangles);
+  free(ob->tiles);
+  free(ob->depth);
+  ob->triangles = NULL;
+  ob->tiles = ob->depth = NULL;
+}
+
+void
+occlusion_begin(struct occlusion_buffer *ob, struct matrix44f *wv, struct matrix44f *vc)
+{
+  ob->wv = *wv;
+  ob->vc = *vc;
+  concatenate44fm(&ob->vc, &ob->wv, &ob->wc);
+  ob->triangle_count = 0;
+}
+
+void
+occlusion_add_occluder(struct occlusion_buffer *ob,
+                       const float *vertices,
+                       const unsigned char *indices,
+                       int index_count,
+                       struct matrix44f *mw)
+{
+  struct matrix44f mc;
+  concatenate44fm(&ob->wc, mw, &mc);
+
+  for(int i = 0; i + 2 < index_count; i += 3)
+  {
+    struct occluder_triangle t;
+    bool clipped = false;
+    for(int v = 0; v < 3; ++v)
+    {
+      const float *p = vertices + indices[i + v] * 3;
+      struct vector4f c = multiply44fm(&mc, (struct vector4f){p[0], p[1], p[2], 1.f});
+      if(c.z < -c.w)
+      {
+        clipped = true;
+        break;
+      }
+      float inv_w = 1.f / c.w;
+      t.x[v] = (c.x * inv_w * 0.5f + 0.5f) * ob->width_px;
+      t.y[v] = (0.5f - c.y * inv_w * 0.5f) * ob->height_px;
+      t.z[v] = c.z * inv_w * 0.5f + 0.5f;
+    }
+    if(clipped)
+      continue;
+
+    if(ob->triangle_count == ob->triangle_capacity)
+    {
+      ob->triangle_capacity *= 2;
+      ob->triangles = xrealloc(ob->triangles, sizeof(struct occluder_triangle) * ob->triangle_capacity);
+    }
+    ob->triangles[ob->triangle_count++] = t;
+  }
+}
+
+void
+occlusion_rasterize(struct occlusion_buffer *ob)
+{
+  parallel_for(0, ob->band_count, 1, rasterize_bands, ob);
+}
+
+/* projected_bounds - the conservative extent along one screen axis of a view
+ * space sphere with centre coordinate 'c' on the axis, nearest and farthest
+ * distances 'dn' and 'df' along the view direction; in ndc scaled by the
+ * projection scale 'p'. */
+static inline void
+projected_bounds(float c, float r, float dn, float df, float p, float *lo, float *hi)
+{
+  /* the max of x/d over the sphere is at the nearest depth if x > 0, else
+     at the farthest depth; likewise for the min */
+  *hi = p * (c + r) / ((c + r > 0.f) ? dn : df);
+  *lo = p * (c - r) / ((c - r < 0.f) ? dn : df);
+}
+
+bool
+occlusion_test_sphere(const struct occlusion_buffer *ob, float x, float y, float z, float r)
+{
+  struct vector4f cv = multiply44fm((struct matrix44f *)&ob->wv, (struct vector4f){x, y, z, 1.f});
+
+  /* view space looks down (-)z; distances to the nearest and farthest points */
+  float dn = -cv.z - r, df = -cv.z + r;
+  if(dn <= 0.f)
+    return true;
+
+  /* depth of the nearest point of the sphere; as computed by the projection */
+  float A = ob->vc.m[2][2], B = ob->vc.m[3][2];
+  float depth = ((B - A * dn) / dn) * 0.5f + 0.5f;
+  if(depth <= 0.f)
+    return true;
+
+  float xlo, xhi, ylo, yhi;
+  projected_bounds(cv.x, r, dn, df, ob->vc.m[0][0], &xlo, &xhi);
+  projected_bounds(cv.y, r, dn, df, ob->vc.m[1][1], &ylo, &yhi);
+
+  int px0 = maxi(0, (int)floorf((xlo * 0.5f + 0.5f) * ob->width_px));
+  int px1 = mini(ob->width_px - 1, (int)ceilf((xhi * 0.5f + 0.5f) * ob->width_px));
+  int py0 = maxi(0, (int)floorf((0.5f - yhi * 0.5f) * ob->height_px));
+  int py1 = mini(ob->height_px - 1, (int)ceilf((0.5f - ylo * 0.5f) * ob->height_px));
+  if(px0 > px1 || py0 > py1)
+    return true;
+
+  for(int ty = py0 / OCCLUSION_TILE_PX; ty <= py1 / OCCLUSION_TILE_PX; ++ty)
+  {
+    for(int tx = px0 / OCCLUSION_TILE_PX; tx <= px1 / OCCLUSION_TILE_PX; ++tx)
+    {
+      /* whole tile nearer than the sphere */
+      if(ob->tiles[ty * ob->tiles_x + tx] < depth)
+        continue;
+
+      /* else test the pixels of the tile under the rectangle */
+      int ya = maxi(py0, ty * OCCLUSION_TILE_PX);
+      int yb = mini(py1, (ty + 1) * OCCLUSION_TILE_PX - 1);
+      int xa = maxi(px0, tx * OCCLUSION_TILE_PX);
+      int xb = mini(px1, (tx + 1) * OCCLUSION_TILE_PX - 1);
+      for(int py = ya; py <= yb; ++py)
+        for(int px = xa; px <= xb; ++px)
+          if(ob->depth[py * ob->width_px + px] >= depth)
+            return true;
+    }
+  }
+  return false;
+}
+
+int
+occlusion_cull(const struct occlusion_buffer *ob,
+               const struct cull_spheres *spheres,
+               int *indices,
+               int count,
+               struct cull_stats *stats)
+{
+  int n = 0;
+  for(int i = 0; i < count; ++i)
+  {
+    int s = indices[i];
+    if(occlusion_test_sphere(ob, spheres->x[s], spheres->y[s], spheres->z[s], spheres->r[s]))
+      indices[n++] = s;
+  }
+
+  if(stats)
+  {
+    stats->visible -= count - n;
+    stats->culled += count - n;
+    stats->occluded += count - n;
+    stats->tested += count;
+  }
+  return n;
+}
@@ -0,0 +1,116 @@
+#ifndef _OCCLUSION_H_
+#define _OCCLUSION_H_
+
+#include <stdbool.h>
+
+#include "math/matrix44f.h"
+#include "cull.h"
+
+/* a triangle of an occluder in screen space of the occlusion buffer; x, y in
+   pixels, z the depth in [0, 1] with 0 at the near plane */
+struct occluder_triangle
+{
+  float x[3];
+  float y[3];
+  float z[3];
+};
+
+/* a low resolution software depth buffer for occlusion culling.
+ *
+ * a small set of occluder meshes is rasterized on the cpu into the buffer,
+ * then objects are tested by the screen space bounding rectangle and nearest
+ * depth of their bounding sphere; if every pixel under the rectangle holds
+ * an occluder nearer than the object, the object is occluded.
+ *
+ * the buffer is hierarchical; each OCCLUSION_TILE_PX square tile stores the
+ * farthest depth of its pixels, so a single tile test can prove an object
+ * occluded without visiting the tile's pixels.
+ *
+ * rasterization is split into horizontal bands of tiles, rasterized in
+ * parallel by the job system.
+ */
+struct occlusion_buffer
+{
+  int width_px;
+  int height_px;
+  int tiles_x;
+  int tiles_y;
+
+  float *depth; /* per pixel nearest occluder depth; row-major */
+  float *tiles; /* per tile farthest depth of its pixels; row-major */
+
+  /* world-view and projection of the frame being culled, and their product */
+  struct matrix44f wv;
+  struct matrix44f vc;
+  struct matrix44f wc;
+
+  /* occluder triangles submitted this frame */
+  struct occluder_triangle *triangles;
+  int triangle_count;
+  int triangle_capacity;
+
+  /* bands of tile rows rasterized as separate jobs */
+  int band_count;
+};
+
+/* occlusion_init - allocates a buffer of the given size, rasterized in
+ *   'band_count' bands of tile rows.
+ *
+ * note - width must be a multiple of 4 (the SIMD width) and both dimensions a
+ *   multiple of OCCLUSION_TILE_PX.
+ */
+void
+occlusion_init(struct occlusion_buffer *ob, int width_px, int height_px, int band_count);
+
+void
+occlusion_free(struct occlusion_buffer *ob);
+
+/* occlusion_begin - clears the buffer and the occluder list ready for a new
+ *   frame viewed through the world-view 'wv' and view-clip 'vc' matrices.
+ */
+void
+occlusion_begin(struct occlusion_buffer *ob, struct matrix44f *wv, struct matrix44f *vc);
+
+/* occlusion_add_occluder - transforms an indexed triangle mesh by its model-world
+ *   matrix 'mw' into the buffer's screen space and queues it for rasterization.
+ *
+ * @vertices - 3 floats per vertex.
+ * @indices - 3 indices per triangle.
+ *
+ * note - triangles crossing the near plane are dropped, which is conservative;
+ *   a missing occluder can only make objects visible, never hide them.
+ */
+void
+occlusion_add_occluder(struct occlusion_buffer *ob,
+                       const float *vertices,
+                       const unsigned char *indices,
+                       int index_count,
+                       struct matrix44f *mw);
+
+/* occlusion_rasterize - rasterizes all queued occluders into the buffer and
+ *   builds the tile depths; blocks until all bands are done.
+ */
+void
+occlusion_rasterize(struct occlusion_buffer *ob);
+
+/* occlusion_test_sphere - tests a world space sphere against the buffer.
+ *
+ * returns - true if the sphere may be visible; false only if it is
+ *   certainly hidden behind the occluders.
+ */
+bool
+occlusion_test_sphere(const struct occlusion_buffer *ob, float x, float y, float z, float r);
+
+/* occlusion_cull - removes occluded spheres from a list of sphere indices,
+ *   e.g. the output of frustum_cull; preserves the order of the list.
+ *
+ * returns - the new length of the list.
+ */
+int
+occlusion_cull(const struct occlusion_buffer *ob,
+               const struct cull_spheres *spheres,
+               int *indices,
+               int count,
+               struct cull_stats *stats);
+
+#endif
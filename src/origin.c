@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "util/log.h"
+#include "origin.h"
+
+void
+origin_init(struct floating_origin *o)
+{
+  assert(o != NULL);
+  o->sector = (struct sector_coord){0, 0, 0};
+  o->rebases = 0;
+}
+
+bool
+origin_due(struct vector4f pos_w_m)
+{
+  return fabsf(pos_w_m.x) > ORIGIN_REBASE_DISTANCE_M ||
+         fabsf(pos_w_m.y) > ORIGIN_REBASE_DISTANCE_M ||
+         fabsf(pos_w_m.z) > ORIGIN_REBASE_DISTANCE_M;
+}
+
+struct vector4f
+origin_rebase(struct floating_origin *o, struct vector4f pos_w_m)
+{
+  struct sector_coord from = o->sector;
+  o->sector = sector_add(from, sector_of(pos_w_m));
+  ++o->rebases;
+
+  log_write(LOG_INFO,
+            "origin: rebased from sector (%d, %d, %d) to (%d, %d, %d)",
+            from.x,
+            from.y,
+            from.z,
+            o->sector.x,
+            o->sector.y,
+            o->sector.z);
+  return origin_shift(from, o->sector);
+}
+
+void
+origin_world_position(const struct floating_origin *o, struct vector4f pos_w_m, double out[3])
+{
+  out[0] = (double)o->sector.x * WORLD_SECTOR_SIZE_M + pos_w_m.x;
+  out[1] = (double)o->sector.y * WORLD_SECTOR_SIZE_M + pos_w_m.y;
+  out[2] = (double)o->sector.z * WORLD_SECTOR_SIZE_M + pos_w_m.z;
+}
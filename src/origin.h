@@ -0,0 +1,106 @@
+#ifndef _ORIGIN_H_
+#define _ORIGIN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "config.h"
+#include "math/vector4f.h"
+
+/*
+ * The floating origin; a float carries 24 bits of precision, so a position
+ * a kilometre from its origin is only good to ~0.06mm and one at 100km to
+ * ~8mm, enough for the camera and the asteroids near it to visibly jitter.
+ * Rather than double every position, positions are floats relative to the
+ * corner of a sector of the world's grid of WORLD_SECTOR_SIZE_M cubes:
+ *
+ *   world position = sector * WORLD_SECTOR_SIZE_M + offset
+ *
+ * The simulation's positions, e.g. the ship's vpos_w_m, are offsets from the
+ * origin's sector. Once the ship is ORIGIN_REBASE_DISTANCE_M from it the
+ * origin is rebased to the ship's sector; everything positioned relative to
+ * the old origin is shifted by a whole number of sectors, which is exact, so
+ * the offsets in use stay small however far the ship flies.
+ *
+ * A group of positions which must agree, e.g. the ship and its cameras, is
+ * shifted at once. Bulk data, e.g. the asteroid belt's sectors, records the
+ * sector its offsets are from and is rebased a part per tick; whilst it is
+ * behind it is drawn via origin_shift from the sector it is relative to.
+ */
+
+/* a sector of the world's grid; sector (x, y, z) spans [x, x + 1) sectors
+   along the x-axis and likewise y and z */
+struct sector_coord
+{
+  int32_t x, y, z;
+};
+
+struct floating_origin
+{
+  struct sector_coord sector; /* of the simulation's positions */
+  uint64_t rebases;           /* since init */
+};
+
+static inline bool
+sector_equal(struct sector_coord a, struct sector_coord b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+/* sector_add - the sector 'offset' sectors from 'a'. */
+static inline struct sector_coord
+sector_add(struct sector_coord a, struct sector_coord offset)
+{
+  return (struct sector_coord){a.x + offset.x, a.y + offset.y, a.z + offset.z};
+}
+
+/* sector_of - the sector containing position 'p', as a number of sectors from
+ *   the sector 'p' is relative to. */
+static inline struct sector_coord
+sector_of(struct vector4f p)
+{
+  return (struct sector_coord){
+    (int32_t)floorf(p.x / WORLD_SECTOR_SIZE_M),
+    (int32_t)floorf(p.y / WORLD_SECTOR_SIZE_M),
+    (int32_t)floorf(p.z / WORLD_SECTOR_SIZE_M)
+  };
+}
+
+/* origin_shift - the direction vector taking positions relative to sector
+ *   'from' to positions relative to sector 'to'; exact whilst the sectors are
+ *   within 2^24 / WORLD_SECTOR_SIZE_M sectors of each other. */
+static inline struct vector4f
+origin_shift(struct sector_coord from, struct sector_coord to)
+{
+  return (struct vector4f){
+    (float)((int64_t)from.x - to.x) * WORLD_SECTOR_SIZE_M,
+    (float)((int64_t)from.y - to.y) * WORLD_SECTOR_SIZE_M,
+    (float)((int64_t)from.z - to.z) * WORLD_SECTOR_SIZE_M,
+    0.f
+  };
+}
+
+/* origin_init - the origin at the world's origin, i.e. sector (0, 0, 0). */
+void
+origin_init(struct floating_origin *o);
+
+/* origin_due - whether 'pos_w_m', relative to the origin, is further than
+ *   ORIGIN_REBASE_DISTANCE_M from it along any axis, so the origin is due to
+ *   be rebased. */
+bool
+origin_due(struct vector4f pos_w_m);
+
+/* origin_rebase - moves the origin to the sector containing 'pos_w_m'.
+ *
+ * returns - the shift to add to positions relative to the old origin.
+ */
+struct vector4f
+origin_rebase(struct floating_origin *o, struct vector4f pos_w_m);
+
+/* origin_world_position - the world position of 'pos_w_m', relative to the
+ *   origin, in doubles; e.g. for logs. */
+void
+origin_world_position(const struct floating_origin *o, struct vector4f pos_w_m, double out[3]);
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "config.h"
+#include "util/log.h"
+#include "overload.h"
+
+/* the recovery hold doubles at most this many times */
+#define MAX_HOLD_DOUBLINGS 4
+
+static const char *step_names[OVERLOAD_STEP_COUNT] = {"sim lod", "particles", "render lod"};
+
+void
+overload_init(struct overload_governor *g, uint64_t now_ns)
+{
+  memset(g, 0, sizeof(struct overload_governor));
+  g->window_start_ns = now_ns;
+  g->recover_hold_ns = (uint64_t)(OVERLOAD_RECOVER_HOLD_S * 1e9);
+}
+
+void
+overload_set_handler(struct overload_governor *g,
+                     enum overload_step step,
+                     int levels,
+                     overload_apply_fn apply,
+                     void *ctx)
+{
+  assert(step >= 0 && step < OVERLOAD_STEP_COUNT && levels >= 1 && apply != NULL);
+
+  g->handlers[step] = (struct overload_handler){apply, ctx, levels};
+  g->level -= g->step_levels[step];
+  g->step_levels[step] = 0;
+  apply(ctx, 0);
+}
+
+bool
+overload_exhausted(const struct overload_governor *g)
+{
+  for(int s = 0; s < OVERLOAD_STEP_COUNT; ++s)
+    if(g->handlers[s].apply && g->step_levels[s] < g->handlers[s].levels)
+      return false;
+  return true;
+}
+
+static void
+set_step_level(struct overload_governor *g, int step, int level)
+{
+  g->level += level - g->step_levels[step];
+  g->step_levels[step] = level;
+  g->handlers[step].apply(g->handlers[step].ctx, level);
+}
+
+/* degrade - sheds one more level from the first step, in order, which has
+ * any left. */
+static void
+degrade(struct overload_governor *g, float catchup, uint64_t now_ns)
+{
+  for(int s = 0; s < OVERLOAD_STEP_COUNT; ++s)
+  {
+    if(!g->handlers[s].apply || g->step_levels[s] == g->handlers[s].levels)
+      continue;
+
+    /* a level restored within the hold didn't hold; wait longer next time */
+    uint64_t base_ns = (uint64_t)(OVERLOAD_RECOVER_HOLD_S * 1e9);
+    if(g->last_recover_ns && now_ns - g->last_recover_ns < g->recover_hold_ns)
+    {
+      if(g->recover_hold_ns < (base_ns << MAX_HOLD_DOUBLINGS))
+        g->recover_hold_ns *= 2;
+    }
+    else
+      g->recover_hold_ns = base_ns;
+
+    set_step_level(g, s, g->step_levels[s] + 1);
+    ++g->degrades;
+    log_write(LOG_WARNING,
+              "overload: %.0f%% of ticks catching up, degraded %s to level %d of %d",
+              catchup * 100.f,
+              step_names[s],
+              g->step_levels[s],
+              g->handlers[s].levels);
+    return;
+  }
+}
+
+/* recover - restores one level to the last step, in order, which was
+ * degraded. */
+static void
+recover(struct overload_governor *g, uint64_t now_ns)
+{
+  for(int s = OVERLOAD_STEP_COUNT - 1; s >= 0; --s)
+  {
+    if(g->step_levels[s] == 0)
+      continue;
+
+    set_step_level(g, s, g->step_levels[s] - 1);
+    ++g->recoveries;
+    g->last_recover_ns = now_ns;
+    log_write(LOG_INFO,
+              "overload: keeping up, restored %s to level %d of %d",
+              step_names[s],
+              g->step_levels[s],
+              g->handlers[s].levels);
+    return;
+  }
+}
+
+void
+overload_observe(struct overload_governor *g, int ticks, uint64_t idle_ns, uint64_t now_ns)
+{
+  g->window_ticks += ticks;
+  if(ticks > 1)
+    g->window_catchup_ticks += ticks - 1;
+  g->window_idle_ns += idle_ns;
+
+  uint64_t window_ns = now_ns - g->window_start_ns;
+  if(window_ns < (uint64_t)(OVERLOAD_WINDOW_S * 1e9))
+    return;
+
+  float catchup = g->window_ticks ? (float)g->window_catchup_ticks / g->window_ticks : 0.f;
+  float idle = (float)g->window_idle_ns / (float)window_ns;
+
+  if(g->window_dropped_ticks > 0 || catchup > OVERLOAD_CATCHUP_FRACTION)
+  {
+    g->healthy_since_ns = 0;
+    degrade(g, catchup, now_ns);
+  }
+  else if(g->level > 0 && idle >= OVERLOAD_RECOVER_IDLE_FRACTION)
+  {
+    if(!g->healthy_since_ns)
+      g->healthy_since_ns = g->window_start_ns;
+    if(now_ns - g->healthy_since_ns >= g->recover_hold_ns)
+    {
+      recover(g, now_ns);
+      g->healthy_since_ns = now_ns;
+    }
+  }
+  else
+    g->healthy_since_ns = 0;
+
+  g->window_start_ns = now_ns;
+  g->window_ticks = g->window_catchup_ticks = g->window_dropped_ticks = 0;
+  g->window_idle_ns = 0;
+}
+
+void
+overload_ticks_dropped(struct overload_governor *g, int ticks)
+{
+  g->window_dropped_ticks += ticks;
+  g->dropped_ticks += ticks;
+  LOGF_WARNING_RATE(1, "overload: dropped %d ticks, %llu in total", ticks, (unsigned long long)g->dropped_ticks);
+}
+
+void
+overload_log_report(const struct overload_governor *g)
+{
+  log_write(g->dropped_ticks ? LOG_WARNING : LOG_INFO,
+            "overload: level %d (sim lod %d, particles %d, render lod %d), "
+            "%llu degrades, %llu recoveries, %llu ticks dropped",
+            g->level,
+            g->step_levels[OVERLOAD_SIM_LOD],
+            g->step_levels[OVERLOAD_PARTICLES],
+            g->step_levels[OVERLOAD_RENDER_LOD],
+            (unsigned long long)g->degrades,
+            (unsigned long long)g->recoveries,
+            (unsigned long long)g->dropped_ticks);
+}
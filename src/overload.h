@@ -0,0 +1,94 @@
+#ifndef _OVERLOAD_H_
+#define _OVERLOAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* the ways load is shed, in the order they are taken; the simulation's detail
+   goes first as it is least visible, the render detail last as it is most */
+enum overload_step
+{
+  OVERLOAD_SIM_LOD = 0, /* simulation level of detail */
+  OVERLOAD_PARTICLES,   /* particle and effect budgets */
+  OVERLOAD_RENDER_LOD,  /* render level of detail */
+  OVERLOAD_STEP_COUNT
+};
+
+/* sets the level of detail of a step; level 0 is full detail, higher levels
+   shed more load */
+typedef void (*overload_apply_fn)(void *ctx, int level);
+
+struct overload_handler
+{
+  overload_apply_fn apply; /* NULL if nothing can be shed by the step */
+  void *ctx;
+  int levels;              /* most levels the step can be degraded by */
+};
+
+/* the overload governor; watches the game loop for sustained catch-up, i.e.
+ * iterations running more than one tick to keep up with real time, and sheds
+ * load one level at a time until the loop keeps up again. Only when every
+ * step is fully degraded are ticks dropped; every dropped tick is counted.
+ *
+ * the loop is judged over windows of OVERLOAD_WINDOW_S. A window is overloaded
+ * if ticks were dropped or too many of its ticks were catch-up ticks; each
+ * overloaded window degrades one more level. A level is restored only after
+ * the loop has been idle for a good part of every window for a hold time, and
+ * the hold doubles each time a restored level had to be degraded again within
+ * it, so the governor settles rather than oscillates.
+ */
+struct overload_governor
+{
+  struct overload_handler handlers[OVERLOAD_STEP_COUNT];
+  int step_levels[OVERLOAD_STEP_COUNT]; /* current level of each step */
+  int level;                            /* sum of the steps' levels */
+
+  /* the current window */
+  uint64_t window_start_ns;
+  int window_ticks;
+  int window_catchup_ticks;
+  int window_dropped_ticks;
+  uint64_t window_idle_ns;
+
+  uint64_t healthy_since_ns; /* start of the run of windows with headroom */
+  uint64_t recover_hold_ns;
+  uint64_t last_recover_ns;
+
+  /* totals */
+  uint64_t dropped_ticks;
+  uint64_t degrades;
+  uint64_t recoveries;
+};
+
+void
+overload_init(struct overload_governor *g, uint64_t now_ns);
+
+/* overload_set_handler - registers what 'step' sheds; steps without a handler
+ *   are skipped. Applies level 0. */
+void
+overload_set_handler(struct overload_governor *g,
+                     enum overload_step step,
+                     int levels,
+                     overload_apply_fn apply,
+                     void *ctx);
+
+/* overload_observe - an iteration of the game loop ran 'ticks' ticks, and
+ *   before it the loop was idle for 'idle_ns', e.g. waiting for the tick. May
+ *   degrade or restore a level at the end of a window. */
+void
+overload_observe(struct overload_governor *g, int ticks, uint64_t idle_ns, uint64_t now_ns);
+
+/* overload_exhausted - true if every step is fully degraded; only then should
+ *   the loop drop ticks. */
+bool
+overload_exhausted(const struct overload_governor *g);
+
+/* overload_ticks_dropped - counts ticks the loop dropped to catch up. */
+void
+overload_ticks_dropped(struct overload_governor *g, int ticks);
+
+/* overload_log_report - logs the current level and the totals. */
+void
+overload_log_report(const struct overload_governor *g);
+
+#endif
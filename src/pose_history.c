@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "pose_history.h"
+
+/* at - the i'th oldest pose in the history; i = 0 is the oldest */
+static inline struct pose *
+at(struct pose_history *ph, int i)
+{
+  int index = ph->newest - ph->count + 1 + i;
+  if(index < 0)
+    index += ph->capacity;
+  return &ph->poses[index];
+}
+
+void
+pose_history_init(struct pose_history *ph, int capacity, struct arena *arena)
+{
+  assert(capacity > 0);
+  ph->capacity = capacity;
+  ph->count = 0;
+  ph->newest = capacity - 1;
+  ph->poses = ARENA_NEW(arena, struct pose, capacity);
+}
+
+void
+pose_history_push(struct pose_history *ph, double time_s, struct matrix44f *mw)
+{
+  assert(ph->count == 0 || time_s >= ph->poses[ph->newest].time_s);
+
+  if(++ph->newest == ph->capacity)
+    ph->newest = 0;
+  if(ph->count < ph->capacity)
+    ++ph->count;
+
+  struct pose *pose = &ph->poses[ph->newest];
+  pose->time_s = time_s;
+  pose->pos_w_m = (struct vector4f){mw->m[3][0], mw->m[3][1], mw->m[3][2], 1.f};
+  pose->rot = fromrotationqf(mw);
+}
+
+bool
+pose_history_sample(struct pose_history *ph, double time_s, struct pose *out)
+{
+  if(ph->count == 0)
+    return false;
+
+  struct pose *oldest = at(ph, 0);
+  struct pose *newest = &ph->poses[ph->newest];
+  if(time_s <= oldest->time_s)
+  {
+    *out = *oldest;
+    return true;
+  }
+  if(time_s >= newest->time_s)
+  {
+    *out = *newest;
+    return true;
+  }
+
+  /* binary search for the first pose after 'time_s'; there is always one
+     before it, since time_s is within the recorded range */
+  int lo = 1, hi = ph->count - 1;
+  while(lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+    if(at(ph, mid)->time_s > time_s)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  struct pose *a = at(ph, lo - 1);
+  struct pose *b = at(ph, lo);
+  float t = (float)((time_s - a->time_s) / (b->time_s - a->time_s));
+
+  out->time_s = time_s;
+  out->pos_w_m = (struct vector4f){a->pos_w_m.x + (b->pos_w_m.x - a->pos_w_m.x) * t,
+                                   a->pos_w_m.y + (b->pos_w_m.y - a->pos_w_m.y) * t,
+                                   a->pos_w_m.z + (b->pos_w_m.z - a->pos_w_m.z) * t,
+                                   1.f};
+  out->rot = slerpqf(a->rot, b->rot, t);
+  return true;
+}
+
+void
+pose_history_rebase(struct pose_history *ph, struct vector4f shift)
+{
+  for(int i = 0; i < ph->count; ++i)
+    at(ph, i)->pos_w_m = add4fv(at(ph, i)->pos_w_m, shift);
+}
+
+struct matrix44f *
+pose_mw(const struct pose *pose, struct matrix44f *out)
+{
+  torotationqf(pose->rot, out);
+  out->m[3][0] = pose->pos_w_m.x;
+  out->m[3][1] = pose->pos_w_m.y;
+  out->m[3][2] = pose->pos_w_m.z;
+  return out;
+}
@@ -0,0 +1,68 @@
+#ifndef _POSE_HISTORY_H_
+#define _POSE_HISTORY_H_
+
+#include <stdbool.h>
+
+#include "math/vector4f.h"
+#include "math/matrix44f.h"
+#include "math/quaternionf.h"
+#include "util/memory.h"
+
+/* the position and orientation of an object at a moment in time */
+struct pose
+{
+  double time_s;
+  struct vector4f pos_w_m;
+  struct quaternionf rot;
+};
+
+/* a fixed capacity ring buffer of the most recent poses of an object, in
+ * order of time; once full, each push overwrites the oldest pose. All poses
+ * are in a single allocation.
+ *
+ * usage: e.g. a follow camera viewing its target as it was some time ago,
+ * trails, lag compensation.
+ */
+struct pose_history
+{
+  int capacity;
+  int count;
+  int newest;         /* index of the newest pose */
+  struct pose *poses;
+};
+
+/* pose_history_init - allocates an empty history of 'capacity' poses from the
+ *   arena; the history is freed with the arena. */
+void
+pose_history_init(struct pose_history *ph, int capacity, struct arena *arena);
+
+/* pose_history_push - records the pose of the object at 'time_s' in O(1); 
+ *   times must not decrease between pushes.
+ *
+ * @mw - the model-world matrix of the object; must have no scale.
+ */
+void
+pose_history_push(struct pose_history *ph, double time_s, struct matrix44f *mw);
+
+/* pose_history_sample - the pose at time 'time_s', interpolated between the
+ *   recorded poses either side; positions are lerped and orientations slerped.
+ *   Times outside the recorded range are clamped to the oldest or newest pose.
+ *
+ * returns - false if the history is empty, 'out' is unchanged.
+ */
+bool
+pose_history_sample(struct pose_history *ph, double time_s, struct pose *out);
+
+/* pose_history_rebase - adds 'shift' to the positions of the recorded poses,
+ *   e.g. when the floating origin is rebased. */
+void
+pose_history_rebase(struct pose_history *ph, struct vector4f shift);
+
+/* pose_mw - builds matrix 'out' into the model-world matrix of 'pose'.
+ *
+ * returns - matrix 'out'.
+ */
+struct matrix44f *
+pose_mw(const struct pose *pose, struct matrix44f *out);
+
+#endif
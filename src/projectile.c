@@ -0,0 +1,295 @@
+#include <string.h>
+#include <assert.h>
+
+#include "config.h"
+#include "util/trace.h"
+#include "util/jobs.h"
+#include "projectile.h"
+
+/* the float arrays, x to ttl_s, are allocated one after another */
+#define PROJECTILE_ARRAYS 7
+
+/* set_arrays - points the float arrays into 'base'. */
+static void
+set_arrays(struct projectiles *ps, float *base)
+{
+  int n = ps->capacity;
+  ps->x = base;
+  ps->y = base + n;
+  ps->z = base + 2 * n;
+  ps->vx = base + 3 * n;
+  ps->vy = base + 4 * n;
+  ps->vz = base + 5 * n;
+  ps->ttl_s = base + 6 * n;
+}
+
+/* copy_arrays - copies projectile 'from' of the float arrays at 'src' to 'to'
+ * of those at 'dst'. */
+static inline void
+copy_arrays(const float *src, int from, float *dst, int to, int capacity)
+{
+  for(int a = 0; a < PROJECTILE_ARRAYS; ++a)
+    dst[a * capacity + to] = src[a * capacity + from];
+}
+
+void
+projectiles_init(struct projectiles *ps, int capacity, struct arena *arena)
+{
+  assert(ps != NULL && capacity > 0 && arena != NULL);
+
+  ps->capacity = capacity;
+  ps->live_count = 0;
+  set_arrays(ps, ARENA_NEW(arena, float, capacity * PROJECTILE_ARRAYS));
+  ps->spare = ARENA_NEW(arena, float, capacity * PROJECTILE_ARRAYS);
+  ps->handle = ARENA_NEW(arena, uint32_t, capacity);
+  ps->spare_handle = ARENA_NEW(arena, uint32_t, capacity);
+  ps->index = ARENA_NEW(arena, int, capacity);
+  ps->hits = ARENA_NEW(arena, int, capacity);
+
+  /* handles are taken from the top of the stack; 0 first */
+  ps->free_handles = ARENA_NEW(arena, uint32_t, capacity);
+  ps->free_count = capacity;
+  for(int h = 0; h < capacity; ++h)
+  {
+    ps->free_handles[h] = (uint32_t)(capacity - 1 - h);
+    ps->index[h] = -1;
+  }
+
+  morton_sort_init(&ps->order, capacity, arena);
+  ps->reordering = false;
+  ps->reorder_ticks = 0;
+
+  ps->events = NULL;
+  ps->fired = ps->hit = ps->expired = ps->reorders = 0;
+}
+
+bool
+projectiles_fire(struct projectiles *ps, struct vector4f pos_w_m, struct vector4f dir)
+{
+  if(ps->free_count == 0)
+    return false;
+
+  uint32_t h = ps->free_handles[--ps->free_count];
+  int i = ps->live_count++;
+  ps->x[i] = pos_w_m.x;
+  ps->y[i] = pos_w_m.y;
+  ps->z[i] = pos_w_m.z;
+  ps->vx[i] = dir.x * PROJECTILE_SPEED_M_P_S;
+  ps->vy[i] = dir.y * PROJECTILE_SPEED_M_P_S;
+  ps->vz[i] = dir.z * PROJECTILE_SPEED_M_P_S;
+  ps->ttl_s[i] = PROJECTILE_LIFETIME_S;
+  ps->handle[i] = h;
+  ps->index[h] = i;
+  ++ps->fired;
+  return true;
+}
+
+static void
+move_job(void *arg, int begin, int end)
+{
+  struct projectiles *ps = arg;
+  for(int i = begin; i < end; ++i)
+  {
+    ps->x[i] += ps->vx[i] * TICK_DELTA_S;
+    ps->y[i] += ps->vy[i] * TICK_DELTA_S;
+    ps->z[i] += ps->vz[i] * TICK_DELTA_S;
+    ps->ttl_s[i] -= TICK_DELTA_S;
+  }
+}
+
+void
+projectiles_move(struct projectiles *ps)
+{
+  TRACE_ZONE("projectiles_move");
+  parallel_for(0, ps->live_count, PROJECTILE_JOB_GRAIN, move_job, ps);
+}
+
+struct collide_job_arg
+{
+  struct projectiles *ps;
+  const struct asteroid_field *field;
+};
+
+static void
+collide_job(void *arg, int begin, int end)
+{
+  struct collide_job_arg *cj = arg;
+  struct projectiles *ps = cj->ps;
+  for(int i = begin; i < end; ++i)
+  {
+    int hit = asteroid_field_hit(cj->field,
+                                 ps->x[i] - ps->vx[i] * TICK_DELTA_S,
+                                 ps->y[i] - ps->vy[i] * TICK_DELTA_S,
+                                 ps->z[i] - ps->vz[i] * TICK_DELTA_S,
+                                 ps->x[i],
+                                 ps->y[i],
+                                 ps->z[i]);
+    ps->hits[i] = hit;
+    if(hit >= 0 && ps->events)
+    {
+      struct event e = {.type = EVENT_PROJECTILE_HIT};
+      e.key = ps->handle[i];
+      e.projectile_hit.asteroid = hit;
+      e.projectile_hit.x = ps->x[i];
+      e.projectile_hit.y = ps->y[i];
+      e.projectile_hit.z = ps->z[i];
+      event_bus_publish(ps->events, &e);
+    }
+  }
+}
+
+void
+projectiles_collide(struct projectiles *ps, const struct asteroid_field *field)
+{
+  TRACE_ZONE("projectiles_collide");
+
+  /* the hits are found in parallel, then resolved in order on this thread as
+     releasing packs the arrays */
+  struct collide_job_arg cj = {ps, field};
+  parallel_for(0, ps->live_count, PROJECTILE_JOB_GRAIN, collide_job, &cj);
+
+  int kept = 0;
+  for(int i = 0; i < ps->live_count; ++i)
+  {
+    uint32_t h = ps->handle[i];
+    if(ps->hits[i] >= 0 || ps->ttl_s[i] <= 0.f)
+    {
+      if(ps->hits[i] >= 0)
+        ++ps->hit;
+      else
+      {
+        ++ps->expired;
+        if(ps->events)
+        {
+          struct event e = {.type = EVENT_PROJECTILE_EXPIRED};
+          e.key = h;
+          e.projectile_expired.x = ps->x[i];
+          e.projectile_expired.y = ps->y[i];
+          e.projectile_expired.z = ps->z[i];
+          event_bus_publish(ps->events, &e);
+        }
+      }
+      ps->index[h] = -1;
+      ps->free_handles[ps->free_count++] = h;
+      continue;
+    }
+
+    /* packing keeps the order, so keeps a sorted order sorted */
+    if(kept != i)
+    {
+      copy_arrays(ps->x, i, ps->x, kept, ps->capacity);
+      ps->handle[kept] = h;
+      ps->index[h] = kept;
+    }
+    ++kept;
+  }
+  ps->live_count = kept;
+}
+
+void
+projectiles_tick(struct projectiles *ps, const struct asteroid_field *field)
+{
+  projectiles_move(ps);
+  projectiles_collide(ps, field);
+  projectiles_reorder(ps);
+}
+
+/**** REORDERING *************************************************************/
+
+static void
+key_job(void *arg, int begin, int end)
+{
+  struct projectiles *ps = arg;
+  uint32_t *keys = morton_sort_keys(&ps->order), *values = morton_sort_values(&ps->order);
+  for(int i = begin; i < end; ++i)
+  {
+    keys[i] = morton_code_at(ps->x[i], ps->y[i], ps->z[i], PROJECTILE_ORDER_CELL_M);
+    values[i] = ps->handle[i];
+  }
+}
+
+/* apply_order - gathers the projectiles into the spare arrays in the order of
+ * the sorted handles, then those fired since the sort began, and swaps the
+ * arrays. Uses frame scratch. */
+static void
+apply_order(struct projectiles *ps)
+{
+  TRACE_ZONE("projectiles_apply_order");
+
+  arena_mark scratch = arena_get_mark(&memory_frame);
+  bool *placed = frame_alloc(sizeof(bool) * (ps->live_count ? ps->live_count : 1));
+  memset(placed, 0, sizeof(bool) * ps->live_count);
+
+  /* a handle released and reused since the snapshot places its new
+     projectile where the old one was; the order is only a little worse */
+  const uint32_t *sorted = morton_sort_values(&ps->order);
+  int n = 0;
+  for(int k = 0; k < ps->order.count; ++k)
+  {
+    int i = ps->index[sorted[k]];
+    if(i < 0 || placed[i])
+      continue;
+    placed[i] = true;
+    copy_arrays(ps->x, i, ps->spare, n, ps->capacity);
+    ps->spare_handle[n++] = ps->handle[i];
+  }
+  for(int i = 0; i < ps->live_count; ++i)
+  {
+    if(placed[i])
+      continue;
+    copy_arrays(ps->x, i, ps->spare, n, ps->capacity);
+    ps->spare_handle[n++] = ps->handle[i];
+  }
+  assert(n == ps->live_count);
+
+  float *arrays = ps->x;
+  set_arrays(ps, ps->spare);
+  ps->spare = arrays;
+  uint32_t *handles = ps->handle;
+  ps->handle = ps->spare_handle;
+  ps->spare_handle = handles;
+  for(int i = 0; i < ps->live_count; ++i)
+    ps->index[ps->handle[i]] = i;
+
+  arena_release(&memory_frame, scratch);
+}
+
+void
+projectiles_reorder(struct projectiles *ps)
+{
+  TRACE_ZONE("projectiles_reorder");
+
+  if(!ps->reordering)
+  {
+    if(++ps->reorder_ticks < PROJECTILE_REORDER_TICKS)
+      return;
+    morton_sort_begin(&ps->order, ps->live_count);
+    parallel_for(0, ps->live_count, PROJECTILE_JOB_GRAIN, key_job, ps);
+    ps->reordering = true;
+    ps->reorder_ticks = 0;
+    return;
+  }
+
+  if(!morton_sort_step(&ps->order))
+    return;
+  apply_order(ps);
+  ps->reordering = false;
+  ++ps->reorders;
+}
+
+float
+projectiles_disorder(const struct projectiles *ps)
+{
+  if(ps->live_count < 2)
+    return 0.f;
+
+  int descents = 0;
+  uint32_t last = morton_code_at(ps->x[0], ps->y[0], ps->z[0], PROJECTILE_ORDER_CELL_M);
+  for(int i = 1; i < ps->live_count; ++i)
+  {
+    uint32_t code = morton_code_at(ps->x[i], ps->y[i], ps->z[i], PROJECTILE_ORDER_CELL_M);
+    descents += code < last;
+    last = code;
+  }
+  return (float)descents / (float)(ps->live_count - 1);
+}
@@ -0,0 +1,108 @@
+#ifndef _PROJECTILE_H_
+#define _PROJECTILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "math/vector4f.h"
+#include "util/memory.h"
+#include "util/morton.h"
+#include "asteroid.h"
+#include "event_bus.h"
+
+/*
+ * The projectiles in flight; a projectile flies in a straight line until it
+ * hits an asteroid or its time to live runs out.
+ *
+ * The projectiles are stored SoA, packed: the live projectiles are indices
+ * [0, live_count) of the arrays, so ticks stream through only live
+ * projectiles and can split them across the job system. Indices change as
+ * projectiles are released and the arrays re-sorted; a projectile is named
+ * by its handle, which is fixed from fire to release, and found through the
+ * handle's index. Handles of released projectiles are reused.
+ *
+ * As projectiles fly and are fired the order of the arrays stops matching
+ * where they are, so testing each against the asteroid field's cells jumps
+ * about the field. Every PROJECTILE_REORDER_TICKS ticks the arrays are
+ * re-sorted into the Morton order of the projectiles' positions, see
+ * util/morton.h; incrementally, a radix pass of a snapshot of the order a
+ * tick, applied at once when sorted. Projectiles fired meanwhile are placed
+ * after the sorted, those released are skipped. Nothing is allocated once
+ * initialised.
+ */
+struct projectiles
+{
+  int capacity;
+  int live_count;
+
+  /* position and velocity w.r.t world space, time to live; by index */
+  float *x, *y, *z;
+  float *vx, *vy, *vz;
+  float *ttl_s;
+  uint32_t *handle;
+
+  int *index;                /* by handle; -1 if released */
+  uint32_t *free_handles;    /* a stack */
+  int free_count;
+
+  int *hits;       /* asteroid hit by each live projectile this tick, or -1 */
+
+  /* the arrays the sorted order is gathered into, swapped with the above */
+  float *spare;
+  uint32_t *spare_handle;
+
+  struct morton_sort order;
+  bool reordering;           /* a sort is in progress */
+  int reorder_ticks;         /* since the last sort */
+
+  /* hits and expiries are published here if not NULL; keyed by the handle of
+     the projectile */
+  struct event_bus *events;
+
+  /* totals since init */
+  uint64_t fired;
+  uint64_t hit;
+  uint64_t expired;
+  uint64_t reorders;
+};
+
+/* projectiles_init - room for 'capacity' projectiles in flight, allocated from
+ *   the arena. */
+void
+projectiles_init(struct projectiles *ps, int capacity, struct arena *arena);
+
+/* projectiles_fire - launches a projectile from 'pos_w_m' in the direction
+ *   'dir', a unit vector, at PROJECTILE_SPEED_M_P_S.
+ *
+ * returns - false if the most projectiles are already in flight.
+ */
+bool
+projectiles_fire(struct projectiles *ps, struct vector4f pos_w_m, struct vector4f dir);
+
+/* projectiles_tick - moves the projectiles one tick and finds the asteroids
+ *   they hit; projectiles which hit or expire are released. Then advances
+ *   the re-sort of the arrays. */
+void
+projectiles_tick(struct projectiles *ps, const struct asteroid_field *field);
+
+/* the parts of projectiles_tick; moves the projectiles, then finds and
+   resolves their hits, then advances the re-sort; exposed so the parts can
+   be timed separately */
+void
+projectiles_move(struct projectiles *ps);
+
+void
+projectiles_collide(struct projectiles *ps, const struct asteroid_field *field);
+
+/* projectiles_reorder - once a tick; every PROJECTILE_REORDER_TICKS ticks
+ *   starts a sort of the arrays into Morton order, runs a pass of one in
+ *   progress or applies one sorted. Indices change as a sort is applied. */
+void
+projectiles_reorder(struct projectiles *ps);
+
+/* projectiles_disorder - the fraction of consecutive live projectiles whose
+ *   Morton codes descend; 0 once sorted, about 0.5 when in no order. */
+float
+projectiles_disorder(const struct projectiles *ps);
+
+#endif
@@ -0,0 +1,246 @@
+#include <assert.h>
+
+#include "../config.h"
+#include "models.h"
+
+/**** CUBE MODEL *************************************************************/
+
+float cube_vertices[] = {
+  -1.0f, -1.0f,  1.0f,  
+   1.0f, -1.0f,  1.0f,
+   1.0f,  1.0f,  1.0f,
+  -1.0f,  1.0f,  1.0f,
+  -1.0f, -1.0f, -1.0f,  
+   1.0f, -1.0f, -1.0f,
+   1.0f,  1.0f, -1.0f,
+  -1.0f,  1.0f, -1.0f
+}; /* size = 12 */
+
+float cube_colors[] = {
+  1.0f, 0.f, 0.f,
+  1.0f, 0.f, 0.f,
+  1.0f, 0.f, 0.f,
+  1.0f, 0.f, 0.f,
+  0.0f, 1.f, 0.f,
+  0.0f, 1.f, 0.f,
+  0.0f, 1.f, 0.f,
+  0.0f, 1.f, 0.f
+}; /* size = 12 */
+
+unsigned char cube_indices[] = {
+  0, 1, 2,
+  0, 2, 3,
+  1, 5, 6,
+  1, 6, 2,
+  5, 4, 7,
+  5, 7, 6, 
+  4, 0, 3,
+  4, 3, 7,
+  3, 2, 6,
+  3, 6, 7,
+  1, 0, 4, 
+  1, 4, 5
+}; /* size == 36 */
+
+/**** spaceship MODEL *************************************************************/
+
+float spaceship_vertices[] = {
+  -0.5f,  0.0f, -1.0f,
+  -1.0f,  0.0f,  1.0f,
+   1.0f,  0.0f,  1.0f,
+   0.5f,  0.0f, -1.0f,
+  -0.75f, 0.3f,  0.5f,
+   0.75f, 0.3f,  0.5f,
+   0.75f,-0.3f,  0.5f,
+  -0.75f,-0.3f,  0.5f
+}; /* size = 8 */
+
+float spaceship_colors[] = {
+  0.0f, 1.0f, 0.0f,
+  1.0f, 1.0f, 0.0f,
+  1.0f, 1.0f, 0.0f,
+  0.0f, 1.0f, 0.0f,
+  1.0f, 0.0f, 0.0f,
+  1.0f, 0.0f, 0.0f,
+  0.0f, 0.0f, 1.0f,
+  0.0f, 0.0f, 1.0f
+}; /* size = 8 */
+
+unsigned char spaceship_indices[] = {
+  0, 4, 1,
+  4, 5, 1,
+  1, 5, 2,
+  2, 5, 3,
+  0, 3, 4,
+  4, 3, 5,
+  0, 1, 7,
+  1, 6, 7,
+  1, 2, 6,
+  0, 7, 3,
+  3, 7, 6,
+  2, 3, 6
+}; /* size = 36 */
+
+unsigned char spaceship_bottom_indices[] = {
+  0, 7, 1,
+  1, 7, 6,
+  1, 6, 2,
+  0, 3, 7,
+  3, 6, 7,
+  2, 6, 3,
+};
+
+unsigned char spaceship_top_indices[] = {
+  0, 1, 4,
+  4, 1, 5,
+  1, 2, 5,
+  2, 3, 5,
+  0, 4, 3,
+  4, 5, 3
+};
+
+unsigned char spaceship_wireframe_indices[] = {
+  0, 1,
+  1, 2,
+  2, 3,
+  0, 3,
+  0, 4,
+  1, 4,
+  2, 5,
+  4, 5,
+  3, 5,
+  0, 7,
+  1, 7,
+  2, 6,
+  6, 7,
+  6, 3
+};
+
+/*** WORLD AXES **************************************************************/
+
+float axis_vertices[] = {
+   0.f  , 0.f  , 0.f  ,
+   200.f, 0.f  , 0.f  ,   /* (+)x-axis */
+   0.f  , 0.f  , 0.f  ,
+  -200.f, 0.f  , 0.f  ,   /* (-)x-axis */
+   0.f  , 0.f  , 0.f  ,
+   0.f  , 200.f, 0.f  ,   /* (+)y-axis */
+   0.f  , 0.f  , 0.f  ,
+   0.f  ,-200.f, 0.f  ,   /* (-)y-axis */
+   0.f  , 0.f  , 0.f  ,
+   0.f  , 0.f  , 200.f,   /* (+)z-axis */
+   0.f  , 0.f  , 0.f  ,
+   0.f  , 0.f  ,-200.f    /* (-)z-axis */
+}; /* size = 36 */
+
+float axis_colors[] = {
+  1.0f, 0.0f, 0.0f,
+  1.0f, 0.0f, 0.0f,       /* (+)x-axis */
+  1.0f, 0.5f, 0.0f,
+  1.0f, 0.5f, 0.0f,       /* (-)x-axis */
+  0.0f, 1.0f, 0.0f,
+  0.0f, 1.0f, 0.0f,       /* (+)y-axis */
+  1.0f, 1.0f, 0.0f,
+  1.0f, 1.0f, 0.0f,       /* (-)y-axis */
+  0.0f, 0.0f, 1.0f,
+  0.0f, 0.0f, 1.0f,       /* (+)z-axis */
+  0.0f, 1.0f, 1.0f,
+  0.0f, 1.0f, 1.0f,       /* (-)z-axis */
+}; /* size = 12 */
+
+/*** WORLD GRID **************************************************************/
+
+float xzgrid[XZ_GRID_VERTEX_COUNT * 3];
+
+struct matrix44f grid_mw[GRID_COUNT];
+
+const float grid_centers[GRID_COUNT][3] = {
+  {0.f, -WORLD_HALF_EXTENT_M, 0.f},  /* bottom */
+  {0.f,  WORLD_HALF_EXTENT_M, 0.f},  /* top */
+  {0.f, 0.f,  WORLD_HALF_EXTENT_M},  /* back */
+  {0.f, 0.f, -WORLD_HALF_EXTENT_M}   /* front */
+};
+
+/* generate_xz_grid - generates a vertex array which can be used to render
+ * a grid in the world space x-z plane. The grid is centered about it's origin.
+ *
+ * @vertex_array - buffer to store generated vertices.
+ * @ox,oy,oz - position vector to origin of the grid.
+ * @d - distance between grid lines (unit: meters).
+ * @nx - num lines perpendicular to x-axis in grid.
+ * @nz - num lines perpendicular to z-axis in grid.
+ *
+ * note - the @vertex_array MUST be large enough to store all the generated
+ * vertices or a seg fault will occur. The number of generated vertices can
+ * be calculated as:
+ *    
+ *    num_vertices = (nx + ny) * 2 * 3
+ *
+ * why? nx + ny = num lines in grid, then have 2 points per line and 3 vertices
+ * per point.
+ *
+ * note - nx and nz should be odd values to allow the grid to be evenly spaced
+ * about the origin; the odd, extra line in each dimension is the center line
+ * in that dimension. This approach is taken to allow the center line to be
+ * rendered as the axes of the grid and have the grid evenly spaced about the
+ * axes. If nx or nz is even, they are made odd by subtracting 1.
+ */
+void
+generate_xz_grid(float *vertex_array, float d_m, int nx, int nz)
+{
+  assert(vertex_array != NULL);
+
+  int nhx, nhz, v = 0;
+
+  if(nx % 2 == 0)
+    nx--;
+  if(nz % 2 == 0)
+    nz--;
+
+  nhx = (nx - 1) / 2;
+  nhz = (nz - 1) / 2;
+
+  /* generate the lines perpendicular to the x-axis */
+  for(int i = -nhx; i <= nhx; ++i)
+  {
+    vertex_array[v++] = (d_m * i);
+    vertex_array[v++] = 0.f;
+    vertex_array[v++] = (-nhz) * d_m;
+
+    vertex_array[v++] = (d_m * i);
+    vertex_array[v++] = 0.f;
+    vertex_array[v++] = nhz * d_m;
+  }
+
+  /* generate the lines perpendicular to the z-axis */
+  for(int i = -nhz; i <= nhz; ++i)
+  {
+    vertex_array[v++] = (-nhx) * d_m;
+    vertex_array[v++] = 0.f;
+    vertex_array[v++] = d_m * i;
+
+    vertex_array[v++] = nhx * d_m;
+    vertex_array[v++] = 0.f;
+    vertex_array[v++] = (d_m * i);
+  }
+}
+
+void
+models_init()
+{
+  generate_xz_grid(xzgrid, 10.f, XZ_GRID_LINES, XZ_GRID_LINES);
+
+  /* floor and ceiling grids lie in the x-z plane, the back and front walls
+     are the x-z grid rotated into the x-y plane */
+  for(int g = 0; g < GRID_COUNT; ++g)
+  {
+    if(g == GRID_BACK || g == GRID_FRONT)
+      rotation_x44fm(90.f, &grid_mw[g]);
+    else
+      identity44fm(&grid_mw[g]);
+
+    grid_mw[g].m[3][0] = grid_centers[g][0];
+    grid_mw[g].m[3][1] = grid_centers[g][1];
+    grid_mw[g].m[3][2] = grid_centers[g][2];
+  }
+}
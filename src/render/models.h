@@ -0,0 +1,64 @@
+#ifndef _MODELS_H_
+#define _MODELS_H_
+
+#include "../math/matrix44f.h"
+
+/* the static meshes of the scene, shared by all render backends. Vertices are
+ * 3 floats, colours 3 floats (rgb) per vertex and indices are bytes. */
+
+/**** CUBE MODEL *************************************************************/
+
+#define CUBE_INDEX_COUNT 36
+
+extern float cube_vertices[];
+extern float cube_colors[];
+extern unsigned char cube_indices[];
+
+/**** SPACESHIP MODEL ********************************************************/
+
+#define SPACESHIP_HALF_INDEX_COUNT 18   /* top or bottom */
+#define SPACESHIP_WIREFRAME_INDEX_COUNT 28
+
+extern float spaceship_vertices[];
+extern float spaceship_colors[];
+extern unsigned char spaceship_indices[];
+extern unsigned char spaceship_bottom_indices[];
+extern unsigned char spaceship_top_indices[];
+extern unsigned char spaceship_wireframe_indices[];
+
+/*** WORLD AXES **************************************************************/
+
+#define AXIS_VERTEX_COUNT 12
+
+extern float axis_vertices[];
+extern float axis_colors[];
+
+/*** WORLD GRID **************************************************************/
+
+#define XZ_GRID_LINES 101 /* num lines per dimension; square grid */
+#define XZ_GRID_VERTEX_COUNT (XZ_GRID_LINES * 2 * 2)
+
+enum grid_wall {GRID_BOTTOM = 0, GRID_TOP, GRID_BACK, GRID_FRONT, GRID_COUNT};
+
+/* bounding spheres of the grid walls and world axes for culling; a grid
+   wall is a 1000m square, hence radius = 500 * sqrt(2) */
+#define GRID_RADIUS_M 707.2f
+#define AXIS_RADIUS_M 200.f
+
+/* vertices of a single x-z grid, drawn as GL_LINES */
+extern float xzgrid[];
+
+/* model-world matrices placing the x-z grid as each wall of the world box */
+extern struct matrix44f grid_mw[GRID_COUNT];
+
+/* centres of the grid walls w.r.t world space */
+extern const float grid_centers[GRID_COUNT][3];
+
+void
+generate_xz_grid(float *vertex_array, float d_m, int nx, int nz);
+
+/* models_init - generates the procedural models; call once before use. */
+void
+models_init();
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include <stdbool.h>
+
+#include "../math/matrix44f.h"
+#include "../asteroid.h"
+#include "models.h"
+
+/* the most views a scene may have */
+#define RENDER_MAX_VIEWS 4
+
+/* a view of the scene through one camera into a rectangle of the output,
+ * e.g. a split-screen half or a rear-view mirror inset. The culling has been
+ * done per view; backends draw exactly what the view lists. */
+struct render_view
+{
+  /* the viewport; pixels from the top left of the output */
+  int x_px;
+  int y_px;
+  int width_px;
+  int height_px;
+
+  struct matrix44f *wv; /* world-view of the camera */
+  struct matrix44f *vc; /* view-clip, i.e. the projection */
+
+  bool grid_visible[GRID_COUNT];
+  bool axes_visible;
+
+  const int *asteroids; /* indices into the field of the asteroids to draw */
+  int asteroid_count;
+
+  /* the model-world matrices of the asteroids to draw, in the same order; if
+     NULL the field's matrices are drawn */
+  struct matrix44f *asteroid_mw;
+};
+
+/* everything a backend needs to draw one frame; the objects are shared by all
+ * views, views are drawn in order, each over the top of those before it. */
+struct render_scene
+{
+  struct matrix44f *ship_mw;
+  const struct asteroid_field *field;
+
+  const struct render_view *views;
+  int view_count;
+};
+
+/* a render backend; an implementation fills in the operations and its own
+ * state in its init function, e.g. render_gl_init. */
+struct render_backend
+{
+  const char *name;
+
+  /* resize - the output has been resized; sets the viewport. */
+  void (*resize)(struct render_backend *rb, int width_px, int height_px);
+
+  /* draw - draws all views of the scene into the back buffer. */
+  void (*draw)(struct render_backend *rb, const struct render_scene *scene);
+
+  /* present - shows the back buffer, e.g. swaps the window buffers. */
+  void (*present)(struct render_backend *rb);
+
+  /* set_vsync - turns waiting for the display's vertical blank in present on
+   *   or off.
+   *
+   * returns - the display's refresh interval in seconds if presents now wait
+   *   for it; 0 if they do not, i.e. vsync is off or unsupported. */
+  double (*set_vsync)(struct render_backend *rb, bool vsync);
+
+  /* write_ppm - writes the last presented frame to a binary (P6) ppm image.
+   *
+   * returns - 0 on success, non-zero on error; errors logged to log file. */
+  int (*write_ppm)(struct render_backend *rb, const char *path);
+
+  /* quit - frees all resources of the backend. */
+  void (*quit)(struct render_backend *rb);
+
+  void *state; /* backend private state */
+};
+
+/* render_gl_init - the opengl 3.1 glsl backend drawing to an SDL window;
+ *   exits the program on failure to create the window or gl context.
+ */
+void
+render_gl_init(struct render_backend *rb, int width_px, int height_px);
+
+/* render_gl_offscreen_init - the opengl 3.1 glsl backend drawing to an
+ *   offscreen pbuffer of an EGL context; needs no window or display server.
+ *   Presenting does not swap, it waits for gl to finish the frame, so frames
+ *   are never paced by the swap interval.
+ *
+ * returns - false if no EGL display, config or context could be created.
+ */
+bool
+render_gl_offscreen_init(struct render_backend *rb, int width_px, int height_px);
+
+/* render_soft_init - the software rasterizer backend drawing to a framebuffer
+ *   in memory; needs no window or gpu. Tiles are rasterized across the job
+ *   system's threads.
+ */
+void
+render_soft_init(struct render_backend *rb, int width_px, int height_px);
+
+#endif
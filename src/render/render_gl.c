@@ -0,0 +1,623 @@
+#define GL_GLEXT_PROTOTYPES
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <GL/glu.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../config.h"
+#include "../util/log.h"
+#include "../util/system.h"
+#include "../util/trace.h"
+#include "render.h"
+
+/* vertex attribute locations shared by all meshes */
+enum gl_attribute {ATTRIB_POSITION = 0, ATTRIB_COLOR = 1};
+
+/* binding point of the per-frame 'view' uniform block */
+#define VIEW_BLOCK_BINDING 0
+
+/* the per-frame uniform block; std140 layout, mat4 are 16 floats column major */
+struct gl_view_block
+{
+  float vc[16];
+  float wv[16];
+};
+
+/* a static mesh in gpu buffers; the vertex array object records the vertex
+   and index buffers and which attributes are arrays */
+struct gl_mesh
+{
+  GLuint vao;
+  GLuint vbo_positions;
+  GLuint vbo_colors;    /* 0 if the mesh uses a constant colour */
+  GLuint ibo;           /* 0 if the mesh is drawn with glDrawArrays */
+};
+
+/* the opengl 3.1 glsl backend; draws to either an SDL window or an EGL
+   pbuffer when offscreen */
+struct gl_state
+{
+  bool offscreen;
+  int width_px;
+  int height_px;
+
+  SDL_Window *window;
+  SDL_GLContext glcontext;
+
+  EGLDisplay egl_display;
+  EGLSurface egl_surface;
+  EGLContext egl_context;
+
+  GLuint program;
+  GLint mw_location;
+  GLuint view_ubo;
+
+  struct gl_mesh cube;
+  struct gl_mesh spaceship; /* indices are the top then the bottom half */
+  struct gl_mesh axes;
+  struct gl_mesh grids;     /* all grid walls pre-transformed to world space */
+};
+
+static struct gl_state gl;
+
+/* all objects are transformed by their model-world matrix 'mw' then by the
+ * camera's world-view and view-clip matrices of the frame. */
+static const char *vertex_shader_source =
+  "#version 140\n"
+  "uniform view\n"
+  "{\n"
+  "  mat4 vc;\n"
+  "  mat4 wv;\n"
+  "};\n"
+  "uniform mat4 mw;\n"
+  "in vec3 position;\n"
+  "in vec3 color;\n"
+  "out vec3 vertex_color;\n"
+  "void main()\n"
+  "{\n"
+  "  vertex_color = color;\n"
+  "  gl_Position = vc * (wv * (mw * vec4(position, 1.0)));\n"
+  "}\n";
+
+static const char *fragment_shader_source =
+  "#version 140\n"
+  "in vec3 vertex_color;\n"
+  "out vec4 fragment_color;\n"
+  "void main()\n"
+  "{\n"
+  "  fragment_color = vec4(vertex_color, 1.0);\n"
+  "}\n";
+
+static void
+gl_resize(struct render_backend *rb, int width_px, int height_px)
+{
+  (void)rb;
+  gl.width_px = width_px;
+  gl.height_px = height_px;
+  glViewport(0, 0, (GLsizei)width_px, (GLsizei)height_px);
+}
+
+/* draw_view - draws the objects visible in the view; the view uniform block
+ * is updated per view, the meshes and per object matrices are shared. */
+static void
+draw_view(const struct render_scene *scene, const struct render_view *view)
+{
+  TRACE_ZONE("gl_draw_view");
+
+  /* gl viewports are from the bottom left */
+  int y_px = gl.height_px - view->y_px - view->height_px;
+  glViewport(view->x_px, y_px, view->width_px, view->height_px);
+  glScissor(view->x_px, y_px, view->width_px, view->height_px);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  //
+  // the model appears to be inverted if I use my own view matrix, if
+  // using the opengl matrix math to build the view it is not inverted.
+  //
+  // it is both the winding order and the spaceship direction that is inverted,
+  // it is asthough the spaceship is scaled by -1.0 on the z-axis.
+  //
+  // With my view the spaceship points down -z but the winding order is inside
+  // out, with opengl view the spaceship points up +z and the winding order is
+  // correct.
+  //
+  // NOPE! i was wrong, in both cases the spaceship points up +z, but with my
+  // view the winding order is inside out.
+  //
+  // NOPE! wrong again, they are actually the same. IT IS VERY HARD TO TELL!
+  //
+  // need a better testing setup/arrangement.
+  //
+
+  /* set the view and projection matrices; once per view for all objects */
+  struct gl_view_block block;
+  memcpy(block.vc, flatten44fm(view->vc), sizeof(block.vc));
+  memcpy(block.wv, flatten44fm(view->wv), sizeof(block.wv));
+  glBindBuffer(GL_UNIFORM_BUFFER, gl.view_ubo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+
+  /* grid walls: bottom, top, back (+)z, front (-)z; baked in world space */
+  TRACE_BEGIN(grids_zone, "draw_grids");
+  struct matrix44f identity;
+  identity44fm(&identity);
+  glUniformMatrix4fv(gl.mw_location, 1, GL_FALSE, flatten44fm(&identity));
+  glBindVertexArray(gl.grids.vao);
+  glVertexAttrib3f(ATTRIB_COLOR, 0.5f, 0.5f, 0.5f);
+  for(int g = 0; g < GRID_COUNT; ++g)
+  {
+    if(view->grid_visible[g])
+      glDrawArrays(GL_LINES, g * XZ_GRID_VERTEX_COUNT, XZ_GRID_VERTEX_COUNT);
+  }
+  TRACE_END(grids_zone);
+
+  /* draw asteroids; only those which survived culling */
+  TRACE_BEGIN(asteroids_zone, "draw_asteroids");
+  const struct asteroid_field *field = scene->field;
+  glBindVertexArray(gl.cube.vao);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glVertexAttrib3f(ATTRIB_COLOR, 0.4f, 0.35f, 0.3f);
+  for(int v = 0; v < view->asteroid_count; ++v)
+  {
+    struct matrix44f *mw = view->asteroid_mw ? &view->asteroid_mw[v] : &field->mw[view->asteroids[v]];
+    glUniformMatrix4fv(gl.mw_location, 1, GL_FALSE, flatten44fm(mw));
+    glDrawElements(GL_TRIANGLES, CUBE_INDEX_COUNT, GL_UNSIGNED_BYTE, NULL);
+  }
+  TRACE_END(asteroids_zone);
+
+  /* draw world space axes */
+  if(view->axes_visible)
+  {
+    TRACE_ZONE("draw_axes");
+    glUniformMatrix4fv(gl.mw_location, 1, GL_FALSE, flatten44fm(&identity));
+    glBindVertexArray(gl.axes.vao);
+    glDrawArrays(GL_LINES, 0, AXIS_VERTEX_COUNT);
+  }
+
+  /* draw spaceship */
+  TRACE_BEGIN(ship_zone, "draw_ship");
+  const void *top = NULL;
+  const void *bottom = (const void *)(ptrdiff_t)SPACESHIP_HALF_INDEX_COUNT;
+  glUniformMatrix4fv(gl.mw_location, 1, GL_FALSE, flatten44fm(scene->ship_mw));
+  glBindVertexArray(gl.spaceship.vao);
+  glVertexAttrib3f(ATTRIB_COLOR, 1.f, 0.f, 0.5f);
+  glDrawElements(GL_TRIANGLES, SPACESHIP_HALF_INDEX_COUNT, GL_UNSIGNED_BYTE, top);
+  glVertexAttrib3f(ATTRIB_COLOR, 0.f, 1.f, 1.f);
+  glDrawElements(GL_TRIANGLES, SPACESHIP_HALF_INDEX_COUNT, GL_UNSIGNED_BYTE, bottom);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+  glVertexAttrib3f(ATTRIB_COLOR, 1.f, 1.f, 1.f);
+  glDrawElements(GL_TRIANGLES, SPACESHIP_HALF_INDEX_COUNT * 2, GL_UNSIGNED_BYTE, top);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  TRACE_END(ship_zone);
+}
+
+static void
+gl_draw(struct render_backend *rb, const struct render_scene *scene)
+{
+  (void)rb;
+  TRACE_ZONE("gl_draw");
+
+  glUseProgram(gl.program);
+  glEnable(GL_SCISSOR_TEST);
+  for(int v = 0; v < scene->view_count; ++v)
+    draw_view(scene, &scene->views[v]);
+  glDisable(GL_SCISSOR_TEST);
+  glBindVertexArray(0);
+}
+
+static void
+gl_present(struct render_backend *rb)
+{
+  (void)rb;
+  /* offscreen there is nothing to show; wait for the frame to complete so
+     frame times include the gl execution, not just the submission */
+  if(gl.offscreen)
+    glFinish();
+  else
+    SDL_GL_SwapWindow(gl.window);
+}
+
+static double
+gl_set_vsync(struct render_backend *rb, bool vsync)
+{
+  (void)rb;
+  /* an offscreen present never swaps, so has no vblank to wait for */
+  if(gl.offscreen)
+    return 0.0;
+
+  if(SDL_GL_SetSwapInterval(vsync ? 1 : 0) != 0)
+  {
+    log_write(LOG_WARNING, "failed to set the swap interval to %d: SDL error: %s", vsync ? 1 : 0, SDL_GetError());
+    return 0.0;
+  }
+  if(!vsync)
+    return 0.0;
+
+  /* the refresh rate is unknown to some drivers; assume the common 60Hz */
+  SDL_DisplayMode mode;
+  int display = SDL_GetWindowDisplayIndex(gl.window);
+  if(display < 0 || SDL_GetCurrentDisplayMode(display, &mode) != 0 || mode.refresh_rate <= 0)
+    return 1.0 / 60.0;
+  return 1.0 / mode.refresh_rate;
+}
+
+static int
+gl_write_ppm(struct render_backend *rb, const char *path)
+{
+  (void)rb;
+  FILE *f = fopen(path, "wb");
+  if(!f)
+  {
+    log_write(LOG_ERROR, "failed to open ppm file '%s'", path);
+    return -1;
+  }
+
+  /* read the front buffer if presented by a swap, else the drawn buffer */
+  int row_bytes = gl.width_px * 3;
+  unsigned char *rgb = xmalloc(row_bytes * gl.height_px);
+  glReadBuffer(gl.offscreen ? GL_BACK : GL_FRONT);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, gl.width_px, gl.height_px, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+
+  /* gl rows are bottom to top, ppm rows top to bottom */
+  fprintf(f, "P6\n%d %d\n255\n", gl.width_px, gl.height_px);
+  for(int row = gl.height_px - 1; row >= 0; --row)
+    fwrite(rgb + row * row_bytes, 1, row_bytes, f);
+  free(rgb);
+
+  if(fclose(f))
+  {
+    log_write(LOG_ERROR, "failed to write ppm file '%s'", path);
+    return -1;
+  }
+  return 0;
+}
+
+static void
+delete_mesh(struct gl_mesh *mesh)
+{
+  glDeleteVertexArrays(1, &mesh->vao);
+  glDeleteBuffers(1, &mesh->vbo_positions);
+  if(mesh->vbo_colors)
+    glDeleteBuffers(1, &mesh->vbo_colors);
+  if(mesh->ibo)
+    glDeleteBuffers(1, &mesh->ibo);
+}
+
+static void
+gl_quit(struct render_backend *rb)
+{
+  (void)rb;
+  delete_mesh(&gl.cube);
+  delete_mesh(&gl.spaceship);
+  delete_mesh(&gl.axes);
+  delete_mesh(&gl.grids);
+  glDeleteBuffers(1, &gl.view_ubo);
+  glDeleteProgram(gl.program);
+
+  if(gl.offscreen)
+  {
+    eglMakeCurrent(gl.egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(gl.egl_display, gl.egl_context);
+    eglDestroySurface(gl.egl_display, gl.egl_surface);
+    eglTerminate(gl.egl_display);
+  }
+  else
+  {
+    SDL_GL_DeleteContext(gl.glcontext);
+    SDL_DestroyWindow(gl.window);
+    SDL_Quit();
+  }
+}
+
+/* create_mesh - uploads a static mesh to gpu buffers.
+ *
+ * @positions - 3 floats per vertex.
+ * @colors - 3 floats per vertex, or NULL to use the constant colour attribute.
+ * @indices - byte indices, or NULL if drawn as arrays.
+ */
+static void
+create_mesh(struct gl_mesh *mesh,
+            const float *positions,
+            const float *colors,
+            int vertex_count,
+            const unsigned char *indices,
+            int index_count)
+{
+  glGenVertexArrays(1, &mesh->vao);
+  glBindVertexArray(mesh->vao);
+
+  glGenBuffers(1, &mesh->vbo_positions);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo_positions);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * vertex_count, positions, GL_STATIC_DRAW);
+  glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+  glEnableVertexAttribArray(ATTRIB_POSITION);
+
+  mesh->vbo_colors = 0;
+  if(colors)
+  {
+    glGenBuffers(1, &mesh->vbo_colors);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo_colors);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * vertex_count, colors, GL_STATIC_DRAW);
+    glVertexAttribPointer(ATTRIB_COLOR, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glEnableVertexAttribArray(ATTRIB_COLOR);
+  }
+
+  mesh->ibo = 0;
+  if(indices)
+  {
+    glGenBuffers(1, &mesh->ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count, indices, GL_STATIC_DRAW);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* create_meshes - uploads all static meshes of the scene. The grid walls are
+ * baked into world space so they draw without per wall matrices. */
+static void
+create_meshes()
+{
+  create_mesh(&gl.cube, cube_vertices, NULL, 8, cube_indices, CUBE_INDEX_COUNT);
+
+  unsigned char spaceship_halves[SPACESHIP_HALF_INDEX_COUNT * 2];
+  memcpy(spaceship_halves, spaceship_top_indices, SPACESHIP_HALF_INDEX_COUNT);
+  memcpy(spaceship_halves + SPACESHIP_HALF_INDEX_COUNT, 
+         spaceship_bottom_indices, 
+         SPACESHIP_HALF_INDEX_COUNT);
+  create_mesh(&gl.spaceship, 
+              spaceship_vertices, 
+              NULL, 
+              8, 
+              spaceship_halves, 
+              SPACESHIP_HALF_INDEX_COUNT * 2);
+
+  create_mesh(&gl.axes, axis_vertices, axis_colors, AXIS_VERTEX_COUNT, NULL, 0);
+
+  float *grids = xmalloc(sizeof(float) * 3 * XZ_GRID_VERTEX_COUNT * GRID_COUNT);
+  float *out = grids;
+  for(int g = 0; g < GRID_COUNT; ++g)
+  {
+    for(int v = 0; v < XZ_GRID_VERTEX_COUNT; ++v)
+    {
+      const float *in = &xzgrid[v * 3];
+      struct vector4f p = multiply44fm(&grid_mw[g], (struct vector4f){in[0], in[1], in[2], 1.f});
+      *out++ = p.x;
+      *out++ = p.y;
+      *out++ = p.z;
+    }
+  }
+  create_mesh(&gl.grids, grids, NULL, XZ_GRID_VERTEX_COUNT * GRID_COUNT, NULL, 0);
+  free(grids);
+}
+
+/* compile_shader - returns the shader or 0 on error; errors logged to log file. */
+static GLuint
+compile_shader(GLenum type, const char *source)
+{
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+
+  GLint status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if(!status)
+  {
+    char info[512];
+    glGetShaderInfoLog(shader, sizeof(info), NULL, info);
+    log_write(LOG_ERROR, "failed to compile shader: %s", info);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+/* create_program - builds the shader program and the view uniform block.
+ *
+ * returns - false on error; errors logged to log file.
+ */
+static bool
+create_program()
+{
+  GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
+  GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+  if(!vertex_shader || !fragment_shader)
+    return false;
+
+  gl.program = glCreateProgram();
+  glAttachShader(gl.program, vertex_shader);
+  glAttachShader(gl.program, fragment_shader);
+  glBindAttribLocation(gl.program, ATTRIB_POSITION, "position");
+  glBindAttribLocation(gl.program, ATTRIB_COLOR, "color");
+  glLinkProgram(gl.program);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  GLint status;
+  glGetProgramiv(gl.program, GL_LINK_STATUS, &status);
+  if(!status)
+  {
+    char info[512];
+    glGetProgramInfoLog(gl.program, sizeof(info), NULL, info);
+    log_write(LOG_ERROR, "failed to link shader program: %s", info);
+    return false;
+  }
+
+  gl.mw_location = glGetUniformLocation(gl.program, "mw");
+  glUniformBlockBinding(gl.program, 
+                        glGetUniformBlockIndex(gl.program, "view"), 
+                        VIEW_BLOCK_BINDING);
+
+  glGenBuffers(1, &gl.view_ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, gl.view_ubo);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(struct gl_view_block), NULL, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING, gl.view_ubo);
+  return true;
+}
+
+/* setup - sets the gl state common to window and offscreen contexts, and the
+ * backend operations.
+ *
+ * returns - false on gl error.
+ */
+static bool
+setup(struct render_backend *rb, int width_px, int height_px)
+{
+  GLenum glerror;
+
+  gl.width_px = width_px;
+  gl.height_px = height_px;
+  glViewport(0, 0, (GLsizei)width_px, (GLsizei)height_px);
+  if((glerror = glGetError()) != GL_NO_ERROR)
+  {
+    fprintf(stderr, "fatal: glViewport: opengl error: %s\n", gluErrorString(glerror));
+    return false;
+  }
+
+  glClearColor(0.f, 0.f, 0.f, 1.f);
+  if((glerror = glGetError()) != GL_NO_ERROR)
+  {
+    fprintf(stderr, "fatal: glClearColor: opengl error: %s\n", gluErrorString(glerror));
+    return false;
+  }
+
+  log_write(LOG_INFO, 
+            "opengl %s, glsl %s", 
+            (const char *)glGetString(GL_VERSION),
+            (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+  if(!create_program())
+    return false;
+  create_meshes();
+
+  glCullFace(GL_BACK);
+  glFrontFace(GL_CCW);
+  glEnable(GL_CULL_FACE);
+
+  rb->name = gl.offscreen ? "gl-offscreen" : "gl";
+  rb->resize = gl_resize;
+  rb->draw = gl_draw;
+  rb->present = gl_present;
+  rb->set_vsync = gl_set_vsync;
+  rb->write_ppm = gl_write_ppm;
+  rb->quit = gl_quit;
+  rb->state = &gl;
+  return true;
+}
+
+void
+render_gl_init(struct render_backend *rb, int width_px, int height_px)
+{
+  gl.offscreen = false;
+
+  if(SDL_Init(SDL_INIT_VIDEO) < 0)
+  {
+    fprintf(stderr, "fatal: failed to init SDL2: SDL error: %s\n", SDL_GetError());
+    exit(EXIT_SUCCESS);
+  }
+
+  /* uniform blocks need opengl 3.1; must be set before the context is made */
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+
+  gl.window = SDL_CreateWindow("sdl2-opengl",
+                               SDL_WINDOWPOS_UNDEFINED,
+                               SDL_WINDOWPOS_UNDEFINED,
+                               width_px,
+                               height_px,
+                               SDL_WINDOW_OPENGL);
+  if(!gl.window)
+  {
+    fprintf(stderr, "fatal: failed to create window: SDL error: %s\n", SDL_GetError());
+    exit(EXIT_SUCCESS);
+  }
+
+  gl.glcontext = SDL_GL_CreateContext(gl.window);
+  if(!gl.glcontext)
+  {
+    fprintf(stderr, "fatal: failed to create opengl context: SDL error: %s\n", SDL_GetError());
+    exit(EXIT_SUCCESS);
+  }
+
+  if(!setup(rb, width_px, height_px))
+    exit(EXIT_SUCCESS);
+}
+
+bool
+render_gl_offscreen_init(struct render_backend *rb, int width_px, int height_px)
+{
+  gl.offscreen = true;
+
+  /* prefer mesa's surfaceless platform, which needs no display server or
+     gpu; fall back to the default display */
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = 
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  gl.egl_display = EGL_NO_DISPLAY;
+  if(get_platform_display)
+    gl.egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  if(gl.egl_display == EGL_NO_DISPLAY)
+    gl.egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  EGLint major, minor;
+  if(gl.egl_display == EGL_NO_DISPLAY || !eglInitialize(gl.egl_display, &major, &minor))
+  {
+    log_write(LOG_ERROR, "failed to initialise EGL display: EGL error: 0x%x", eglGetError());
+    return false;
+  }
+
+  static const EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint config_count;
+  if(!eglChooseConfig(gl.egl_display, config_attribs, &config, 1, &config_count) || config_count < 1)
+  {
+    log_write(LOG_ERROR, "no EGL config for an opengl pbuffer: EGL error: 0x%x", eglGetError());
+    eglTerminate(gl.egl_display);
+    return false;
+  }
+
+  const EGLint pbuffer_attribs[] = {EGL_WIDTH, width_px, EGL_HEIGHT, height_px, EGL_NONE};
+  gl.egl_surface = eglCreatePbufferSurface(gl.egl_display, config, pbuffer_attribs);
+  if(gl.egl_surface == EGL_NO_SURFACE)
+  {
+    log_write(LOG_ERROR, "failed to create EGL pbuffer: EGL error: 0x%x", eglGetError());
+    eglTerminate(gl.egl_display);
+    return false;
+  }
+
+  /* uniform blocks need opengl 3.1 */
+  static const EGLint context_attribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 1,
+    EGL_NONE
+  };
+  eglBindAPI(EGL_OPENGL_API);
+  gl.egl_context = eglCreateContext(gl.egl_display, config, EGL_NO_CONTEXT, context_attribs);
+  if(gl.egl_context == EGL_NO_CONTEXT ||
+     !eglMakeCurrent(gl.egl_display, gl.egl_surface, gl.egl_surface, gl.egl_context))
+  {
+    log_write(LOG_ERROR, "failed to create EGL opengl context: EGL error: 0x%x", eglGetError());
+    eglDestroySurface(gl.egl_display, gl.egl_surface);
+    eglTerminate(gl.egl_display);
+    return false;
+  }
+
+  log_write(LOG_INFO, 
+            "EGL %d.%d offscreen context: %s", 
+            major, 
+            minor, 
+            (const char *)glGetString(GL_RENDERER));
+
+  return setup(rb, width_px, height_px);
+}
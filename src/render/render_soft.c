@@ -0,0 +1,730 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "../config.h"
+#include "../util/system.h"
+#include "../util/log.h"
+#include "../util/trace.h"
+#include "../util/memory.h"
+#include "../util/alloc_track.h"
+#include "../util/jobs.h"
+#include "render.h"
+
+/* the software rasterizer backend.
+ *
+ * drawing is split in two phases. First, on the calling thread, the scene's
+ * meshes are transformed, clipped against the near and far planes, projected
+ * to screen space and binned into the TILE_PX square screen tiles they cover.
+ * Second, the tiles are rasterized in parallel by the job system, each tile
+ * by a single job, so every pixel is written by one thread in submission
+ * order; the output is deterministic for any number of threads.
+ *
+ * like the gl backend there is no depth buffer; primitives are painted in
+ * submission order, back faces of triangles are culled.
+ *
+ * all views of the scene share the one primitive list, in view order. Each
+ * primitive is clipped to the viewport of its view, and each view begins with
+ * a clear of its viewport, so later views paint over the top of earlier ones.
+ */
+
+#define TILE_PX 64
+
+/* max vertices of a mesh drawn by the backend */
+#define MAX_MESH_VERTICES 16
+
+/* a convex polygon clipped by 2 planes has at most 5 vertices */
+#define MAX_CLIPPED_VERTICES 5
+
+enum primitive_type {PRIM_TRIANGLE = 0, PRIM_LINE = 1, PRIM_CLEAR = 2};
+
+/* a vertex in clip space */
+struct clip_vertex
+{
+  float x, y, z, w;
+};
+
+/* a screen space rectangle [x0, x1) x [y0, y1) of pixels */
+struct viewport
+{
+  int x0, y0, x1, y1;
+};
+
+/* a screen space primitive; y down, lines use the first 2 vertices, clears
+   fill the whole viewport */
+struct primitive
+{
+  enum primitive_type type;
+  int view;
+  uint32_t color;
+  float x[3];
+  float y[3];
+};
+
+struct soft_state
+{
+  int width_px;
+  int height_px;
+  int stride_px; /* row length; padded to a whole number of tiles */
+  int tiles_x;
+  int tiles_y;
+
+  uint32_t *color; /* framebuffer; bytes r, g, b, a in memory */
+  uint32_t clear_color;
+
+  /* viewports of the views of the scene being drawn, and the view primitives
+     are being emitted for */
+  struct viewport viewports[RENDER_MAX_VIEWS];
+  int view;
+
+  struct primitive *prims;
+  int prim_count;
+  int prim_capacity;
+
+  /* per tile lists of primitive indices; tile t's list is the range
+     bin_items[bin_start[t], bin_start[t + 1]). The items are frame scratch. */
+  int *bin_start;
+  int *bin_cursor;
+  int *bin_items;
+};
+
+static inline int
+mini(int a, int b){return a < b ? a : b;}
+
+static inline int
+maxi(int a, int b){return a > b ? a : b;}
+
+static inline uint32_t
+pack_rgb(float r, float g, float b)
+{
+  return (uint32_t)(r * 255.f + 0.5f) |
+         ((uint32_t)(g * 255.f + 0.5f) << 8) |
+         ((uint32_t)(b * 255.f + 0.5f) << 16) |
+         0xff000000u;
+}
+
+/**** SETUP ******************************************************************/
+
+static inline struct clip_vertex
+transform(struct matrix44f *m, const float *p)
+{
+  struct vector4f c = multiply44fm(m, (struct vector4f){p[0], p[1], p[2], 1.f});
+  return (struct clip_vertex){c.x, c.y, c.z, c.w};
+}
+
+/* signed distance to the near (plane 0) and far (plane 1) clip planes; inside
+   if >= 0 */
+static inline float
+plane_distance(const struct clip_vertex *v, int plane)
+{
+  return (plane == 0) ? v->z + v->w : v->w - v->z;
+}
+
+static inline struct clip_vertex
+lerp_vertex(const struct clip_vertex *a, const struct clip_vertex *b, float t)
+{
+  return (struct clip_vertex){
+    a->x + (b->x - a->x) * t,
+    a->y + (b->y - a->y) * t,
+    a->z + (b->z - a->z) * t,
+    a->w + (b->w - a->w) * t
+  };
+}
+
+/* clip_polygon - sutherland-hodgman clip of a convex polygon by a plane.
+ *
+ * returns - number of vertices in 'out'.
+ */
+static int
+clip_polygon(const struct clip_vertex *in, int n, struct clip_vertex *out, int plane)
+{
+  int m = 0;
+  for(int i = 0; i < n; ++i)
+  {
+    const struct clip_vertex *a = &in[i], *b = &in[(i + 1) % n];
+    float da = plane_distance(a, plane), db = plane_distance(b, plane);
+    if(da >= 0.f)
+      out[m++] = *a;
+    if((da >= 0.f) != (db >= 0.f))
+      out[m++] = lerp_vertex(a, b, da / (da - db));
+  }
+  return m;
+}
+
+static inline void
+to_screen(const struct soft_state *ss, const struct clip_vertex *v, float *x, float *y)
+{
+  const struct viewport *vp = &ss->viewports[ss->view];
+  float inv_w = 1.f / v->w;
+  *x = vp->x0 + (v->x * inv_w * 0.5f + 0.5f) * (vp->x1 - vp->x0);
+  *y = vp->y0 + (0.5f - v->y * inv_w * 0.5f) * (vp->y1 - vp->y0);
+}
+
+static struct primitive *
+new_primitive(struct soft_state *ss)
+{
+  if(ss->prim_count == ss->prim_capacity)
+  {
+    ss->prim_capacity *= 2;
+    ss->prims = xrealloc(ss->prims, sizeof(struct primitive) * ss->prim_capacity);
+  }
+  struct primitive *p = &ss->prims[ss->prim_count++];
+  p->view = ss->view;
+  return p;
+}
+
+static void
+emit_line(struct soft_state *ss, struct clip_vertex a, struct clip_vertex b, uint32_t color)
+{
+  /* liang-barsky clip of the parametric range against the near, far planes */
+  float t0 = 0.f, t1 = 1.f;
+  for(int plane = 0; plane < 2; ++plane)
+  {
+    float da = plane_distance(&a, plane), db = plane_distance(&b, plane);
+    if(da < 0.f && db < 0.f)
+      return;
+    if(da < 0.f)
+      t0 = fmaxf(t0, da / (da - db));
+    else if(db < 0.f)
+      t1 = fminf(t1, da / (da - db));
+  }
+  if(t0 > t1)
+    return;
+
+  struct clip_vertex ca = lerp_vertex(&a, &b, t0), cb = lerp_vertex(&a, &b, t1);
+  struct primitive *p = new_primitive(ss);
+  p->type = PRIM_LINE;
+  p->color = color;
+  to_screen(ss, &ca, &p->x[0], &p->y[0]);
+  to_screen(ss, &cb, &p->x[1], &p->y[1]);
+}
+
+/* emit_triangle - clips, culls if back facing and emits a filled triangle, or
+ * its edges if 'wireframe'; like glPolygonMode(GL_FRONT, GL_LINE). */
+static void
+emit_triangle(struct soft_state *ss,
+              const struct clip_vertex *v0,
+              const struct clip_vertex *v1,
+              const struct clip_vertex *v2,
+              uint32_t color,
+              bool wireframe)
+{
+  struct clip_vertex a[MAX_CLIPPED_VERTICES] = {*v0, *v1, *v2}, b[MAX_CLIPPED_VERTICES];
+  int n = clip_polygon(a, 3, b, 0);
+  n = clip_polygon(b, n, a, 1);
+  if(n < 3)
+    return;
+
+  float x[MAX_CLIPPED_VERTICES], y[MAX_CLIPPED_VERTICES];
+  for(int i = 0; i < n; ++i)
+    to_screen(ss, &a[i], &x[i], &y[i]);
+
+  /* front faces are CCW with y up, thus CW with screen y down */
+  float area = 0.f;
+  for(int i = 0; i < n; ++i)
+    area += x[i] * y[(i + 1) % n] - x[(i + 1) % n] * y[i];
+  if(area >= 0.f)
+    return;
+
+  if(wireframe)
+  {
+    emit_line(ss, *v0, *v1, color);
+    emit_line(ss, *v1, *v2, color);
+    emit_line(ss, *v2, *v0, color);
+    return;
+  }
+
+  /* triangle fan of the clipped polygon */
+  for(int i = 1; i + 1 < n; ++i)
+  {
+    struct primitive *p = new_primitive(ss);
+    p->type = PRIM_TRIANGLE;
+    p->color = color;
+    p->x[0] = x[0];     p->y[0] = y[0];
+    p->x[1] = x[i];     p->y[1] = y[i];
+    p->x[2] = x[i + 1]; p->y[2] = y[i + 1];
+  }
+}
+
+static void
+emit_mesh(struct soft_state *ss,
+          struct matrix44f *mc,
+          const float *vertices,
+          int vertex_count,
+          const unsigned char *indices,
+          int index_count,
+          uint32_t color,
+          bool wireframe)
+{
+  assert(vertex_count <= MAX_MESH_VERTICES);
+
+  struct clip_vertex cv[MAX_MESH_VERTICES];
+  for(int i = 0; i < vertex_count; ++i)
+    cv[i] = transform(mc, vertices + i * 3);
+
+  for(int i = 0; i + 2 < index_count; i += 3)
+    emit_triangle(ss, &cv[indices[i]], &cv[indices[i + 1]], &cv[indices[i + 2]], color, wireframe);
+}
+
+/* primitive_tiles - the inclusive range of tiles overlapped by the primitive's
+ * bounding box.
+ *
+ * returns - false if the primitive is wholly off screen.
+ */
+static bool
+primitive_tiles(const struct soft_state *ss, const struct primitive *p, int *t)
+{
+  const struct viewport *vp = &ss->viewports[p->view];
+  float minx = vp->x0, maxx = vp->x1 - 1, miny = vp->y0, maxy = vp->y1 - 1;
+  if(p->type != PRIM_CLEAR)
+  {
+    int n = (p->type == PRIM_TRIANGLE) ? 3 : 2;
+    float bminx = p->x[0], bmaxx = p->x[0], bminy = p->y[0], bmaxy = p->y[0];
+    for(int i = 1; i < n; ++i)
+    {
+      bminx = fminf(bminx, p->x[i]);
+      bmaxx = fmaxf(bmaxx, p->x[i]);
+      bminy = fminf(bminy, p->y[i]);
+      bmaxy = fmaxf(bmaxy, p->y[i]);
+    }
+    minx = fmaxf(minx, bminx);
+    maxx = fminf(maxx, bmaxx);
+    miny = fmaxf(miny, bminy);
+    maxy = fminf(maxy, bmaxy);
+  }
+  if(maxx < minx || maxy < miny)
+    return false;
+
+  t[0] = maxi(0, (int)minx / TILE_PX);
+  t[1] = maxi(0, (int)miny / TILE_PX);
+  t[2] = mini(ss->tiles_x - 1, (int)maxx / TILE_PX);
+  t[3] = mini(ss->tiles_y - 1, (int)maxy / TILE_PX);
+  return true;
+}
+
+/* bin_primitives - sorts the primitives into per tile lists, preserving their
+ * submission order within each list. */
+static void
+bin_primitives(struct soft_state *ss)
+{
+  TRACE_ZONE("soft_bin");
+
+  int tile_count = ss->tiles_x * ss->tiles_y, t[4];
+
+  memset(ss->bin_start, 0, sizeof(int) * (tile_count + 1));
+  for(int i = 0; i < ss->prim_count; ++i)
+  {
+    if(!primitive_tiles(ss, &ss->prims[i], t))
+      continue;
+    for(int ty = t[1]; ty <= t[3]; ++ty)
+      for(int tx = t[0]; tx <= t[2]; ++tx)
+        ++ss->bin_start[ty * ss->tiles_x + tx + 1];
+  }
+
+  for(int i = 0; i < tile_count; ++i)
+    ss->bin_start[i + 1] += ss->bin_start[i];
+
+  ss->bin_items = frame_alloc(sizeof(int) * ss->bin_start[tile_count]);
+
+  memcpy(ss->bin_cursor, ss->bin_start, sizeof(int) * tile_count);
+  for(int i = 0; i < ss->prim_count; ++i)
+  {
+    if(!primitive_tiles(ss, &ss->prims[i], t))
+      continue;
+    for(int ty = t[1]; ty <= t[3]; ++ty)
+      for(int tx = t[0]; tx <= t[2]; ++tx)
+        ss->bin_items[ss->bin_cursor[ty * ss->tiles_x + tx]++] = i;
+  }
+}
+
+/**** RASTERIZATION **********************************************************/
+
+/* rasterize_triangle - fills the pixels of the triangle whose centres lie in
+ * the rectangle [x0, x1) x [y0, y1). */
+static void
+rasterize_triangle(struct soft_state *ss, const struct primitive *p, int x0, int y0, int x1, int y1)
+{
+  /* edge functions E(p) = A*p.x + B*p.y + C, see occlusion.c */
+  float A[3], B[3], C[3];
+  for(int e = 0; e < 3; ++e)
+  {
+    int a = (e + 1) % 3, b = (e + 2) % 3;
+    A[e] = p->y[a] - p->y[b];
+    B[e] = p->x[b] - p->x[a];
+    C[e] = (p->y[b] - p->y[a]) * p->x[a] - (p->x[b] - p->x[a]) * p->y[a];
+  }
+
+  float area = A[0] * p->x[0] + B[0] * p->y[0] + C[0];
+  if(area == 0.f)
+    return;
+  if(area < 0.f)
+  {
+    for(int e = 0; e < 3; ++e)
+    {
+      A[e] = -A[e];
+      B[e] = -B[e];
+      C[e] = -C[e];
+    }
+  }
+
+  int minx = maxi(x0, (int)floorf(fminf(p->x[0], fminf(p->x[1], p->x[2]))));
+  int maxx = mini(x1 - 1, (int)ceilf(fmaxf(p->x[0], fmaxf(p->x[1], p->x[2]))));
+  int miny = maxi(y0, (int)floorf(fminf(p->y[0], fminf(p->y[1], p->y[2]))));
+  int maxy = mini(y1 - 1, (int)ceilf(fmaxf(p->y[0], fmaxf(p->y[1], p->y[2]))));
+
+#if defined(__SSE2__)
+
+  /* 4 pixels per step; tiles are a multiple of 4 wide so aligning down stays
+     in the tile, pixels outside [x0, x1) are masked as viewports need not be
+     aligned */
+  minx &= ~3;
+  const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 clip_x0 = _mm_set1_ps((float)x0);
+  const __m128 clip_x1 = _mm_set1_ps((float)x1);
+  const __m128i color = _mm_set1_epi32((int)p->color);
+  for(int py = miny; py <= maxy; ++py)
+  {
+    uint32_t *row = ss->color + py * ss->stride_px;
+    float cy = (float)py + 0.5f;
+    __m128 e0row = _mm_set1_ps(B[0] * cy + C[0]);
+    __m128 e1row = _mm_set1_ps(B[1] * cy + C[1]);
+    __m128 e2row = _mm_set1_ps(B[2] * cy + C[2]);
+    for(int px = minx; px <= maxx; px += 4)
+    {
+      __m128 cx = _mm_add_ps(_mm_set1_ps((float)px), offsets);
+      __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), cx), e0row);
+      __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), cx), e1row);
+      __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), cx), e2row);
+      __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                 _mm_cmpge_ps(e2, zero));
+      inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(cx, clip_x0), _mm_cmplt_ps(cx, clip_x1)));
+      if(_mm_movemask_ps(inside) == 0)
+        continue;
+      __m128i mask = _mm_castps_si128(inside);
+      __m128i old = _mm_loadu_si128((__m128i *)(row + px));
+      _mm_storeu_si128((__m128i *)(row + px),
+                       _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old)));
+    }
+  }
+
+#else
+
+  for(int py = miny; py <= maxy; ++py)
+  {
+    uint32_t *row = ss->color + py * ss->stride_px;
+    float cy = (float)py + 0.5f;
+    for(int px = minx; px <= maxx; ++px)
+    {
+      float cx = (float)px + 0.5f;
+      if(A[0] * cx + B[0] * cy + C[0] >= 0.f &&
+         A[1] * cx + B[1] * cy + C[1] >= 0.f &&
+         A[2] * cx + B[2] * cy + C[2] >= 0.f)
+        row[px] = p->color;
+    }
+  }
+
+#endif
+}
+
+/* rasterize_line - dda line; plots one pixel per column (or row if steep)
+ * whose centre lies within the line's extent, clipped to [x0, x1) x [y0, y1). */
+static void
+rasterize_line(struct soft_state *ss, const struct primitive *p, int x0, int y0, int x1, int y1)
+{
+  float dx = p->x[1] - p->x[0], dy = p->y[1] - p->y[0];
+  bool steep = fabsf(dy) > fabsf(dx);
+
+  /* major and minor axis coordinates and clip ranges */
+  float ma = steep ? p->y[0] : p->x[0], mb = steep ? p->y[1] : p->x[1];
+  float na = steep ? p->x[0] : p->y[0], nb = steep ? p->x[1] : p->y[1];
+  int mlo = steep ? y0 : x0, mhi = steep ? y1 : x1;
+  int nlo = steep ? x0 : y0, nhi = steep ? x1 : y1;
+
+  if(ma > mb)
+  {
+    float t = ma; ma = mb; mb = t;
+    t = na; na = nb; nb = t;
+  }
+  if(mb - ma < 1e-6f)
+    return;
+
+  float slope = (nb - na) / (mb - ma);
+
+  /* pixels whose centre c satisfies ma <= c < mb */
+  int first = maxi(mlo, (int)ceilf(ma - 0.5f));
+  int last = mini(mhi - 1, (int)ceilf(mb - 0.5f) - 1);
+  for(int m = first; m <= last; ++m)
+  {
+    int n = (int)floorf(na + ((float)m + 0.5f - ma) * slope);
+    if(n < nlo || n >= nhi)
+      continue;
+    if(steep)
+      ss->color[m * ss->stride_px + n] = p->color;
+    else
+      ss->color[n * ss->stride_px + m] = p->color;
+  }
+}
+
+static void
+clear_rect(struct soft_state *ss, uint32_t color, int x0, int y0, int x1, int y1)
+{
+  for(int py = y0; py < y1; ++py)
+  {
+    uint32_t *row = ss->color + py * ss->stride_px;
+    for(int px = x0; px < x1; ++px)
+      row[px] = color;
+  }
+}
+
+static void
+render_tile(struct soft_state *ss, int tile)
+{
+  int tx = tile % ss->tiles_x, ty = tile / ss->tiles_x;
+  int x0 = tx * TILE_PX, y0 = ty * TILE_PX;
+  int x1 = mini(x0 + TILE_PX, ss->width_px), y1 = mini(y0 + TILE_PX, ss->height_px);
+
+  for(int py = y0; py < y1; ++py)
+  {
+    uint32_t *row = ss->color + py * ss->stride_px;
+    for(int px = x0; px < x0 + TILE_PX; ++px)
+      row[px] = ss->clear_color;
+  }
+
+  for(int i = ss->bin_start[tile]; i < ss->bin_start[tile + 1]; ++i)
+  {
+    /* clip to the intersection of the tile and the primitive's viewport */
+    const struct primitive *p = &ss->prims[ss->bin_items[i]];
+    const struct viewport *vp = &ss->viewports[p->view];
+    int cx0 = maxi(x0, vp->x0), cy0 = maxi(y0, vp->y0);
+    int cx1 = mini(x1, vp->x1), cy1 = mini(y1, vp->y1);
+    if(p->type == PRIM_TRIANGLE)
+      rasterize_triangle(ss, p, cx0, cy0, cx1, cy1);
+    else if(p->type == PRIM_LINE)
+      rasterize_line(ss, p, cx0, cy0, cx1, cy1);
+    else
+      clear_rect(ss, p->color, cx0, cy0, cx1, cy1);
+  }
+}
+
+/* render_tiles - job rasterizing the tiles [begin, end). */
+static void
+render_tiles(void *arg, int begin, int end)
+{
+  TRACE_ZONE("soft_render_tiles");
+  ALLOC_TAG("raster");
+
+  for(int tile = begin; tile < end; ++tile)
+    render_tile(arg, tile);
+}
+
+/**** BACKEND ****************************************************************/
+
+static void
+allocate_framebuffer(struct soft_state *ss, int width_px, int height_px)
+{
+  ss->width_px = width_px;
+  ss->height_px = height_px;
+  ss->tiles_x = (width_px + TILE_PX - 1) / TILE_PX;
+  ss->tiles_y = (height_px + TILE_PX - 1) / TILE_PX;
+  ss->stride_px = ss->tiles_x * TILE_PX;
+
+  free(ss->color);
+  free(ss->bin_start);
+  free(ss->bin_cursor);
+  ss->color = xmalloc(sizeof(uint32_t) * ss->stride_px * ss->tiles_y * TILE_PX);
+  ss->bin_start = xmalloc(sizeof(int) * (ss->tiles_x * ss->tiles_y + 1));
+  ss->bin_cursor = xmalloc(sizeof(int) * ss->tiles_x * ss->tiles_y);
+  for(int i = 0; i < ss->stride_px * ss->height_px; ++i)
+    ss->color[i] = ss->clear_color;
+}
+
+static void
+soft_resize(struct render_backend *rb, int width_px, int height_px)
+{
+  allocate_framebuffer(rb->state, width_px, height_px);
+}
+
+/* emit_view - emits the clear of the view's viewport then the objects
+ * visible in the view. */
+static void
+emit_view(struct soft_state *ss, const struct render_scene *scene, const struct render_view *view)
+{
+  TRACE_ZONE("soft_emit_view");
+
+  struct matrix44f wc, mc;
+
+  ss->viewports[ss->view] = (struct viewport){
+    maxi(0, view->x_px),
+    maxi(0, view->y_px),
+    mini(ss->width_px, view->x_px + view->width_px),
+    mini(ss->height_px, view->y_px + view->height_px)
+  };
+  struct primitive *clear = new_primitive(ss);
+  clear->type = PRIM_CLEAR;
+  clear->color = ss->clear_color;
+
+  concatenate44fm(view->vc, view->wv, &wc);
+
+  /* grid walls */
+  TRACE_BEGIN(grids_zone, "draw_grids");
+  uint32_t grey = pack_rgb(0.5f, 0.5f, 0.5f);
+  for(int g = 0; g < GRID_COUNT; ++g)
+  {
+    if(!view->grid_visible[g])
+      continue;
+    concatenate44fm(&wc, &grid_mw[g], &mc);
+    for(int i = 0; i < XZ_GRID_VERTEX_COUNT; i += 2)
+      emit_line(ss, transform(&mc, xzgrid + i * 3), transform(&mc, xzgrid + (i + 1) * 3), grey);
+  }
+  TRACE_END(grids_zone);
+
+  /* asteroids */
+  TRACE_BEGIN(asteroids_zone, "draw_asteroids");
+  const struct asteroid_field *field = scene->field;
+  uint32_t rock = pack_rgb(0.4f, 0.35f, 0.3f);
+  for(int v = 0; v < view->asteroid_count; ++v)
+  {
+    struct matrix44f *mw = view->asteroid_mw ? &view->asteroid_mw[v] : &field->mw[view->asteroids[v]];
+    concatenate44fm(&wc, mw, &mc);
+    emit_mesh(ss, &mc, cube_vertices, 8, cube_indices, CUBE_INDEX_COUNT, rock, false);
+  }
+  TRACE_END(asteroids_zone);
+
+  /* world space axes; colours are per line */
+  if(view->axes_visible)
+  {
+    TRACE_ZONE("draw_axes");
+    for(int i = 0; i < AXIS_VERTEX_COUNT; i += 2)
+    {
+      const float *c = axis_colors + i * 3;
+      emit_line(ss,
+                transform(&wc, axis_vertices + i * 3),
+                transform(&wc, axis_vertices + (i + 1) * 3),
+                pack_rgb(c[0], c[1], c[2]));
+    }
+  }
+
+  /* spaceship; filled halves then the wireframe over the top */
+  TRACE_BEGIN(ship_zone, "draw_ship");
+  concatenate44fm(&wc, scene->ship_mw, &mc);
+  emit_mesh(ss, &mc, spaceship_vertices, 8, spaceship_top_indices,
+            SPACESHIP_HALF_INDEX_COUNT, pack_rgb(1.f, 0.f, 0.5f), false);
+  emit_mesh(ss, &mc, spaceship_vertices, 8, spaceship_bottom_indices,
+            SPACESHIP_HALF_INDEX_COUNT, pack_rgb(0.f, 1.f, 1.f), false);
+  emit_mesh(ss, &mc, spaceship_vertices, 8, spaceship_top_indices,
+            SPACESHIP_HALF_INDEX_COUNT, pack_rgb(1.f, 1.f, 1.f), true);
+  emit_mesh(ss, &mc, spaceship_vertices, 8, spaceship_bottom_indices,
+            SPACESHIP_HALF_INDEX_COUNT, pack_rgb(1.f, 1.f, 1.f), true);
+  TRACE_END(ship_zone);
+}
+
+static void
+soft_draw(struct render_backend *rb, const struct render_scene *scene)
+{
+  TRACE_ZONE("soft_draw");
+
+  struct soft_state *ss = rb->state;
+  assert(scene->view_count <= RENDER_MAX_VIEWS);
+
+  ss->prim_count = 0;
+  for(ss->view = 0; ss->view < scene->view_count; ++ss->view)
+    emit_view(ss, scene, &scene->views[ss->view]);
+
+  bin_primitives(ss);
+
+  parallel_for(0, ss->tiles_x * ss->tiles_y, 1, render_tiles, ss);
+}
+
+static void
+soft_present(struct render_backend *rb)
+{
+  (void)rb;
+}
+
+static double
+soft_set_vsync(struct render_backend *rb, bool vsync)
+{
+  (void)rb;
+  (void)vsync;
+  return 0.0;
+}
+
+static void
+soft_quit(struct render_backend *rb)
+{
+  struct soft_state *ss = rb->state;
+
+  free(ss->bin_cursor);
+  free(ss->bin_start);
+  free(ss->prims);
+  free(ss->color);
+  free(ss);
+  rb->state = NULL;
+}
+
+static int
+soft_write_ppm(struct render_backend *rb, const char *path)
+{
+  struct soft_state *ss = rb->state;
+
+  FILE *f = fopen(path, "wb");
+  if(!f)
+  {
+    log_write(LOG_ERROR, "failed to open ppm file '%s'", path);
+    return -1;
+  }
+
+  fprintf(f, "P6\n%d %d\n255\n", ss->width_px, ss->height_px);
+  unsigned char *rgb = xmalloc(ss->width_px * 3);
+  for(int py = 0; py < ss->height_px; ++py)
+  {
+    const uint32_t *row = ss->color + py * ss->stride_px;
+    for(int px = 0; px < ss->width_px; ++px)
+    {
+      rgb[px * 3 + 0] = row[px] & 0xff;
+      rgb[px * 3 + 1] = (row[px] >> 8) & 0xff;
+      rgb[px * 3 + 2] = (row[px] >> 16) & 0xff;
+    }
+    fwrite(rgb, 3, ss->width_px, f);
+  }
+  free(rgb);
+
+  if(fclose(f))
+  {
+    log_write(LOG_ERROR, "failed to write ppm file '%s'", path);
+    return -1;
+  }
+  return 0;
+}
+
+void
+render_soft_init(struct render_backend *rb, int width_px, int height_px)
+{
+  assert(rb != NULL && width_px > 0 && height_px > 0);
+
+  struct soft_state *ss = xmalloc(sizeof(struct soft_state));
+  memset(ss, 0, sizeof(struct soft_state));
+
+  ss->clear_color = pack_rgb(0.f, 0.f, 0.f);
+  allocate_framebuffer(ss, width_px, height_px);
+
+  ss->prim_capacity = 4096;
+  ss->prims = xmalloc(sizeof(struct primitive) * ss->prim_capacity);
+
+  rb->name = "soft";
+  rb->resize = soft_resize;
+  rb->draw = soft_draw;
+  rb->present = soft_present;
+  rb->set_vsync = soft_set_vsync;
+  rb->write_ppm = soft_write_ppm;
+  rb->quit = soft_quit;
+  rb->state = ss;
+}
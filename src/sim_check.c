@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "util/clock.h"
+#include "util/log.h"
+#include "util/memory.h"
+#include "spaceship.h"
+#include "spaceship_camera.h"
+#include "input.h"
+#include "golden.h"
+
+/*
+ * Determinism check of the simulation; replays recorded input scenarios
+ * through the fixed-step simulation, without rendering, and compares the
+ * snapshots of its state with the scenarios' golden files.
+ *
+ * usage: simcheck [--update] [--tolerance[=T]] [--interval=N] SCENARIO...
+ *
+ * A scenario is an input recording (see input.h, and --record of the game);
+ * its golden file is beside it, named as the scenario with the extension
+ * .golden. --update rewrites the golden files from this build, e.g. after an
+ * intended change in behaviour. Exits with failure if any scenario diverges.
+ */
+
+#define ARENA_BYTES (64u << 20)
+
+static void
+usage()
+{
+  fprintf(stderr,
+          "usage: simcheck [--update] [--tolerance[=T]] [--interval=N] SCENARIO...\n"
+          "  --update        write the scenarios' golden files rather than check them\n"
+          "  --tolerance[=T] compare within a relative tolerance (default %g), not exactly\n"
+          "  --interval=N    snapshot every N ticks (default %d)\n",
+          GOLDEN_TOLERANCE,
+          GOLDEN_INTERVAL_TICKS);
+  exit(EXIT_FAILURE);
+}
+
+/* golden_path - the scenario's path with its extension replaced by .golden. */
+static void
+golden_path(const char *scenario, char *path, size_t size)
+{
+  const char *slash = strrchr(scenario, '/');
+  const char *dot = strrchr(scenario, '.');
+  int stem = (dot && (!slash || dot > slash)) ? (int)(dot - scenario) : (int)strlen(scenario);
+  snprintf(path, size, "%.*s.golden", stem, scenario);
+}
+
+/* simulate - replays the scenario from the game's start, snapshotting the ship
+ * and its chase camera.
+ *
+ * returns - false if the scenario can't be read.
+ */
+static bool
+simulate(const char *scenario, int interval, struct golden_run *run, struct arena *arena)
+{
+  struct input_player player;
+  if(!input_player_open(&player, scenario, arena))
+    return false;
+
+  /* as the game starts the ship in run() */
+  struct spaceship ship;
+  spaceship_init(&ship,
+                 (struct vector4f){0.f, 0.f, 0.f, 1.f},
+                 (struct vector4f){0.f, 0.f, -1.f, 1.f},
+                 (struct vector4f){0.f, 1.f, 0.f, 0.f});
+  struct spaceship_camera camera;
+  shipcam_init(&camera, &ship, arena);
+
+  golden_run_init(run, interval, (int)player.ticks, arena);
+  struct tick_command command;
+  for(int tick = 0; input_player_command(&player, (uint32_t)tick, &command); )
+  {
+    tick_command_apply(&command, &ship);
+    spaceship_tick(&ship);
+    shipcam_tick(&camera);
+    golden_capture(run, ++tick, &ship, &camera);
+  }
+  return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+  bool update = false;
+  float tolerance = 0.f;
+  int interval = GOLDEN_INTERVAL_TICKS;
+  int first_scenario = argc;
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strcmp(argv[i], "--update") == 0)
+      update = true;
+    else if(strcmp(argv[i], "--tolerance") == 0)
+      tolerance = GOLDEN_TOLERANCE;
+    else if(strncmp(argv[i], "--tolerance=", 12) == 0)
+      tolerance = (float)atof(argv[i] + 12);
+    else if(strncmp(argv[i], "--interval=", 11) == 0)
+      interval = atoi(argv[i] + 11);
+    else if(strncmp(argv[i], "--", 2) == 0)
+      usage();
+    else
+    {
+      first_scenario = i;
+      break;
+    }
+  }
+  if(first_scenario == argc || interval < 1 || tolerance < 0.f)
+    usage();
+
+  log_init();
+  clock_timestamp_init();
+
+  struct arena arena;
+  arena_init(&arena, "simcheck", ARENA_BYTES, 0);
+
+  int failures = 0;
+  for(int i = first_scenario; i < argc; ++i)
+  {
+    const char *scenario = argv[i];
+    char path[1024];
+    golden_path(scenario, path, sizeof(path));
+    arena_mark mark = arena_get_mark(&arena);
+
+    struct golden_run run, golden;
+    if(!simulate(scenario, interval, &run, &arena))
+    {
+      printf("%s: FAIL, can't read the scenario; see log\n", scenario);
+      ++failures;
+    }
+    else if(update)
+    {
+      bool ok = golden_write(&run, path, scenario);
+      printf("%s: %s %d snapshots to %s\n", scenario, ok ? "wrote" : "FAIL, can't write", run.count, path);
+      failures += !ok;
+    }
+    else if(!golden_read(&golden, path, &arena))
+    {
+      printf("%s: FAIL, can't read the golden file %s; see log\n", scenario, path);
+      ++failures;
+    }
+    else
+    {
+      struct golden_diff diff;
+      if(golden_compare(&golden, &run, tolerance, &diff))
+      {
+        printf("%s: ok, %d snapshots match %s\n", scenario, run.count, tolerance ? "within tolerance" : "exactly");
+      }
+      else if(golden.interval != run.interval)
+      {
+        printf("%s: FAIL, golden snapshots are every %d ticks, not %d\n", scenario, golden.interval, run.interval);
+        ++failures;
+      }
+      else if(diff.field == GOLDEN_FIELD_COUNT)
+      {
+        printf("%s: FAIL, diverged at tick %d: %d snapshots, golden has %d\n",
+               scenario, diff.tick, run.count, golden.count);
+        ++failures;
+      }
+      else
+      {
+        printf("%s: FAIL, diverged at tick %d: %s[%d] is %a (%.9g), golden %a (%.9g)\n",
+               scenario,
+               diff.tick,
+               golden_field_name(diff.field),
+               diff.component,
+               diff.actual,
+               diff.actual,
+               diff.expected,
+               diff.expected);
+        ++failures;
+      }
+    }
+    arena_release(&arena, mark);
+  }
+
+  arena_free(&arena);
+  log_quit();
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
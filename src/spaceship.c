@@ -6,6 +6,8 @@
 #include "config.h"
 #include "math/matrix44f.h"
 #include "math/vector4f.h"
+#include "util/log.h"
+#include "util/trace.h"
 
 #include "spaceship.h"
 
@@ -94,6 +96,8 @@ spaceship_init(struct spaceship *sh,
 void
 spaceship_tick(struct spaceship *sh)
 {
+  TRACE_ZONE("spaceship_tick");
+
   bool roll_change = false, pitch_change = false;
 
   /* tick roll magnitude */
@@ -231,5 +235,20 @@ spaceship_tick(struct spaceship *sh)
   sh->vpos_w_m = add4fv(sh->vpos_w_m, scale4fv(sh->front, sh->pos_w_m_p_s));
 
   recalculate_model_world(sh);
+
+  LOGF_DEBUG_RATE(1,
+                  "ship: pos=(%.1f, %.1f, %.1f) speed=%.2f m/s roll=%.1f pitch=%.1f dg/s",
+                  sh->vpos_w_m.x,
+                  sh->vpos_w_m.y,
+                  sh->vpos_w_m.z,
+                  sh->pos_w_m_p_s,
+                  sh->roll_dg_p_s,
+                  sh->pitch_dg_p_s);
 }
 
+void
+spaceship_rebase(struct spaceship *sh, struct vector4f shift)
+{
+  sh->vpos_w_m = add4fv(sh->vpos_w_m, shift);
+  recalculate_model_world(sh);
+}
@@ -66,6 +66,11 @@ spaceship_init(struct spaceship *sh,
 void
 spaceship_tick(struct spaceship *sh);
 
+/* spaceship_rebase - adds 'shift' to the ship's position, e.g. when the
+ *   floating origin is rebased. */
+void
+spaceship_rebase(struct spaceship *sh, struct vector4f shift);
+
 static inline void
 spaceship_roll(struct spaceship *sh, enum rotation r){sh->rolling = r;}
 
@@ -7,74 +7,104 @@
 
 #include "config.h"
 #include "util/system.h"
+#include "util/trace.h"
 #include "math/mathutil.h"
 #include "spaceship.h"
 #include "spaceship_camera.h"
 
-/* stores a new target MW in the history and returns the new oldest record;
-   shallow copies the new_MW into the history */
-static struct matrix44f *
-record_mw(struct spaceship_camera *cam, struct matrix44f *mw)
+void
+shipcam_init(struct spaceship_camera *cam, struct spaceship *target, struct arena *arena)
 {
-  struct matrix44f *temp;
-
-  /* temp pointer to the last record; is about to be shifted off the end */
-  temp = cam->mw_history[SHIP_MW_HISTORY_SIZE - 1];
-
-  /* shift all records, freeing up element 0 for the new MW */
-  for(int i = SHIP_MW_HISTORY_SIZE - 1; i >= 1; --i)
-    cam->mw_history[i] = cam->mw_history[i - 1]; 
-
-  memcpy((void *)temp, (void *)mw, sizeof(struct matrix44f));
-  cam->mw_history[0] = temp;
-
-  if(cam->oldest_mw < SHIP_MW_HISTORY_SIZE - 1)
-    cam->oldest_mw++;
-
-  return cam->mw_history[cam->oldest_mw];
+  cam->target = target;
+  cam->mode = SHIPCAM_CHASE;
+  cam->time_s = 0.0;
+  cam->delay_s = FOLLOW_DELAY_S;
+  cam->spectator_w_m = (struct vector4f){SHIPCAM_SPECTATOR_X_M, 
+                                         SHIPCAM_SPECTATOR_Y_M, 
+                                         SHIPCAM_SPECTATOR_Z_M, 
+                                         1.f};
+
+  /* +2 as the sample at the max delay interpolates between the 2 poses either
+     side of it */
+  pose_history_init(&cam->history, (int)ceil(SHIPCAM_MAX_DELAY_S / TICK_DELTA_S) + 2, arena);
 }
 
 void
-shipcam_init(struct spaceship_camera *cam, struct spaceship *target)
+shipcam_set_delay(struct spaceship_camera *cam, double delay_s)
 {
-  cam->target = target;
-  cam->oldest_mw = -1;
-
-  for(int i = 0; i < SHIP_MW_HISTORY_SIZE; ++i)
-    cam->mw_history[i] = xmalloc(sizeof(struct matrix44f));
+  cam->delay_s = fmax(0.0, fmin(delay_s, SHIPCAM_MAX_DELAY_S));
 }
 
 void
-shipcam_free(struct spaceship_camera *cam)
+shipcam_rebase(struct spaceship_camera *cam, struct vector4f shift)
+{
+  pose_history_rebase(&cam->history, shift);
+  cam->spectator_w_m = add4fv(cam->spectator_w_m, shift);
+}
+
+/* view_at - builds the camera's world-view matrix viewing the target as it was
+ * at 'sample_s' on the camera's tick time. */
+static void
+view_at(struct spaceship_camera *cam, double sample_s)
 {
-  for(int i = 0; i < SHIP_MW_HISTORY_SIZE; ++i)
+  struct vector4f eye_w_m, I, J, K;
+  struct matrix44f mw;
+  struct pose pose;
+
+  pose_history_sample(&cam->history, sample_s, &pose);
+  pose_mw(&pose, &mw);
+
+  switch(cam->mode)
   {
-    free(cam->mw_history[i]);
-    cam->mw_history[i] = NULL;
+  case SHIPCAM_CHASE:
+    /* compute the eye position w.r.t world space */
+    eye_w_m = multiply44fm(&mw, 
+                           (struct vector4f){0.f, 
+                                             SHIPCAM_VIEW_HEIGHT_M, 
+                                             SHIPCAM_MIN_VIEW_DISTANCE_M, 
+                                             1.f});
+
+    /* compute the view space unit basis vectors w.r.t world space */
+    I = multiply44fm(&mw, (struct vector4f){1.f, 0.f, 0.f, 0.f});
+    J = multiply44fm(&mw, (struct vector4f){0.f, 1.f, 0.f, 0.f});
+    K = multiply44fm(&mw, (struct vector4f){0.f, 0.f, 1.f, 0.f});
+    break;
+  case SHIPCAM_MIRROR:
+    /* the ship's basis turned about its y-axis to look back */
+    eye_w_m = multiply44fm(&mw, (struct vector4f){0.f, SHIPCAM_MIRROR_HEIGHT_M, 0.f, 1.f});
+    I = multiply44fm(&mw, (struct vector4f){-1.f, 0.f, 0.f, 0.f});
+    J = multiply44fm(&mw, (struct vector4f){0.f, 1.f, 0.f, 0.f});
+    K = multiply44fm(&mw, (struct vector4f){0.f, 0.f, -1.f, 0.f});
+    break;
+  case SHIPCAM_SPECTATOR:
+    /* view space looks down (-)z, thus K points from the ship to the eye */
+    eye_w_m = cam->spectator_w_m;
+    K = normalise4fv(sub4fv(pose.pos_w_m, eye_w_m)); /* eye - ship */
+    I = normalise4fv(cross4fv((struct vector4f){0.f, 1.f, 0.f, 0.f}, K));
+    J = cross4fv(K, I);
+    break;
   }
+
+  /* construct the world-to-view matrix */
+  worldview44fm(I, J, K, eye_w_m, &(cam->wv));
 }
 
 /* should be updated after the target ship */
 void
 shipcam_tick(struct spaceship_camera *cam)
 {
-  struct vector4f eye_w_m, I, J, K;
-  struct matrix44f *mw;
-
-  mw = record_mw(cam, &(cam->target->mw));
+  TRACE_ZONE("shipcam_tick");
 
-  /* compute the eye position w.r.t world space */
-  eye_w_m = multiply44fm(mw, 
-                         (struct vector4f){0.f, 
-                                           SHIPCAM_VIEW_HEIGHT_M, 
-                                           SHIPCAM_MIN_VIEW_DISTANCE_M, 
-                                           1.f});
-
-  /* compute the view space unit basis vectors w.r.t world space */
-  I = multiply44fm(mw, (struct vector4f){1.f, 0.f, 0.f, 0.f});
-  J = multiply44fm(mw, (struct vector4f){0.f, 1.f, 0.f, 0.f});
-  K = multiply44fm(mw, (struct vector4f){0.f, 0.f, 1.f, 0.f});
+  cam->time_s += TICK_DELTA_S;
+  pose_history_push(&cam->history, cam->time_s, &(cam->target->mw));
+  view_at(cam, cam->time_s - cam->delay_s);
+}
 
-  /* construct the world-to-view matrix */
-  worldview44fm(I, J, K, eye_w_m, &(cam->wv));
+void
+shipcam_frame(struct spaceship_camera *cam, double since_tick_s)
+{
+  /* the newest pose is the latest there is; a camera without delay views it
+     as the target is drawn */
+  double sample_s = cam->time_s + since_tick_s - cam->delay_s;
+  view_at(cam, sample_s < cam->time_s ? sample_s : cam->time_s);
 }
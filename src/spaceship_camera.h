@@ -3,29 +3,66 @@
 
 #include "config.h"
 #include "math/matrix44f.h"
+#include "pose_history.h"
 
 struct spaceship;
 
+/* how the camera views its target:
+ *   chase - from behind and above, looking where the ship is headed.
+ *   mirror - from the ship, looking back; a rear-view mirror.
+ *   spectator - from a fixed point in the world, looking at the ship. */
+enum shipcam_mode {SHIPCAM_CHASE = 0, SHIPCAM_MIRROR, SHIPCAM_SPECTATOR};
+
 struct spaceship_camera
 {
   /* the spaceship being followed */
   struct spaceship *target; 
 
+  enum shipcam_mode mode;
+
   /* the world-view matrix of the camera */
   struct matrix44f wv; 
 
-  /* history of model-world matrices (MW) of the target for the last FOLLW_DELAY_S seconds, used 
-     to implement the movement effects. The most recent mw is stored at array position 0, the 
-     oldest at array position 'oldest_record' */
-  int oldest_mw; 
-  struct matrix44f *mw_history[SHIP_MW_HISTORY_SIZE];
+  /* the camera views the target as it was 'delay_s' ago; the lag makes the
+     ship's movement visible. Poses of the target are recorded each tick at
+     the camera's tick time 'time_s'. */
+  double delay_s;
+  double time_s;
+  struct pose_history history;
+
+  /* the eye of the spectator */
+  struct vector4f spectator_w_m;
 };
 
+/* shipcam_init - the camera's history of the target's poses is allocated from
+ *   the arena, and freed with it. */
+void
+shipcam_init(struct spaceship_camera *cam, struct spaceship *target, struct arena *arena);
+
+/* shipcam_set_mode - sets how the camera views its target; defaults to chase. */
+static inline void
+shipcam_set_mode(struct spaceship_camera *cam, enum shipcam_mode mode){cam->mode = mode;}
+
+/* shipcam_set_delay - sets the follow delay; clamped to [0, SHIPCAM_MAX_DELAY_S]. */
+void
+shipcam_set_delay(struct spaceship_camera *cam, double delay_s);
+
+/* shipcam_rebase - adds 'shift' to the camera's positions; call with the
+ *   target's spaceship_rebase, between ticks. */
 void
-shipcam_init(struct spaceship_camera *cam, struct spaceship *target);
+shipcam_rebase(struct spaceship_camera *cam, struct vector4f shift);
 
-/* should be ticked after the ship */
+/* should be ticked after the ship; records the ship's pose and views it as at
+   the tick */
 void
 shipcam_tick(struct spaceship_camera *cam);
 
+/* shipcam_frame - views the target for a frame drawn 'since_tick_s' after the
+ *   camera's last tick. The target is sampled at that time less the delay,
+ *   interpolated between the recorded poses, so a delayed camera moves
+ *   smoothly at any frame rate rather than in tick steps; a sample newer than
+ *   the last tick is the last tick's pose. */
+void
+shipcam_frame(struct spaceship_camera *cam, double since_tick_s);
+
 #endif
@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "util/system.h"
+#include "util/log.h"
+#include "telemetry.h"
+
+static const char *field_names[TELEMETRY_FIELD_COUNT] = {
+  "frame_ms", "ticks", "dropped_ms", "events_ms", "sim_ms", "render_ms", "swap_ms", "overload_level",
+  "game_events", "drain_ms"
+};
+
+static float
+field_value(const struct frame_record *r, enum telemetry_field field)
+{
+  switch(field)
+  {
+  case TELEMETRY_FRAME_MS: return r->frame_ms;
+  case TELEMETRY_TICKS: return (float)r->ticks;
+  case TELEMETRY_DROPPED_MS: return r->dropped_ms;
+  case TELEMETRY_EVENTS_MS: return r->events_ms;
+  case TELEMETRY_SIM_MS: return r->sim_ms;
+  case TELEMETRY_RENDER_MS: return r->render_ms;
+  case TELEMETRY_SWAP_MS: return r->swap_ms;
+  case TELEMETRY_OVERLOAD_LEVEL: return (float)r->overload_level;
+  case TELEMETRY_GAME_EVENTS: return (float)r->game_events;
+  case TELEMETRY_DRAIN_MS: return r->drain_ms;
+  default: assert(0); return 0.f;
+  }
+}
+
+/* the i'th oldest record held */
+static inline const struct frame_record *
+at(const struct telemetry *t, int i)
+{
+  int index = t->next - t->count + i;
+  if(index < 0)
+    index += t->capacity;
+  return &t->records[index];
+}
+
+void
+telemetry_init(struct telemetry *t, int capacity)
+{
+  assert(capacity > 0);
+  t->capacity = capacity;
+  t->count = 0;
+  t->next = 0;
+  t->frames = 0;
+  t->records = xmalloc(sizeof(struct frame_record) * capacity);
+  t->scratch = xmalloc(sizeof(float) * capacity);
+}
+
+void
+telemetry_free(struct telemetry *t)
+{
+  free(t->records);
+  free(t->scratch);
+  t->records = NULL;
+  t->scratch = NULL;
+  t->count = 0;
+}
+
+void
+telemetry_record(struct telemetry *t, const struct frame_record *record)
+{
+  struct frame_record *r = &t->records[t->next];
+  *r = *record;
+  r->frame = t->frames++;
+  if(++t->next == t->capacity)
+    t->next = 0;
+  if(t->count < t->capacity)
+    ++t->count;
+}
+
+/* quickselect - hoare's selection; partially orders 'v' such that v[k] is the
+ * k'th smallest, all before it are <= and all after are >=. In place. */
+static void
+quickselect(float *v, int n, int k)
+{
+  int lo = 0, hi = n - 1;
+  while(lo < hi)
+  {
+    float pivot = v[lo + (hi - lo) / 2];
+    int i = lo, j = hi;
+    while(i <= j)
+    {
+      while(v[i] < pivot)
+        ++i;
+      while(v[j] > pivot)
+        --j;
+      if(i <= j)
+      {
+        float tmp = v[i];
+        v[i++] = v[j];
+        v[j--] = tmp;
+      }
+    }
+    if(k <= j)
+      hi = j;
+    else if(k >= i)
+      lo = i;
+    else
+      return;
+  }
+}
+
+/* nearest rank of percentile 'p' of 'n' values */
+static inline int
+rank(int n, float p)
+{
+  return (int)(p * (float)(n - 1) + 0.5f);
+}
+
+void
+telemetry_stats(struct telemetry *t, enum telemetry_field field, struct telemetry_stats *out)
+{
+  memset(out, 0, sizeof(struct telemetry_stats));
+  if(t->count == 0)
+    return;
+
+  float *v = t->scratch;
+  int n = t->count;
+  for(int i = 0; i < n; ++i)
+  {
+    v[i] = field_value(at(t, i), field);
+    if(v[i] > out->max)
+      out->max = v[i];
+  }
+
+  /* each selection leaves all values above the rank after it, thus each higher
+     percentile need only search what remains above the last */
+  int k50 = rank(n, 0.50f), k95 = rank(n, 0.95f), k99 = rank(n, 0.99f);
+  quickselect(v, n, k50);
+  out->p50 = v[k50];
+  quickselect(v + k50, n - k50, k95 - k50);
+  out->p95 = v[k95];
+  quickselect(v + k95, n - k95, k99 - k95);
+  out->p99 = v[k99];
+}
+
+void
+telemetry_log_report(struct telemetry *t)
+{
+  static const enum telemetry_field fields[] = {
+    TELEMETRY_FRAME_MS, TELEMETRY_SIM_MS, TELEMETRY_RENDER_MS, TELEMETRY_SWAP_MS, TELEMETRY_TICKS
+  };
+
+  struct telemetry_stats stats;
+  for(int i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); ++i)
+  {
+    telemetry_stats(t, fields[i], &stats);
+    log_write(LOG_INFO, 
+              "telemetry: %-9s p50=%.3f p95=%.3f p99=%.3f max=%.3f (last %d frames)", 
+              field_names[fields[i]],
+              stats.p50,
+              stats.p95,
+              stats.p99,
+              stats.max,
+              t->count);
+  }
+
+  float dropped_ms = 0.f;
+  for(int i = 0; i < t->count; ++i)
+    dropped_ms += at(t, i)->dropped_ms;
+  if(dropped_ms > 0.f)
+    log_write(LOG_WARNING, "telemetry: dropped %.1f ms of sim time (last %d frames)", dropped_ms, t->count);
+}
+
+static bool
+ends_with(const char *s, const char *suffix)
+{
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+int
+telemetry_write(struct telemetry *t, const char *path)
+{
+  FILE *f = fopen(path, "w");
+  if(!f)
+  {
+    log_write(LOG_ERROR, "failed to open telemetry file '%s'", path);
+    return -1;
+  }
+
+  bool json = ends_with(path, ".json");
+  if(json)
+    fprintf(f, "{\"frames\": [\n");
+  else
+    fprintf(f, "frame,frame_ms,ticks,dropped_ms,events_ms,sim_ms,render_ms,swap_ms,overload_level,game_events,drain_ms\n");
+
+  for(int i = 0; i < t->count; ++i)
+  {
+    const struct frame_record *r = at(t, i);
+    if(json)
+    {
+      fprintf(f, 
+              "  {\"frame\": %llu, \"frame_ms\": %.4f, \"ticks\": %d, \"dropped_ms\": %.4f, "
+              "\"events_ms\": %.4f, \"sim_ms\": %.4f, \"render_ms\": %.4f, \"swap_ms\": %.4f, "
+              "\"overload_level\": %d, \"game_events\": %d, \"drain_ms\": %.4f}%s\n",
+              (unsigned long long)r->frame, r->frame_ms, r->ticks, r->dropped_ms,
+              r->events_ms, r->sim_ms, r->render_ms, r->swap_ms, r->overload_level,
+              r->game_events, r->drain_ms,
+              (i + 1 < t->count) ? "," : "");
+    }
+    else
+    {
+      fprintf(f, 
+              "%llu,%.4f,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d,%.4f\n",
+              (unsigned long long)r->frame, r->frame_ms, r->ticks, r->dropped_ms,
+              r->events_ms, r->sim_ms, r->render_ms, r->swap_ms, r->overload_level,
+              r->game_events, r->drain_ms);
+    }
+  }
+
+  if(json)
+  {
+    fprintf(f, "],\n\"stats\": {");
+    struct telemetry_stats stats;
+    for(int field = 0; field < TELEMETRY_FIELD_COUNT; ++field)
+    {
+      telemetry_stats(t, field, &stats);
+      fprintf(f, 
+              "%s\n  \"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+              field ? "," : "",
+              field_names[field], stats.p50, stats.p95, stats.p99, stats.max);
+    }
+    fprintf(f, "\n}}\n");
+  }
+
+  if(fclose(f))
+  {
+    log_write(LOG_ERROR, "failed to write telemetry file '%s'", path);
+    return -1;
+  }
+  log_write(LOG_INFO, "wrote %d frames of telemetry to '%s'", t->count, path);
+  return 0;
+}
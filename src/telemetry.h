@@ -0,0 +1,89 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+/* what happened in one frame of the game loop; times in milliseconds */
+struct frame_record
+{
+  uint64_t frame;    /* frame number, from 0 */
+  float frame_ms;    /* time since the previous frame was presented */
+  int ticks;         /* game ticks run to catch up to real time */
+  float dropped_ms;  /* real time not simulated as the tick limit was hit */
+  float events_ms;
+  float sim_ms;
+  float render_ms;
+  float swap_ms;
+  int overload_level; /* levels of detail shed by the overload governor */
+  int game_events;   /* gameplay events delivered by the event bus */
+  float drain_ms;    /* time delivering them */
+};
+
+/* the fields of a frame record percentiles can be taken of */
+enum telemetry_field
+{
+  TELEMETRY_FRAME_MS = 0,
+  TELEMETRY_TICKS,
+  TELEMETRY_DROPPED_MS,
+  TELEMETRY_EVENTS_MS,
+  TELEMETRY_SIM_MS,
+  TELEMETRY_RENDER_MS,
+  TELEMETRY_SWAP_MS,
+  TELEMETRY_OVERLOAD_LEVEL,
+  TELEMETRY_GAME_EVENTS,
+  TELEMETRY_DRAIN_MS,
+  TELEMETRY_FIELD_COUNT
+};
+
+struct telemetry_stats
+{
+  float p50;
+  float p95;
+  float p99;
+  float max;
+};
+
+/* a ring buffer of the most recent frame records; once full each record
+ * overwrites the oldest. All memory is allocated by telemetry_init, thus
+ * recording never allocates and can be left on in production. */
+struct telemetry
+{
+  int capacity;
+  int count;
+  int next;         /* index the next record is written to */
+  uint64_t frames;  /* total frames recorded */
+  struct frame_record *records;
+  float *scratch;   /* workspace for the percentiles; capacity floats */
+};
+
+void
+telemetry_init(struct telemetry *t, int capacity);
+
+void
+telemetry_free(struct telemetry *t);
+
+/* telemetry_record - records a frame in O(1); the record's frame number is set
+ * by the telemetry. */
+void
+telemetry_record(struct telemetry *t, const struct frame_record *record);
+
+/* telemetry_stats - percentiles and max of 'field' over the records held,
+ *   i.e. over the last 'capacity' frames; zeros if there are no records.
+ *   Does not allocate; O(capacity) expected.
+ */
+void
+telemetry_stats(struct telemetry *t, enum telemetry_field field, struct telemetry_stats *out);
+
+/* telemetry_log_report - logs the stats of the frame, tick and phase times. */
+void
+telemetry_log_report(struct telemetry *t);
+
+/* telemetry_write - writes the records held, oldest first, to a file; JSON if
+ *   the path ends in '.json', else CSV with a header row.
+ *
+ * returns - 0 on success, non-zero on error; errors logged to log file.
+ */
+int
+telemetry_write(struct telemetry *t, const char *path);
+
+#endif
@@ -0,0 +1,288 @@
+#ifdef ALLOC_TRACKING
+
+#define _GNU_SOURCE /* dladdr */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+
+#include "log.h"
+#include "alloc_track.h"
+
+/* most subsystems and call sites counted; the rest are counted as one */
+#define MAX_TAGS 16
+#define MAX_SITES 256
+
+/* most call sites of steady state allocations logged */
+#define REPORT_SITES 10
+
+struct tag_counts
+{
+  const char *tag;
+  long allocs;
+  long frees;
+  long bytes;
+  long steady_allocs; /* allocations in the steady state */
+};
+
+/* the place an allocation was made from; the caller of the allocation
+   function and its caller, since the first is often just xmalloc */
+struct site_counts
+{
+  void *caller[2];
+  const char *tag;
+  long allocs;
+  long steady_allocs;
+};
+
+static struct
+{
+  int lock;                  /* spin lock over all below */
+  struct tag_counts tags[MAX_TAGS];
+  int tag_count;
+  struct site_counts sites[MAX_SITES];
+  int site_count;
+
+  bool is_steady;
+  int frame;                 /* frames ended */
+  long frame_allocs;         /* allocations of the current frame */
+  long frame_bytes;
+  long steady_frames;        /* steady state frames which allocated */
+  long max_frame_allocs;     /* most allocations of a steady state frame */
+} counts;
+
+static __thread const char *thread_tag = "untagged";
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__real_aligned_alloc(size_t align, size_t size);
+void __real_free(void *p);
+
+static inline void
+lock()
+{
+  while(__atomic_exchange_n(&counts.lock, 1, __ATOMIC_ACQUIRE))
+    while(__atomic_load_n(&counts.lock, __ATOMIC_RELAXED))
+      ;
+}
+
+static inline void
+unlock()
+{
+  __atomic_store_n(&counts.lock, 0, __ATOMIC_RELEASE);
+}
+
+static struct tag_counts *
+find_tag(const char *tag)
+{
+  for(int i = 0; i < counts.tag_count; ++i)
+    if(counts.tags[i].tag == tag)
+      return &counts.tags[i];
+  if(counts.tag_count < MAX_TAGS)
+  {
+    struct tag_counts *t = &counts.tags[counts.tag_count++];
+    t->tag = tag;
+    return t;
+  }
+  return &counts.tags[MAX_TAGS - 1];
+}
+
+static struct site_counts *
+find_site(void *caller[2])
+{
+  for(int i = 0; i < counts.site_count; ++i)
+    if(counts.sites[i].caller[0] == caller[0] && counts.sites[i].caller[1] == caller[1])
+      return &counts.sites[i];
+  if(counts.site_count < MAX_SITES)
+  {
+    struct site_counts *s = &counts.sites[counts.site_count++];
+    s->caller[0] = caller[0];
+    s->caller[1] = caller[1];
+    s->tag = thread_tag;
+    return s;
+  }
+  return &counts.sites[MAX_SITES - 1];
+}
+
+/* note - counts an allocation; frames [0] and [1] of the backtrace are this
+ * and the wrapper, [2] and [3] the call site. */
+static void
+note(size_t size)
+{
+  void *frames[4] = {0};
+  int depth = backtrace(frames, 4);
+  void *caller[2] = {depth > 2 ? frames[2] : NULL, depth > 3 ? frames[3] : NULL};
+
+  lock();
+  struct tag_counts *t = find_tag(thread_tag);
+  struct site_counts *s = find_site(caller);
+  ++t->allocs;
+  t->bytes += size;
+  ++s->allocs;
+  ++counts.frame_allocs;
+  counts.frame_bytes += size;
+  if(counts.is_steady)
+  {
+    ++t->steady_allocs;
+    ++s->steady_allocs;
+  }
+  unlock();
+}
+
+static void
+note_free()
+{
+  lock();
+  ++find_tag(thread_tag)->frees;
+  unlock();
+}
+
+void *
+__wrap_malloc(size_t size)
+{
+  note(size);
+  return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t count, size_t size)
+{
+  note(count * size);
+  return __real_calloc(count, size);
+}
+
+void *
+__wrap_realloc(void *p, size_t size)
+{
+  note(size);
+  return __real_realloc(p, size);
+}
+
+void *
+__wrap_aligned_alloc(size_t align, size_t size)
+{
+  note(size);
+  return __real_aligned_alloc(align, size);
+}
+
+void
+__wrap_free(void *p)
+{
+  if(p)
+    note_free();
+  __real_free(p);
+}
+
+void
+alloc_track_init()
+{
+  void *frames[4];
+  backtrace(frames, 4);
+}
+
+const char *
+alloc_track_tag(const char *tag)
+{
+  const char *previous = thread_tag;
+  thread_tag = tag;
+  return previous;
+}
+
+int
+alloc_track_frame_end(int warmup_frames)
+{
+  lock();
+  int frame = counts.frame++;
+  long allocs = counts.frame_allocs, bytes = counts.frame_bytes;
+  bool was_steady = counts.is_steady;
+  counts.frame_allocs = counts.frame_bytes = 0;
+  if(was_steady && allocs > 0)
+  {
+    ++counts.steady_frames;
+    if(allocs > counts.max_frame_allocs)
+      counts.max_frame_allocs = allocs;
+  }
+  counts.is_steady = counts.frame >= warmup_frames;
+  unlock();
+
+  if(was_steady && allocs > 0)
+    LOGF_WARNING_RATE(1, "frame %d: %ld allocations (%ld bytes) in the steady state", frame, allocs, bytes);
+  return (int)allocs;
+}
+
+static void
+log_caller(const char *what, void *address)
+{
+  Dl_info info;
+  if(address && dladdr(address, &info) && info.dli_fname)
+  {
+    uintptr_t offset = (uintptr_t)address - (uintptr_t)info.dli_fbase;
+    if(info.dli_sname)
+      log_write(LOG_INFO, "    %s %s+0x%lx (%s+0x%lx)", what, info.dli_fname, (unsigned long)offset,
+                info.dli_sname, (unsigned long)((uintptr_t)address - (uintptr_t)info.dli_saddr));
+    else
+      log_write(LOG_INFO, "    %s %s+0x%lx", what, info.dli_fname, (unsigned long)offset);
+  }
+  else
+    log_write(LOG_INFO, "    %s %p", what, address);
+}
+
+long
+alloc_track_report()
+{
+  lock();
+  struct tag_counts tags[MAX_TAGS];
+  struct site_counts sites[MAX_SITES];
+  int tag_count = counts.tag_count, site_count = counts.site_count;
+  memcpy(tags, counts.tags, sizeof(tags));
+  memcpy(sites, counts.sites, sizeof(sites));
+  long steady_frames = counts.steady_frames, max_frame_allocs = counts.max_frame_allocs;
+  int frames = counts.frame;
+  unlock();
+
+  long steady = 0;
+  for(int i = 0; i < tag_count; ++i)
+  {
+    log_write(LOG_INFO, 
+              "allocations: %-10s allocs=%ld frees=%ld bytes=%ld steady-state allocs=%ld",
+              tags[i].tag,
+              tags[i].allocs,
+              tags[i].frees,
+              tags[i].bytes,
+              tags[i].steady_allocs);
+    steady += tags[i].steady_allocs;
+  }
+
+  if(steady == 0)
+  {
+    log_write(LOG_INFO, "allocations: none in the steady state (%d frames)", frames);
+    return 0;
+  }
+
+  log_write(LOG_WARNING, 
+            "allocations: %ld in the steady state, in %ld of %d frames, at most %ld a frame",
+            steady, steady_frames, frames, max_frame_allocs);
+
+  /* the sites with the most steady state allocations; resolve the module
+     offsets with addr2line -f -e <module> <offset> */
+  for(int r = 0; r < REPORT_SITES; ++r)
+  {
+    int best = -1;
+    for(int i = 0; i < site_count; ++i)
+      if(sites[i].steady_allocs > 0 && (best < 0 || sites[i].steady_allocs > sites[best].steady_allocs))
+        best = i;
+    if(best < 0)
+      break;
+    log_write(LOG_WARNING, 
+              "  %ld steady-state allocations (%ld in all) in subsystem %s from:",
+              sites[best].steady_allocs, sites[best].allocs, sites[best].tag);
+    log_caller("at", sites[best].caller[0]);
+    log_caller("by", sites[best].caller[1]);
+    sites[best].steady_allocs = 0;
+  }
+  return steady;
+}
+
+#endif
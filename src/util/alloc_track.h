@@ -0,0 +1,74 @@
+#ifndef _ALLOC_TRACK_H_
+#define _ALLOC_TRACK_H_
+
+/*
+ * Allocation accounting; counts the calls to malloc, calloc, realloc,
+ * aligned_alloc and free made by the game's code, per frame, per subsystem and
+ * per call site, and finds allocations made in the steady state of the game
+ * loop, i.e. once it has warmed up.
+ *
+ * Only compiled in if ALLOC_TRACKING is defined, and the program is linked
+ * with --wrap for each of the functions (see the makefile's 'alloccheck'
+ * target); otherwise the macros here expand to nothing. Calls made within
+ * libraries, e.g. by libc's fopen or the gl driver, are not seen.
+ */
+
+#ifdef ALLOC_TRACKING
+
+#include <stdbool.h>
+
+/* alloc_track_init - call before the first frame; warms up the backtraces
+ *   the call sites are found by, which may themselves allocate. */
+void
+alloc_track_init();
+
+/* alloc_track_tag - sets the subsystem the calling thread's allocations are
+ *   counted against; 'tag' must be a literal.
+ *
+ * returns - the previous tag. */
+const char *
+alloc_track_tag(const char *tag);
+
+static inline void
+alloc_track_untag(const char **previous)
+{
+  alloc_track_tag(*previous);
+}
+
+/* alloc_track_frame_end - ends a frame; once 'warmup_frames' frames have ended
+ *   every allocation is counted as one in the steady state. 
+ *
+ * returns - the number of allocations of the frame that ended. */
+int
+alloc_track_frame_end(int warmup_frames);
+
+/* alloc_track_report - logs the allocations per subsystem and the call sites
+ *   of those in the steady state.
+ *
+ * returns - the number of allocations made in the steady state. */
+long
+alloc_track_report();
+
+#define ALLOC_CAT0(a, b) a ## b
+#define ALLOC_CAT1(a, b) ALLOC_CAT0(a, b)
+
+/**
+ * ALLOC_TAG - counts the allocations of the rest of the enclosing block, on
+ *   the calling thread, against the subsystem 'tag', a string literal.
+ */
+#define ALLOC_TAG(tag)                                                   \
+  const char *ALLOC_CAT1(_alloc_tag_, __LINE__)                          \
+    __attribute__((cleanup(alloc_track_untag))) = alloc_track_tag(tag)
+
+#define ALLOC_TRACK_INIT() alloc_track_init()
+#define ALLOC_TRACK_FRAME_END(warmup_frames) alloc_track_frame_end(warmup_frames)
+
+#else
+
+#define ALLOC_TAG(tag) ((void)0)
+#define ALLOC_TRACK_INIT() ((void)0)
+#define ALLOC_TRACK_FRAME_END(warmup_frames) ((void)0)
+
+#endif
+
+#endif
@@ -1,6 +1,21 @@
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 #include "clock.h"
 
+/* duration of the tsc calibration */
+#define CALIBRATION_NS 10000000ull
+
+/* the clocksource the kernel times CLOCK_MONOTONIC with */
+#define CLOCKSOURCE_PATH "/sys/devices/system/clocksource/clocksource0/current_clocksource"
+
+struct tsc_calibration clock_tsc = {false, 0, 0, 0, 0.0};
+
+static const char *phase_names[PHASE_COUNT] = {"events", "sim", "render", "swap"};
+
 static void
 delta(struct timespec *start, struct timespec *end, struct timespec *delta)
 {
@@ -64,3 +79,77 @@ clock_time_s(struct clock *c)
   return (double)c->current.tv_sec + ((double)c->current.tv_nsec * factor_ns_to_s);
 }
 
+/* has_invariant_tsc - cpuid leaf 0x80000007, edx bit 8 */
+static bool
+has_invariant_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned eax, ebx, ecx, edx;
+  if(__get_cpuid_max(0x80000000, NULL) < 0x80000007)
+    return false;
+  if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (edx & (1u << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+/* kernel_uses_tsc - whether the kernel's clocksource is the tsc. An invariant
+ * tsc only ticks at a constant rate; the kernel also checks the cores' tscs
+ * are in sync, at boot and as cpus come online, and its watchdog checks the
+ * rate holds, and only keeps the tsc as its clocksource if they pass. */
+static bool
+kernel_uses_tsc()
+{
+  FILE *f = fopen(CLOCKSOURCE_PATH, "r");
+  if(!f)
+    return false;
+  char source[32] = {0};
+  bool is_tsc = fgets(source, sizeof(source), f) && strcmp(source, "tsc\n") == 0;
+  fclose(f);
+  return is_tsc;
+}
+
+void
+clock_timestamp_init()
+{
+  clock_tsc.use_tsc = false;
+  if(!has_invariant_tsc() || !kernel_uses_tsc())
+    return;
+
+#if defined(__x86_64__) || defined(__i386__)
+  /* count tsc ticks over a spin of CALIBRATION_NS on the monotonic clock */
+  uint64_t ns0 = clock_monotonic_ns(), tsc0 = __rdtsc();
+  uint64_t ns1, tsc1;
+  do
+  {
+    ns1 = clock_monotonic_ns();
+    tsc1 = __rdtsc();
+  }
+  while(ns1 - ns0 < CALIBRATION_NS);
+
+  if(tsc1 <= tsc0)
+    return;
+
+  /* ns per tick as 32.32 fixed point */
+  clock_tsc.mult = (uint64_t)(((unsigned __int128)(ns1 - ns0) << 32) / (tsc1 - tsc0));
+  clock_tsc.tsc0 = tsc1;
+  clock_tsc.ns0 = ns1;
+  clock_tsc.ghz = (double)(tsc1 - tsc0) / (double)(ns1 - ns0);
+  clock_tsc.use_tsc = true;
+#endif
+}
+
+const char *
+clock_timestamp_source()
+{
+  return clock_tsc.use_tsc ? "tsc" : "CLOCK_MONOTONIC";
+}
+
+const char *
+phase_name(enum clock_phase phase)
+{
+  assert(phase >= 0 && phase < PHASE_COUNT);
+  return phase_names[phase];
+}
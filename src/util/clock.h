@@ -2,6 +2,12 @@
 #define _CLOCK_H_
 
 #include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 /**
  * represents a continuous timeline; the reading on the clock gives the time
@@ -67,4 +73,135 @@ clock_time_ms(struct clock *c);
 double
 clock_time_s(struct clock *c);
 
+/**** TIMESTAMPS ***********************************************************/
+
+/**
+ * conversion of cpu timestamp counter ticks to nanoseconds; calibrated against 
+ * CLOCK_MONOTONIC by clock_timestamp_init. 
+ *
+ * ns = ns0 + ((ticks - tsc0) * mult) >> 32
+ */
+struct tsc_calibration
+{
+  bool use_tsc;  /* false if no usable tsc; timestamps use CLOCK_MONOTONIC */
+  uint64_t tsc0;
+  uint64_t ns0;
+  uint64_t mult;
+  double ghz;    /* calibrated tsc frequency */
+};
+
+extern struct tsc_calibration clock_tsc;
+
+/**
+ * clock_timestamp_init - calibrates the timestamp counter; call once before
+ *   use of clock_now_ns. Blocks for ~10ms whilst calibrating.
+ *
+ * note - the tsc is only used if the cpu reports an invariant tsc, i.e. one that
+ *   ticks at a constant rate in all power states, and the kernel times with
+ *   it. An invariant tsc need not be in sync across cores or sockets, and
+ *   timestamps taken on different threads are compared; the kernel only times
+ *   with a tsc it found in sync. Otherwise clock_now_ns falls back to
+ *   CLOCK_MONOTONIC.
+ */
+void
+clock_timestamp_init();
+
+/**
+ * clock_timestamp_source - name of the source of clock_now_ns timestamps.
+ */
+const char *
+clock_timestamp_source();
+
+static inline uint64_t
+clock_monotonic_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * clock_now_ns - a monotonic timestamp in integer nanoseconds from an arbitrary 
+ *   origin; cheap enough to call many times per frame (~10ns with a tsc). The
+ *   timeline is that of CLOCK_MONOTONIC at the time of calibration.
+ */
+static inline uint64_t
+clock_now_ns()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if(clock_tsc.use_tsc)
+  {
+    uint64_t ticks = __rdtsc() - clock_tsc.tsc0;
+    return clock_tsc.ns0 + (uint64_t)(((unsigned __int128)ticks * clock_tsc.mult) >> 32);
+  }
+#endif
+  return clock_monotonic_ns();
+}
+
+/**** PHASE TIMING **********************************************************/
+
+/* the phases of a frame of the game loop */
+enum clock_phase
+{
+  PHASE_EVENTS = 0, /* polling and handling window/input events */
+  PHASE_SIM,        /* game ticks */
+  PHASE_RENDER,     /* culling and drawing */
+  PHASE_SWAP,       /* presenting the frame */
+  PHASE_COUNT
+};
+
+/* durations of the phases accumulated over a frame */
+struct phase_times
+{
+  uint64_t ns[PHASE_COUNT];
+};
+
+/* a phase being timed; see phase_begin/phase_end or PHASE_SCOPE */
+struct phase_timer
+{
+  struct phase_times *times;
+  enum clock_phase phase;
+  uint64_t start_ns;
+};
+
+static inline void
+phase_times_reset(struct phase_times *pt)
+{
+  for(int p = 0; p < PHASE_COUNT; ++p)
+    pt->ns[p] = 0;
+}
+
+static inline struct phase_timer
+phase_begin(struct phase_times *pt, enum clock_phase phase)
+{
+  return (struct phase_timer){pt, phase, clock_now_ns()};
+}
+
+/* phase_end - adds the time since phase_begin to the phase's total. */
+static inline void
+phase_end(struct phase_timer *timer)
+{
+  timer->times->ns[timer->phase] += clock_now_ns() - timer->start_ns;
+}
+
+const char *
+phase_name(enum clock_phase phase);
+
+#define PHASE_CAT0(a, b) a ## b
+#define PHASE_CAT1(a, b) PHASE_CAT0(a, b)
+
+/**
+ * PHASE_SCOPE - times the rest of the enclosing block as 'phase', adding it to
+ *   the phase_times 'pt' as the block is left by any path.
+ *
+ * usage:
+ *   {
+ *     PHASE_SCOPE(&frame_times, PHASE_SIM);
+ *     ... 
+ *   }
+ */
+#define PHASE_SCOPE(pt, phase)                                           \
+  struct phase_timer PHASE_CAT1(_phase_timer_, __LINE__)                 \
+    __attribute__((cleanup(phase_end))) = phase_begin((pt), (phase))
+
 #endif
@@ -0,0 +1,545 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "system.h"
+#include "clock.h"
+#include "log.h"
+#include "memory.h"
+#include "trace.h"
+#include "alloc_track.h"
+#include "jobs.h"
+
+/* the most threads a pool may have */
+#define JOBS_MAX_THREADS 64
+
+/* jobs each thread's deque can hold; a power of 2. A thread submitting to a
+   full deque runs the job itself. */
+#define DEQUE_CAPACITY 4096
+#define DEQUE_MASK (DEQUE_CAPACITY - 1)
+
+/* background jobs the pool can hold; a power of 2. A thread submitting to a
+   full queue runs the job itself. */
+#define BACKGROUND_CAPACITY 1024
+#define BACKGROUND_MASK (BACKGROUND_CAPACITY - 1)
+
+/* a thread without work spins looking for some for this long before it
+   sleeps; long enough to span the gaps between the bursts of jobs of a frame,
+   as waking a sleeping thread costs tens of microseconds */
+#define SPIN_NS 200000
+
+/* failed searches for work spent pausing before a spinning thread starts to
+   yield its cpu; with more threads than cpus a spinning thread can stall the
+   very thread it waits on */
+#define SPIN_PAUSES 64
+
+struct job
+{
+  job_fn fn;
+  void *arg;
+  struct job_counter *counter;
+  int begin;
+  int end;
+  int grain;
+};
+
+/* a Chase-Lev deque; the owner pushes and pops at the bottom, thieves steal
+   from the top. top and bottom only ever increase, jobs[i & DEQUE_MASK] holds
+   the job at position i. See Le et al. "Correct and Efficient Work-Stealing
+   for Weak Memory Models" for the memory orderings. */
+struct deque
+{
+  int64_t top __attribute__((aligned(CACHE_LINE_BYTES)));
+  int64_t bottom __attribute__((aligned(CACHE_LINE_BYTES)));
+  struct job jobs[DEQUE_CAPACITY] __attribute__((aligned(CACHE_LINE_BYTES)));
+};
+
+struct worker
+{
+  struct deque deque;
+  pthread_t thread;
+  int index;
+  uint64_t rng; /* xorshift state for choosing victims */
+  struct jobs_thread_stats stats;
+};
+
+static struct
+{
+  int thread_count;
+  struct worker *workers;
+  bool quit; /* atomic */
+
+  /* sleeping threads wait on 'wake' until 'epoch' changes; every push
+     increments it */
+  pthread_mutex_t sleep_lock;
+  pthread_cond_t wake;
+  int sleeping;   /* atomic */
+  uint64_t epoch; /* atomic */
+
+  /* the background jobs; a ring, oldest first. Taken far less often than the
+     deques' jobs, so behind a lock; 'background_count' lets a search skip an
+     empty queue without taking it */
+  pthread_mutex_t background_lock;
+  struct job background[BACKGROUND_CAPACITY];
+  uint64_t background_head;
+  uint64_t background_tail;
+  int background_count; /* atomic */
+} pool = {.thread_count = 1};
+
+static __thread struct worker *self;
+
+static inline void
+cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+/* the slots are read by thieves whilst the owner may be writing them; a thief
+   which reads a slot being overwritten always fails to claim it, but the
+   fields are still accessed atomically so the race is benign */
+static inline void
+store_job(struct job *slot, const struct job *job)
+{
+  __atomic_store_n(&slot->fn, job->fn, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->arg, job->arg, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->counter, job->counter, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->begin, job->begin, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->end, job->end, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->grain, job->grain, __ATOMIC_RELAXED);
+}
+
+static inline void
+load_job(struct job *slot, struct job *job)
+{
+  job->fn = __atomic_load_n(&slot->fn, __ATOMIC_RELAXED);
+  job->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+  job->counter = __atomic_load_n(&slot->counter, __ATOMIC_RELAXED);
+  job->begin = __atomic_load_n(&slot->begin, __ATOMIC_RELAXED);
+  job->end = __atomic_load_n(&slot->end, __ATOMIC_RELAXED);
+  job->grain = __atomic_load_n(&slot->grain, __ATOMIC_RELAXED);
+}
+
+/* deque_push - owner only; returns false if the deque is full. */
+static bool
+deque_push(struct deque *d, const struct job *job)
+{
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  if(b - t >= DEQUE_CAPACITY)
+    return false;
+  store_job(&d->jobs[b & DEQUE_MASK], job);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+/* deque_pop - owner only; takes the newest job. */
+static bool
+deque_pop(struct deque *d, struct job *job)
+{
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+  if(t > b)
+  {
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  load_job(&d->jobs[b & DEQUE_MASK], job);
+  if(t < b)
+    return true;
+
+  /* the last job; race the thieves for it */
+  bool won = __atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+  __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+  return won;
+}
+
+/* deque_steal - any thread; takes the oldest job. Fails if the deque is empty
+ * or another thread took the job first. */
+static bool
+deque_steal(struct deque *d, struct job *job)
+{
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+  if(t >= b)
+    return false;
+
+  load_job(&d->jobs[t & DEQUE_MASK], job);
+  return __atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t
+next_random(uint64_t *state)
+{
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *state = x;
+}
+
+/* find_job - pops the thread's newest job, else steals the oldest job of
+ * another thread, visiting the others from a random one. */
+static bool
+find_job(struct worker *w, struct job *job)
+{
+  if(deque_pop(&w->deque, job))
+    return true;
+
+  int n = pool.thread_count;
+  int first = (int)(next_random(&w->rng) % (uint64_t)n);
+  for(int i = 0; i < n; ++i)
+  {
+    struct worker *victim = &pool.workers[(first + i) % n];
+    if(victim != w && deque_steal(&victim->deque, job))
+    {
+      ++w->stats.stolen;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* background_push - returns false if the queue is full. */
+static bool
+background_push(const struct job *job)
+{
+  pthread_mutex_lock(&pool.background_lock);
+  bool pushed = pool.background_tail - pool.background_head < BACKGROUND_CAPACITY;
+  if(pushed)
+  {
+    pool.background[pool.background_tail++ & BACKGROUND_MASK] = *job;
+    __atomic_fetch_add(&pool.background_count, 1, __ATOMIC_SEQ_CST);
+  }
+  pthread_mutex_unlock(&pool.background_lock);
+  return pushed;
+}
+
+/* background_pop - takes the oldest background job. */
+static bool
+background_pop(struct worker *w, struct job *job)
+{
+  if(__atomic_load_n(&pool.background_count, __ATOMIC_SEQ_CST) == 0)
+    return false;
+
+  pthread_mutex_lock(&pool.background_lock);
+  bool popped = pool.background_head != pool.background_tail;
+  if(popped)
+  {
+    *job = pool.background[pool.background_head++ & BACKGROUND_MASK];
+    __atomic_fetch_sub(&pool.background_count, 1, __ATOMIC_SEQ_CST);
+  }
+  pthread_mutex_unlock(&pool.background_lock);
+  if(popped)
+    ++w->stats.background;
+  return popped;
+}
+
+/* find_any_job - a job of the deques, else a background job. */
+static inline bool
+find_any_job(struct worker *w, struct job *job)
+{
+  return find_job(w, job) || background_pop(w, job);
+}
+
+/* notify - wakes a sleeping thread, if any, to take a job just pushed. */
+static inline void
+notify()
+{
+  __atomic_fetch_add(&pool.epoch, 1, __ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&pool.sleeping, __ATOMIC_SEQ_CST) > 0)
+  {
+    pthread_mutex_lock(&pool.sleep_lock);
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.sleep_lock);
+  }
+}
+
+static void run_job(struct worker *w, struct job *job);
+
+/* push_job - queues a job on the thread's deque, or the background queue if
+ * a background job, or runs it now if full. */
+static void
+push_job(struct worker *w, struct job *job)
+{
+  __atomic_fetch_add(&job->counter->pending, 1, __ATOMIC_RELAXED);
+  if(job->counter->background ? background_push(job) : deque_push(&w->deque, job))
+  {
+    notify();
+    return;
+  }
+  ++w->stats.inlined;
+  run_job(w, job);
+}
+
+/* run_job - splits the job's range in half until within the grain, pushing
+ * the upper halves for thieves, then runs what remains. The halves of a
+ * background job are background jobs. */
+static void
+run_job(struct worker *w, struct job *job)
+{
+  struct job rest = *job;
+  while(rest.end - rest.begin > rest.grain)
+  {
+    struct job half = rest;
+    half.begin = rest.begin + (rest.end - rest.begin) / 2;
+    rest.end = half.begin;
+    push_job(w, &half);
+  }
+
+  rest.fn(rest.arg, rest.begin, rest.end);
+  ++w->stats.executed;
+  __atomic_fetch_sub(&rest.counter->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void *
+worker_main(void *arg)
+{
+  struct worker *w = arg;
+  self = w;
+
+  TRACE_THREAD_NAME("job worker");
+  ALLOC_TAG("jobs");
+
+  struct job job;
+  while(!__atomic_load_n(&pool.quit, __ATOMIC_ACQUIRE))
+  {
+    if(find_any_job(w, &job))
+    {
+      run_job(w, &job);
+      continue;
+    }
+
+    /* spin a while for more work, then sleep */
+    uint64_t spin_until_ns = clock_now_ns() + SPIN_NS;
+    bool found = false;
+    for(int i = 0; !found && clock_now_ns() < spin_until_ns; ++i)
+    {
+      if(i < SPIN_PAUSES)
+        cpu_relax();
+      else
+        sched_yield();
+      found = find_any_job(w, &job);
+    }
+    if(found)
+    {
+      run_job(w, &job);
+      continue;
+    }
+
+    /* the epoch is read before the last search; a push after the search
+       changes the epoch, which is checked again after announcing the sleep,
+       so either the pusher sees the sleeper or the sleeper sees the push */
+    uint64_t epoch = __atomic_load_n(&pool.epoch, __ATOMIC_SEQ_CST);
+    if(find_any_job(w, &job))
+    {
+      run_job(w, &job);
+      continue;
+    }
+    pthread_mutex_lock(&pool.sleep_lock);
+    __atomic_fetch_add(&pool.sleeping, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&pool.epoch, __ATOMIC_SEQ_CST) == epoch &&
+       !__atomic_load_n(&pool.quit, __ATOMIC_ACQUIRE))
+    {
+      ++w->stats.sleeps;
+      pthread_cond_wait(&pool.wake, &pool.sleep_lock);
+    }
+    __atomic_fetch_sub(&pool.sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool.sleep_lock);
+  }
+  return NULL;
+}
+
+void
+jobs_init(int thread_count)
+{
+  assert(self == NULL && pool.workers == NULL);
+
+  if(thread_count <= 0)
+    thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if(thread_count < 1)
+    thread_count = 1;
+  if(thread_count > JOBS_MAX_THREADS)
+    thread_count = JOBS_MAX_THREADS;
+
+  pool.thread_count = thread_count;
+  pool.quit = false;
+  pool.sleeping = 0;
+  pool.epoch = 0;
+  pthread_mutex_init(&pool.sleep_lock, NULL);
+  pthread_cond_init(&pool.wake, NULL);
+  pthread_mutex_init(&pool.background_lock, NULL);
+  pool.background_head = pool.background_tail = 0;
+  pool.background_count = 0;
+
+  pool.workers = xaligned_alloc(CACHE_LINE_BYTES, sizeof(struct worker) * thread_count);
+  for(int i = 0; i < thread_count; ++i)
+  {
+    struct worker *w = &pool.workers[i];
+    w->deque.top = w->deque.bottom = 0;
+    w->index = i;
+    w->rng = 0x9e3779b97f4a7c15ull * (uint64_t)(i + 1);
+    memset(&w->stats, 0, sizeof(struct jobs_thread_stats));
+  }
+
+  self = &pool.workers[0];
+  for(int i = 1; i < thread_count; ++i)
+  {
+    if(pthread_create(&pool.workers[i].thread, NULL, worker_main, &pool.workers[i]))
+    {
+      fprintf(stderr, "fatal: failed to create job worker thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  log_write(LOG_INFO, "jobs: %d threads", thread_count);
+}
+
+void
+jobs_quit()
+{
+  assert(self == &pool.workers[0]);
+
+  pthread_mutex_lock(&pool.sleep_lock);
+  __atomic_store_n(&pool.quit, true, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool.wake);
+  pthread_mutex_unlock(&pool.sleep_lock);
+
+  for(int i = 1; i < pool.thread_count; ++i)
+    pthread_join(pool.workers[i].thread, NULL);
+
+  pthread_cond_destroy(&pool.wake);
+  pthread_mutex_destroy(&pool.sleep_lock);
+  pthread_mutex_destroy(&pool.background_lock);
+  free(pool.workers);
+  pool.workers = NULL;
+  pool.thread_count = 1;
+  self = NULL;
+}
+
+int
+jobs_thread_count()
+{
+  return pool.thread_count;
+}
+
+int
+jobs_thread_index()
+{
+  return self ? self->index : -1;
+}
+
+void
+jobs_submit(job_fn fn, void *arg, int begin, int end, int grain, struct job_counter *counter)
+{
+  assert(fn != NULL && counter != NULL);
+
+  if(end <= begin)
+    return;
+
+  struct job job = {fn, arg, counter, begin, end, grain < 1 ? 1 : grain};
+
+  /* without a pool the job is run now, as if it was taken at once */
+  if(!self)
+  {
+    assert(pool.workers == NULL);
+    fn(arg, begin, end);
+    return;
+  }
+  push_job(self, &job);
+}
+
+void
+jobs_submit_background(job_fn fn, void *arg, int begin, int end, int grain, struct job_counter *counter)
+{
+  assert(counter != NULL && (counter->background || counter->pending == 0));
+
+  /* without workers nothing would ever take the jobs */
+  if(pool.thread_count == 1)
+  {
+    if(end > begin)
+      fn(arg, begin, end);
+    return;
+  }
+  counter->background = true;
+  jobs_submit(fn, arg, begin, end, grain, counter);
+}
+
+void
+jobs_wait(struct job_counter *counter)
+{
+  int idle = 0;
+  struct job job;
+  bool background = counter->background;
+  while(__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) > 0)
+  {
+    if(background ? find_any_job(self, &job) : find_job(self, &job))
+    {
+      run_job(self, &job);
+      idle = 0;
+    }
+    else if(++idle < SPIN_PAUSES)
+      cpu_relax();
+    else
+      sched_yield();
+  }
+}
+
+void
+parallel_for(int begin, int end, int grain, job_fn fn, void *arg)
+{
+  if(end <= begin)
+    return;
+
+  if(!self || pool.thread_count == 1 || end - begin <= grain)
+  {
+    fn(arg, begin, end);
+    return;
+  }
+
+  struct job_counter counter = {0};
+  jobs_submit(fn, arg, begin, end, grain, &counter);
+  jobs_wait(&counter);
+}
+
+void
+jobs_get_stats(int index, struct jobs_thread_stats *stats)
+{
+  assert(index >= 0 && index < pool.thread_count && pool.workers != NULL);
+  *stats = pool.workers[index].stats;
+}
+
+void
+jobs_log_stats()
+{
+  for(int i = 0; i < pool.thread_count && pool.workers; ++i)
+  {
+    const struct jobs_thread_stats *s = &pool.workers[i].stats;
+    log_write(LOG_INFO,
+              "jobs: thread %-2d ran %llu jobs, %llu stolen, %llu background, %llu inlined, slept %llu times",
+              i,
+              (unsigned long long)s->executed,
+              (unsigned long long)s->stolen,
+              (unsigned long long)s->background,
+              (unsigned long long)s->inlined,
+              (unsigned long long)s->sleeps);
+  }
+}
@@ -0,0 +1,121 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * The job system; a fixed pool of worker threads running jobs submitted by
+ * any of the pool's threads.
+ *
+ * Each thread of the pool, including the thread which called jobs_init (the
+ * main thread), has a deque of jobs. A thread pushes the jobs it submits to
+ * the bottom of its own deque and pops from the bottom, so it runs its newest
+ * work first, whilst its data is hot in cache. A thread whose deque is empty
+ * steals from the top of another thread's deque, taking the oldest and so
+ * typically the largest piece of work. The deques are Chase-Lev work stealing
+ * deques; the owner's push and pop take no lock and only contend with thieves
+ * for the last job.
+ *
+ * Dependencies are expressed with counters: each job submitted against a
+ * counter increments it, each job finishing decrements it. jobs_wait blocks
+ * until a counter is zero, running other jobs whilst it waits, so a waiting
+ * thread is never idle while there is work and jobs may wait on jobs they
+ * submit themselves.
+ *
+ * Background jobs, submitted with jobs_submit_background, are work no frame
+ * waits on, e.g. streaming in the asteroid belt. They are queued apart from
+ * the deques, oldest first, and taken only by workers which find no other
+ * job. A wait runs the jobs in the deques; it runs background jobs only if
+ * the counter it waits on is one of background jobs. So a wait on the jobs
+ * of a parallel_for never runs a long unrelated job, and a worker busy with
+ * a background job is only unavailable to the frame until it finishes it.
+ *
+ * Jobs cover a range of indices [begin, end). A range larger than the job's
+ * grain is split in half; one half is pushed for a thief to take, the other
+ * half is split further until at most grain indices remain, which are run.
+ * This is how parallel_for fans out a loop; the grain trades the overhead of
+ * a job (~100ns) against load balancing.
+ *
+ * Only threads of the pool may submit jobs or wait on counters.
+ */
+
+/* a job; runs fn over the indices [begin, end) */
+typedef void (*job_fn)(void *arg, int begin, int end);
+
+/* the number of submitted jobs still to finish; zero initialise */
+struct job_counter
+{
+  int pending;     /* atomic */
+  bool background; /* counts background jobs; set by jobs_submit_background */
+};
+
+/* jobs_init - starts the pool with 'thread_count' threads including the
+ *   caller, i.e. thread_count - 1 workers; if 0 one per online cpu. */
+void
+jobs_init(int thread_count);
+
+/* jobs_quit - stops and joins the workers; there must be no jobs pending. */
+void
+jobs_quit();
+
+/* jobs_thread_count - number of threads in the pool, including the main
+ *   thread; 1 before init. */
+int
+jobs_thread_count();
+
+/* jobs_thread_index - index of the calling thread in the pool; 0 for the main
+ *   thread, -1 for a thread not in the pool. */
+int
+jobs_thread_index();
+
+/* jobs_submit - queues fn to run over the range [begin, end) split into jobs
+ *   of at most 'grain' indices; returns immediately.
+ *
+ * @counter - incremented for each job, decremented as it finishes; may be
+ *   shared by many submissions to wait on them all at once.
+ */
+void
+jobs_submit(job_fn fn, void *arg, int begin, int end, int grain, struct job_counter *counter);
+
+/* jobs_submit_background - as jobs_submit, but queues the jobs as background
+ *   jobs, see above; with a pool of one thread there are no workers to take
+ *   them, so fn is run now.
+ *
+ * @counter - counts only background jobs.
+ */
+void
+jobs_submit_background(job_fn fn, void *arg, int begin, int end, int grain, struct job_counter *counter);
+
+/* jobs_wait - runs jobs until the counter reaches zero; the submitted jobs'
+ *   writes are visible to the caller on return. Runs background jobs only if
+ *   the counter counts background jobs. */
+void
+jobs_wait(struct job_counter *counter);
+
+/* parallel_for - runs fn over the range [begin, end), split into jobs of at
+ *   most 'grain' indices run across the pool; returns when all are done.
+ *   With a pool of one thread fn is called once over the whole range. */
+void
+parallel_for(int begin, int end, int grain, job_fn fn, void *arg);
+
+/* per thread counts of the pool's work since init */
+struct jobs_thread_stats
+{
+  uint64_t executed;   /* jobs run by the thread */
+  uint64_t stolen;     /* of those, taken from another thread's deque */
+  uint64_t background; /* of those, taken from the background queue */
+  uint64_t inlined;    /* jobs run at submission as the thread's deque was full */
+  uint64_t sleeps;     /* times the thread slept for want of work */
+};
+
+/* jobs_get_stats - copies the counts of thread 'index' of the pool; only
+ *   exact whilst the pool is idle. */
+void
+jobs_get_stats(int index, struct jobs_thread_stats *stats);
+
+/* jobs_log_stats - logs the counts of every thread of the pool. */
+void
+jobs_log_stats();
+
+#endif
@@ -1,23 +1,518 @@
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "log.h"
+#include "clock.h"
 #include "util.h"
 #include "defs.h"
+#include "system.h"
 
-static const char *prefix[4] = {"ERROR: ", "FATAL ERROR: ", "WARNING: ", "INFO: "};
+/*
+ * The log is written by a background thread. log_write copies the format
+ * pointer and the raw arguments into a record of a bounded lock-free queue
+ * (Vyukov's, with a single consumer); the writer thread takes the records,
+ * formats them and writes them to the log file in batches. Thus the logging
+ * thread never formats or waits on the file.
+ *
+ * The arguments are found by scanning the format as printf would; the kinds
+ * of argument a format takes are cached per thread by the format's address,
+ * so only a format's first use is scanned. As no va_list can be built to pass
+ * the arguments back, the writer formats a message one conversion at a time,
+ * with the arguments widened to int, long long, double or a copied string.
+ */
+
+/* number of records in the queue; a power of 2 */
+#define LOG_QUEUE_RECORDS 1024
+
+#define LOG_MAX_ARGS 16
+
+/* bytes per record for copies of the string arguments */
+#define LOG_STRING_BYTES 88
+
+/* how long the writer sleeps when the queue is empty */
+#define LOG_WRITER_SLEEP_NS 2000000
+
+/* size of the writer's buffer of formatted messages; written when full and
+   each time the queue is emptied */
+#define LOG_BATCH_BYTES 65536
+
+/* number of formats each thread caches the argument kinds of */
+#define LOG_FORMAT_CACHE 64
+
+/* the types arguments are read as; long and long double are widened to long
+   long and double once read */
+enum arg_kind {ARG_INT, ARG_LONG, ARG_LLONG, ARG_DOUBLE, ARG_LDOUBLE, ARG_POINTER, ARG_STRING};
+
+/* the arguments a format takes, in order */
+struct format_info
+{
+  const char *format;
+  uint8_t arg_count;
+  uint8_t kinds[LOG_MAX_ARGS];
+};
+
+union log_arg
+{
+  long long i;
+  double d;
+  const void *p;
+  int s; /* offset of the string copy */
+};
+
+struct log_record
+{
+  uint64_t sequence;
+  const char *format;
+  uint8_t type;
+  uint8_t arg_count;
+  uint8_t kinds[LOG_MAX_ARGS];
+  uint16_t string_bytes;
+  union log_arg args[LOG_MAX_ARGS];
+  char strings[LOG_STRING_BYTES];
+} __attribute__((aligned(64)));
+
+static const char *prefix[5] = {"FATAL ERROR: ", "ERROR: ", "WARNING: ", "INFO: ", "DEBUG: "};
+
+int log_level = LOG_LEVEL_INFO;
 
 static bool is_init;
 static bool is_stderr;
 static FILE *log_stream; /* file to output logs */
-static const char *fpath;
+static enum log_overflow overflow = LOG_OVERFLOW_DROP;
+
+static struct log_record *queue;
+static uint64_t enqueue_pos;   /* next record to claim; shared by producers */
+static uint64_t dequeue_pos;   /* next record to write; writer thread only */
+static uint64_t written_pos;   /* all records before this are written */
+static uint64_t dropped_count; /* messages dropped as the queue was full */
+static bool is_quit;
+static pthread_t writer;
+
+/**** PRODUCER ***************************************************************/
+
+/* claim - claims the next record of the queue.
+ *
+ * returns - the record, or NULL if the queue is full. */
+static struct log_record *
+claim()
+{
+  uint64_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+  while(true)
+  {
+    struct log_record *r = &queue[pos & (LOG_QUEUE_RECORDS - 1)];
+    uint64_t sequence = __atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE);
+    int64_t diff = (int64_t)(sequence - pos);
+    if(diff == 0)
+    {
+      if(__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true, 
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return r;
+    }
+    else if(diff < 0)
+      return NULL;
+    else
+      pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+  }
+}
+
+/* publish - hands a claimed and filled record to the writer */
+static inline void
+publish(struct log_record *r)
+{
+  uint64_t pos = r->sequence;
+  __atomic_store_n(&r->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+static void
+copy_string(struct log_record *r, union log_arg *arg, const char *s)
+{
+  if(!s)
+    s = "(null)";
+  int room = LOG_STRING_BYTES - r->string_bytes;
+  if(room == 0)
+  {
+    /* out of room; the terminator of the last copy is an empty string */
+    arg->s = LOG_STRING_BYTES - 1;
+    return;
+  }
+  int n = 0;
+  while(n < room - 1 && s[n])
+    ++n;
+  memcpy(r->strings + r->string_bytes, s, n);
+  r->strings[r->string_bytes + n] = '\0';
+  arg->s = r->string_bytes;
+  r->string_bytes += n + 1;
+}
+
+/* parse_format - finds the arguments the format takes */
+static void
+parse_format(const char *format, struct format_info *info)
+{
+  info->format = format;
+  info->arg_count = 0;
+  for(const char *c = format; *c; ++c)
+  {
+    if(*c != '%')
+      continue;
+    if(*++c == '%')
+      continue;
+
+    /* flags, width, precision; '*' width and precision are int arguments */
+    int length = 0; /* 'l' counts 1, 'll' 2, 'L' 3; 'j', 'z', 't' as 'll' */
+    for(; *c; ++c)
+    {
+      if(*c == '*')
+      {
+        if(info->arg_count < LOG_MAX_ARGS)
+          info->kinds[info->arg_count++] = ARG_INT;
+      }
+      else if(*c == 'l')
+        ++length;
+      else if(*c == 'j' || *c == 'z' || *c == 't')
+        length = 2;
+      else if(*c == 'L')
+        length = 3;
+      else if(strchr("-+ #0123456789.h", *c) == NULL)
+        break;
+    }
+    if(!*c)
+      break;
+
+    enum arg_kind kind;
+    switch(*c)
+    {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+      kind = (length == 0) ? ARG_INT : (length == 1) ? ARG_LONG : ARG_LLONG;
+      break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      kind = (length == 3) ? ARG_LDOUBLE : ARG_DOUBLE;
+      break;
+    case 'p':
+      kind = ARG_POINTER;
+      break;
+    case 's':
+      kind = ARG_STRING;
+      break;
+    default:
+      /* %n and anything unknown; no argument is known to be taken */
+      continue;
+    }
+    if(info->arg_count < LOG_MAX_ARGS)
+      info->kinds[info->arg_count++] = kind;
+  }
+}
+
+static const struct format_info *
+lookup_format(const char *format)
+{
+  static __thread struct format_info cache[LOG_FORMAT_CACHE];
+  struct format_info *info = &cache[((uintptr_t)format >> 3) & (LOG_FORMAT_CACHE - 1)];
+  if(UNLIKELY(info->format != format))
+    parse_format(format, info);
+  return info;
+}
+
+/* capture - copies the arguments of the format into the record. */
+static void
+capture(struct log_record *r, const char *format, va_list args)
+{
+  const struct format_info *info = lookup_format(format);
+  r->arg_count = info->arg_count;
+  r->string_bytes = 0;
+  memcpy(r->kinds, info->kinds, info->arg_count);
+  for(int i = 0; i < info->arg_count; ++i)
+  {
+    union log_arg *arg = &r->args[i];
+    switch(info->kinds[i])
+    {
+    case ARG_INT: arg->i = va_arg(args, int); break;
+    case ARG_LONG: arg->i = va_arg(args, long); break;
+    case ARG_LLONG: arg->i = va_arg(args, long long); break;
+    case ARG_DOUBLE: arg->d = va_arg(args, double); break;
+    case ARG_LDOUBLE: arg->d = (double)va_arg(args, long double); break;
+    case ARG_POINTER: arg->p = va_arg(args, void *); break;
+    case ARG_STRING: copy_string(r, arg, va_arg(args, const char *)); break;
+    }
+  }
+}
+
+void
+log_write(enum log_type type, const char *format, ...)
+{
+  assert(is_init);
+  assert(LOG_FATAL <= type && type <= LOG_DEBUG);
+
+  /* a type is its level */
+  if((int)type > log_level)
+    return;
+
+  bool is_error = (type == LOG_ERROR || type == LOG_FATAL);
+
+  struct log_record *r;
+  while(!(r = claim()))
+  {
+    if(overflow == LOG_OVERFLOW_DROP && !is_error)
+    {
+      __atomic_fetch_add(&dropped_count, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    sched_yield();
+  }
+
+  r->type = type;
+  r->format = format;
+  va_list args;
+  va_start(args, format);
+  capture(r, format, args);
+  va_end(args);
+  publish(r);
+
+  if(is_error)
+    log_flush();
+}
+
+void
+log_flush()
+{
+  if(!is_init)
+    return;
+  uint64_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_ACQUIRE);
+  while(__atomic_load_n(&written_pos, __ATOMIC_ACQUIRE) < pos)
+    sched_yield();
+}
+
+void
+log_set_overflow(enum log_overflow policy)
+{
+  overflow = policy;
+}
+
+void
+log_set_level(int level)
+{
+  log_level = level < LOG_LEVEL_FATAL ? LOG_LEVEL_FATAL : level;
+}
+
+bool
+log_limit_pass(struct log_limit *limit, int per_s, int *suppressed)
+{
+  uint64_t now_ns = clock_now_ns();
+  uint64_t window_ns = __atomic_load_n(&limit->window_ns, __ATOMIC_RELAXED);
+  if(now_ns - window_ns >= 1000000000ull)
+  {
+    if(__atomic_compare_exchange_n(&limit->window_ns, &window_ns, now_ns, false, 
+                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      __atomic_store_n(&limit->count, 0, __ATOMIC_RELAXED);
+  }
+
+  if(__atomic_fetch_add(&limit->count, 1, __ATOMIC_RELAXED) < per_s)
+  {
+    *suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+    return true;
+  }
+  __atomic_fetch_add(&limit->suppressed, 1, __ATOMIC_RELAXED);
+  return false;
+}
+
+/**** WRITER *****************************************************************/
+
+static char batch[LOG_BATCH_BYTES];
+static int batch_bytes;
+
+static void
+write_batch()
+{
+  fwrite(batch, 1, batch_bytes, log_stream);
+  batch_bytes = 0;
+}
+
+static void
+append(const char *s, int n)
+{
+  if(batch_bytes + n > LOG_BATCH_BYTES)
+    write_batch();
+  if(n > LOG_BATCH_BYTES)
+  {
+    fwrite(s, 1, n, log_stream);
+    return;
+  }
+  memcpy(batch + batch_bytes, s, n);
+  batch_bytes += n;
+}
+
+/* format_record - formats a record into the batch one conversion at a time; each
+ * conversion spec is rebuilt with the length modifier of its argument's
+ * widened type. */
+static void
+format_record(const struct log_record *r)
+{
+  char spec[32], out[512];
+  int next = 0;
+
+  append(prefix[r->type], strlen(prefix[r->type]));
+
+  const char *c = r->format, *text = c;
+  while(*c)
+  {
+    if(*c != '%')
+    {
+      ++c;
+      continue;
+    }
+    append(text, c - text);
+    if(c[1] == '%')
+    {
+      append("%", 1);
+      c += 2;
+      text = c;
+      continue;
+    }
+
+    /* the spec less its length modifiers; '*'s are taken from the args */
+    int n = 0, star[2], stars = 0;
+    spec[n++] = *c++;
+    for(; *c && strchr("-+ #0123456789.*hljztL", *c); ++c)
+    {
+      if(*c == '*')
+      {
+        star[stars < 2 ? stars : 1] = (next < r->arg_count) ? (int)r->args[next].i : 0;
+        ++next;
+        ++stars;
+      }
+      if(strchr("ljztL", *c) == NULL && n < (int)sizeof(spec) - 4)
+        spec[n++] = *c;
+    }
+    if(!*c)
+      break;
+    char conversion = *c++;
+    text = c;
+
+    if(!strchr("diuxXocfFeEgGaApsn", conversion) || conversion == 'n')
+      continue;
+    if(next >= r->arg_count)
+    {
+      append("%?", 2);
+      continue;
+    }
+
+    const union log_arg *arg = &r->args[next];
+    enum arg_kind kind = r->kinds[next++];
+    if(kind == ARG_LONG || kind == ARG_LLONG)
+    {
+      kind = ARG_LLONG;
+      spec[n++] = 'l';
+      spec[n++] = 'l';
+    }
+    else if(kind == ARG_LDOUBLE)
+      kind = ARG_DOUBLE;
+    spec[n++] = conversion;
+    spec[n] = '\0';
+
+    int w0 = stars > 0 ? star[0] : 0, w1 = stars > 1 ? star[1] : 0;
+    int len;
+    switch(kind)
+    {
+    case ARG_INT:
+      len = stars == 2 ? snprintf(out, sizeof(out), spec, w0, w1, (int)arg->i) :
+            stars == 1 ? snprintf(out, sizeof(out), spec, w0, (int)arg->i) :
+                         snprintf(out, sizeof(out), spec, (int)arg->i);
+      break;
+    case ARG_LLONG:
+      len = stars == 2 ? snprintf(out, sizeof(out), spec, w0, w1, arg->i) :
+            stars == 1 ? snprintf(out, sizeof(out), spec, w0, arg->i) :
+                         snprintf(out, sizeof(out), spec, arg->i);
+      break;
+    case ARG_DOUBLE:
+      len = stars == 2 ? snprintf(out, sizeof(out), spec, w0, w1, arg->d) :
+            stars == 1 ? snprintf(out, sizeof(out), spec, w0, arg->d) :
+                         snprintf(out, sizeof(out), spec, arg->d);
+      break;
+    case ARG_POINTER:
+      len = stars == 2 ? snprintf(out, sizeof(out), spec, w0, w1, arg->p) :
+            stars == 1 ? snprintf(out, sizeof(out), spec, w0, arg->p) :
+                         snprintf(out, sizeof(out), spec, arg->p);
+      break;
+    default:
+      len = stars == 2 ? snprintf(out, sizeof(out), spec, w0, w1, r->strings + arg->s) :
+            stars == 1 ? snprintf(out, sizeof(out), spec, w0, r->strings + arg->s) :
+                         snprintf(out, sizeof(out), spec, r->strings + arg->s);
+      break;
+    }
+    if(len > 0)
+      append(out, len < (int)sizeof(out) ? len : (int)sizeof(out) - 1);
+  }
+  append(text, c - text);
+  append("\n", 1);
+}
+
+/* drain - formats and writes all published records.
+ *
+ * returns - the number of records written. */
+static int
+drain()
+{
+  int count = 0;
+  while(true)
+  {
+    struct log_record *r = &queue[dequeue_pos & (LOG_QUEUE_RECORDS - 1)];
+    if(__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != dequeue_pos + 1)
+      break;
+    format_record(r);
+    __atomic_store_n(&r->sequence, dequeue_pos + LOG_QUEUE_RECORDS, __ATOMIC_RELEASE);
+    ++dequeue_pos;
+    ++count;
+  }
+
+  uint64_t dropped = __atomic_exchange_n(&dropped_count, 0, __ATOMIC_RELAXED);
+  if(dropped)
+  {
+    char out[128];
+    int len = snprintf(out, sizeof(out), "%slog queue full: dropped %llu messages\n",
+                       prefix[LOG_WARNING], (unsigned long long)dropped);
+    append(out, len);
+  }
+
+  if(count || dropped)
+  {
+    write_batch();
+    fflush(log_stream);
+    __atomic_store_n(&written_pos, dequeue_pos, __ATOMIC_RELEASE);
+  }
+  return count;
+}
+
+static void *
+writer_main(void *arg)
+{
+  (void)arg;
+  struct timespec sleep = {0, LOG_WRITER_SLEEP_NS};
+  while(!__atomic_load_n(&is_quit, __ATOMIC_ACQUIRE))
+  {
+    if(drain() == 0)
+      nanosleep(&sleep, NULL);
+  }
+  drain();
+  return NULL;
+}
+
+/**** INIT/QUIT **************************************************************/
 
 void
 log_init()
 {
   char *path = join_path(DIR_LOG, FILENAME_LOG);
-  log_stream = NULL;//fopen(path, "w");
+  if(mkdir(DIR_LOG, 0755) && errno != EEXIST)
+    log_stream = NULL;
+  else
+    log_stream = fopen(path, "w");
   if(!log_stream)
   {
     fprintf(stderr, "error: failed to initialise log file '%s': ", path);
@@ -26,34 +521,44 @@ log_init()
     log_stream = stderr;
     is_stderr = true;
   }
-  is_init = true;
   free(path);
-}
 
-void
-log_quit()
-{
-  if(is_init && !is_stderr)
+  queue = xaligned_alloc(64, sizeof(struct log_record) * LOG_QUEUE_RECORDS);
+  for(uint64_t i = 0; i < LOG_QUEUE_RECORDS; ++i)
+    queue[i].sequence = i;
+  enqueue_pos = dequeue_pos = written_pos = 0;
+  dropped_count = 0;
+  is_quit = false;
+
+  if(pthread_create(&writer, NULL, writer_main, NULL))
   {
-    fclose(log_stream);
+    fprintf(stderr, "fatal: failed to create log writer thread\n");
+    exit(EXIT_FAILURE);
   }
-  is_init = false;
+
+  static bool is_registered = false;
+  if(!is_registered)
+  {
+    atexit(log_quit);
+    is_registered = true;
+  }
+  is_init = true;
 }
 
-/*
- * bug fix: turns out that printing the 'va_list args' more than once causes one of the
- * prints to fail; 'va_list args' is seemingly 'consumed' in the printing.
- */
 void
-log_write(enum log_type type, const char *format, ...)
+log_quit()
 {
-  assert(is_init);
-  assert(LOG_ERROR <= type && type <= LOG_INFO);
+  if(!is_init)
+    return;
+  is_init = false;
 
-  fprintf(log_stream, prefix[(int)type]);
-  va_list args;
-  va_start(args, format);
-  vfprintf(log_stream, format, args);
-  va_end(args);
-  fprintf(log_stream, "\n");
+  __atomic_store_n(&is_quit, true, __ATOMIC_RELEASE);
+  pthread_join(writer, NULL);
+  free(queue);
+  queue = NULL;
+
+  if(!is_stderr)
+  {
+    fclose(log_stream);
+  }
 }
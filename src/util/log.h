@@ -2,19 +2,163 @@
 #define _LOG_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
-enum log_type {LOG_ERROR = 0, LOG_FATAL = 1, LOG_WARNING = 2, LOG_INFO = 3};
+enum log_type {LOG_FATAL = 0, LOG_ERROR = 1, LOG_WARNING = 2, LOG_INFO = 3, LOG_DEBUG = 4};
+
+/* verbosity levels, those of the log types of the same names; a message is
+   logged only if its type is at most the log level. Fatal errors are always
+   logged. */
+#define LOG_LEVEL_FATAL 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/* the most verbose level compiled in; the LOGF_xxx(...) macros of more verbose
+   levels expand to nothing, their arguments are never compiled. Define before
+   including (e.g. -DLOG_COMPILE_LEVEL=2) to strip levels from a build. */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/* the runtime log level; LOG_LEVEL_INFO by default, see log_set_level */
+extern int log_level;
+
+/* per callsite state of the rate limited LOGF_xxx_RATE(...) macros */
+struct log_limit
+{
+  uint64_t window_ns; /* start of the current one second window */
+  int count;          /* messages passed in the window */
+  int suppressed;     /* messages suppressed since the last one passed */
+};
+
+/* what log_write does when the queue of messages waiting to be written is
+   full; errors always block, they are never dropped */
+enum log_overflow
+{
+  LOG_OVERFLOW_DROP,  /* discard the message; counted and reported in the log */
+  LOG_OVERFLOW_BLOCK  /* wait for the writer thread to make room */
+};
 
 /*
- * log_init - prepare log for writing.
+ * log_init - prepare log for writing; opens the log file and starts the
+ * writer thread.
  */
 void
 log_init();
 
+/*
+ * log_quit - writes all queued messages, stops the writer thread and closes
+ * the log file. Also called at exit if the log is still open.
+ */
 void 
 log_quit();
 
+void
+log_set_overflow(enum log_overflow policy);
+
+/*
+ * log_write - queues a message for the writer thread; the caller's thread
+ * only copies the format pointer and the arguments, the formatting and file
+ * writes are done by the writer thread.
+ *
+ * The format must be a string which outlives the log, i.e. a literal. String
+ * (%s) arguments are copied, up to a limit of bytes per message beyond which
+ * they are truncated. At most LOG_MAX_ARGS arguments are kept. Wide
+ * characters/strings and %n are not supported.
+ *
+ * Errors (LOG_ERROR, LOG_FATAL) are written before log_write returns.
+ */
 void
 log_write(enum log_type t, const char *fmt, ...);
 
+/*
+ * log_flush - waits until all messages queued before the call are written.
+ */
+void
+log_flush();
+
+void
+log_set_level(int level);
+
+/*
+ * log_limit_pass - counts a message against the limit of 'per_s' messages a
+ * second of a callsite; approximate if the callsite is shared by threads.
+ *
+ * @suppressed - set to the number of messages suppressed since the last one
+ *   passed, if this one passes.
+ *
+ * returns - true if the message is within the limit and should be logged.
+ */
+bool
+log_limit_pass(struct log_limit *limit, int per_s, int *suppressed);
+
+/* LOG_AT - logs if 'level' is within the runtime log level; the arguments are
+ * not evaluated otherwise. */
+#define LOG_AT(level, type, ...)                                               \
+  do                                                                           \
+  {                                                                            \
+    if(__builtin_expect((level) <= log_level, 0))                              \
+      log_write((type), __VA_ARGS__);                                          \
+  }                                                                            \
+  while(0)
+
+/* LOG_AT_RATE - as LOG_AT but logs at most 'per_s' messages a second from the
+ * callsite; the count of those suppressed is logged with the next to pass. */
+#define LOG_AT_RATE(level, type, per_s, ...)                                   \
+  do                                                                           \
+  {                                                                            \
+    if(__builtin_expect((level) <= log_level, 0))                              \
+    {                                                                          \
+      static struct log_limit _log_limit;                                      \
+      int _log_suppressed;                                                     \
+      if(log_limit_pass(&_log_limit, (per_s), &_log_suppressed))               \
+      {                                                                        \
+        log_write((type), __VA_ARGS__);                                        \
+        if(_log_suppressed)                                                    \
+          log_write((type), "%s:%d: %d more suppressed",                       \
+                    __FILE__, __LINE__, _log_suppressed);                      \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+  while(0)
+
+/*
+ * The logging macros; e.g. LOGF_INFO("ship at %f", x), or at most 10 a second
+ * with LOGF_INFO_RATE(10, "ship at %f", x). Prefer these to log_write, the
+ * level checks are before argument evaluation and they may be compiled out.
+ */
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOGF_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, LOG_ERROR, __VA_ARGS__)
+#define LOGF_ERROR_RATE(per_s, ...) LOG_AT_RATE(LOG_LEVEL_ERROR, LOG_ERROR, per_s, __VA_ARGS__)
+#else
+#define LOGF_ERROR(...) ((void)0)
+#define LOGF_ERROR_RATE(per_s, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARNING
+#define LOGF_WARNING(...) LOG_AT(LOG_LEVEL_WARNING, LOG_WARNING, __VA_ARGS__)
+#define LOGF_WARNING_RATE(per_s, ...) LOG_AT_RATE(LOG_LEVEL_WARNING, LOG_WARNING, per_s, __VA_ARGS__)
+#else
+#define LOGF_WARNING(...) ((void)0)
+#define LOGF_WARNING_RATE(per_s, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOGF_INFO(...) LOG_AT(LOG_LEVEL_INFO, LOG_INFO, __VA_ARGS__)
+#define LOGF_INFO_RATE(per_s, ...) LOG_AT_RATE(LOG_LEVEL_INFO, LOG_INFO, per_s, __VA_ARGS__)
+#else
+#define LOGF_INFO(...) ((void)0)
+#define LOGF_INFO_RATE(per_s, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGF_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, LOG_DEBUG, __VA_ARGS__)
+#define LOGF_DEBUG_RATE(per_s, ...) LOG_AT_RATE(LOG_LEVEL_DEBUG, LOG_DEBUG, per_s, __VA_ARGS__)
+#else
+#define LOGF_DEBUG(...) ((void)0)
+#define LOGF_DEBUG_RATE(per_s, ...) ((void)0)
+#endif
+
 #endif
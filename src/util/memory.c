@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "memory.h"
+
+/* the most arenas and pools the stats are kept for */
+#define MEMORY_MAX_TRACKED 32
+
+#define HUGE_PAGE_BYTES (2u << 20)
+
+struct arena memory_frame;
+
+static struct arena *arenas[MEMORY_MAX_TRACKED];
+static struct pool *pools[MEMORY_MAX_TRACKED];
+static int arena_count;
+static int pool_count;
+
+static size_t
+round_up(size_t n, size_t align)
+{
+  return (n + align - 1) & ~(align - 1);
+}
+
+static void
+track(void **list, int *count, void *allocator)
+{
+  if(*count < MEMORY_MAX_TRACKED)
+    list[(*count)++] = allocator;
+}
+
+static void
+untrack(void **list, int *count, void *allocator)
+{
+  for(int i = 0; i < *count; ++i)
+  {
+    if(list[i] == allocator)
+    {
+      list[i] = list[--(*count)];
+      return;
+    }
+  }
+}
+
+void
+arena_init(struct arena *a, const char *name, size_t capacity, int flags)
+{
+  assert(a != NULL && capacity > 0);
+
+  a->name = name;
+  a->used = a->high_water = 0;
+  a->allocs = 0;
+  a->is_huge = false;
+
+  /* explicit huge pages need pages reserved by the admin; failing those ask
+     for transparent huge pages, which the kernel may or may not give. The
+     huge pages are not mapped MAP_NORESERVE, else the mapping succeeds without
+     the pages to back it and the first touch of a missing page faults. */
+  void *base = MAP_FAILED;
+  if(flags & MEMORY_HUGE_PAGES)
+  {
+    a->capacity = round_up(capacity, HUGE_PAGE_BYTES);
+    base = mmap(NULL, a->capacity, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    a->is_huge = (base != MAP_FAILED);
+  }
+  if(base == MAP_FAILED)
+  {
+    a->capacity = round_up(capacity, CACHE_LINE_BYTES);
+    base = mmap(NULL, a->capacity, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(base == MAP_FAILED)
+    {
+      fprintf(stderr, "fatal: failed to reserve %zu bytes for arena '%s'\n", capacity, name);
+      exit(EXIT_FAILURE);
+    }
+    if(flags & MEMORY_HUGE_PAGES)
+      madvise(base, a->capacity, MADV_HUGEPAGE);
+  }
+  a->base = base;
+
+  track((void **)arenas, &arena_count, a);
+}
+
+void
+arena_free(struct arena *a)
+{
+  untrack((void **)arenas, &arena_count, a);
+  for(int i = pool_count - 1; i >= 0; --i)
+    if(pools[i]->arena == a)
+      untrack((void **)pools, &pool_count, pools[i]);
+  if(a->base)
+    munmap(a->base, a->capacity);
+  a->base = NULL;
+  a->capacity = a->used = 0;
+}
+
+void *
+arena_alloc(struct arena *a, size_t size, size_t align)
+{
+  assert(a->base != NULL && align && !(align & (align - 1)));
+
+  size_t offset = round_up(a->used, align);
+  if(offset + size > a->capacity)
+  {
+    log_write(LOG_FATAL, 
+              "arena '%s' out of memory: %zu of %zu bytes used, %zu requested",
+              a->name, a->used, a->capacity, size);
+    exit(EXIT_FAILURE);
+  }
+  a->used = offset + size;
+  if(a->used > a->high_water)
+    a->high_water = a->used;
+  ++a->allocs;
+  return a->base + offset;
+}
+
+void
+memory_init(size_t frame_capacity, int flags)
+{
+  arena_init(&memory_frame, "frame", frame_capacity, flags);
+}
+
+void
+memory_quit()
+{
+  arena_free(&memory_frame);
+}
+
+void
+pool_init(struct pool *p, const char *name, size_t item_size, size_t align,
+          int capacity, struct arena *arena)
+{
+  assert(capacity > 0 && item_size > 0);
+
+  /* free items hold the index of the next free item */
+  if(item_size < sizeof(int))
+    item_size = sizeof(int);
+
+  p->name = name;
+  p->arena = arena;
+  p->stride = round_up(item_size, align);
+  p->capacity = capacity;
+  p->count = p->high_water = 0;
+  p->free_head = -1;
+  p->untouched = 0;
+  p->items = arena_alloc(arena, p->stride * capacity, 
+                         align > CACHE_LINE_BYTES ? align : CACHE_LINE_BYTES);
+
+  track((void **)pools, &pool_count, p);
+}
+
+void *
+pool_alloc(struct pool *p)
+{
+  void *item;
+  if(p->free_head >= 0)
+  {
+    item = pool_at(p, p->free_head);
+    memcpy(&p->free_head, item, sizeof(int));
+  }
+  else if(p->untouched < p->capacity)
+    item = pool_at(p, p->untouched++);
+  else
+    return NULL;
+
+  if(++p->count > p->high_water)
+    p->high_water = p->count;
+  return item;
+}
+
+void
+pool_release(struct pool *p, void *item)
+{
+  assert(item != NULL && pool_index(p, item) < p->untouched);
+  memcpy(item, &p->free_head, sizeof(int));
+  p->free_head = pool_index(p, item);
+  --p->count;
+}
+
+void
+memory_log_stats()
+{
+  for(int i = 0; i < arena_count; ++i)
+  {
+    struct arena *a = arenas[i];
+    log_write(LOG_INFO, 
+              "memory: arena %-8s high-water=%.2f MiB (%.1f%% of %.0f MiB) allocs=%llu%s",
+              a->name,
+              a->high_water / (1024.0 * 1024.0),
+              100.0 * a->high_water / a->capacity,
+              a->capacity / (1024.0 * 1024.0),
+              (unsigned long long)a->allocs,
+              a->is_huge ? " huge pages" : "");
+  }
+  for(int i = 0; i < pool_count; ++i)
+  {
+    struct pool *p = pools[i];
+    log_write(LOG_INFO, 
+              "memory: pool %-16s high-water=%d of %d items, %zu bytes each",
+              p->name,
+              p->high_water,
+              p->capacity,
+              p->stride);
+  }
+}
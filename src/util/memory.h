@@ -0,0 +1,187 @@
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Allocators for the three lifetimes of the game's memory:
+ *
+ *   arena  - linear allocation of data freed all at once, e.g. everything
+ *            loaded for a level; one contiguous block, so data allocated
+ *            together sits together.
+ *   frame  - scratch memory valid until the end of the frame; a global arena
+ *            reset after each frame is presented.
+ *   pool   - fixed size items allocated and freed individually, e.g. entities
+ *            and projectiles; items are contiguous in a block taken from an
+ *            arena, freed items are reused first.
+ *
+ * None of them call malloc once created; all memory is reserved up front.
+ * Running out of the reserve is fatal, as for xmalloc. Each allocator keeps
+ * its high-water mark, reported by memory_log_stats.
+ */
+
+#define CACHE_LINE_BYTES 64
+
+/* arena_init flags */
+#define MEMORY_HUGE_PAGES 0x1 /* back with huge pages if possible */
+
+struct arena
+{
+  const char *name;
+  char *base;
+  size_t capacity;
+  size_t used;
+  size_t high_water;
+  uint64_t allocs;
+  bool is_huge;    /* backed by huge pages */
+};
+
+/* a point in an arena to release back to */
+typedef size_t arena_mark;
+
+/* arena_init - reserves 'capacity' bytes of address space for an arena; pages
+ *   are only committed as they are first touched, so a generous capacity
+ *   costs little. Exits the program if the reserve fails.
+ *
+ * @name - for the stats; must outlive the arena, e.g. a literal.
+ */
+void
+arena_init(struct arena *a, const char *name, size_t capacity, int flags);
+
+/* arena_free - unmaps the arena; all its allocations are freed. */
+void
+arena_free(struct arena *a);
+
+/* arena_alloc - allocates 'size' bytes aligned to 'align', a power of 2; exits
+ *   the program if the arena is full. */
+void *
+arena_alloc(struct arena *a, size_t size, size_t align);
+
+static inline arena_mark
+arena_get_mark(const struct arena *a)
+{
+  return a->used;
+}
+
+/* arena_release - frees everything allocated since the mark was taken */
+static inline void
+arena_release(struct arena *a, arena_mark mark)
+{
+  a->used = mark;
+}
+
+static inline void
+arena_reset(struct arena *a)
+{
+  a->used = 0;
+}
+
+/* ARENA_NEW - allocates an array of 'count' 'type's, cache line aligned */
+#define ARENA_NEW(arena, type, count)                                         \
+  ((type *)arena_alloc((arena), sizeof(type) * (count), CACHE_LINE_BYTES))
+
+/* memory_init - creates the frame scratch arena; call before frame_alloc. */
+void
+memory_init(size_t frame_capacity, int flags);
+
+void
+memory_quit();
+
+/* the frame scratch arena; only the main thread allocates from it, but the
+   memory may be used by any thread within the frame */
+extern struct arena memory_frame;
+
+/* frame_alloc - allocates scratch memory, cache line aligned, which is valid
+ *   until the next frame_reset. */
+static inline void *
+frame_alloc(size_t size)
+{
+  return arena_alloc(&memory_frame, size, CACHE_LINE_BYTES);
+}
+
+/* frame_reset - frees all frame allocations; called once a frame is presented */
+static inline void
+frame_reset()
+{
+  arena_reset(&memory_frame);
+}
+
+/* fixed size item pool; use through a typed pool, see POOL_TYPE */
+struct pool
+{
+  const char *name;
+  struct arena *arena; /* the items are freed with the arena */
+  char *items;
+  size_t stride;   /* bytes between items */
+  int capacity;
+  int count;       /* items allocated */
+  int high_water;
+  int free_head;   /* index of the first free item; -1 if none */
+  int untouched;   /* items from here on have never been allocated */
+};
+
+/* pool_init - takes room for 'capacity' items of 'item_size' bytes from the
+ *   arena; items are aligned to 'align', e.g. CACHE_LINE_BYTES for items
+ *   written by different threads. */
+void
+pool_init(struct pool *p, const char *name, size_t item_size, size_t align,
+          int capacity, struct arena *arena);
+
+/* pool_alloc - returns - an uninitialised item, or NULL if the pool is full. */
+void *
+pool_alloc(struct pool *p);
+
+void
+pool_release(struct pool *p, void *item);
+
+static inline int
+pool_index(const struct pool *p, const void *item)
+{
+  return (int)(((const char *)item - p->items) / p->stride);
+}
+
+static inline void *
+pool_at(const struct pool *p, int index)
+{
+  return p->items + p->stride * index;
+}
+
+/**
+ * POOL_TYPE - defines 'struct name', a pool of 'type', and its functions
+ *   name_init, name_alloc, name_release, name_index and name_at. 
+ *
+ * usage:
+ *   POOL_TYPE(projectile_pool, struct projectile)
+ *   ...
+ *   struct projectile_pool projectiles;
+ *   projectile_pool_init(&projectiles, 1024, CACHE_LINE_BYTES, &level_arena);
+ *   struct projectile *p = projectile_pool_alloc(&projectiles);
+ */
+#define POOL_TYPE(name, type)                                                 \
+  struct name {struct pool pool;};                                            \
+  static inline void                                                          \
+  name##_init(struct name *p, int capacity, size_t align, struct arena *arena)\
+  {                                                                           \
+    pool_init(&p->pool, #name, sizeof(type),                                  \
+              align > _Alignof(type) ? align : _Alignof(type),                \
+              capacity, arena);                                               \
+  }                                                                           \
+  static inline type *                                                        \
+  name##_alloc(struct name *p) {return (type *)pool_alloc(&p->pool);}         \
+  static inline void                                                          \
+  name##_release(struct name *p, type *item) {pool_release(&p->pool, item);}  \
+  static inline int                                                           \
+  name##_index(const struct name *p, const type *item)                        \
+  {return pool_index(&p->pool, item);}                                        \
+  static inline type *                                                        \
+  name##_at(const struct name *p, int index)                                  \
+  {return (type *)pool_at(&p->pool, index);}
+
+/* memory_log_stats - logs the usage and high-water marks of all arenas and
+ *   pools. */
+void
+memory_log_stats();
+
+#endif
@@ -0,0 +1,127 @@
+#include <string.h>
+#include <assert.h>
+
+#include "trace.h"
+#include "jobs.h"
+#include "morton.h"
+
+#define MORTON_SORT_RADIX 256
+#define MORTON_SORT_CHUNK 8192 /* keys of a chunk of a pass */
+
+static inline int
+chunk_count(int count)
+{
+  return (count + MORTON_SORT_CHUNK - 1) / MORTON_SORT_CHUNK;
+}
+
+void
+morton_sort_init(struct morton_sort *ms, int capacity, struct arena *arena)
+{
+  assert(ms != NULL && capacity > 0 && arena != NULL);
+
+  ms->capacity = capacity;
+  ms->count = 0;
+  ms->pass = MORTON_SORT_PASSES;
+  ms->current = 0;
+  ms->keys[0] = ARENA_NEW(arena, uint32_t, capacity * 4);
+  ms->keys[1] = ms->keys[0] + capacity;
+  ms->values[0] = ms->keys[1] + capacity;
+  ms->values[1] = ms->values[0] + capacity;
+  ms->counts = ARENA_NEW(arena, int, chunk_count(capacity) * MORTON_SORT_RADIX);
+}
+
+void
+morton_sort_begin(struct morton_sort *ms, int count)
+{
+  assert(count >= 0 && count <= ms->capacity);
+  ms->count = count;
+  ms->pass = 0;
+  ms->current = 0;
+}
+
+/* the range of a chunk's keys */
+static inline void
+chunk_range(const struct morton_sort *ms, int chunk, int *begin, int *end)
+{
+  *begin = chunk * MORTON_SORT_CHUNK;
+  *end = *begin + MORTON_SORT_CHUNK < ms->count ? *begin + MORTON_SORT_CHUNK : ms->count;
+}
+
+static void
+count_job(void *arg, int begin, int end)
+{
+  struct morton_sort *ms = arg;
+  const uint32_t *keys = ms->keys[ms->current];
+  int shift = ms->pass * 8;
+  for(int c = begin; c < end; ++c)
+  {
+    int *counts = ms->counts + c * MORTON_SORT_RADIX;
+    memset(counts, 0, sizeof(int) * MORTON_SORT_RADIX);
+
+    int first, last;
+    chunk_range(ms, c, &first, &last);
+    for(int i = first; i < last; ++i)
+      ++counts[(keys[i] >> shift) & (MORTON_SORT_RADIX - 1)];
+  }
+}
+
+/* scatter_job - each chunk's counts have been replaced by the offsets its
+ * keys of each digit are written from. */
+static void
+scatter_job(void *arg, int begin, int end)
+{
+  struct morton_sort *ms = arg;
+  const uint32_t *keys = ms->keys[ms->current], *values = ms->values[ms->current];
+  uint32_t *keys_out = ms->keys[ms->current ^ 1], *values_out = ms->values[ms->current ^ 1];
+  int shift = ms->pass * 8;
+  for(int c = begin; c < end; ++c)
+  {
+    int *offsets = ms->counts + c * MORTON_SORT_RADIX;
+
+    int first, last;
+    chunk_range(ms, c, &first, &last);
+    for(int i = first; i < last; ++i)
+    {
+      int o = offsets[(keys[i] >> shift) & (MORTON_SORT_RADIX - 1)]++;
+      keys_out[o] = keys[i];
+      values_out[o] = values[i];
+    }
+  }
+}
+
+bool
+morton_sort_step(struct morton_sort *ms)
+{
+  if(ms->pass == MORTON_SORT_PASSES)
+    return true;
+
+  TRACE_ZONE("morton_sort_step");
+
+  int chunks = chunk_count(ms->count);
+  parallel_for(0, chunks, 1, count_job, ms);
+
+  /* the offsets of digit d in chunk c follow those of the smaller digits in
+     every chunk and of digit d in the chunks before c */
+  int offset = 0;
+  bool uniform = false;
+  for(int d = 0; d < MORTON_SORT_RADIX; ++d)
+  {
+    int start = offset;
+    for(int c = 0; c < chunks; ++c)
+    {
+      int *counts = ms->counts + c * MORTON_SORT_RADIX;
+      int n = counts[d];
+      counts[d] = offset;
+      offset += n;
+    }
+    uniform |= offset - start == ms->count;
+  }
+
+  /* every key has the same digit; the pass would not move any */
+  if(!uniform)
+  {
+    parallel_for(0, chunks, 1, scatter_job, ms);
+    ms->current ^= 1;
+  }
+  return ++ms->pass == MORTON_SORT_PASSES;
+}
@@ -0,0 +1,111 @@
+#ifndef _MORTON_H_
+#define _MORTON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "memory.h"
+
+/*
+ * Morton (z-order) codes and a radix sort of values by them.
+ *
+ * The Morton code of a cell of a 3D grid interleaves the bits of the cell's
+ * coordinates, ...z1y1x1z0y0x0, so cells near each other in space are mostly
+ * near each other in the order of their codes; entities stored in the order
+ * of the codes of the cells they are in are stored near their neighbours, and
+ * a pass over them, e.g. to test each against its surroundings, walks space
+ * a neighbourhood at a time rather than at random.
+ *
+ * Codes are of 10 bits of each coordinate; the order wraps every 1024 cells
+ * along an axis, which only costs locality at the seams.
+ *
+ * The sort is a least significant digit radix sort of 8-bit digits, stable,
+ * and runs a digit's pass at a time so a sort may be spread over several
+ * ticks; each pass is split into chunks across the job system, every chunk
+ * counting its digits then scattering its keys to the offsets the counts
+ * give it, so the result is the same however the chunks are run. A pass
+ * whose digit is the same for every key is skipped.
+ */
+
+#define MORTON_AXIS_BITS 10
+#define MORTON_SORT_PASSES 4 /* 8-bit digits of the 30-bit codes */
+
+/* morton_spread - the low 10 bits of 'v' spread to every third bit. */
+static inline uint32_t
+morton_spread(uint32_t v)
+{
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+/* morton_code - the code of the grid cell (x, y, z); the low 10 bits of each
+ *   coordinate are used. */
+static inline uint32_t
+morton_code(uint32_t x, uint32_t y, uint32_t z)
+{
+  return morton_spread(x) | (morton_spread(y) << 1) | (morton_spread(z) << 2);
+}
+
+/* morton_code_at - the code of the cell of side 'cell_m' containing the point;
+ *   negative coordinates wrap like any other. */
+static inline uint32_t
+morton_code_at(float x, float y, float z, float cell_m)
+{
+  return morton_code((uint32_t)(int32_t)floorf(x / cell_m),
+                     (uint32_t)(int32_t)floorf(y / cell_m),
+                     (uint32_t)(int32_t)floorf(z / cell_m));
+}
+
+/* the state of a sort of up to 'capacity' values by 32-bit keys; the keys
+ * and values are double buffered, each pass scattering from one buffer to
+ * the other */
+struct morton_sort
+{
+  int capacity;
+  int count;
+  int pass;               /* the next; MORTON_SORT_PASSES once sorted */
+  int current;            /* the buffer the keys and values are in */
+  uint32_t *keys[2];
+  uint32_t *values[2];
+  int *counts;            /* of each chunk's digits */
+};
+
+/* morton_sort_init - room to sort 'capacity' values, allocated from the arena;
+ *   e.g. frame scratch for a sort done within a frame. */
+void
+morton_sort_init(struct morton_sort *ms, int capacity, struct arena *arena);
+
+/* morton_sort_begin - starts a sort of 'count' values; fill morton_sort_keys
+ *   and morton_sort_values with them before the first step. */
+void
+morton_sort_begin(struct morton_sort *ms, int count);
+
+/* morton_sort_step - runs the next pass of the sort.
+ *
+ * returns - true once the values are sorted.
+ */
+bool
+morton_sort_step(struct morton_sort *ms);
+
+/* morton_sort_run - runs the remaining passes of the sort. */
+static inline void
+morton_sort_run(struct morton_sort *ms)
+{
+  while(!morton_sort_step(ms))
+    ;
+}
+
+/* the keys and values of the sort; to fill after begin, and sorted by key in
+   ascending order, ties in the order filled, once the sort is done */
+static inline uint32_t *
+morton_sort_keys(struct morton_sort *ms){return ms->keys[ms->current];}
+
+static inline uint32_t *
+morton_sort_values(struct morton_sort *ms){return ms->values[ms->current];}
+
+#endif
@@ -0,0 +1,163 @@
+#include <time.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "clock.h"
+#include "log.h"
+#include "pacer.h"
+
+/* bounds of the spin margin; it starts at the max and settles to twice the
+   average oversleep of the sleeps */
+#define MIN_SPIN_NS 50000
+#define MAX_SPIN_NS 2000000
+
+/* weight of each sleep's oversleep in the moving average */
+#define OVERSLEEP_WEIGHT (1.0 / 16.0)
+
+static const char *mode_names[PACER_MODE_COUNT] = {"vsync", "capped", "uncapped"};
+
+static inline uint64_t
+clamp_ns(uint64_t ns, uint64_t lo, uint64_t hi)
+{
+  return ns < lo ? lo : ns > hi ? hi : ns;
+}
+
+static void
+reset_stats(struct frame_pacer *p, uint64_t now_ns)
+{
+  p->waits = 0;
+  p->late_ns = p->late_max_ns = 0;
+  p->slept_ns = p->spun_ns = 0;
+  p->frames = 0;
+  p->frame_error_ns = p->frame_error_max_ns = 0;
+  p->missed = 0;
+  p->report_start_ns = now_ns;
+}
+
+void
+pacer_init(struct frame_pacer *p, enum pacer_mode mode, double cap_interval_s, double target_interval_s)
+{
+  assert(p != NULL && mode >= 0 && mode < PACER_MODE_COUNT);
+  assert(mode != PACER_CAPPED || cap_interval_s > 0.0);
+
+  uint64_t now_ns = clock_now_ns();
+  p->mode = mode;
+  p->cap_interval_ns = mode == PACER_CAPPED ? (uint64_t)(cap_interval_s * 1e9) : 0;
+  p->target_interval_ns = (uint64_t)(target_interval_s * 1e9);
+  p->next_frame_ns = now_ns;
+  p->last_present_ns = 0;
+  p->spin_ns = MAX_SPIN_NS;
+  p->oversleep_ns = MAX_SPIN_NS / 2;
+  reset_stats(p, now_ns);
+}
+
+const char *
+pacer_mode_name(enum pacer_mode mode)
+{
+  return mode_names[mode];
+}
+
+void
+pacer_frame_begin(struct frame_pacer *p, uint64_t now_ns)
+{
+  if(p->mode != PACER_CAPPED)
+    return;
+
+  /* keep to the cap's schedule, unless so far behind it the frames would run
+     back to back to catch up */
+  p->next_frame_ns += p->cap_interval_ns;
+  if(p->next_frame_ns + p->cap_interval_ns < now_ns)
+    p->next_frame_ns = now_ns + p->cap_interval_ns;
+}
+
+void
+pacer_frame_presented(struct frame_pacer *p, uint64_t now_ns)
+{
+  if(p->last_present_ns)
+  {
+    uint64_t interval_ns = now_ns - p->last_present_ns;
+    uint64_t error_ns = interval_ns > p->target_interval_ns ?
+                        interval_ns - p->target_interval_ns :
+                        p->target_interval_ns - interval_ns;
+    p->frame_error_ns += error_ns;
+    if(error_ns > p->frame_error_max_ns)
+      p->frame_error_max_ns = error_ns;
+    if(interval_ns * 2 > p->target_interval_ns * 3)
+      ++p->missed;
+    ++p->frames;
+  }
+  p->last_present_ns = now_ns;
+}
+
+uint64_t
+pacer_wait_until(struct frame_pacer *p, uint64_t deadline_ns)
+{
+  uint64_t now_ns = clock_now_ns();
+  if(now_ns >= deadline_ns)
+    return 0;
+
+  uint64_t wait_start_ns = now_ns;
+
+  /* sleep relative to now rather than to an absolute CLOCK_MONOTONIC time, as
+     the timestamps' timeline may drift from CLOCK_MONOTONIC's over a long run */
+  if(deadline_ns - now_ns > p->spin_ns)
+  {
+    uint64_t sleep_ns = deadline_ns - now_ns - p->spin_ns;
+    struct timespec duration = {(time_t)(sleep_ns / 1000000000ull), (long)(sleep_ns % 1000000000ull)};
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, NULL);
+
+    uint64_t woke_ns = clock_now_ns();
+    uint64_t oversleep_ns = woke_ns > now_ns + sleep_ns ? woke_ns - (now_ns + sleep_ns) : 0;
+    p->oversleep_ns += (oversleep_ns - p->oversleep_ns) * OVERSLEEP_WEIGHT;
+    p->spin_ns = clamp_ns((uint64_t)(p->oversleep_ns * 2.0), MIN_SPIN_NS, MAX_SPIN_NS);
+    p->slept_ns += woke_ns - now_ns;
+    now_ns = woke_ns;
+  }
+
+  uint64_t spin_start_ns = now_ns;
+  while(now_ns < deadline_ns)
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+    now_ns = clock_now_ns();
+  }
+  p->spun_ns += now_ns - spin_start_ns;
+
+  uint64_t late_ns = now_ns - deadline_ns;
+  p->late_ns += late_ns;
+  if(late_ns > p->late_max_ns)
+    p->late_max_ns = late_ns;
+  ++p->waits;
+  return now_ns - wait_start_ns;
+}
+
+void
+pacer_log_report(struct frame_pacer *p)
+{
+  uint64_t now_ns = clock_now_ns();
+  double elapsed_ns = (double)(now_ns - p->report_start_ns);
+  if(elapsed_ns <= 0.0)
+    return;
+
+  log_write(LOG_INFO,
+            "pacing: %s, %llu frames: present error mean=%.3f max=%.3f ms vs %.3f ms, %llu missed",
+            mode_names[p->mode],
+            (unsigned long long)p->frames,
+            p->frames ? (p->frame_error_ns * 1e-6) / p->frames : 0.0,
+            p->frame_error_max_ns * 1e-6,
+            p->target_interval_ns * 1e-6,
+            (unsigned long long)p->missed);
+  log_write(LOG_INFO,
+            "pacing: %llu waits: late mean=%.1f max=%.1f us, slept %.1f%% spun %.1f%% of the time, spin margin %.1f us",
+            (unsigned long long)p->waits,
+            p->waits ? (p->late_ns * 1e-3) / p->waits : 0.0,
+            p->late_max_ns * 1e-3,
+            100.0 * p->slept_ns / elapsed_ns,
+            100.0 * p->spun_ns / elapsed_ns,
+            p->spin_ns * 1e-3);
+  reset_stats(p, now_ns);
+}
@@ -0,0 +1,101 @@
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Frame pacing; waits for the game loop's next deadline (a tick, or a frame
+ * of a capped frame rate) without burning a core.
+ *
+ * A wait sleeps until shortly before the deadline then spins the rest of the
+ * way, as a sleep can overshoot by tens to hundreds of microseconds. The spin
+ * margin adapts to how late the sleeps of this machine wake, so the pacer
+ * spins only as long as it must to hit the deadline.
+ */
+
+/* how presented frames are paced */
+enum pacer_mode
+{
+  PACER_VSYNC = 0, /* presents wait for the display's vertical blank */
+  PACER_CAPPED,    /* frames begin no more often than a cap; no vsync */
+  PACER_UNCAPPED,  /* frames are presented as soon as they are drawn */
+  PACER_MODE_COUNT
+};
+
+struct frame_pacer
+{
+  enum pacer_mode mode;
+  uint64_t cap_interval_ns;    /* capped: least time between frame starts */
+  uint64_t target_interval_ns; /* expected time between presents */
+  uint64_t next_frame_ns;      /* capped: earliest start of the next frame */
+  uint64_t last_present_ns;
+
+  uint64_t spin_ns;            /* margin before a deadline spent spinning */
+  double oversleep_ns;         /* moving average of sleeps' late wakes */
+
+  /* pacing since the last report */
+  uint64_t waits;
+  uint64_t late_ns;            /* total and max lateness of waits' wakes */
+  uint64_t late_max_ns;
+  uint64_t slept_ns;
+  uint64_t spun_ns;
+  uint64_t frames;
+  uint64_t frame_error_ns;     /* total and max |present interval - target| */
+  uint64_t frame_error_max_ns;
+  uint64_t missed;             /* presents over 1.5 target intervals apart */
+  uint64_t report_start_ns;
+};
+
+/* pacer_init - starts pacing frames in 'mode'.
+ *
+ * @cap_interval_s - capped mode: the least time between the starts of frames.
+ * @target_interval_s - the expected time between presents, e.g. the refresh
+ *   interval with vsync; pacing errors are measured against it.
+ */
+void
+pacer_init(struct frame_pacer *p, enum pacer_mode mode, double cap_interval_s, double target_interval_s);
+
+/* pacer_mode_name - the mode as named by the --pacing option. */
+const char *
+pacer_mode_name(enum pacer_mode mode);
+
+/* pacer_frame_due - true if a frame may start now; only ever false in capped
+ *   mode, before the cap allows the next frame. */
+static inline bool
+pacer_frame_due(const struct frame_pacer *p, uint64_t now_ns)
+{
+  return p->mode != PACER_CAPPED || now_ns >= p->next_frame_ns;
+}
+
+/* pacer_next_frame_ns - the earliest time the next frame may start. */
+static inline uint64_t
+pacer_next_frame_ns(const struct frame_pacer *p)
+{
+  return p->mode == PACER_CAPPED ? p->next_frame_ns : 0;
+}
+
+/* pacer_frame_begin - a frame started at 'now_ns'; moves the cap's deadline
+ *   on. */
+void
+pacer_frame_begin(struct frame_pacer *p, uint64_t now_ns);
+
+/* pacer_frame_presented - a frame was presented at 'now_ns'; measures the
+ *   present interval against the target. */
+void
+pacer_frame_presented(struct frame_pacer *p, uint64_t now_ns);
+
+/* pacer_wait_until - sleeps then spins until the clock_now_ns time
+ *   'deadline_ns'; returns at once if it has passed.
+ *
+ * returns - the time waited in nanoseconds.
+ */
+uint64_t
+pacer_wait_until(struct frame_pacer *p, uint64_t deadline_ns);
+
+/* pacer_log_report - logs the pacing errors and the time slept and spun since
+ *   the last report, then resets them. */
+void
+pacer_log_report(struct frame_pacer *p);
+
+#endif
@@ -0,0 +1,85 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "log.h"
+#include "perf.h"
+
+static const uint64_t counter_configs[PERF_COUNTER_COUNT] = {
+  PERF_COUNT_HW_CACHE_REFERENCES,
+  PERF_COUNT_HW_CACHE_MISSES
+};
+
+static const char *counter_names[PERF_COUNTER_COUNT] = {"cache references", "cache misses"};
+
+static int
+open_counter(uint64_t config, int group_fd)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = group_fd < 0; /* the group starts as one once complete */
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+bool
+perf_counters_open(struct perf_counters *pc)
+{
+  pc->available = false;
+  for(int c = 0; c < PERF_COUNTER_COUNT; ++c)
+    pc->fd[c] = -1;
+
+  for(int c = 0; c < PERF_COUNTER_COUNT; ++c)
+  {
+    pc->fd[c] = open_counter(counter_configs[c], pc->fd[0]);
+    if(pc->fd[c] < 0)
+    {
+      log_write(LOG_WARNING,
+                "perf: no %s counter, cache counts unavailable: %s",
+                counter_names[c],
+                strerror(errno));
+      perf_counters_close(pc);
+      return false;
+    }
+  }
+
+  ioctl(pc->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(pc->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  pc->available = true;
+  return true;
+}
+
+void
+perf_counters_read(const struct perf_counters *pc, struct perf_sample *out)
+{
+  memset(out, 0, sizeof(struct perf_sample));
+  if(!pc->available)
+    return;
+
+  /* a group reads as the number of counters then each counter's value */
+  uint64_t values[1 + PERF_COUNTER_COUNT];
+  if(read(pc->fd[0], values, sizeof(values)) != (ssize_t)sizeof(values) || values[0] != PERF_COUNTER_COUNT)
+    return;
+  for(int c = 0; c < PERF_COUNTER_COUNT; ++c)
+    out->count[c] = values[1 + c];
+}
+
+void
+perf_counters_close(struct perf_counters *pc)
+{
+  for(int c = PERF_COUNTER_COUNT - 1; c >= 0; --c)
+  {
+    if(pc->fd[c] >= 0)
+      close(pc->fd[c]);
+    pc->fd[c] = -1;
+  }
+  pc->available = false;
+}
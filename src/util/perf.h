@@ -0,0 +1,62 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Hardware cache counters of the calling thread, read through the kernel's
+ * perf_event_open; e.g. to compare the cache misses of a pass over memory in
+ * two orders. The counters count the thread's user space work only, not
+ * that of the job system's other threads, so measure a run on one thread to
+ * count all of it.
+ *
+ * The counters are a group, read at once. Virtual machines and containers
+ * often have no hardware counters, and perf_event_paranoid may forbid them;
+ * the counters are then unavailable, read as zero, and the reason is logged.
+ */
+
+enum perf_counter
+{
+  PERF_CACHE_REFERENCES = 0, /* accesses to the last level cache */
+  PERF_CACHE_MISSES,         /* of those, misses; i.e. went to memory */
+  PERF_COUNTER_COUNT
+};
+
+struct perf_counters
+{
+  bool available;
+  int fd[PERF_COUNTER_COUNT]; /* fd[0] leads the group */
+};
+
+/* a reading of the counters */
+struct perf_sample
+{
+  uint64_t count[PERF_COUNTER_COUNT];
+};
+
+/* perf_counters_open - opens and starts the calling thread's counters.
+ *
+ * returns - false if the counters are unavailable; they may still be read
+ *   and closed.
+ */
+bool
+perf_counters_open(struct perf_counters *pc);
+
+/* perf_counters_read - the counts since open. */
+void
+perf_counters_read(const struct perf_counters *pc, struct perf_sample *out);
+
+void
+perf_counters_close(struct perf_counters *pc);
+
+/* perf_sample_add - adds the counts between readings 'from' and 'to' to
+ *   'total'. */
+static inline void
+perf_sample_add(struct perf_sample *total, const struct perf_sample *from, const struct perf_sample *to)
+{
+  for(int c = 0; c < PERF_COUNTER_COUNT; ++c)
+    total->count[c] += to->count[c] - from->count[c];
+}
+
+#endif
@@ -0,0 +1,330 @@
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "rng.h"
+
+/* Philox4x32 multipliers and Weyl key increments */
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/* words generated at a time by the batch functions; a multiple of a block */
+#define RNG_CHUNK_WORDS 256
+
+#define RNG_TWO_PI 6.28318530718f
+
+struct rng_stream
+rng_stream(uint32_t seed, uint64_t entity, enum rng_purpose purpose, uint32_t tick)
+{
+  assert(purpose >= 0 && purpose < RNG_PURPOSE_COUNT);
+  return (struct rng_stream){{seed, (uint32_t)purpose}, tick, entity, 0};
+}
+
+/* philox_block - block 'block' of the stream, i.e. 4 words. */
+static void
+philox_block(const struct rng_stream *s, uint32_t block, uint32_t out[4])
+{
+  uint32_t c0 = block, c1 = s->tick, c2 = (uint32_t)s->entity, c3 = (uint32_t)(s->entity >> 32);
+  uint32_t k0 = s->key[0], k1 = s->key[1];
+  for(int r = 0; r < PHILOX_ROUNDS; ++r)
+  {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+#if defined(__AVX2__)
+
+/* mulhilo - the high and low halves of the 64-bit products of the lanes */
+static inline void
+mulhilo(__m256i a, __m256i m, __m256i *hi, __m256i *lo)
+{
+  __m256i p02 = _mm256_mul_epu32(a, m);
+  __m256i p13 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+  p02 = _mm256_shuffle_epi32(p02, _MM_SHUFFLE(3, 1, 2, 0));
+  p13 = _mm256_shuffle_epi32(p13, _MM_SHUFFLE(3, 1, 2, 0));
+  *lo = _mm256_unpacklo_epi32(p02, p13);
+  *hi = _mm256_unpackhi_epi32(p02, p13);
+}
+
+#elif defined(__SSE2__)
+
+static inline void
+mulhilo(__m128i a, __m128i m, __m128i *hi, __m128i *lo)
+{
+  __m128i p02 = _mm_mul_epu32(a, m);
+  __m128i p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+  p02 = _mm_shuffle_epi32(p02, _MM_SHUFFLE(3, 1, 2, 0));
+  p13 = _mm_shuffle_epi32(p13, _MM_SHUFFLE(3, 1, 2, 0));
+  *lo = _mm_unpacklo_epi32(p02, p13);
+  *hi = _mm_unpackhi_epi32(p02, p13);
+}
+
+#endif
+
+/* philox_blocks - 'count' consecutive blocks of the stream from 'first'; each
+ * lane of a vector computes a block, the lanes are then transposed so the
+ * words are stored in order. */
+static void
+philox_blocks(const struct rng_stream *s, uint32_t first, int count, uint32_t *out)
+{
+  int b = 0;
+
+#if defined(__AVX2__)
+
+  const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+  const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  for(; b + 8 <= count; b += 8)
+  {
+    __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int)(first + b)), lanes);
+    __m256i c1 = _mm256_set1_epi32((int)s->tick);
+    __m256i c2 = _mm256_set1_epi32((int)(uint32_t)s->entity);
+    __m256i c3 = _mm256_set1_epi32((int)(uint32_t)(s->entity >> 32));
+    uint32_t k0 = s->key[0], k1 = s->key[1];
+    for(int r = 0; r < PHILOX_ROUNDS; ++r)
+    {
+      __m256i hi0, lo0, hi1, lo1;
+      mulhilo(c0, m0, &hi0, &lo0);
+      mulhilo(c2, m1, &hi1, &lo1);
+      c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+      c1 = lo1;
+      c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+      c3 = lo0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+
+    /* transposed within each half; the low halves hold blocks 0-3, the high
+       halves blocks 4-7 */
+    __m256i t0 = _mm256_unpacklo_epi32(c0, c1);
+    __m256i t1 = _mm256_unpacklo_epi32(c2, c3);
+    __m256i t2 = _mm256_unpackhi_epi32(c0, c1);
+    __m256i t3 = _mm256_unpackhi_epi32(c2, c3);
+    __m256i r0 = _mm256_unpacklo_epi64(t0, t1);
+    __m256i r1 = _mm256_unpackhi_epi64(t0, t1);
+    __m256i r2 = _mm256_unpacklo_epi64(t2, t3);
+    __m256i r3 = _mm256_unpackhi_epi64(t2, t3);
+    __m256i *o = (__m256i *)(out + 4 * b);
+    _mm256_storeu_si256(o + 0, _mm256_permute2x128_si256(r0, r1, 0x20));
+    _mm256_storeu_si256(o + 1, _mm256_permute2x128_si256(r2, r3, 0x20));
+    _mm256_storeu_si256(o + 2, _mm256_permute2x128_si256(r0, r1, 0x31));
+    _mm256_storeu_si256(o + 3, _mm256_permute2x128_si256(r2, r3, 0x31));
+  }
+
+#elif defined(__SSE2__)
+
+  const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+  const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+  const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+  for(; b + 4 <= count; b += 4)
+  {
+    __m128i c0 = _mm_add_epi32(_mm_set1_epi32((int)(first + b)), lanes);
+    __m128i c1 = _mm_set1_epi32((int)s->tick);
+    __m128i c2 = _mm_set1_epi32((int)(uint32_t)s->entity);
+    __m128i c3 = _mm_set1_epi32((int)(uint32_t)(s->entity >> 32));
+    uint32_t k0 = s->key[0], k1 = s->key[1];
+    for(int r = 0; r < PHILOX_ROUNDS; ++r)
+    {
+      __m128i hi0, lo0, hi1, lo1;
+      mulhilo(c0, m0, &hi0, &lo0);
+      mulhilo(c2, m1, &hi1, &lo1);
+      c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int)k0));
+      c1 = lo1;
+      c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int)k1));
+      c3 = lo0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+
+    __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+    __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+    __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+    __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+    __m128i *o = (__m128i *)(out + 4 * b);
+    _mm_storeu_si128(o + 0, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128(o + 1, _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128(o + 2, _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128(o + 3, _mm_unpackhi_epi64(t2, t3));
+  }
+
+#endif
+
+  /* scalar tail, or everything if no SIMD */
+  for(; b < count; ++b)
+    philox_block(s, first + b, out + 4 * b);
+}
+
+/* stream_words - the 'count' words of the stream from 'position'; a block
+ * the range starts or ends part way through is generated whole. */
+static void
+stream_words(const struct rng_stream *s, uint64_t position, uint32_t *out, int count)
+{
+  uint32_t block = (uint32_t)(position >> 2);
+  uint32_t partial[4];
+  int n = 0;
+
+  int offset = (int)(position & 3);
+  if(offset && count > 0)
+  {
+    philox_block(s, block++, partial);
+    n = 4 - offset < count ? 4 - offset : count;
+    memcpy(out, partial + offset, sizeof(uint32_t) * n);
+  }
+
+  int whole = (count - n) / 4;
+  philox_blocks(s, block, whole, out + n);
+  n += whole * 4;
+  block += whole;
+
+  if(n < count)
+  {
+    philox_block(s, block, partial);
+    memcpy(out + n, partial, sizeof(uint32_t) * (count - n));
+  }
+}
+
+void
+rng_words(struct rng_stream *s, uint32_t *out, int count)
+{
+  assert(count >= 0);
+  stream_words(s, s->position, out, count);
+  s->position += count;
+}
+
+/* unit - the top 24 bits of a word as a float in [0, 1); exact */
+static inline float
+unit(uint32_t word)
+{
+  return (float)(word >> 8) * (1.f / 16777216.f);
+}
+
+static void
+words_to_unit(const uint32_t *words, float *out, int count)
+{
+  int i = 0;
+
+#if defined(__AVX2__)
+
+  const __m256 scale = _mm256_set1_ps(1.f / 16777216.f);
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i w = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i *)(words + i)), 8);
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(w), scale));
+  }
+
+#elif defined(__SSE2__)
+
+  const __m128 scale = _mm_set1_ps(1.f / 16777216.f);
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i w = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)(words + i)), 8);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(w), scale));
+  }
+
+#endif
+
+  for(; i < count; ++i)
+    out[i] = unit(words[i]);
+}
+
+void
+rng_uniform(struct rng_stream *s, float *out, int count)
+{
+  uint32_t words[RNG_CHUNK_WORDS];
+  for(int i = 0; i < count; i += RNG_CHUNK_WORDS)
+  {
+    int n = count - i < RNG_CHUNK_WORDS ? count - i : RNG_CHUNK_WORDS;
+    rng_words(s, words, n);
+    words_to_unit(words, out + i, n);
+  }
+}
+
+void
+rng_normal(struct rng_stream *s, float *out, int count)
+{
+  uint32_t words[RNG_CHUNK_WORDS];
+  float z[RNG_CHUNK_WORDS];
+  for(int i = 0; i < count;)
+  {
+    /* the normals of a pair of words are generated together, so a batch
+       starting or ending part way through a pair generates the whole pair */
+    int skip = (int)(s->position & 1);
+    int n = count - i < RNG_CHUNK_WORDS - 2 ? count - i : RNG_CHUNK_WORDS - 2;
+    int pairs = (skip + n + 1) / 2;
+    stream_words(s, s->position - skip, words, pairs * 2);
+
+    for(int p = 0; p < pairs; ++p)
+    {
+      /* u0 in (0, 1] so its log is finite */
+      float u0 = (float)((words[2 * p] >> 8) + 1) * (1.f / 16777216.f);
+      float a = RNG_TWO_PI * unit(words[2 * p + 1]);
+      float r = sqrtf(-2.f * logf(u0));
+      z[2 * p] = r * cosf(a);
+      z[2 * p + 1] = r * sinf(a);
+    }
+
+    memcpy(out + i, z + skip, sizeof(float) * n);
+    s->position += n;
+    i += n;
+  }
+}
+
+/* sphere - the points of rng_on_sphere or, if 'volume', rng_in_sphere; the
+ * polar angle is the arc cosine of a uniform z so the points are uniform over
+ * the surface rather than bunched at the poles, the cube root of a uniform
+ * radius likewise through the volume. */
+static void
+sphere(struct rng_stream *s, struct vector4f *out, int count, float radius, bool volume)
+{
+  uint32_t words[RNG_CHUNK_WORDS];
+
+  /* a sample takes a block, so starts at the next whole block */
+  s->position = (s->position + 3) & ~(uint64_t)3;
+  for(int i = 0; i < count; i += RNG_CHUNK_WORDS / 4)
+  {
+    int n = count - i < RNG_CHUNK_WORDS / 4 ? count - i : RNG_CHUNK_WORDS / 4;
+    rng_words(s, words, n * 4);
+    for(int j = 0; j < n; ++j)
+    {
+      const uint32_t *w = words + 4 * j;
+      struct spherical4f p = {
+        .r = volume ? radius * cbrtf(unit(w[2])) : radius,
+        .theta = RNG_TWO_PI * unit(w[0]),
+        .phi = acosf(1.f - 2.f * unit(w[1])),
+        .w = 1.f
+      };
+      out[i + j] = spherical_to_cartesian4fv(p);
+    }
+  }
+}
+
+void
+rng_on_sphere(struct rng_stream *s, struct vector4f *out, int count, float radius)
+{
+  sphere(s, out, count, radius, false);
+}
+
+void
+rng_in_sphere(struct rng_stream *s, struct vector4f *out, int count, float radius)
+{
+  sphere(s, out, count, radius, true);
+}
@@ -0,0 +1,88 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <stdint.h>
+
+#include "../math/vector4f.h"
+
+/*
+ * Counter-based random numbers; Philox4x32-10 (Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3", SC'11).
+ *
+ * A counter-based generator has no sequential state: the n'th block of four
+ * words of a stream is a bijection of the counter n under a key, so any
+ * block can be computed directly, in any order, on any thread. A stream is
+ * named by what it is for rather than by who draws from it:
+ *
+ *   key     - (world seed, purpose)
+ *   counter - (block, tick, entity)
+ *
+ * e.g. the fragments of asteroid 17 broken on tick 300 are drawn from the
+ * stream (seed, RNG_FRAGMENT, 300, 17); the same fragments result however
+ * the work is split between threads, whatever the thread count and whether
+ * or not it is vectorised, and without any draw of another stream changing
+ * them. Parallel jobs each open the streams of the entities they process;
+ * opening a stream costs nothing.
+ *
+ * Batches of blocks are generated 8 (AVX2) or 4 (SSE2) at a time with a
+ * scalar tail; the vector and scalar paths give identical words. The floats
+ * are derived from the words with exact integer arithmetic, or with libm
+ * (normal and sphere samples), so are deterministic for a given platform.
+ *
+ * A stream's samples are a function of their position in the stream only, so
+ * a batch drawn in one call is the same as in several smaller calls. Normals
+ * are drawn in pairs from aligned pairs of words, sphere samples take a block
+ * each; draw a single kind from a stream, or the kinds may be correlated.
+ */
+
+/* what a stream is for; streams of different purposes are independent */
+enum rng_purpose
+{
+  RNG_SPAWN = 0,  /* placement of new entities */
+  RNG_FRAGMENT,   /* the pieces an entity breaks into */
+  RNG_PARTICLES,  /* visual effects */
+  RNG_PURPOSE_COUNT
+};
+
+struct rng_stream
+{
+  uint32_t key[2];   /* world seed, purpose */
+  uint32_t tick;
+  uint64_t entity;
+  uint64_t position; /* words drawn so far */
+};
+
+/* rng_stream - the stream of 'entity's randomness for 'purpose' on 'tick';
+ *   streams of differing arguments are independent. */
+struct rng_stream
+rng_stream(uint32_t seed, uint64_t entity, enum rng_purpose purpose, uint32_t tick);
+
+/* rng_words - the next 'count' raw 32-bit words of the stream. */
+void
+rng_words(struct rng_stream *s, uint32_t *out, int count);
+
+/* rng_uniform - the next 'count' uniform floats in [0, 1); each of 24 bits
+ *   of precision and taking a word of the stream. */
+void
+rng_uniform(struct rng_stream *s, float *out, int count);
+
+/* rng_normal - the next 'count' normally distributed floats of mean 0 and
+ *   standard deviation 1; each taking a word of the stream (Box-Muller). */
+void
+rng_normal(struct rng_stream *s, float *out, int count);
+
+/* rng_on_sphere - the next 'count' points uniformly distributed on the
+ *   surface of the sphere of 'radius' about the origin; each taking a block
+ *   of the stream.
+ *
+ * note - the points are positions; w = 1.
+ */
+void
+rng_on_sphere(struct rng_stream *s, struct vector4f *out, int count, float radius);
+
+/* rng_in_sphere - as rng_on_sphere but the points are uniformly distributed
+ *   through the volume of the sphere. */
+void
+rng_in_sphere(struct rng_stream *s, struct vector4f *out, int count, float radius);
+
+#endif
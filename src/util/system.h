@@ -4,13 +4,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#ifndef LIKELY /* util.h defines them too */
 #define LIKELY(cond) __builtin_expect((cond), 1)
 #define UNLIKELY(cond) __builtin_expect((cond), 0)
+#endif
 
+/* xcheck - exits if an allocation failed.
+ *
+ * returns - 'mem'.
+ */
 static inline void *
-xmalloc(size_t size)
+xcheck(void *mem)
 {
-  void *mem = malloc(size);
   if(UNLIKELY(mem == 0))
   {
     fprintf(stderr, "fatal: out of memory\n");
@@ -19,4 +24,22 @@ xmalloc(size_t size)
   return mem;
 }
 
+static inline void *
+xmalloc(size_t size)
+{
+  return xcheck(malloc(size));
+}
+
+static inline void *
+xrealloc(void *mem, size_t size)
+{
+  return xcheck(realloc(mem, size));
+}
+
+static inline void *
+xaligned_alloc(size_t alignment, size_t size)
+{
+  return xcheck(aligned_alloc(alignment, size));
+}
+
 #endif
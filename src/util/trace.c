@@ -0,0 +1,249 @@
+#ifdef TRACE_ENABLED
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "system.h"
+#include "log.h"
+#include "trace.h"
+
+/* zones per buffer; a thread hands over its buffer each time it fills */
+#define TRACE_CHUNK_ZONES 4096
+
+struct trace_event
+{
+  const char *name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+struct trace_chunk
+{
+  struct trace_chunk *next;
+  int tid;
+  int count;
+  struct trace_event events[TRACE_CHUNK_ZONES];
+};
+
+struct trace_thread
+{
+  struct trace_thread *next;
+  int tid;
+  const char *name;
+  struct trace_chunk *chunk; /* being filled; only touched by its thread */
+};
+
+static struct
+{
+  bool is_init;
+  FILE *file;
+  bool is_first;             /* no event written yet; for the commas */
+  uint64_t start_ns;
+
+  pthread_mutex_t lock;      /* guards all below */
+  pthread_cond_t wake;
+  bool quit;
+  struct trace_chunk *full;  /* waiting to be written, oldest first */
+  struct trace_chunk *full_tail;
+  struct trace_chunk *spare; /* written and ready for reuse */
+  struct trace_thread *threads;
+  int thread_count;
+
+  pthread_t writer;
+} trace;
+
+static __thread struct trace_thread *self;
+
+static struct trace_chunk *
+take_chunk(int tid)
+{
+  struct trace_chunk *chunk = trace.spare;
+  if(chunk)
+    trace.spare = chunk->next;
+  else
+    chunk = xmalloc(sizeof(struct trace_chunk));
+  chunk->next = NULL;
+  chunk->tid = tid;
+  chunk->count = 0;
+  return chunk;
+}
+
+static struct trace_thread *
+register_thread()
+{
+  struct trace_thread *t = xmalloc(sizeof(struct trace_thread));
+  pthread_mutex_lock(&trace.lock);
+  t->tid = trace.thread_count++;
+  t->name = NULL;
+  t->chunk = take_chunk(t->tid);
+  t->next = trace.threads;
+  trace.threads = t;
+  pthread_mutex_unlock(&trace.lock);
+  return t;
+}
+
+static void
+write_chunk(const struct trace_chunk *chunk)
+{
+  for(int i = 0; i < chunk->count; ++i)
+  {
+    const struct trace_event *e = &chunk->events[i];
+    fprintf(trace.file,
+            "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            trace.is_first ? "" : ",",
+            e->name,
+            chunk->tid,
+            (e->begin_ns - trace.start_ns) * 1e-3,
+            (e->end_ns - e->begin_ns) * 1e-3);
+    trace.is_first = false;
+  }
+}
+
+/* writer_main - writes out the full chunks as they are handed over; only this
+ * thread writes the file until it is joined. */
+static void *
+writer_main(void *arg)
+{
+  (void)arg;
+  pthread_mutex_lock(&trace.lock);
+  while(true)
+  {
+    while(!trace.full && !trace.quit)
+      pthread_cond_wait(&trace.wake, &trace.lock);
+    if(!trace.full)
+      break;
+
+    struct trace_chunk *batch = trace.full;
+    trace.full = trace.full_tail = NULL;
+    pthread_mutex_unlock(&trace.lock);
+
+    struct trace_chunk *last = batch;
+    for(struct trace_chunk *c = batch; c; c = c->next)
+    {
+      write_chunk(c);
+      last = c;
+    }
+
+    pthread_mutex_lock(&trace.lock);
+    last->next = trace.spare;
+    trace.spare = batch;
+  }
+  pthread_mutex_unlock(&trace.lock);
+  return NULL;
+}
+
+void
+trace_init(const char *path)
+{
+  assert(!trace.is_init);
+  trace.file = fopen(path, "w");
+  if(!trace.file)
+  {
+    log_write(LOG_FATAL, "failed to open trace file '%s'", path);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(trace.file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  trace.is_first = true;
+  trace.start_ns = clock_now_ns();
+
+  pthread_mutex_init(&trace.lock, NULL);
+  pthread_cond_init(&trace.wake, NULL);
+  trace.quit = false;
+  if(pthread_create(&trace.writer, NULL, writer_main, NULL))
+  {
+    log_write(LOG_FATAL, "failed to create trace writer thread");
+    exit(EXIT_FAILURE);
+  }
+
+  log_write(LOG_INFO, "tracing to '%s'", path);
+  trace.is_init = true;
+}
+
+void
+trace_quit()
+{
+  if(!trace.is_init)
+    return;
+  trace.is_init = false;
+
+  pthread_mutex_lock(&trace.lock);
+  trace.quit = true;
+  pthread_cond_signal(&trace.wake);
+  pthread_mutex_unlock(&trace.lock);
+  pthread_join(trace.writer, NULL);
+
+  /* the writer has written all full chunks; what remain are the partially
+     filled chunks of each thread */
+  struct trace_thread *t = trace.threads;
+  while(t)
+  {
+    struct trace_thread *next = t->next;
+    write_chunk(t->chunk);
+    if(t->name)
+    {
+      fprintf(trace.file,
+              "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+              trace.is_first ? "" : ",",
+              t->tid,
+              t->name);
+      trace.is_first = false;
+    }
+    free(t->chunk);
+    free(t);
+    t = next;
+  }
+  trace.threads = NULL;
+  self = NULL;
+
+  while(trace.spare)
+  {
+    struct trace_chunk *next = trace.spare->next;
+    free(trace.spare);
+    trace.spare = next;
+  }
+
+  fprintf(trace.file, "\n]}\n");
+  fclose(trace.file);
+  pthread_cond_destroy(&trace.wake);
+  pthread_mutex_destroy(&trace.lock);
+}
+
+void
+trace_thread_name(const char *name)
+{
+  if(!trace.is_init)
+    return;
+  if(!self)
+    self = register_thread();
+  self->name = name;
+}
+
+void
+trace_record(const char *name, uint64_t begin_ns, uint64_t end_ns)
+{
+  if(UNLIKELY(!trace.is_init))
+    return;
+  if(UNLIKELY(!self))
+    self = register_thread();
+
+  struct trace_chunk *chunk = self->chunk;
+  chunk->events[chunk->count++] = (struct trace_event){name, begin_ns, end_ns};
+
+  if(UNLIKELY(chunk->count == TRACE_CHUNK_ZONES))
+  {
+    pthread_mutex_lock(&trace.lock);
+    if(trace.full_tail)
+      trace.full_tail->next = chunk;
+    else
+      trace.full = chunk;
+    trace.full_tail = chunk;
+    self->chunk = take_chunk(self->tid);
+    pthread_cond_signal(&trace.wake);
+    pthread_mutex_unlock(&trace.lock);
+  }
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/*
+ * Trace zones; timelines of where each thread spends its time, written as
+ * chrome trace-event json which opens in chrome://tracing or ui.perfetto.dev.
+ *
+ * Tracing is compiled in only if TRACE_ENABLED is defined (see the makefile's
+ * 'trace' target); otherwise every macro here expands to nothing and the
+ * program carries no trace code at all.
+ *
+ * Each thread records its zones into its own buffer without locking; full
+ * buffers are handed to a background thread which writes them out, so the
+ * file writes never stall a traced thread.
+ */
+
+#ifdef TRACE_ENABLED
+
+#include <stdint.h>
+#include "clock.h"
+
+/* a zone being timed; see TRACE_ZONE or TRACE_BEGIN/TRACE_END */
+struct trace_zone
+{
+  const char *name;
+  uint64_t begin_ns;
+};
+
+/* trace_init - starts a trace to be written to 'path'; zones recorded before
+ *   init or after quit are ignored. Exits the program if the file cannot be
+ *   opened. */
+void
+trace_init(const char *path);
+
+/* trace_quit - writes out the zones of all threads and closes the trace; the
+ *   traced threads other than the caller must be idle or joined. */
+void
+trace_quit();
+
+/* trace_thread_name - names the calling thread in the trace viewer; 'name'
+ *   must outlive the trace, e.g. a string literal. */
+void
+trace_thread_name(const char *name);
+
+/* trace_record - records a zone of the calling thread; O(1) except when the
+ *   thread's buffer fills and is handed to the writer. */
+void
+trace_record(const char *name, uint64_t begin_ns, uint64_t end_ns);
+
+static inline struct trace_zone
+trace_zone_begin(const char *name)
+{
+  return (struct trace_zone){name, clock_now_ns()};
+}
+
+static inline void
+trace_zone_end(struct trace_zone *zone)
+{
+  trace_record(zone->name, zone->begin_ns, clock_now_ns());
+}
+
+#define TRACE_CAT0(a, b) a ## b
+#define TRACE_CAT1(a, b) TRACE_CAT0(a, b)
+
+/**
+ * TRACE_ZONE - records the rest of the enclosing block as a zone named 'name',
+ *   a string literal, ending as the block is left by any path.
+ */
+#define TRACE_ZONE(name)                                                 \
+  struct trace_zone TRACE_CAT1(_trace_zone_, __LINE__)                   \
+    __attribute__((cleanup(trace_zone_end))) = trace_zone_begin(name)
+
+/* TRACE_BEGIN/TRACE_END - records a zone which is not a whole block. */
+#define TRACE_BEGIN(zone, name) struct trace_zone zone = trace_zone_begin(name)
+#define TRACE_END(zone) trace_zone_end(&(zone))
+
+#define TRACE_INIT(path) trace_init(path)
+#define TRACE_QUIT() trace_quit()
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+
+#else
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_BEGIN(zone, name) ((void)0)
+#define TRACE_END(zone) ((void)0)
+#define TRACE_INIT(path) ((void)0)
+#define TRACE_QUIT() ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+#endif